@@ -0,0 +1,198 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_MIN_CHUNK_SIZE (4096)
+#define ARENA_MAX_CHUNK_SIZE (64 * 1024 * 1024)
+
+struct ArenaChunk
+{
+  ArenaChunk *prev_;
+  alignas (max_align_t) char data_[];
+};
+
+static size_t
+align_up (size_t size)
+{
+  return (size + alignof (max_align_t) - 1) & ~(alignof (max_align_t) - 1);
+}
+
+Arena
+Arena_new ()
+{
+  return (Arena){ .chunk_ = NULL,
+                  .cursor_ = NULL,
+                  .end_ = NULL,
+                  .last_ = NULL,
+                  .num_allocs_ = 0,
+                  .num_bytes_ = 0,
+                  .num_chunks_ = 0,
+                  .num_reserved_bytes_ = 0 };
+}
+
+void
+Arena_drop (Arena *self)
+{
+  ArenaChunk *chunk = self->chunk_;
+  while (chunk)
+    {
+      ArenaChunk *prev = chunk->prev_;
+      free (chunk);
+      chunk = prev;
+    }
+  *self = Arena_new ();
+}
+
+static void
+Arena_grow (Arena *self, size_t size)
+{
+  size_t chunk_size = self->num_reserved_bytes_ < ARENA_MIN_CHUNK_SIZE
+                          ? ARENA_MIN_CHUNK_SIZE
+                          : self->num_reserved_bytes_;
+  if (chunk_size > ARENA_MAX_CHUNK_SIZE)
+    {
+      chunk_size = ARENA_MAX_CHUNK_SIZE;
+    }
+  if (chunk_size < size)
+    {
+      chunk_size = size;
+    }
+  ArenaChunk *chunk
+      = (ArenaChunk *)malloc (sizeof (ArenaChunk) + chunk_size);
+  if (chunk == NULL)
+    {
+      abort ();
+    }
+  chunk->prev_ = self->chunk_;
+  self->chunk_ = chunk;
+  self->cursor_ = chunk->data_;
+  self->end_ = chunk->data_ + chunk_size;
+  self->num_chunks_++;
+  self->num_reserved_bytes_ += chunk_size;
+}
+
+void *
+Arena_alloc (Arena *self, size_t size)
+{
+  size = align_up (size ? size : 1);
+  if ((size_t)(self->end_ - self->cursor_) < size)
+    {
+      Arena_grow (self, size);
+    }
+  void *ptr = self->cursor_;
+  self->cursor_ += size;
+  self->last_ = ptr;
+  self->num_allocs_++;
+  self->num_bytes_ += size;
+  return ptr;
+}
+
+void *
+Arena_realloc (Arena *self, void *ptr, size_t old_size, size_t new_size)
+{
+  if (ptr == NULL)
+    {
+      return Arena_alloc (self, new_size);
+    }
+  old_size = align_up (old_size ? old_size : 1);
+  new_size = align_up (new_size ? new_size : 1);
+  if (new_size <= old_size)
+    {
+      return ptr;
+    }
+  if (ptr == self->last_
+      && (size_t)(self->end_ - (char *)ptr) >= new_size)
+    {
+      self->cursor_ = (char *)ptr + new_size;
+      self->num_bytes_ += new_size - old_size;
+      return ptr;
+    }
+  void *new_ptr = Arena_alloc (self, new_size);
+  memcpy (new_ptr, ptr, old_size);
+  return new_ptr;
+}
+
+size_t
+Arena_num_allocs (const Arena *self)
+{
+  return self->num_allocs_;
+}
+
+size_t
+Arena_num_bytes (const Arena *self)
+{
+  return self->num_bytes_;
+}
+
+size_t
+Arena_num_chunks (const Arena *self)
+{
+  return self->num_chunks_;
+}
+
+size_t
+Arena_num_reserved_bytes (const Arena *self)
+{
+  return self->num_reserved_bytes_;
+}
+
+#ifdef TESTS
+#include "test.h"
+
+#include "vec.h"
+
+NEO_TEST (test_arena_alloc_00)
+{
+  Arena arena = Arena_new ();
+  char *a = Arena_alloc (&arena, 3);
+  char *b = Arena_alloc (&arena, 5);
+  ASSERT_U64_EQ ((uintptr_t)a % alignof (max_align_t), 0);
+  ASSERT_U64_EQ ((uintptr_t)b % alignof (max_align_t), 0);
+  ASSERT_U64_EQ (b - a, align_up (3));
+  ASSERT_U64_EQ (Arena_num_allocs (&arena), 2);
+  ASSERT_U64_EQ (Arena_num_chunks (&arena), 1);
+  Arena_alloc (&arena, 2 * ARENA_MIN_CHUNK_SIZE);
+  ASSERT_U64_EQ (Arena_num_chunks (&arena), 2);
+  Arena_drop (&arena);
+  ASSERT_U64_EQ (Arena_num_allocs (&arena), 0);
+}
+
+NEO_TEST (test_arena_realloc_00)
+{
+  Arena arena = Arena_new ();
+  char *a = Arena_alloc (&arena, 16);
+  memset (a, 'a', 16);
+  ASSERT_U64_EQ ((uintptr_t)Arena_realloc (&arena, a, 16, 64), (uintptr_t)a);
+  Arena_alloc (&arena, 16);
+  char *c = Arena_realloc (&arena, a, 64, 128);
+  ASSERT_U64_EQ (c == a, 0);
+  ASSERT_U64_EQ (c[15], 'a');
+  ASSERT_U64_EQ (Arena_num_allocs (&arena), 3);
+  Arena_drop (&arena);
+}
+
+NEO_TEST (test_arena_vec_00)
+{
+  Arena arena = Arena_new ();
+  Vec_u32 vec = Vec_u32_new_in (&arena);
+  for (uint32_t i = 0; i < 1000; i++)
+    {
+      Vec_u32_push (&vec, i);
+    }
+  ASSERT_U64_EQ (Vec_u32_len (&vec), 1000);
+  ASSERT_U64_EQ (Vec_u32_cbegin (&vec)[999], 999);
+  /* A lone growing vector is always the last allocation.  */
+  ASSERT_U64_EQ (Arena_num_allocs (&arena), 1);
+  Vec_u32_drop (&vec);
+  Arena_drop (&arena);
+}
+
+NEO_TESTS (arena_tests, test_arena_alloc_00, test_arena_realloc_00,
+           test_arena_vec_00)
+#endif
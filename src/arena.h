@@ -0,0 +1,41 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_ARENA_H
+#define NEO_ARENA_H
+
+#include <stddef.h>
+
+typedef struct ArenaChunk ArenaChunk;
+
+/* A bump allocator.  Memory is only returned to the system when the whole
+ * arena is dropped, which frees every chunk at once.  */
+typedef struct Arena
+{
+  ArenaChunk *chunk_;
+  char *cursor_;
+  char *end_;
+  void *last_;
+  size_t num_allocs_;
+  size_t num_bytes_;
+  size_t num_chunks_;
+  size_t num_reserved_bytes_;
+} Arena;
+
+Arena Arena_new ();
+void Arena_drop (Arena *self);
+void *Arena_alloc (Arena *self, size_t size);
+/* Grows the allocation in place if it is the last one, otherwise copies it
+ * to a new block.  The old block is not reused.  */
+void *Arena_realloc (Arena *self, void *ptr, size_t old_size,
+                     size_t new_size);
+size_t Arena_num_allocs (const Arena *self);
+size_t Arena_num_bytes (const Arena *self);
+size_t Arena_num_chunks (const Arena *self);
+size_t Arena_num_reserved_bytes (const Arena *self);
+
+#ifdef TESTS
+#include "test.h"
+Tests arena_tests ();
+#endif
+
+#endif
@@ -5,13 +5,19 @@
 #include <assert.h>
 #include <stdbool.h>
 
+#include "arena.h"
 #include "array_macro.h"
+#include "big_int.h"
+#include "int64.h"
 #include "span.h"
 #include "token.h"
 #include "vec_macro.h"
 
 NEO_IMPL_VEC (ASTNodeId, ASTNodeId)
 NEO_IMPL_VEC (ASTNode, ASTNode)
+NEO_IMPL_VEC (ASTKind, enum ASTKind)
+NEO_IMPL_VEC (CompactSpan, CompactSpan)
+NEO_IMPL_VEC (ASTPayload, ASTPayload)
 
 NEO_IMPL_ARRAY (ASTKind, enum ASTKind)
 
@@ -39,155 +45,653 @@ is_invalid_ast_node_id (ASTNodeId id)
   return id == 1;
 }
 
+/* Drops the Ints pooled after there were NUM_INTEGERS of them.  */
+static void
+ASTNodeManager_truncate_integers (ASTNodeManager *self, size_t num_integers)
+{
+  assert (num_integers <= Vec_BigInt_len (&self->integers_));
+  while (Vec_BigInt_len (&self->integers_) > num_integers)
+    {
+      BigInt integer = Vec_BigInt_pop (&self->integers_);
+      BigInt_drop (&integer);
+    }
+}
+
 ASTNodeManager
 ASTNodeManager_new ()
 {
-  Vec_ASTNode nodes = Vec_ASTNode_new ();
-  Vec_ASTNode_push (&nodes, (ASTNode){ .kind_ = AST_NULL });
-  Vec_ASTNode_push (&nodes, (ASTNode){ .kind_ = AST_INVALID });
-  return (ASTNodeManager){ .nodes_ = nodes };
+  return ASTNodeManager_new_in (NULL);
+}
+
+#ifdef NEO_AST_AOS
+ASTNodeManager
+ASTNodeManager_new_in (Arena *arena)
+{
+  ASTNodeManager self = { .arena_ = arena,
+                          .nodes_ = Vec_ASTNode_new_in (arena),
+                          .ids_ = Vec_ASTNodeId_new_in (arena),
+                          .integers_ = Vec_BigInt_new_in (arena) };
+  Vec_ASTNode_push (&self.nodes_, (ASTNode){ .kind_ = AST_NULL });
+  Vec_ASTNode_push (&self.nodes_, (ASTNode){ .kind_ = AST_INVALID });
+  return self;
 }
 
 void
 ASTNodeManager_drop (ASTNodeManager *self)
 {
-  for (ASTNode *ptr = Vec_ASTNode_begin (&self->nodes_);
-       ptr < Vec_ASTNode_end (&self->nodes_); ptr++)
-    {
-      switch (ptr->kind_)
-        {
-        case AST_LET:
-          {
-            Vec_ASTNodeId_drop (&ptr->let_.vars_);
-            Vec_ASTNodeId_drop (&ptr->let_.types_);
-            Vec_ASTNodeId_drop (&ptr->let_.inits_);
-            break;
-          }
-        case AST_LAMBDA:
-          {
-            Vec_ASTNodeId_drop (&ptr->lambda_.vars_);
-            Vec_ASTNodeId_drop (&ptr->lambda_.types_);
-            break;
-          }
-        case AST_TUPLE:
-          {
-            Vec_ASTNodeId_drop (&ptr->tuple_.args_);
-            break;
-          }
-        default:
-          break;
-        }
-    }
   Vec_ASTNode_drop (&self->nodes_);
+  Vec_ASTNodeId_drop (&self->ids_);
+  ASTNodeManager_truncate_integers (self, 0);
+  Vec_BigInt_drop (&self->integers_);
 }
 
-const Vec_ASTNode *
-ASTNodeManager_get_nodes (const ASTNodeManager *self)
+size_t
+ASTNodeManager_num_nodes (const ASTNodeManager *self)
 {
-  return &self->nodes_;
+  return Vec_ASTNode_len (&self->nodes_);
 }
 
-ASTNodeId
-ASTNodeManager_get_id (const ASTNodeManager *self, const ASTNode *node)
+ASTNode
+ASTNodeManager_get_node (const ASTNodeManager *self, ASTNodeId id)
 {
-  assert (node >= Vec_ASTNode_cbegin (&self->nodes_));
-  assert (node < Vec_ASTNode_cend (&self->nodes_));
-  return node - Vec_ASTNode_cbegin (&self->nodes_);
+  assert (id < Vec_ASTNode_len (&self->nodes_));
+  return Vec_ASTNode_cbegin (&self->nodes_)[id];
 }
 
-const ASTNode *
-ASTNodeManager_get_node (const ASTNodeManager *self, ASTNodeId id)
+enum ASTKind
+ASTNodeManager_get_kind (const ASTNodeManager *self, ASTNodeId id)
 {
   assert (id < Vec_ASTNode_len (&self->nodes_));
-  return Vec_ASTNode_cbegin (&self->nodes_) + id;
+  return Vec_ASTNode_cbegin (&self->nodes_)[id].kind_;
 }
 
-const Span *
+const CompactSpan *
 ASTNodeManager_get_span (const ASTNodeManager *self, ASTNodeId id)
 {
   assert (id < Vec_ASTNode_len (&self->nodes_));
-  return &(Vec_ASTNode_cbegin (&self->nodes_) + id)->span_;
+  return &Vec_ASTNode_cbegin (&self->nodes_)[id].span_;
+}
+
+const ASTPayload *
+ASTNodeManager_get_payload (const ASTNodeManager *self, ASTNodeId id)
+{
+  assert (id < Vec_ASTNode_len (&self->nodes_));
+  return &Vec_ASTNode_cbegin (&self->nodes_)[id].payload_;
+}
+
+size_t
+ASTNodeManager_num_bytes (const ASTNodeManager *self)
+{
+  return Vec_ASTNode_capacity (&self->nodes_) * sizeof (ASTNode)
+         + Vec_ASTNodeId_capacity (&self->ids_) * sizeof (ASTNodeId)
+         + Vec_BigInt_capacity (&self->integers_) * sizeof (BigInt);
+}
+
+void
+ASTNodeManager_reserve (ASTNodeManager *self, size_t num_nodes)
+{
+  Vec_ASTNode_reserve (&self->nodes_, num_nodes);
+}
+
+void
+ASTNodeManager_shrink_to_fit (ASTNodeManager *self)
+{
+  Vec_ASTNode_shrink_to_fit (&self->nodes_);
+  Vec_ASTNodeId_shrink_to_fit (&self->ids_);
+  Vec_BigInt_shrink_to_fit (&self->integers_);
 }
 
 static ASTNodeId
-ASTNodeManager_get_next_id (const ASTNodeManager *self)
+ASTNodeManager_push (ASTNodeManager *self, ASTNode node)
 {
-  return Vec_ASTNode_len (&self->nodes_);
+  ASTNodeId id = Vec_ASTNode_len (&self->nodes_);
+  Vec_ASTNode_push (&self->nodes_, node);
+  return id;
 }
 
-ASTNodeId
-ASTNodeManager_push_lit (ASTNodeManager *self, Span span, enum ASTKind kind)
+static void
+ASTNodeManager_truncate_nodes (ASTNodeManager *self, size_t num_nodes)
 {
-  ASTNodeId id = ASTNodeManager_get_next_id (self);
-  Vec_ASTNode_push (&self->nodes_, (ASTNode){
-                                       .kind_ = kind,
-                                       .span_ = span,
-                                   });
+  assert (num_nodes <= Vec_ASTNode_len (&self->nodes_));
+  Vec_ASTNode_resize (&self->nodes_, num_nodes, (ASTNode){ 0 });
+}
+
+static CompactSpan *
+ASTNodeManager_span_at (ASTNodeManager *self, ASTNodeId id)
+{
+  assert (id < Vec_ASTNode_len (&self->nodes_));
+  return &Vec_ASTNode_begin (&self->nodes_)[id].span_;
+}
+
+static ASTPayload *
+ASTNodeManager_payload_at (ASTNodeManager *self, ASTNodeId id)
+{
+  assert (id < Vec_ASTNode_len (&self->nodes_));
+  return &Vec_ASTNode_begin (&self->nodes_)[id].payload_;
+}
+#else
+static ASTNodeId
+ASTNodeManager_push (ASTNodeManager *self, ASTNode node)
+{
+  ASTNodeId id = Vec_ASTKind_len (&self->kinds_);
+  Vec_ASTKind_push (&self->kinds_, node.kind_);
+  Vec_CompactSpan_push (&self->spans_, node.span_);
+  Vec_ASTPayload_push (&self->payloads_, node.payload_);
   return id;
 }
 
+static void
+ASTNodeManager_truncate_nodes (ASTNodeManager *self, size_t num_nodes)
+{
+  assert (num_nodes <= Vec_ASTKind_len (&self->kinds_));
+  Vec_ASTKind_resize (&self->kinds_, num_nodes, AST_NULL);
+  Vec_CompactSpan_resize (&self->spans_, num_nodes, (CompactSpan){ 0 });
+  Vec_ASTPayload_resize (&self->payloads_, num_nodes, (ASTPayload){ 0 });
+}
+
+static CompactSpan *
+ASTNodeManager_span_at (ASTNodeManager *self, ASTNodeId id)
+{
+  assert (id < Vec_CompactSpan_len (&self->spans_));
+  return Vec_CompactSpan_begin (&self->spans_) + id;
+}
+
+static ASTPayload *
+ASTNodeManager_payload_at (ASTNodeManager *self, ASTNodeId id)
+{
+  assert (id < Vec_ASTPayload_len (&self->payloads_));
+  return Vec_ASTPayload_begin (&self->payloads_) + id;
+}
+
+ASTNodeManager
+ASTNodeManager_new_in (Arena *arena)
+{
+  ASTNodeManager self = { .arena_ = arena,
+                          .kinds_ = Vec_ASTKind_new_in (arena),
+                          .spans_ = Vec_CompactSpan_new_in (arena),
+                          .payloads_ = Vec_ASTPayload_new_in (arena),
+                          .ids_ = Vec_ASTNodeId_new_in (arena),
+                          .integers_ = Vec_BigInt_new_in (arena) };
+  ASTNodeManager_push (&self, (ASTNode){ .kind_ = AST_NULL });
+  ASTNodeManager_push (&self, (ASTNode){ .kind_ = AST_INVALID });
+  return self;
+}
+
+void
+ASTNodeManager_drop (ASTNodeManager *self)
+{
+  Vec_ASTKind_drop (&self->kinds_);
+  Vec_CompactSpan_drop (&self->spans_);
+  Vec_ASTPayload_drop (&self->payloads_);
+  Vec_ASTNodeId_drop (&self->ids_);
+  ASTNodeManager_truncate_integers (self, 0);
+  Vec_BigInt_drop (&self->integers_);
+}
+
+size_t
+ASTNodeManager_num_nodes (const ASTNodeManager *self)
+{
+  return Vec_ASTKind_len (&self->kinds_);
+}
+
+ASTNode
+ASTNodeManager_get_node (const ASTNodeManager *self, ASTNodeId id)
+{
+  return (ASTNode){ .kind_ = ASTNodeManager_get_kind (self, id),
+                    .span_ = *ASTNodeManager_get_span (self, id),
+                    .payload_ = *ASTNodeManager_get_payload (self, id) };
+}
+
+enum ASTKind
+ASTNodeManager_get_kind (const ASTNodeManager *self, ASTNodeId id)
+{
+  assert (id < Vec_ASTKind_len (&self->kinds_));
+  return Vec_ASTKind_cbegin (&self->kinds_)[id];
+}
+
+const CompactSpan *
+ASTNodeManager_get_span (const ASTNodeManager *self, ASTNodeId id)
+{
+  assert (id < Vec_CompactSpan_len (&self->spans_));
+  return Vec_CompactSpan_cbegin (&self->spans_) + id;
+}
+
+const ASTPayload *
+ASTNodeManager_get_payload (const ASTNodeManager *self, ASTNodeId id)
+{
+  assert (id < Vec_ASTPayload_len (&self->payloads_));
+  return Vec_ASTPayload_cbegin (&self->payloads_) + id;
+}
+
+size_t
+ASTNodeManager_num_bytes (const ASTNodeManager *self)
+{
+  return Vec_ASTKind_capacity (&self->kinds_) * sizeof (enum ASTKind)
+         + Vec_CompactSpan_capacity (&self->spans_) * sizeof (CompactSpan)
+         + Vec_ASTPayload_capacity (&self->payloads_) * sizeof (ASTPayload)
+         + Vec_ASTNodeId_capacity (&self->ids_) * sizeof (ASTNodeId)
+         + Vec_BigInt_capacity (&self->integers_) * sizeof (BigInt);
+}
+
+void
+ASTNodeManager_reserve (ASTNodeManager *self, size_t num_nodes)
+{
+  Vec_ASTKind_reserve (&self->kinds_, num_nodes);
+  Vec_CompactSpan_reserve (&self->spans_, num_nodes);
+  Vec_ASTPayload_reserve (&self->payloads_, num_nodes);
+}
+
+void
+ASTNodeManager_shrink_to_fit (ASTNodeManager *self)
+{
+  Vec_ASTKind_shrink_to_fit (&self->kinds_);
+  Vec_CompactSpan_shrink_to_fit (&self->spans_);
+  Vec_ASTPayload_shrink_to_fit (&self->payloads_);
+  Vec_ASTNodeId_shrink_to_fit (&self->ids_);
+  Vec_BigInt_shrink_to_fit (&self->integers_);
+}
+
+#endif
+
+const ASTNodeId *
+ASTNodeManager_get_let_vars (const ASTNodeManager *self, const ASTLet *let)
+{
+  assert (let->ids_ + 3 * let->num_vars_ <= Vec_ASTNodeId_len (&self->ids_));
+  return Vec_ASTNodeId_cbegin (&self->ids_) + let->ids_;
+}
+
+const ASTNodeId *
+ASTNodeManager_get_let_types (const ASTNodeManager *self, const ASTLet *let)
+{
+  return ASTNodeManager_get_let_vars (self, let) + let->num_vars_;
+}
+
+const ASTNodeId *
+ASTNodeManager_get_let_inits (const ASTNodeManager *self, const ASTLet *let)
+{
+  return ASTNodeManager_get_let_vars (self, let) + 2 * let->num_vars_;
+}
+
+const ASTNodeId *
+ASTNodeManager_get_lambda_vars (const ASTNodeManager *self,
+                                const ASTLambda *lambda)
+{
+  assert (lambda->ids_ + 2 * lambda->num_vars_
+          <= Vec_ASTNodeId_len (&self->ids_));
+  return Vec_ASTNodeId_cbegin (&self->ids_) + lambda->ids_;
+}
+
+const ASTNodeId *
+ASTNodeManager_get_lambda_types (const ASTNodeManager *self,
+                                 const ASTLambda *lambda)
+{
+  return ASTNodeManager_get_lambda_vars (self, lambda) + lambda->num_vars_;
+}
+
+const ASTNodeId *
+ASTNodeManager_get_tuple_args (const ASTNodeManager *self,
+                               const ASTTuple *tuple)
+{
+  assert (tuple->ids_ + tuple->num_args_ <= Vec_ASTNodeId_len (&self->ids_));
+  return Vec_ASTNodeId_cbegin (&self->ids_) + tuple->ids_;
+}
+
+const ASTNodeId *
+ASTNodeManager_get_ids (const ASTNodeManager *self)
+{
+  return Vec_ASTNodeId_cbegin (&self->ids_);
+}
+
+size_t
+ASTNodeManager_num_ids (const ASTNodeManager *self)
+{
+  return Vec_ASTNodeId_len (&self->ids_);
+}
+
+bool
+ASTNodeManager_get_int64 (const ASTNodeManager *self, const SourceFile *file,
+                          ASTNodeId id, int64_t *value)
+{
+  assert (ASTNodeManager_get_kind (self, id) == AST_LIT_INTEGER);
+  const ASTInteger *integer = &ASTNodeManager_get_payload (self, id)->integer_;
+  switch (integer->kind_)
+    {
+    case AST_INTEGER_INT64:
+      {
+        *value = (int64_t)((uint64_t)integer->high_ << 32 | integer->low_);
+        return true;
+      }
+    case AST_INTEGER_INT:
+      {
+        return false;
+      }
+    default:
+      {
+        Span text = SourceFile_get_span (
+            file, *ASTNodeManager_get_span (self, id));
+        return Int64_from_str (Span_cbegin (&text), Span_len (&text), value);
+      }
+    }
+}
+
+BigInt
+ASTNodeManager_get_integer (const ASTNodeManager *self, const SourceFile *file,
+                            ASTNodeId id)
+{
+  assert (ASTNodeManager_get_kind (self, id) == AST_LIT_INTEGER);
+  const ASTInteger *integer = &ASTNodeManager_get_payload (self, id)->integer_;
+  switch (integer->kind_)
+    {
+    case AST_INTEGER_INT64:
+      {
+        int64_t value = 0;
+        ASTNodeManager_get_int64 (self, file, id, &value);
+        return BigInt_from_i64 (value);
+      }
+    case AST_INTEGER_INT:
+      {
+        assert (integer->low_ < Vec_BigInt_len (&self->integers_));
+        return BigInt_clone (Vec_BigInt_cbegin (&self->integers_)
+                             + integer->low_);
+      }
+    default:
+      {
+        Span text = SourceFile_get_span (
+            file, *ASTNodeManager_get_span (self, id));
+        Option_BigInt value
+            = BigInt_from_str (Span_cbegin (&text), Span_len (&text));
+        return Option_BigInt_unwrap (&value);
+      }
+    }
+}
+
+void
+ASTNodeManager_truncate (ASTNodeManager *self, size_t num_nodes,
+                         size_t num_ids)
+{
+  assert (num_ids <= Vec_ASTNodeId_len (&self->ids_));
+  /* The Ints are pooled in the order of their nodes, so the first dropped
+   * one is that of the first dropped Int literal.  */
+  size_t len = ASTNodeManager_num_nodes (self);
+  for (ASTNodeId id = num_nodes; id < len; id++)
+    {
+      if (ASTNodeManager_get_kind (self, id) == AST_LIT_INTEGER
+          && ASTNodeManager_get_payload (self, id)->integer_.kind_
+                 == AST_INTEGER_INT)
+        {
+          ASTNodeManager_truncate_integers (
+              self, ASTNodeManager_get_payload (self, id)->integer_.low_);
+          break;
+        }
+    }
+  ASTNodeManager_truncate_nodes (self, num_nodes);
+  Vec_ASTNodeId_resize (&self->ids_, num_ids, 0);
+}
+
+void
+ASTNodeManager_set_span (ASTNodeManager *self, ASTNodeId id, CompactSpan span)
+{
+  *ASTNodeManager_span_at (self, id) = span;
+}
+
+void
+ASTNodeManager_shift_spans (ASTNodeManager *self, size_t num_nodes,
+                            uint32_t offset, int64_t delta)
+{
+  assert (num_nodes <= ASTNodeManager_num_nodes (self));
+  for (ASTNodeId id = get_invalid_ast_node_id () + 1; id < num_nodes; id++)
+    {
+      CompactSpan *span = ASTNodeManager_span_at (self, id);
+      if (span->offset_ >= offset)
+        {
+          span->offset_ += delta;
+        }
+    }
+}
+
+static void
+replace_id (ASTNodeId *ids, size_t len, ASTNodeId old_id, ASTNodeId new_id)
+{
+  for (size_t i = 0; i < len; i++)
+    {
+      if (ids[i] == old_id)
+        {
+          ids[i] = new_id;
+        }
+    }
+}
+
+void
+ASTNodeManager_replace_child (ASTNodeManager *self, ASTNodeId parent,
+                              ASTNodeId old_child, ASTNodeId new_child)
+{
+  ASTPayload *payload = ASTNodeManager_payload_at (self, parent);
+  ASTNodeId *ids = Vec_ASTNodeId_begin (&self->ids_);
+  switch (ASTNodeManager_get_kind (self, parent))
+    {
+    case AST_IF_THEN_ELSE:
+      replace_id (&payload->if_then_else_.if_expr_, 1, old_child, new_child);
+      replace_id (&payload->if_then_else_.then_expr_, 1, old_child,
+                  new_child);
+      replace_id (&payload->if_then_else_.else_expr_, 1, old_child,
+                  new_child);
+      break;
+    case AST_LET:
+      replace_id (ids + payload->let_.ids_, 3 * payload->let_.num_vars_,
+                  old_child, new_child);
+      replace_id (&payload->let_.body_, 1, old_child, new_child);
+      break;
+    case AST_LAMBDA:
+      replace_id (ids + payload->lambda_.ids_, 2 * payload->lambda_.num_vars_,
+                  old_child, new_child);
+      replace_id (&payload->lambda_.body_, 1, old_child, new_child);
+      break;
+    case AST_TUPLE:
+      replace_id (ids + payload->tuple_.ids_, payload->tuple_.num_args_,
+                  old_child, new_child);
+      break;
+    case AST_CALL:
+      replace_id (&payload->call_.base_, 1, old_child, new_child);
+      replace_id (&payload->call_.tuple_, 1, old_child, new_child);
+      break;
+    case AST_POSITIVE:
+    case AST_NEGATIVE:
+      replace_id (&payload->unary_.expr_, 1, old_child, new_child);
+      break;
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MUL:
+    case AST_DIV:
+    case AST_EQ:
+    case AST_NEQ:
+    case AST_LE:
+    case AST_GE:
+    case AST_LT:
+    case AST_GT:
+      replace_id (&payload->binary_.left_, 1, old_child, new_child);
+      replace_id (&payload->binary_.right_, 1, old_child, new_child);
+      break;
+    default:
+      assert (false);
+      break;
+    }
+}
+
+void
+ASTNodeManager_push_children (const ASTNodeManager *self, ASTNodeId id,
+                              Vec_ASTNodeId *children)
+{
+  const ASTPayload *payload = ASTNodeManager_get_payload (self, id);
+  switch (ASTNodeManager_get_kind (self, id))
+    {
+    case AST_IF_THEN_ELSE:
+      Vec_ASTNodeId_push (children, payload->if_then_else_.if_expr_);
+      Vec_ASTNodeId_push (children, payload->if_then_else_.then_expr_);
+      Vec_ASTNodeId_push (children, payload->if_then_else_.else_expr_);
+      break;
+    case AST_LET:
+      {
+        const ASTLet *let = &payload->let_;
+        for (uint32_t i = 0; i < let->num_vars_; i++)
+          {
+            Vec_ASTNodeId_push (children,
+                                ASTNodeManager_get_let_vars (self, let)[i]);
+            Vec_ASTNodeId_push (children,
+                                ASTNodeManager_get_let_types (self, let)[i]);
+            Vec_ASTNodeId_push (children,
+                                ASTNodeManager_get_let_inits (self, let)[i]);
+          }
+        Vec_ASTNodeId_push (children, let->body_);
+        break;
+      }
+    case AST_LAMBDA:
+      {
+        const ASTLambda *lambda = &payload->lambda_;
+        for (uint32_t i = 0; i < lambda->num_vars_; i++)
+          {
+            Vec_ASTNodeId_push (
+                children, ASTNodeManager_get_lambda_vars (self, lambda)[i]);
+            Vec_ASTNodeId_push (
+                children, ASTNodeManager_get_lambda_types (self, lambda)[i]);
+          }
+        Vec_ASTNodeId_push (children, lambda->body_);
+        break;
+      }
+    case AST_TUPLE:
+      for (uint32_t i = 0; i < payload->tuple_.num_args_; i++)
+        {
+          Vec_ASTNodeId_push (children, ASTNodeManager_get_tuple_args (
+                                            self, &payload->tuple_)[i]);
+        }
+      break;
+    case AST_CALL:
+      Vec_ASTNodeId_push (children, payload->call_.base_);
+      Vec_ASTNodeId_push (children, payload->call_.tuple_);
+      break;
+    case AST_POSITIVE:
+    case AST_NEGATIVE:
+      Vec_ASTNodeId_push (children, payload->unary_.expr_);
+      break;
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MUL:
+    case AST_DIV:
+    case AST_EQ:
+    case AST_NEQ:
+    case AST_LE:
+    case AST_GE:
+    case AST_LT:
+    case AST_GT:
+      Vec_ASTNodeId_push (children, payload->binary_.left_);
+      Vec_ASTNodeId_push (children, payload->binary_.right_);
+      break;
+    default:
+      break;
+    }
+}
+
+/* Appends the ids to the pool and returns the offset of the first one.  */
+static uint32_t
+ASTNodeManager_push_ids (ASTNodeManager *self, const ASTNodeId *ids,
+                         size_t len)
+{
+  uint32_t offset = Vec_ASTNodeId_len (&self->ids_);
+  Vec_ASTNodeId_extend (&self->ids_, ids, len);
+  return offset;
+}
+
+ASTNodeId
+ASTNodeManager_push_lit (ASTNodeManager *self, CompactSpan span,
+                         enum ASTKind kind)
+{
+  return ASTNodeManager_push (self, (ASTNode){ .kind_ = kind, .span_ = span });
+}
+
+ASTNodeId
+ASTNodeManager_push_int64 (ASTNodeManager *self, CompactSpan span,
+                           int64_t value)
+{
+  return ASTNodeManager_push (
+      self, (ASTNode){ .kind_ = AST_LIT_INTEGER,
+                       .span_ = span,
+                       .payload_.integer_
+                       = (ASTInteger){ .kind_ = AST_INTEGER_INT64,
+                                       .low_ = (uint32_t)value,
+                                       .high_ = (uint64_t)value >> 32 } });
+}
+
+ASTNodeId
+ASTNodeManager_push_integer (ASTNodeManager *self, CompactSpan span,
+                             BigInt value)
+{
+  uint32_t index = Vec_BigInt_len (&self->integers_);
+  Vec_BigInt_push (&self->integers_, value);
+  return ASTNodeManager_push (
+      self,
+      (ASTNode){ .kind_ = AST_LIT_INTEGER,
+                 .span_ = span,
+                 .payload_.integer_ = (ASTInteger){ .kind_ = AST_INTEGER_INT,
+                                                    .low_ = index } });
+}
+
 ASTNodeId
-ASTNodeManager_push_if_then_else (ASTNodeManager *self, Span span,
+ASTNodeManager_push_if_then_else (ASTNodeManager *self, CompactSpan span,
                                   ASTNodeId if_expr, ASTNodeId then_expr,
                                   ASTNodeId else_expr)
 {
-  ASTNodeId id = ASTNodeManager_get_next_id (self);
-  Vec_ASTNode_push (&self->nodes_, (ASTNode){ .kind_ = AST_IF_THEN_ELSE,
-                                              .span_ = span,
-                                              .if_then_else_ = (ASTIfThenElse){
-                                                  .if_expr_ = if_expr,
-                                                  .then_expr_ = then_expr,
-                                                  .else_expr_ = else_expr } });
-  return id;
+  return ASTNodeManager_push (
+      self, (ASTNode){ .kind_ = AST_IF_THEN_ELSE,
+                       .span_ = span,
+                       .payload_.if_then_else_
+                       = (ASTIfThenElse){ .if_expr_ = if_expr,
+                                          .then_expr_ = then_expr,
+                                          .else_expr_ = else_expr } });
 }
 
 ASTNodeId
-ASTNodeManager_push_var (ASTNodeManager *self, Span span)
+ASTNodeManager_push_var (ASTNodeManager *self, CompactSpan span)
 {
-  ASTNodeId id = ASTNodeManager_get_next_id (self);
-  Vec_ASTNode_push (&self->nodes_,
-                    (ASTNode){ .kind_ = AST_VAR, .span_ = span });
-  return id;
+  return ASTNodeManager_push (self,
+                              (ASTNode){ .kind_ = AST_VAR, .span_ = span });
 }
 
 ASTNodeId
-ASTNodeManager_push_type (ASTNodeManager *self, Span span)
+ASTNodeManager_push_type (ASTNodeManager *self, CompactSpan span)
 {
-  ASTNodeId id = ASTNodeManager_get_next_id (self);
-  Vec_ASTNode_push (&self->nodes_,
-                    (ASTNode){ .kind_ = AST_TYPE, .span_ = span });
-  return id;
+  return ASTNodeManager_push (self,
+                              (ASTNode){ .kind_ = AST_TYPE, .span_ = span });
 }
 
 ASTNodeId
-ASTNodeManager_push_let (ASTNodeManager *self, Span span, Vec_ASTNodeId vars,
-                         Vec_ASTNodeId types, Vec_ASTNodeId inits,
+ASTNodeManager_push_let (ASTNodeManager *self, CompactSpan span,
+                         const ASTNodeId *vars, const ASTNodeId *types,
+                         const ASTNodeId *inits, size_t num_vars,
                          ASTNodeId body)
 {
-  ASTNodeId id = ASTNodeManager_get_next_id (self);
-  Vec_ASTNode_push (&self->nodes_,
-                    (ASTNode){ .kind_ = AST_LET,
-                               .span_ = span,
-                               .let_ = (ASTLet){ .vars_ = vars,
-                                                 .types_ = types,
-                                                 .inits_ = inits,
-                                                 .body_ = body } });
-  return id;
+  uint32_t ids = ASTNodeManager_push_ids (self, vars, num_vars);
+  ASTNodeManager_push_ids (self, types, num_vars);
+  ASTNodeManager_push_ids (self, inits, num_vars);
+  return ASTNodeManager_push (
+      self, (ASTNode){ .kind_ = AST_LET,
+                       .span_ = span,
+                       .payload_.let_ = (ASTLet){ .ids_ = ids,
+                                                  .num_vars_ = num_vars,
+                                                  .body_ = body } });
 }
 
 ASTNodeId
-ASTNodeManager_push_lambda (ASTNodeManager *self, Span span,
-                            Vec_ASTNodeId vars, Vec_ASTNodeId types,
-                            ASTNodeId body)
-{
-  ASTNodeId id = ASTNodeManager_get_next_id (self);
-  Vec_ASTNode_push (&self->nodes_,
-                    (ASTNode){ .kind_ = AST_LAMBDA,
-                               .span_ = span,
-                               .lambda_ = (ASTLambda){ .vars_ = vars,
-                                                       .types_ = types,
-                                                       .body_ = body } });
-  return id;
+ASTNodeManager_push_lambda (ASTNodeManager *self, CompactSpan span,
+                            const ASTNodeId *vars, const ASTNodeId *types,
+                            size_t num_vars, ASTNodeId body)
+{
+  uint32_t ids = ASTNodeManager_push_ids (self, vars, num_vars);
+  ASTNodeManager_push_ids (self, types, num_vars);
+  return ASTNodeManager_push (
+      self, (ASTNode){ .kind_ = AST_LAMBDA,
+                       .span_ = span,
+                       .payload_.lambda_ = (ASTLambda){ .ids_ = ids,
+                                                        .num_vars_ = num_vars,
+                                                        .body_ = body } });
 }
 
 static enum ASTKind
@@ -224,50 +728,47 @@ op_to_ast (enum TokenKind op)
 }
 
 ASTNodeId
-ASTNodeManager_push_tuple (ASTNodeManager *self, Span span, Vec_ASTNodeId args)
+ASTNodeManager_push_tuple (ASTNodeManager *self, CompactSpan span,
+                           const ASTNodeId *args, size_t num_args)
 {
-  ASTNodeId id = ASTNodeManager_get_next_id (self);
-  Vec_ASTNode_push (&self->nodes_,
-                    (ASTNode){ .kind_ = AST_TUPLE,
-                               .span_ = span,
-                               .tuple_ = (ASTTuple){ .args_ = args } });
-  return id;
+  uint32_t ids = ASTNodeManager_push_ids (self, args, num_args);
+  return ASTNodeManager_push (
+      self, (ASTNode){ .kind_ = AST_TUPLE,
+                       .span_ = span,
+                       .payload_.tuple_
+                       = (ASTTuple){ .ids_ = ids, .num_args_ = num_args } });
 }
 
 ASTNodeId
-ASTNodeManager_push_call (ASTNodeManager *self, Span span, ASTNodeId base,
-                          ASTNodeId tuple)
+ASTNodeManager_push_call (ASTNodeManager *self, CompactSpan span,
+                          ASTNodeId base, ASTNodeId tuple)
 {
-  ASTNodeId id = ASTNodeManager_get_next_id (self);
-  Vec_ASTNode_push (
-      &self->nodes_,
-      (ASTNode){ .kind_ = AST_CALL,
-                 .span_ = span,
-                 .call_ = (ASTCall){ .base_ = base, .tuple_ = tuple } });
-  return id;
+  return ASTNodeManager_push (
+      self, (ASTNode){ .kind_ = AST_CALL,
+                       .span_ = span,
+                       .payload_.call_
+                       = (ASTCall){ .base_ = base, .tuple_ = tuple } });
 }
 
 ASTNodeId
-ASTNodeManager_push_unary (ASTNodeManager *self, Span span, enum TokenKind op,
-                           ASTNodeId expr)
-{
-  ASTNodeId id = ASTNodeManager_get_next_id (self);
-  Vec_ASTNode_push (&self->nodes_,
-                    (ASTNode){ .kind_ = op_to_ast (op),
-                               .span_ = span,
-                               .unary_ = (ASTUnary){ .expr_ = expr } });
-  return id;
+ASTNodeManager_push_unary (ASTNodeManager *self, CompactSpan span,
+                           enum TokenKind op, ASTNodeId expr)
+{
+  assert (op == TOKEN_PLUS || op == TOKEN_HYPHEN);
+  return ASTNodeManager_push (
+      self, (ASTNode){ .kind_ = op == TOKEN_PLUS ? AST_POSITIVE : AST_NEGATIVE,
+                       .span_ = span,
+                       .payload_.unary_ = (ASTUnary){ .expr_ = expr } });
 }
 
 ASTNodeId
-ASTNodeManager_push_binary (ASTNodeManager *self, Span span, enum TokenKind op,
-                            ASTNodeId left, ASTNodeId right)
+ASTNodeManager_push_binary (ASTNodeManager *self, CompactSpan span,
+                            enum TokenKind op, ASTNodeId left,
+                            ASTNodeId right)
 {
-  ASTNodeId id = ASTNodeManager_get_next_id (self);
-  Vec_ASTNode_push (
-      &self->nodes_,
-      (ASTNode){ .kind_ = op_to_ast (op),
-                 .span_ = span,
-                 .binary_ = (ASTBinary){ .left_ = left, .right_ = right } });
-  return id;
+  return ASTNodeManager_push (
+      self, (ASTNode){ .kind_ = op_to_ast (op),
+                       .span_ = span,
+                       .payload_.binary_
+                       = (ASTBinary){ .left_ = left, .right_ = right } });
 }
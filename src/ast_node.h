@@ -5,7 +5,9 @@
 
 #include <stdint.h>
 
+#include "arena.h"
 #include "array_macro.h"
+#include "big_int.h"
 #include "span.h"
 #include "token.h"
 #include "vec_macro.h"
@@ -37,24 +39,27 @@ typedef struct ASTIfThenElse
   ASTNodeId else_expr_;
 } ASTIfThenElse;
 
+/* Variable-length child lists live in the manager's id pool.  A let stores
+ * its vars, types and inits back to back, each `num_vars_` long.  */
 typedef struct ASTLet
 {
-  Vec_ASTNodeId vars_;
-  Vec_ASTNodeId types_;
-  Vec_ASTNodeId inits_;
+  uint32_t ids_;
+  uint32_t num_vars_;
   ASTNodeId body_;
 } ASTLet;
 
+/* The vars and types, each `num_vars_` long.  */
 typedef struct ASTLambda
 {
-  Vec_ASTNodeId vars_;
-  Vec_ASTNodeId types_;
+  uint32_t ids_;
+  uint32_t num_vars_;
   ASTNodeId body_;
 } ASTLambda;
 
 typedef struct ASTTuple
 {
-  Vec_ASTNodeId args_;
+  uint32_t ids_;
+  uint32_t num_args_;
 } ASTTuple;
 
 typedef struct ASTCall
@@ -74,56 +79,160 @@ typedef struct ASTBinary
   ASTNodeId right_;
 } ASTBinary;
 
+enum ASTIntegerKind
+{
+  /* Its value is read from its text.  */
+  AST_INTEGER_TEXT,
+  AST_INTEGER_INT64,
+  AST_INTEGER_INT
+};
+
+/* An integer literal with no text of its own, like one made by folding,
+ * keeps its value here: an Int64 split in halves, which keeps payloads
+ * 4-aligned, or the index of an Int in the manager's integer pool.  */
+typedef struct ASTInteger
+{
+  enum ASTIntegerKind kind_;
+  uint32_t low_;
+  uint32_t high_;
+} ASTInteger;
+
+/* The child ids of a node, selected by its kind, or the value of a folded
+ * integer literal.  */
+typedef union ASTPayload
+{
+  ASTInteger integer_;
+  ASTIfThenElse if_then_else_;
+  ASTLet let_;
+  ASTLambda lambda_;
+  ASTTuple tuple_;
+  ASTCall call_;
+  ASTUnary unary_;
+  ASTBinary binary_;
+} ASTPayload;
+
 typedef struct ASTNode
 {
   enum ASTKind kind_;
-  Span span_;
-  union
-  {
-    ASTIfThenElse if_then_else_;
-    ASTLet let_;
-    ASTLambda lambda_;
-    ASTTuple tuple_;
-    ASTCall call_;
-    ASTUnary unary_;
-    ASTBinary binary_;
-  };
+  CompactSpan span_;
+  ASTPayload payload_;
 } ASTNode;
 
+NEO_DECL_VEC (ASTKind, enum ASTKind)
+NEO_DECL_VEC (CompactSpan, CompactSpan)
+NEO_DECL_VEC (ASTPayload, ASTPayload)
+
+/* Nodes are stored as one column per field unless NEO_AST_AOS is defined,
+ * so that a pass only streams the columns it reads: the checker mostly
+ * needs kinds and payloads, diagnostics only need spans.  */
 typedef struct ASTNodeManager
 {
+  Arena *arena_;
+#ifdef NEO_AST_AOS
   Vec_ASTNode nodes_;
+#else
+  Vec_ASTKind kinds_;
+  Vec_CompactSpan spans_;
+  Vec_ASTPayload payloads_;
+#endif
+  Vec_ASTNodeId ids_;
+  /* The Int values of integer literals, in the order of their nodes.  */
+  Vec_BigInt integers_;
 } ASTNodeManager;
 
 ASTNodeManager ASTNodeManager_new ();
+/* The nodes and the id pool are allocated from the arena, which must
+ * outlive the manager.  */
+ASTNodeManager ASTNodeManager_new_in (Arena *arena);
 void ASTNodeManager_drop (ASTNodeManager *self);
-const Vec_ASTNode *ASTNodeManager_get_nodes (const ASTNodeManager *self);
-ASTNodeId ASTNodeManager_get_id (const ASTNodeManager *self,
-                                 const ASTNode *node);
-const ASTNode *ASTNodeManager_get_node (const ASTNodeManager *self,
-                                        ASTNodeId id);
-const Span *ASTNodeManager_get_span (const ASTNodeManager *self, ASTNodeId id);
-ASTNodeId ASTNodeManager_push_lit (ASTNodeManager *self, Span span,
+size_t ASTNodeManager_num_nodes (const ASTNodeManager *self);
+/* Gathers every column of the node.  */
+ASTNode ASTNodeManager_get_node (const ASTNodeManager *self, ASTNodeId id);
+enum ASTKind ASTNodeManager_get_kind (const ASTNodeManager *self,
+                                      ASTNodeId id);
+const CompactSpan *ASTNodeManager_get_span (const ASTNodeManager *self,
+                                            ASTNodeId id);
+const ASTPayload *ASTNodeManager_get_payload (const ASTNodeManager *self,
+                                              ASTNodeId id);
+const ASTNodeId *ASTNodeManager_get_let_vars (const ASTNodeManager *self,
+                                              const ASTLet *let);
+const ASTNodeId *ASTNodeManager_get_let_types (const ASTNodeManager *self,
+                                               const ASTLet *let);
+const ASTNodeId *ASTNodeManager_get_let_inits (const ASTNodeManager *self,
+                                               const ASTLet *let);
+const ASTNodeId *ASTNodeManager_get_lambda_vars (const ASTNodeManager *self,
+                                                 const ASTLambda *lambda);
+const ASTNodeId *ASTNodeManager_get_lambda_types (const ASTNodeManager *self,
+                                                  const ASTLambda *lambda);
+const ASTNodeId *ASTNodeManager_get_tuple_args (const ASTNodeManager *self,
+                                                const ASTTuple *tuple);
+/* The id pool that the child lists above index into.  */
+const ASTNodeId *ASTNodeManager_get_ids (const ASTNodeManager *self);
+size_t ASTNodeManager_num_ids (const ASTNodeManager *self);
+/* Whether the integer literal ID is an Int64, as the checker types it, and
+ * if so sets VALUE to it.  FILE holds the text of the literals.  */
+bool ASTNodeManager_get_int64 (const ASTNodeManager *self,
+                               const SourceFile *file, ASTNodeId id,
+                               int64_t *value);
+/* Returns the value of the integer literal ID.  */
+BigInt ASTNodeManager_get_integer (const ASTNodeManager *self,
+                                   const SourceFile *file, ASTNodeId id);
+/* Bytes held by the node columns and the pools.  */
+size_t ASTNodeManager_num_bytes (const ASTNodeManager *self);
+/* Makes room for NUM_NODES more nodes.  */
+void ASTNodeManager_reserve (ASTNodeManager *self, size_t num_nodes);
+/* Gives back the room that no node, pooled id or Int uses.  */
+void ASTNodeManager_shrink_to_fit (ASTNodeManager *self);
+/* Drops the nodes, pooled ids and Ints pushed after there were NUM_NODES
+ * nodes and NUM_IDS ids.  */
+void ASTNodeManager_truncate (ASTNodeManager *self, size_t num_nodes,
+                              size_t num_ids);
+void ASTNodeManager_set_span (ASTNodeManager *self, ASTNodeId id,
+                              CompactSpan span);
+/* Moves the spans of the first NUM_NODES nodes that begin at or after OFFSET
+ * by DELTA, i.e. the nodes following a text edit that ended at OFFSET.  */
+void ASTNodeManager_shift_spans (ASTNodeManager *self, size_t num_nodes,
+                                 uint32_t offset, int64_t delta);
+/* Appends the children of ID to CHILDREN in source order, including the
+ * null ids of omitted types.  */
+void ASTNodeManager_push_children (const ASTNodeManager *self, ASTNodeId id,
+                                   Vec_ASTNodeId *children);
+/* Makes PARENT point to NEW_CHILD wherever it pointed to OLD_CHILD.  The
+ * new child may then follow its parent in the manager.  */
+void ASTNodeManager_replace_child (ASTNodeManager *self, ASTNodeId parent,
+                                   ASTNodeId old_child, ASTNodeId new_child);
+ASTNodeId ASTNodeManager_push_lit (ASTNodeManager *self, CompactSpan span,
                                    enum ASTKind kind);
-ASTNodeId ASTNodeManager_push_if_then_else (ASTNodeManager *self, Span span,
+/* Pushes an integer literal whose value is VALUE rather than the text in
+ * SPAN, i.e. the result of folding what SPAN covers.  */
+ASTNodeId ASTNodeManager_push_int64 (ASTNodeManager *self, CompactSpan span,
+                                     int64_t value);
+/* As above, for the Int VALUE, which the manager takes.  */
+ASTNodeId ASTNodeManager_push_integer (ASTNodeManager *self, CompactSpan span,
+                                       BigInt value);
+ASTNodeId ASTNodeManager_push_if_then_else (ASTNodeManager *self,
+                                            CompactSpan span,
                                             ASTNodeId if_expr,
                                             ASTNodeId then_expr,
                                             ASTNodeId else_expr);
-ASTNodeId ASTNodeManager_push_var (ASTNodeManager *self, Span span);
-ASTNodeId ASTNodeManager_push_type (ASTNodeManager *self, Span span);
-ASTNodeId ASTNodeManager_push_let (ASTNodeManager *self, Span span,
-                                   Vec_ASTNodeId vars, Vec_ASTNodeId types,
-                                   Vec_ASTNodeId inits, ASTNodeId body);
-ASTNodeId ASTNodeManager_push_lambda (ASTNodeManager *self, Span span,
-                                      Vec_ASTNodeId vars, Vec_ASTNodeId types,
+ASTNodeId ASTNodeManager_push_var (ASTNodeManager *self, CompactSpan span);
+ASTNodeId ASTNodeManager_push_type (ASTNodeManager *self, CompactSpan span);
+ASTNodeId ASTNodeManager_push_let (ASTNodeManager *self, CompactSpan span,
+                                   const ASTNodeId *vars,
+                                   const ASTNodeId *types,
+                                   const ASTNodeId *inits, size_t num_vars,
+                                   ASTNodeId body);
+ASTNodeId ASTNodeManager_push_lambda (ASTNodeManager *self, CompactSpan span,
+                                      const ASTNodeId *vars,
+                                      const ASTNodeId *types, size_t num_vars,
                                       ASTNodeId body);
-ASTNodeId ASTNodeManager_push_tuple (ASTNodeManager *self, Span span,
-                                     Vec_ASTNodeId args);
-ASTNodeId ASTNodeManager_push_call (ASTNodeManager *self, Span span,
+ASTNodeId ASTNodeManager_push_tuple (ASTNodeManager *self, CompactSpan span,
+                                     const ASTNodeId *args, size_t num_args);
+ASTNodeId ASTNodeManager_push_call (ASTNodeManager *self, CompactSpan span,
                                     ASTNodeId base, ASTNodeId tuple);
-ASTNodeId ASTNodeManager_push_unary (ASTNodeManager *self, Span span,
+ASTNodeId ASTNodeManager_push_unary (ASTNodeManager *self, CompactSpan span,
                                      enum TokenKind op, ASTNodeId expr);
-ASTNodeId ASTNodeManager_push_binary (ASTNodeManager *self, Span span,
+ASTNodeId ASTNodeManager_push_binary (ASTNodeManager *self, CompactSpan span,
                                       enum TokenKind op, ASTNodeId left,
                                       ASTNodeId right);
 
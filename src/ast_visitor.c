@@ -0,0 +1,478 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "ast_visitor.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast_node.h"
+#include "vec.h"
+#include "vec_macro.h"
+
+NEO_IMPL_VEC (ASTVisitor, ASTVisitor)
+NEO_IMPL_VEC (ASTWalkFrame, ASTWalkFrame)
+
+ASTVisitor
+ASTVisitor_new (void *data)
+{
+  return (ASTVisitor){ .data_ = data };
+}
+
+static ASTPreVisit
+ASTVisitor_get_pre (const ASTVisitor *self, enum ASTKind kind)
+{
+  switch (kind)
+    {
+#define NEO_ASTKIND(KIND, NAME)                                               \
+  case AST_##KIND:                                                            \
+    return self->pre_##NAME##_ ? self->pre_##NAME##_ : self->pre_;
+#include "ast_kind.def"
+#undef NEO_ASTKIND
+    }
+  return self->pre_;
+}
+
+static ASTPostVisit
+ASTVisitor_get_post (const ASTVisitor *self, enum ASTKind kind)
+{
+  switch (kind)
+    {
+#define NEO_ASTKIND(KIND, NAME)                                               \
+  case AST_##KIND:                                                            \
+    return self->post_##NAME##_ ? self->post_##NAME##_ : self->post_;
+#include "ast_kind.def"
+#undef NEO_ASTKIND
+    }
+  return self->post_;
+}
+
+ASTWalker
+ASTWalker_new ()
+{
+  return (ASTWalker){ .visitors_ = Vec_ASTVisitor_new (),
+                      .skip_depths_ = Vec_u32_new (),
+                      .stack_ = Vec_ASTWalkFrame_new (),
+                      .children_ = Vec_ASTNodeId_new (),
+                      .has_post_ = false };
+}
+
+void
+ASTWalker_drop (ASTWalker *self)
+{
+  Vec_ASTVisitor_drop (&self->visitors_);
+  Vec_u32_drop (&self->skip_depths_);
+  Vec_ASTWalkFrame_drop (&self->stack_);
+  Vec_ASTNodeId_drop (&self->children_);
+}
+
+void
+ASTWalker_add (ASTWalker *self, ASTVisitor visitor)
+{
+  Vec_ASTVisitor_push (&self->visitors_, visitor);
+  Vec_u32_push (&self->skip_depths_, 0);
+  self->has_post_ = self->has_post_ || visitor.post_;
+#define NEO_ASTKIND(UNUSED, NAME)                                             \
+  self->has_post_ = self->has_post_ || visitor.post_##NAME##_;
+#include "ast_kind.def"
+#undef NEO_ASTKIND
+}
+
+/* Calls the pre callbacks of FRAME, and returns whether any visitor wants
+ * its children.  */
+static bool
+ASTWalker_pre (ASTWalker *self, const ASTNodeManager *ast_mgr,
+               ASTWalkFrame frame, enum ASTKind kind)
+{
+  const ASTVisitor *visitors = Vec_ASTVisitor_cbegin (&self->visitors_);
+  uint32_t *skip_depths = Vec_u32_begin (&self->skip_depths_);
+  bool descend = false;
+  for (size_t i = 0; i < Vec_ASTVisitor_len (&self->visitors_); i++)
+    {
+      /* Below a node whose children the visitor skips, until the walk
+       * leaves it, which is only seen here if there are no post frames.  */
+      if (skip_depths[i] >= frame.depth_)
+        {
+          skip_depths[i] = 0;
+        }
+      if (skip_depths[i])
+        {
+          continue;
+        }
+      ASTPreVisit pre = ASTVisitor_get_pre (visitors + i, kind);
+      if (pre && !pre (visitors[i].data_, ast_mgr, frame.id_))
+        {
+          skip_depths[i] = frame.depth_;
+        }
+      else
+        {
+          descend = true;
+        }
+    }
+  return descend;
+}
+
+static void
+ASTWalker_post (ASTWalker *self, const ASTNodeManager *ast_mgr,
+                ASTWalkFrame frame, enum ASTKind kind)
+{
+  const ASTVisitor *visitors = Vec_ASTVisitor_cbegin (&self->visitors_);
+  uint32_t *skip_depths = Vec_u32_begin (&self->skip_depths_);
+  for (size_t i = 0; i < Vec_ASTVisitor_len (&self->visitors_); i++)
+    {
+      if (skip_depths[i] && skip_depths[i] < frame.depth_)
+        {
+          continue;
+        }
+      skip_depths[i] = 0;
+      ASTPostVisit post = ASTVisitor_get_post (visitors + i, kind);
+      if (post)
+        {
+          post (visitors[i].data_, ast_mgr, frame.id_);
+        }
+    }
+}
+
+void
+ASTWalker_walk (ASTWalker *self, const ASTNodeManager *ast_mgr, ASTNodeId id)
+{
+  if (is_null_ast_node_id (id))
+    {
+      return;
+    }
+  Vec_ASTWalkFrame_push (&self->stack_, (ASTWalkFrame){
+                                            .id_ = id,
+                                            .depth_ = 1,
+                                            .post_ = false,
+                                        });
+  while (!Vec_ASTWalkFrame_is_empty (&self->stack_))
+    {
+      ASTWalkFrame frame = Vec_ASTWalkFrame_pop (&self->stack_);
+      enum ASTKind kind = ASTNodeManager_get_kind (ast_mgr, frame.id_);
+      if (frame.post_)
+        {
+          ASTWalker_post (self, ast_mgr, frame, kind);
+          continue;
+        }
+      bool descend = ASTWalker_pre (self, ast_mgr, frame, kind);
+      if (self->has_post_)
+        {
+          frame.post_ = true;
+          Vec_ASTWalkFrame_push (&self->stack_, frame);
+        }
+      if (!descend)
+        {
+          continue;
+        }
+      /* Pushed last to first, so that they are popped in source order.  */
+      Vec_ASTNodeId_resize (&self->children_, 0, 0);
+      ASTNodeManager_push_children (ast_mgr, frame.id_, &self->children_);
+      const ASTNodeId *children = Vec_ASTNodeId_cbegin (&self->children_);
+      for (size_t i = Vec_ASTNodeId_len (&self->children_); i-- > 0;)
+        {
+          if (!is_null_ast_node_id (children[i]))
+            {
+              Vec_ASTWalkFrame_push (&self->stack_,
+                                     (ASTWalkFrame){
+                                         .id_ = children[i],
+                                         .depth_ = frame.depth_ + 1,
+                                         .post_ = false,
+                                     });
+            }
+        }
+    }
+}
+
+#ifdef TESTS
+#include "test.h"
+
+#include "diagnostic.h"
+#include "parser.h"
+
+typedef struct ASTVisitorTest
+{
+  SourceFile file_;
+  ASTNodeManager ast_mgr_;
+  ASTNodeId node_id_;
+} ASTVisitorTest;
+
+static void
+ASTVisitorTest_init (ASTVisitorTest *self, const char *content)
+{
+  self->file_ = SourceFile_new (String_from_cstring ("test"),
+                                String_from_cstring (content));
+  self->ast_mgr_ = ASTNodeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&self->file_);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  self->node_id_
+      = Parser_parse_file (&self->file_, &diag_mgr, &self->ast_mgr_);
+  DiagnosticManager_drop (&diag_mgr);
+}
+
+static void
+ASTVisitorTest_drop (ASTVisitorTest *self)
+{
+  SourceFile_drop (&self->file_);
+  ASTNodeManager_drop (&self->ast_mgr_);
+}
+
+/* Records ids on entry, and ids with the top bit set on exit.  */
+#define TRACE_POST (UINT32_C (1) << 31)
+
+static bool
+trace_pre (void *trace, const ASTNodeManager *ast_mgr, ASTNodeId id)
+{
+  (void)ast_mgr;
+  Vec_ASTNodeId_push ((Vec_ASTNodeId *)trace, id);
+  return true;
+}
+
+/* Like trace_pre, but keeps out of the bindings and body of a let.  */
+static bool
+trace_pre_let (void *trace, const ASTNodeManager *ast_mgr, ASTNodeId id)
+{
+  trace_pre (trace, ast_mgr, id);
+  return false;
+}
+
+static void
+trace_post (void *trace, const ASTNodeManager *ast_mgr, ASTNodeId id)
+{
+  (void)ast_mgr;
+  Vec_ASTNodeId_push ((Vec_ASTNodeId *)trace, id | TRACE_POST);
+}
+
+/* What a recursive walk of ID records, stopping at lets if SKIP_LETS.  */
+static void
+trace_recursive (const ASTNodeManager *ast_mgr, ASTNodeId id, bool skip_lets,
+                 Vec_ASTNodeId *trace)
+{
+  Vec_ASTNodeId_push (trace, id);
+  if (!skip_lets || ASTNodeManager_get_kind (ast_mgr, id) != AST_LET)
+    {
+      Vec_ASTNodeId children = Vec_ASTNodeId_new ();
+      ASTNodeManager_push_children (ast_mgr, id, &children);
+      for (size_t i = 0; i < Vec_ASTNodeId_len (&children); i++)
+        {
+          ASTNodeId child = Vec_ASTNodeId_cbegin (&children)[i];
+          if (!is_null_ast_node_id (child))
+            {
+              trace_recursive (ast_mgr, child, skip_lets, trace);
+            }
+        }
+      Vec_ASTNodeId_drop (&children);
+    }
+  Vec_ASTNodeId_push (trace, id | TRACE_POST);
+}
+
+static void
+trace_drop_posts (Vec_ASTNodeId *trace)
+{
+  ASTNodeId *begin = Vec_ASTNodeId_begin (trace);
+  size_t len = 0;
+  for (size_t i = 0; i < Vec_ASTNodeId_len (trace); i++)
+    {
+      if (!(begin[i] & TRACE_POST))
+        {
+          begin[len++] = begin[i];
+        }
+    }
+  Vec_ASTNodeId_resize (trace, len, 0);
+}
+
+static size_t
+trace_num_mismatches (const Vec_ASTNodeId *trace,
+                      const Vec_ASTNodeId *expected)
+{
+  size_t len = Vec_ASTNodeId_len (trace);
+  size_t expected_len = Vec_ASTNodeId_len (expected);
+  size_t num_mismatches = len != expected_len;
+  for (size_t i = 0; i < len && i < expected_len; i++)
+    {
+      num_mismatches += Vec_ASTNodeId_cbegin (trace)[i]
+                        != Vec_ASTNodeId_cbegin (expected)[i];
+    }
+  return num_mismatches;
+}
+
+NEO_TEST (test_ast_walker_00)
+{
+  static const char *const sources[] = {
+    "true",
+    "if true then false else true",
+    "let x = true, y: Bool = x in if y then x else false",
+    "if let b = true in b then let c = false in c else true",
+    "let f = (a, b: Bool) +> if a then b else c in f((1, -2), 3 * 4 + 5)",
+    "(x, let y = let z = 1 in z in y, if a then b else c)",
+  };
+  for (size_t i = 0; i < sizeof (sources) / sizeof (sources[0]); i++)
+    {
+      ASTVisitorTest tester;
+      ASTVisitorTest_init (&tester, sources[i]);
+      const ASTNodeManager *ast_mgr = &tester.ast_mgr_;
+      Vec_ASTNodeId expected = Vec_ASTNodeId_new ();
+      Vec_ASTNodeId expected_skipped = Vec_ASTNodeId_new ();
+      trace_recursive (ast_mgr, tester.node_id_, false, &expected);
+      trace_recursive (ast_mgr, tester.node_id_, true, &expected_skipped);
+      /* Fused, a visitor that skips does not keep the other from its
+       * walk.  */
+      Vec_ASTNodeId trace = Vec_ASTNodeId_new ();
+      Vec_ASTNodeId skipped = Vec_ASTNodeId_new ();
+      ASTVisitor tracer = ASTVisitor_new (&trace);
+      tracer.pre_ = trace_pre;
+      tracer.post_ = trace_post;
+      ASTVisitor skipper = ASTVisitor_new (&skipped);
+      skipper.pre_ = trace_pre;
+      skipper.pre_let_ = trace_pre_let;
+      skipper.post_ = trace_post;
+      ASTWalker walker = ASTWalker_new ();
+      ASTWalker_add (&walker, skipper);
+      ASTWalker_add (&walker, tracer);
+      ASTWalker_walk (&walker, ast_mgr, tester.node_id_);
+      ASSERT_U64_EQ (trace_num_mismatches (&trace, &expected), 0);
+      ASSERT_U64_EQ (trace_num_mismatches (&skipped, &expected_skipped), 0);
+      ASTWalker_drop (&walker);
+      /* Alone, the skipper stops the walk itself.  */
+      Vec_ASTNodeId_resize (&skipped, 0, 0);
+      walker = ASTWalker_new ();
+      ASTWalker_add (&walker, skipper);
+      ASTWalker_walk (&walker, ast_mgr, tester.node_id_);
+      ASSERT_U64_EQ (trace_num_mismatches (&skipped, &expected_skipped), 0);
+      ASTWalker_drop (&walker);
+      /* With no post callbacks at all, skips end as the walk moves on.  */
+      Vec_ASTNodeId_resize (&trace, 0, 0);
+      Vec_ASTNodeId_resize (&skipped, 0, 0);
+      tracer.post_ = NULL;
+      skipper.post_ = NULL;
+      walker = ASTWalker_new ();
+      ASTWalker_add (&walker, skipper);
+      ASTWalker_add (&walker, tracer);
+      ASTWalker_walk (&walker, ast_mgr, tester.node_id_);
+      trace_drop_posts (&expected);
+      trace_drop_posts (&expected_skipped);
+      ASSERT_U64_EQ (trace_num_mismatches (&trace, &expected), 0);
+      ASSERT_U64_EQ (trace_num_mismatches (&skipped, &expected_skipped), 0);
+      ASTWalker_drop (&walker);
+      Vec_ASTNodeId_drop (&expected);
+      Vec_ASTNodeId_drop (&expected_skipped);
+      Vec_ASTNodeId_drop (&trace);
+      Vec_ASTNodeId_drop (&skipped);
+      ASTVisitorTest_drop (&tester);
+    }
+}
+
+NEO_TESTS (ast_visitor_tests, test_ast_walker_00)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+#include "diagnostic.h"
+#include "parser.h"
+
+typedef struct WalkStats
+{
+  size_t num_nodes_;
+  size_t num_ifs_;
+  uint32_t depth_;
+  uint32_t max_depth_;
+} WalkStats;
+
+static bool
+count_node (void *stats, const ASTNodeManager *ast_mgr, ASTNodeId id)
+{
+  (void)ast_mgr;
+  (void)id;
+  ((WalkStats *)stats)->num_nodes_++;
+  return true;
+}
+
+static bool
+count_if (void *stats, const ASTNodeManager *ast_mgr, ASTNodeId id)
+{
+  (void)ast_mgr;
+  (void)id;
+  ((WalkStats *)stats)->num_ifs_++;
+  return true;
+}
+
+static bool
+enter_depth (void *stats_arg, const ASTNodeManager *ast_mgr, ASTNodeId id)
+{
+  (void)ast_mgr;
+  (void)id;
+  WalkStats *stats = stats_arg;
+  if (++stats->depth_ > stats->max_depth_)
+    {
+      stats->max_depth_ = stats->depth_;
+    }
+  return true;
+}
+
+static void
+leave_depth (void *stats, const ASTNodeManager *ast_mgr, ASTNodeId id)
+{
+  (void)ast_mgr;
+  (void)id;
+  ((WalkStats *)stats)->depth_--;
+}
+
+/* Runs three analyses over a parse of a generated source, fused into one
+ * walk or in a walk each.  */
+static void
+walk_bench (Bencher *bencher_, bool fused)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"),
+                                    bench_gen_source (1 << 20, 42));
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  ASTNodeId node_id = Parser_parse_file (&file, &diag_mgr, &ast_mgr);
+  WalkStats stats = { 0 };
+  ASTVisitor visitors[3];
+  visitors[0] = ASTVisitor_new (&stats);
+  visitors[0].pre_ = count_node;
+  visitors[1] = ASTVisitor_new (&stats);
+  visitors[1].pre_if_then_else_ = count_if;
+  visitors[2] = ASTVisitor_new (&stats);
+  visitors[2].pre_ = enter_depth;
+  visitors[2].post_ = leave_depth;
+  ASTWalker walkers[3] = { ASTWalker_new (), ASTWalker_new (),
+                           ASTWalker_new () };
+  for (size_t i = 0; i < 3; i++)
+    {
+      ASTWalker_add (&walkers[fused ? 0 : i], visitors[i]);
+    }
+  BENCH_ITER
+  {
+    stats = (WalkStats){ 0 };
+    for (size_t i = 0; i < (fused ? 1 : 3); i++)
+      {
+        ASTWalker_walk (&walkers[i], &ast_mgr, node_id);
+      }
+  }
+  Bencher_report_u64 (bencher_, "nodes", stats.num_nodes_);
+  Bencher_report_u64 (bencher_, "ifs", stats.num_ifs_);
+  Bencher_report_u64 (bencher_, "depth", stats.max_depth_);
+  for (size_t i = 0; i < 3; i++)
+    {
+      ASTWalker_drop (&walkers[i]);
+    }
+  DiagnosticManager_drop (&diag_mgr);
+  ASTNodeManager_drop (&ast_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCH (bench_ast_walk_separate_00)
+{
+  walk_bench (bencher_, false);
+}
+
+NEO_BENCH (bench_ast_walk_fused_00)
+{
+  walk_bench (bencher_, true);
+}
+
+NEO_BENCHES (ast_visitor_benches, bench_ast_walk_separate_00,
+             bench_ast_walk_fused_00)
+#endif
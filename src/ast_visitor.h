@@ -0,0 +1,85 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_AST_VISITOR_H
+#define NEO_AST_VISITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ast_node.h"
+#include "vec.h"
+#include "vec_macro.h"
+
+/* Called when a walk enters ID.  Returns whether to visit the children of
+ * ID, which the post callback of ID follows either way.  */
+typedef bool (*ASTPreVisit) (void *data, const ASTNodeManager *ast_mgr,
+                             ASTNodeId id);
+/* Called once the walk is done with the children of ID.  */
+typedef void (*ASTPostVisit) (void *data, const ASTNodeManager *ast_mgr,
+                              ASTNodeId id);
+
+/* The callbacks of one analysis, a pair for each kind of ast_kind.def.
+ * Those left NULL fall back to PRE and POST, and where those are NULL too,
+ * nothing is called and children are visited.  */
+typedef struct ASTVisitor
+{
+  void *data_;
+  ASTPreVisit pre_;
+  ASTPostVisit post_;
+#define NEO_ASTKIND(UNUSED, NAME)                                             \
+  ASTPreVisit pre_##NAME##_;                                                  \
+  ASTPostVisit post_##NAME##_;
+#include "ast_kind.def"
+#undef NEO_ASTKIND
+} ASTVisitor;
+
+/* Every callback NULL, to be set by name.  */
+ASTVisitor ASTVisitor_new (void *data);
+
+NEO_DECL_VEC (ASTVisitor, ASTVisitor)
+
+typedef struct ASTWalkFrame
+{
+  ASTNodeId id_;
+  uint32_t depth_;
+  bool post_;
+} ASTWalkFrame;
+
+NEO_DECL_VEC (ASTWalkFrame, ASTWalkFrame)
+
+/* Runs several visitors in a single walk of a tree, with no recursion.
+ * Each sees the nodes in the order of a walk of its own: children in
+ * source order, between the pre and post callbacks of their parent.  */
+typedef struct ASTWalker
+{
+  Vec_ASTVisitor visitors_;
+  /* For each visitor, the depth of the node whose children it skips, or 0
+   * if it skips none.  */
+  Vec_u32 skip_depths_;
+  Vec_ASTWalkFrame stack_;
+  Vec_ASTNodeId children_;
+  /* Whether any visitor has a post callback.  If none has, nodes are left
+   * as soon as they are entered.  */
+  bool has_post_;
+} ASTWalker;
+
+ASTWalker ASTWalker_new ();
+void ASTWalker_drop (ASTWalker *self);
+/* Visitors are called in the order they were added.  */
+void ASTWalker_add (ASTWalker *self, ASTVisitor visitor);
+/* Walks the subtree of ID, whose null children are not visited.  Children
+ * are only read from the manager while some visitor wants them.  */
+void ASTWalker_walk (ASTWalker *self, const ASTNodeManager *ast_mgr,
+                     ASTNodeId id);
+
+#ifdef TESTS
+#include "test.h"
+Tests ast_visitor_tests ();
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+Benches ast_visitor_benches ();
+#endif
+
+#endif
@@ -0,0 +1,364 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "bench.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "array_macro.h"
+#include "string.h"
+#include "vec_macro.h"
+
+#define BENCH_MIN_SECS (0.5)
+
+NEO_IMPL_ARRAY (Bencher, Bencher)
+NEO_IMPL_VEC (Bencher, Bencher)
+
+static double
+timespec_diff_secs (const struct timespec *begin, const struct timespec *end)
+{
+  return (double)(end->tv_sec - begin->tv_sec)
+         + (double)(end->tv_nsec - begin->tv_nsec) / 1000000000.0;
+}
+
+BenchManager
+BenchManager_new ()
+{
+  return (BenchManager){ .benches_ = Vec_Bencher_new () };
+}
+
+void
+BenchManager_drop (BenchManager *self)
+{
+  for (Bencher *bench = Vec_Bencher_begin (&self->benches_);
+       bench < Vec_Bencher_end (&self->benches_); bench++)
+    {
+      String_drop (&bench->report_);
+    }
+  Vec_Bencher_drop (&self->benches_);
+}
+
+void
+BenchManager_push_benches (BenchManager *self, Array_Bencher benches)
+{
+  for (const Bencher *bench = Array_Bencher_cbegin (&benches);
+       bench < Array_Bencher_cend (&benches); bench++)
+    {
+      Vec_Bencher_push (&self->benches_, *bench);
+    }
+}
+
+size_t
+BenchManager_run (BenchManager *self, const char *filter)
+{
+  size_t count = 0;
+  for (Bencher *bench = Vec_Bencher_begin (&self->benches_);
+       bench < Vec_Bencher_end (&self->benches_); bench++)
+    {
+      if (filter && !strstr (bench->func_, filter))
+        {
+          continue;
+        }
+      printf ("bench %s:%s ... ", bench->file_, bench->func_);
+      fflush (stdout);
+      bench->bench_fn_ (bench);
+      printf ("%.0lf ns/iter (%" PRIu64 " iters)%.*s\n",
+              bench->num_iters_ ? bench->secs_ * 1e9 / bench->num_iters_ : 0,
+              bench->num_iters_, (int)String_len (&bench->report_),
+              String_cbegin (&bench->report_));
+      count++;
+    }
+  return count;
+}
+
+void
+Bencher_start (Bencher *self)
+{
+  self->num_iters_ = 0;
+  self->secs_ = 0;
+  timespec_get (&self->begin_, TIME_UTC);
+}
+
+bool
+Bencher_iter (Bencher *self)
+{
+  struct timespec now;
+  timespec_get (&now, TIME_UTC);
+  self->secs_ = timespec_diff_secs (&self->begin_, &now);
+  if (self->num_iters_ && self->secs_ >= BENCH_MIN_SECS)
+    {
+      return false;
+    }
+  self->num_iters_++;
+  return true;
+}
+
+void
+Bencher_report_u64 (Bencher *self, const char *key, uint64_t value)
+{
+  String_push_cstring (&self->report_, ", ");
+  String_push_cstring (&self->report_, key);
+  String_push_cstring (&self->report_, " = ");
+  String_push_u64 (&self->report_, value);
+}
+
+void
+Bencher_report_f64 (Bencher *self, const char *key, double value)
+{
+  char buf[64];
+  int len = snprintf (buf, sizeof (buf), "%.2lf", value);
+  String_push_cstring (&self->report_, ", ");
+  String_push_cstring (&self->report_, key);
+  String_push_cstring (&self->report_, " = ");
+  String_push_carray (&self->report_, buf, len);
+}
+
+typedef struct SourceGen
+{
+  String *out_;
+  uint64_t state_;
+  uint32_t num_vars_;
+} SourceGen;
+
+/* xorshift64, so that the corpus does not depend on the libc.  */
+static uint32_t
+SourceGen_rand (SourceGen *self, uint32_t n)
+{
+  self->state_ ^= self->state_ << 13;
+  self->state_ ^= self->state_ >> 7;
+  self->state_ ^= self->state_ << 17;
+  return self->state_ % n;
+}
+
+static void
+SourceGen_push_var (SourceGen *self, uint32_t var)
+{
+  String_push (self->out_, 'v');
+  String_push_u64 (self->out_, var);
+}
+
+static void SourceGen_push_expr (SourceGen *self, uint32_t depth);
+
+static void
+SourceGen_push_atom (SourceGen *self)
+{
+  switch (SourceGen_rand (self, self->num_vars_ ? 4 : 3))
+    {
+    case 0:
+      String_push_cstring (self->out_, "true");
+      break;
+    case 1:
+      String_push_cstring (self->out_, "false");
+      break;
+    case 2:
+      String_push_u64 (self->out_, SourceGen_rand (self, 1000));
+      break;
+    default:
+      SourceGen_push_var (self, SourceGen_rand (self, self->num_vars_));
+      break;
+    }
+}
+
+static void
+SourceGen_push_let (SourceGen *self, uint32_t depth)
+{
+  uint32_t num_vars = self->num_vars_;
+  uint32_t count = 1 + SourceGen_rand (self, 3);
+  String_push_cstring (self->out_, "let ");
+  for (uint32_t i = 0; i < count; i++)
+    {
+      if (i)
+        {
+          String_push_cstring (self->out_, ", ");
+        }
+      SourceGen_push_var (self, num_vars + i);
+      if (SourceGen_rand (self, 2))
+        {
+          String_push_cstring (self->out_, ": Bool");
+        }
+      String_push_cstring (self->out_, " = ");
+      SourceGen_push_expr (self, depth - 1);
+    }
+  String_push_cstring (self->out_, " in\n");
+  self->num_vars_ = num_vars + count;
+  SourceGen_push_expr (self, depth - 1);
+  self->num_vars_ = num_vars;
+}
+
+static void
+SourceGen_push_lambda (SourceGen *self, uint32_t depth)
+{
+  uint32_t num_vars = self->num_vars_;
+  uint32_t count = SourceGen_rand (self, 3);
+  String_push (self->out_, '(');
+  for (uint32_t i = 0; i < count; i++)
+    {
+      if (i)
+        {
+          String_push_cstring (self->out_, ", ");
+        }
+      SourceGen_push_var (self, num_vars + i);
+      if (SourceGen_rand (self, 2))
+        {
+          String_push_cstring (self->out_, ": Bool");
+        }
+    }
+  String_push_cstring (self->out_, ") +> ");
+  self->num_vars_ = num_vars + count;
+  SourceGen_push_expr (self, depth - 1);
+  self->num_vars_ = num_vars;
+}
+
+static void
+SourceGen_push_args (SourceGen *self, uint32_t depth)
+{
+  uint32_t count = SourceGen_rand (self, 4);
+  String_push (self->out_, '(');
+  for (uint32_t i = 0; i < count; i++)
+    {
+      if (i)
+        {
+          String_push_cstring (self->out_, ", ");
+        }
+      SourceGen_push_expr (self, depth - 1);
+    }
+  String_push (self->out_, ')');
+}
+
+static void
+SourceGen_push_expr (SourceGen *self, uint32_t depth)
+{
+  static const char *const binary_ops[]
+      = { " + ", " - ", " * ", " / ", " == ", " < " };
+  if (depth == 0)
+    {
+      SourceGen_push_atom (self);
+      return;
+    }
+  switch (SourceGen_rand (self, 7))
+    {
+    case 0:
+      String_push_cstring (self->out_, "if ");
+      SourceGen_push_expr (self, depth - 1);
+      String_push_cstring (self->out_, " then ");
+      SourceGen_push_expr (self, depth - 1);
+      String_push_cstring (self->out_, " else ");
+      SourceGen_push_expr (self, depth - 1);
+      break;
+    case 1:
+    case 2:
+      SourceGen_push_let (self, depth);
+      break;
+    case 3:
+      SourceGen_push_lambda (self, depth);
+      break;
+    case 4:
+      if (self->num_vars_)
+        {
+          SourceGen_push_var (self, SourceGen_rand (self, self->num_vars_));
+        }
+      else
+        {
+          String_push (self->out_, 'f');
+        }
+      SourceGen_push_args (self, depth);
+      break;
+    case 5:
+      SourceGen_push_atom (self);
+      String_push_cstring (
+          self->out_,
+          binary_ops[SourceGen_rand (self, sizeof (binary_ops)
+                                               / sizeof (binary_ops[0]))]);
+      SourceGen_push_expr (self, depth - 1);
+      break;
+    default:
+      SourceGen_push_atom (self);
+      break;
+    }
+}
+
+static void
+SourceGen_push_if (SourceGen *self, uint32_t depth)
+{
+  if (depth == 0)
+    {
+      if (self->num_vars_ && SourceGen_rand (self, 2))
+        {
+          SourceGen_push_var (self, SourceGen_rand (self, self->num_vars_));
+          return;
+        }
+      String_push_cstring (self->out_,
+                           SourceGen_rand (self, 2) ? "true" : "false");
+      return;
+    }
+  String_push_cstring (self->out_, "if ");
+  SourceGen_push_if (self, depth - 1);
+  String_push_cstring (self->out_, "\nthen ");
+  SourceGen_push_if (self, depth - 1);
+  String_push_cstring (self->out_, "\nelse ");
+  SourceGen_push_if (self, depth - 1);
+}
+
+String
+bench_gen_if_source (uint32_t depth, uint64_t seed)
+{
+  String out = String_new ();
+  SourceGen gen = { .out_ = &out, .state_ = seed ? seed : 1, .num_vars_ = 0 };
+  SourceGen_push_if (&gen, depth);
+  String_push (&out, '\n');
+  return out;
+}
+
+String
+bench_gen_let_source (uint32_t num_lets, uint32_t depth, uint64_t seed)
+{
+  String out = String_new ();
+  SourceGen gen = { .out_ = &out, .state_ = seed ? seed : 1, .num_vars_ = 0 };
+  for (uint32_t i = 0; i < num_lets; i++)
+    {
+      uint32_t count = 1 + SourceGen_rand (&gen, 3);
+      String_push_cstring (&out, "let ");
+      for (uint32_t j = 0; j < count; j++)
+        {
+          if (j)
+            {
+              String_push_cstring (&out, ", ");
+            }
+          SourceGen_push_var (&gen, gen.num_vars_);
+          if (SourceGen_rand (&gen, 2))
+            {
+              String_push_cstring (&out, ": Bool");
+            }
+          String_push_cstring (&out, " = ");
+          SourceGen_push_if (&gen, depth);
+          gen.num_vars_++;
+        }
+      String_push_cstring (&out, " in\n");
+    }
+  SourceGen_push_if (&gen, depth);
+  String_push (&out, '\n');
+  return out;
+}
+
+String
+bench_gen_source (size_t len, uint64_t seed)
+{
+  String out = String_new ();
+  SourceGen gen = { .out_ = &out, .state_ = seed ? seed : 1, .num_vars_ = 0 };
+  /* A flat tuple keeps the nesting, and so the recursion of every pass,
+   * bounded however large the corpus is.  */
+  String_push (&out, '(');
+  SourceGen_push_expr (&gen, 6);
+  while (String_len (&out) < len)
+    {
+      String_push_cstring (&out, ",\n");
+      SourceGen_push_expr (&gen, 6);
+    }
+  String_push_cstring (&out, ")\n");
+  return out;
+}
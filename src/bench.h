@@ -0,0 +1,81 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_BENCH_H
+#define NEO_BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "array_macro.h"
+#include "string.h"
+#include "vec_macro.h"
+
+typedef struct Bencher Bencher;
+typedef void (*BenchFn) (Bencher *);
+
+typedef struct Bencher
+{
+  const char *file_;
+  const char *func_;
+  BenchFn bench_fn_;
+  uint64_t num_iters_;
+  double secs_;
+  struct timespec begin_;
+  String report_;
+} Bencher;
+
+NEO_DECL_ARRAY (Bencher, Bencher)
+NEO_DECL_VEC (Bencher, Bencher)
+
+typedef Array_Bencher Benches;
+
+/* Benches run one at a time so that they do not disturb each other.  */
+typedef struct BenchManager
+{
+  Vec_Bencher benches_;
+} BenchManager;
+
+BenchManager BenchManager_new ();
+void BenchManager_drop (BenchManager *self);
+void BenchManager_push_benches (BenchManager *self, Array_Bencher benches);
+/* Runs the benches whose name contains FILTER, or all of them if it is
+ * NULL, and returns the number of benches run.  */
+size_t BenchManager_run (BenchManager *self, const char *filter);
+
+void Bencher_start (Bencher *self);
+/* Returns true while the measured loop should run once more.  */
+bool Bencher_iter (Bencher *self);
+void Bencher_report_u64 (Bencher *self, const char *key, uint64_t value);
+void Bencher_report_f64 (Bencher *self, const char *key, double value);
+
+/* Returns a deterministic, well-formed Neo expression of at least LEN
+ * bytes, so that benches of different passes share one corpus.  */
+String bench_gen_source (size_t len, uint64_t seed);
+/* Returns a complete tree of Bool if-then-else expressions of the given
+ * depth, which every pass of the checker accepts.  */
+String bench_gen_if_source (uint32_t depth, uint64_t seed);
+/* Returns NUM_LETS nested lets, whose inits and body are such trees over the
+ * vars bound before them, which every pass of the checker accepts too.  */
+String bench_gen_let_source (uint32_t num_lets, uint32_t depth,
+                             uint64_t seed);
+
+#define NEO_BENCH(NAME)                                                       \
+  static void NAME##_bench_fn_ (Bencher *bencher_);                           \
+  static const Bencher NAME                                                   \
+      = { .file_ = __FILE__, .func_ = #NAME, .bench_fn_ = NAME##_bench_fn_ }; \
+  static void NAME##_bench_fn_ (Bencher *bencher_)
+
+#define NEO_BENCHES(NAME, ...)                                                \
+  static Bencher NAME##_begin_[] = { __VA_ARGS__ };                           \
+  Benches NAME ()                                                             \
+  {                                                                           \
+    return (Benches){ .begin_ = NAME##_begin_,                                \
+                      .len_ = sizeof (NAME##_begin_) / sizeof (Bencher) };    \
+  }
+
+/* Only the statement following BENCH_ITER is timed.  */
+#define BENCH_ITER for (Bencher_start (bencher_); Bencher_iter (bencher_);)
+
+#endif
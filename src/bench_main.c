@@ -0,0 +1,29 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "bench.h"
+
+#include <stdio.h>
+
+/* Includes the bench headers at file scope first, so that benches.def can
+ * be expanded again inside main.  */
+#define NEO_PUSH_BENCHES(NAME)
+#include "benches.def"
+#undef NEO_PUSH_BENCHES
+
+int
+main (int argc, char *argv[])
+{
+  if (argc > 2)
+    {
+      fprintf (stderr, "usage: %s [FILTER]\n", argv[0]);
+      return 1;
+    }
+  BenchManager bench_mgr = BenchManager_new ();
+#define NEO_PUSH_BENCHES(NAME) BenchManager_push_benches (&bench_mgr, NAME ());
+#include "benches.def"
+#undef NEO_PUSH_BENCHES
+  size_t count = BenchManager_run (&bench_mgr, argc > 1 ? argv[1] : NULL);
+  printf ("\nbench result: %zu run\n", count);
+  BenchManager_drop (&bench_mgr);
+  return 0;
+}
@@ -8,11 +8,17 @@
 #include <stdint.h>
 
 #include "option_macro.h"
+#include "string.h"
 #include "vec.h"
 
 #define U32_BITS (32)
+/* The largest power of ten in a digit, by which decimals are written nine
+ * at a time.  */
+#define DECIMAL_CHUNK (1000000000)
+#define DECIMAL_CHUNK_LEN (9)
 
 NEO_IMPL_OPTION (BigInt, BigInt)
+NEO_IMPL_VEC (BigInt, BigInt)
 
 BigInt
 BigInt_new ()
@@ -133,6 +139,48 @@ BigInt_from_str (const char *src, size_t len)
   return BigInt_from_str_radix (src, len, 10);
 }
 
+BigInt
+BigInt_from_i64 (int64_t value)
+{
+  if (value == 0)
+    {
+      return BigInt_new ();
+    }
+  /* Negated unsigned, so that INT64_MIN does not overflow.  */
+  uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+  Vec_u32 digits = Vec_u32_new ();
+  Vec_u32_push (&digits, (uint32_t)magnitude);
+  if (magnitude >> 32)
+    {
+      Vec_u32_push (&digits, (uint32_t)(magnitude >> 32));
+    }
+  return (BigInt){ .sign_ = value < 0 ? BIG_INT_NEGATIVE : BIG_INT_POSITIVE,
+                   .digits_ = digits };
+}
+
+bool
+BigInt_to_i64 (const BigInt *self, int64_t *result)
+{
+  size_t len = Vec_u32_len (&self->digits_);
+  if (len > 2)
+    {
+      return false;
+    }
+  const uint32_t *digits = Vec_u32_cbegin (&self->digits_);
+  uint64_t magnitude = len == 0   ? 0
+                       : len == 1 ? digits[0]
+                                  : (uint64_t)digits[1] << 32 | digits[0];
+  /* The least Int64 has no positive counterpart.  */
+  uint64_t limit = (uint64_t)INT64_MAX + (self->sign_ == BIG_INT_NEGATIVE);
+  if (magnitude > limit)
+    {
+      return false;
+    }
+  *result = self->sign_ == BIG_INT_NEGATIVE ? (int64_t)(0 - magnitude)
+                                            : (int64_t)magnitude;
+  return true;
+}
+
 bool
 BigInt_is_zero (const BigInt *self)
 {
@@ -238,6 +286,110 @@ raw_digits_mac_u32 (uint32_t *acc, const uint32_t *left, size_t left_len,
   raw_digits_add_u32_in_place (acc, carry);
 }
 
+/* Removes the leading zeros, which are stored last.  */
+static void
+digits_trim (Vec_u32 *digits)
+{
+  size_t len = Vec_u32_len (digits);
+  while (len && !Vec_u32_cbegin (digits)[len - 1])
+    {
+      len--;
+    }
+  Vec_u32_resize (digits, len, 0);
+}
+
+static Vec_u32
+digits_clone (const Vec_u32 *digits)
+{
+  Vec_u32 clone = Vec_u32_with_capacity (Vec_u32_len (digits));
+  Vec_u32_extend (&clone, Vec_u32_cbegin (digits), Vec_u32_len (digits));
+  return clone;
+}
+
+static Vec_u32
+digits_add (const Vec_u32 *left, const Vec_u32 *right)
+{
+  if (Vec_u32_len (left) < Vec_u32_len (right))
+    {
+      const Vec_u32 *tmp = left;
+      left = right;
+      right = tmp;
+    }
+  Vec_u32 sum = digits_clone (left);
+  /* One more digit for the last carry.  */
+  Vec_u32_push (&sum, 0);
+  for (size_t idx = 0; idx < Vec_u32_len (right); idx++)
+    {
+      raw_digits_add_u32_in_place (Vec_u32_begin (&sum) + idx,
+                                   Vec_u32_cbegin (right)[idx]);
+    }
+  digits_trim (&sum);
+  return sum;
+}
+
+/* LEFT -= RIGHT, where LEFT is at least RIGHT.  */
+static void
+digits_sub_in_place (Vec_u32 *left, const Vec_u32 *right)
+{
+  assert (digits_cmp (left, right) >= 0);
+  uint32_t *left_digits = Vec_u32_begin (left);
+  bool borrow = false;
+  for (size_t idx = 0; idx < Vec_u32_len (left); idx++)
+    {
+      uint64_t sub = (idx < Vec_u32_len (right) ? Vec_u32_cbegin (right)[idx]
+                                                : 0)
+                     + (uint64_t)borrow;
+      borrow = left_digits[idx] < sub;
+      left_digits[idx] -= sub;
+      if (!borrow && idx >= Vec_u32_len (right))
+        {
+          break;
+        }
+    }
+  digits_trim (left);
+}
+
+/* SELF = SELF * 2 + BIT.  */
+static void
+digits_shl1_in_place (Vec_u32 *self, uint32_t bit)
+{
+  for (uint32_t *digit = Vec_u32_begin (self); digit < Vec_u32_end (self);
+       digit++)
+    {
+      uint32_t carry = *digit >> (U32_BITS - 1);
+      *digit = *digit << 1 | bit;
+      bit = carry;
+    }
+  if (bit)
+    {
+      Vec_u32_push (self, bit);
+    }
+}
+
+/* Long division one bit at a time, which is slow for large divisors but
+ * only ever meets constants.  */
+static Vec_u32
+digits_div (const Vec_u32 *left, const Vec_u32 *right)
+{
+  Vec_u32 quot = Vec_u32_new ();
+  Vec_u32_resize (&quot, Vec_u32_len (left), 0);
+  Vec_u32 rem = Vec_u32_new ();
+  for (size_t bit = Vec_u32_len (left) * U32_BITS; bit-- > 0;)
+    {
+      digits_shl1_in_place (
+          &rem, Vec_u32_cbegin (left)[bit / U32_BITS] >> bit % U32_BITS & 1);
+      if (digits_cmp (&rem, right) >= 0)
+        {
+          digits_sub_in_place (&rem, right);
+          Vec_u32_begin (&quot)[bit / U32_BITS] |= UINT32_C (1)
+                                                    << bit % U32_BITS;
+        }
+    }
+  Vec_u32_drop (&rem);
+  digits_trim (&quot);
+  return quot;
+}
+
 static Vec_u32
 digits_mul (const Vec_u32 *left, const Vec_u32 *right)
 {
@@ -254,17 +406,80 @@ digits_mul (const Vec_u32 *left, const Vec_u32 *right)
       raw_digits_mac_u32 (Vec_u32_begin (&prod) + idx, left_cbegin, left_len,
                           Vec_u32_cbegin (right)[idx]);
     }
-  /* Remove the trailing zeros.  */
-  const uint32_t *back = Vec_u32_cend (&prod);
-  while (back-- > Vec_u32_cbegin (&prod))
+  digits_trim (&prod);
+  return prod;
+}
+
+BigInt
+BigInt_clone (const BigInt *self)
+{
+  return (BigInt){ .sign_ = self->sign_,
+                   .digits_ = digits_clone (&self->digits_) };
+}
+
+static enum BigIntSign
+neg_sign (enum BigIntSign sign)
+{
+  switch (sign)
     {
-      if (*back)
-        {
-          break;
-        }
+    case BIG_INT_NEGATIVE:
+      return BIG_INT_POSITIVE;
+    case BIG_INT_POSITIVE:
+      return BIG_INT_NEGATIVE;
+    default:
+      return BIG_INT_ZERO;
     }
-  Vec_u32_resize (&prod, back + 1 - Vec_u32_cbegin (&prod), 0);
-  return prod;
+}
+
+BigInt
+BigInt_neg (const BigInt *self)
+{
+  BigInt neg = BigInt_clone (self);
+  neg.sign_ = neg_sign (neg.sign_);
+  return neg;
+}
+
+BigInt
+BigInt_add (const BigInt *left, const BigInt *right)
+{
+  if (BigInt_is_zero (left))
+    {
+      return BigInt_clone (right);
+    }
+  if (BigInt_is_zero (right))
+    {
+      return BigInt_clone (left);
+    }
+  if (left->sign_ == right->sign_)
+    {
+      return (BigInt){ .sign_ = left->sign_,
+                       .digits_ = digits_add (&left->digits_,
+                                              &right->digits_) };
+    }
+  int cmp = digits_cmp (&left->digits_, &right->digits_);
+  if (cmp == 0)
+    {
+      return BigInt_new ();
+    }
+  /* The one of the larger magnitude gives the sign.  */
+  if (cmp < 0)
+    {
+      const BigInt *tmp = left;
+      left = right;
+      right = tmp;
+    }
+  BigInt diff = BigInt_clone (left);
+  digits_sub_in_place (&diff.digits_, &right->digits_);
+  return diff;
+}
+
+BigInt
+BigInt_sub (const BigInt *left, const BigInt *right)
+{
+  /* Shares the digits of RIGHT, and so is not dropped.  */
+  BigInt neg_right = { .sign_ = neg_sign (right->sign_),
+                       .digits_ = right->digits_ };
+  return BigInt_add (left, &neg_right);
 }
 
 BigInt
@@ -279,6 +494,72 @@ BigInt_mul (const BigInt *left, const BigInt *right)
                    .digits_ = digits_mul (&left->digits_, &right->digits_) };
 }
 
+BigInt
+BigInt_div (const BigInt *left, const BigInt *right)
+{
+  assert (!BigInt_is_zero (right));
+  Vec_u32 quot = digits_div (&left->digits_, &right->digits_);
+  if (Vec_u32_is_empty (&quot))
+    {
+      Vec_u32_drop (&quot);
+      return BigInt_new ();
+    }
+  return (BigInt){ .sign_ = left->sign_ == right->sign_ ? BIG_INT_POSITIVE
+                                                        : BIG_INT_NEGATIVE,
+                   .digits_ = quot };
+}
+
+/* Divides SELF by RIGHT in place and returns the remainder.  */
+static uint32_t
+digits_div_u32_in_place (Vec_u32 *self, uint32_t right)
+{
+  uint64_t rem = 0;
+  for (uint32_t *ptr = Vec_u32_end (self); ptr > Vec_u32_begin (self);)
+    {
+      ptr--;
+      uint64_t cur = (rem << U32_BITS) | *ptr;
+      *ptr = cur / right;
+      rem = cur % right;
+    }
+  digits_trim (self);
+  return rem;
+}
+
+void
+BigInt_write (const BigInt *self, String *str)
+{
+  if (BigInt_is_zero (self))
+    {
+      String_push (str, '0');
+      return;
+    }
+  if (self->sign_ == BIG_INT_NEGATIVE)
+    {
+      String_push (str, '-');
+    }
+  /* Chunks come out least significant first.  */
+  Vec_u32 digits = digits_clone (&self->digits_);
+  Vec_u32 chunks = Vec_u32_new ();
+  while (!Vec_u32_is_empty (&digits))
+    {
+      Vec_u32_push (&chunks, digits_div_u32_in_place (&digits, DECIMAL_CHUNK));
+    }
+  String_push_u64 (str, Vec_u32_pop (&chunks));
+  while (!Vec_u32_is_empty (&chunks))
+    {
+      uint32_t chunk = Vec_u32_pop (&chunks);
+      char buf[DECIMAL_CHUNK_LEN];
+      for (size_t i = DECIMAL_CHUNK_LEN; i > 0; i--)
+        {
+          buf[i - 1] = '0' + chunk % 10;
+          chunk /= 10;
+        }
+      String_push_carray (str, buf, DECIMAL_CHUNK_LEN);
+    }
+  Vec_u32_drop (&chunks);
+  Vec_u32_drop (&digits);
+}
+
 #ifdef TESTS
 #include "test.h"
 
@@ -353,7 +634,122 @@ NEO_TEST (test_mul_00)
                  0);
 }
 
+NEO_TEST (test_add_sub_00)
+{
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_add, "11", "22", "33"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_add, "-11", "22", "11"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_add, "11", "-22", "-11"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_add, "-11", "11", "0"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_add, "0", "-7", "-7"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_add, "18446744073709551615", "1",
+                                "18446744073709551616"),
+                 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_add, "1",
+                                "340282366920938463426481119284349108225",
+                                "340282366920938463426481119284349108226"),
+                 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_sub, "18446744073709551616", "1",
+                                "18446744073709551615"),
+                 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_sub, "1", "18446744073709551616",
+                                "-18446744073709551615"),
+                 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_sub, "-5", "-5", "0"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_sub, "-5", "7", "-12"), 0);
+}
+
+NEO_TEST (test_div_00)
+{
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_div, "242", "22", "11"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_div, "7", "2", "3"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_div, "-7", "2", "-3"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_div, "7", "-8", "0"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_div, "0", "3", "0"), 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_div,
+                                "2722258935367507707706996859454145691648",
+                                "36893488147419103232",
+                                "73786976294838206464"),
+                 0);
+  ASSERT_I64_EQ (cmp_binary_op (BigInt_div,
+                                "340282366920938463426481119284349108226",
+                                "18446744073709551615",
+                                "18446744073709551615"),
+                 0);
+}
+
+NEO_TEST (test_write_00)
+{
+  static const char *const cases[]
+      = { "0", "7", "-42", "1000000000", "-4294967296",
+          "18446744073709551616", "340282366920938463426481119284349108225",
+          "-1000000000000000000000000000001" };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      Option_BigInt value = BigInt_from_str (cases[i], strlen (cases[i]));
+      BigInt n = Option_BigInt_unwrap (&value);
+      String str = String_new ();
+      BigInt_write (&n, &str);
+      ASSERT_U64_EQ (String_len (&str), strlen (cases[i]));
+      ASSERT_I64_EQ (
+          memcmp (String_cbegin (&str), cases[i], String_len (&str)), 0);
+      String_drop (&str);
+      BigInt_drop (&n);
+    }
+}
+
+NEO_TEST (test_from_i64_00)
+{
+  static const struct
+  {
+    int64_t value;
+    const char *expect;
+  } cases[] = { { 0, "0" },
+                { 42, "42" },
+                { -42, "-42" },
+                { 4294967296, "4294967296" },
+                { INT64_MAX, "9223372036854775807" },
+                { INT64_MIN, "-9223372036854775808" } };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      Option_BigInt expect_opt
+          = BigInt_from_str (cases[i].expect, strlen (cases[i].expect));
+      BigInt expect = Option_BigInt_unwrap (&expect_opt);
+      BigInt n = BigInt_from_i64 (cases[i].value);
+      ASSERT_I64_EQ (BigInt_cmp (&n, &expect), 0);
+      BigInt_drop (&n);
+      BigInt_drop (&expect);
+    }
+}
+
+NEO_TEST (test_to_i64_00)
+{
+  static const struct
+  {
+    const char *value;
+    bool fits;
+    int64_t expect;
+  } cases[] = { { "0", true, 0 },
+                { "-42", true, -42 },
+                { "4294967296", true, 4294967296 },
+                { "9223372036854775807", true, INT64_MAX },
+                { "-9223372036854775808", true, INT64_MIN },
+                { "9223372036854775808", false, 0 },
+                { "-9223372036854775809", false, 0 },
+                { "18446744073709551616", false, 0 } };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      Option_BigInt n_opt
+          = BigInt_from_str (cases[i].value, strlen (cases[i].value));
+      BigInt n = Option_BigInt_unwrap (&n_opt);
+      int64_t result = 0;
+      ASSERT_U64_EQ (BigInt_to_i64 (&n, &result), cases[i].fits);
+      ASSERT_I64_EQ (result, cases[i].expect);
+      BigInt_drop (&n);
+    }
+}
+
 NEO_TESTS (big_int_tests, test_raw_digits_add_u32_in_place_00,
-           test_raw_digits_mac_00, test_mul_00)
+           test_raw_digits_mac_00, test_mul_00, test_add_sub_00, test_div_00,
+           test_write_00, test_from_i64_00, test_to_i64_00)
 
 #endif
@@ -5,8 +5,10 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "option_macro.h"
+#include "string.h"
 #include "vec.h"
 
 enum BigIntSign
@@ -23,17 +25,29 @@ typedef struct BigInt
 } BigInt;
 
 NEO_DECL_OPTION (BigInt, BigInt)
+NEO_DECL_VEC (BigInt, BigInt)
 
 /* Returns a zero.  */
 BigInt BigInt_new ();
 void BigInt_drop (BigInt *self);
 Option_BigInt BigInt_from_str (const char *src, size_t len);
+BigInt BigInt_from_i64 (int64_t value);
+/* Whether SELF is in the range of Int64, and if so sets RESULT to it.  */
+bool BigInt_to_i64 (const BigInt *self, int64_t *result);
 bool BigInt_is_zero (const BigInt *self);
 /* Returns 0 if `left == right`,
  * returns 1 if `left > right`,
  * returns -1 if `left < right`.  */
 int BigInt_cmp (const BigInt *left, const BigInt *right);
+BigInt BigInt_clone (const BigInt *self);
+BigInt BigInt_neg (const BigInt *self);
+BigInt BigInt_add (const BigInt *left, const BigInt *right);
+BigInt BigInt_sub (const BigInt *left, const BigInt *right);
 BigInt BigInt_mul (const BigInt *left, const BigInt *right);
+/* Rounds toward zero.  RIGHT must not be zero.  */
+BigInt BigInt_div (const BigInt *left, const BigInt *right);
+/* Appends SELF in decimal to STR.  */
+void BigInt_write (const BigInt *self, String *str);
 
 #ifdef TESTS
 #include "test.h"
@@ -0,0 +1,547 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+/* For mmap, fstat and getpid.  */
+#define _POSIX_C_SOURCE 200809L
+
+#include "cache.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ast_node.h"
+#include "string.h"
+#include "token.h"
+#include "type.h"
+#include "type_checker.h"
+
+/* The on-disk header.  The source, the tokens, the node columns, the id
+ * pool and the node types follow it in that order, each 8-byte aligned, so
+ * that they can be used in place once the file is mapped.  */
+typedef struct CacheHeader
+{
+  char magic_[4];
+  uint32_t version_;
+  uint64_t hash_;
+  uint64_t content_len_;
+  uint32_t num_tokens_;
+  uint32_t num_nodes_;
+  uint32_t num_ids_;
+  ASTNodeId root_;
+  /* Catches builds whose structs differ, e.g. with NEO_AST_AOS.  */
+  uint32_t token_size_;
+  uint32_t payload_size_;
+} CacheHeader;
+
+static const char CACHE_MAGIC[4] = { 'N', 'E', 'O', 'C' };
+
+uint64_t
+hash_fnv1a (const char *data, size_t len)
+{
+  uint64_t hash = 0xcbf29ce484222325;
+  for (size_t i = 0; i < len; i++)
+    {
+      hash ^= (unsigned char)data[i];
+      hash *= 0x100000001b3;
+    }
+  return hash;
+}
+
+static size_t
+align8 (size_t n)
+{
+  return (n + 7) & ~(size_t)7;
+}
+
+/* Offsets of the sections following the header.  */
+typedef struct CacheLayout
+{
+  size_t content_;
+  size_t tokens_;
+  size_t kinds_;
+  size_t spans_;
+  size_t payloads_;
+  size_t ids_;
+  size_t types_;
+  size_t size_;
+} CacheLayout;
+
+static CacheLayout
+CacheLayout_new (const CacheHeader *header)
+{
+  CacheLayout layout;
+  layout.content_ = align8 (sizeof (CacheHeader));
+  layout.tokens_ = layout.content_ + align8 (header->content_len_);
+  layout.kinds_
+      = layout.tokens_ + align8 (header->num_tokens_ * sizeof (Token));
+  layout.spans_
+      = layout.kinds_ + align8 (header->num_nodes_ * sizeof (enum ASTKind));
+  layout.payloads_
+      = layout.spans_ + align8 (header->num_nodes_ * sizeof (CompactSpan));
+  layout.ids_ = layout.payloads_
+                + align8 (header->num_nodes_ * sizeof (ASTPayload));
+  layout.types_
+      = layout.ids_ + align8 (header->num_ids_ * sizeof (ASTNodeId));
+  layout.size_
+      = layout.types_ + align8 (header->num_nodes_ * sizeof (TypeId));
+  return layout;
+}
+
+String
+Cache_path (const char *dir, const String *content)
+{
+  char name[32];
+  snprintf (name, sizeof (name), "%016llx.neoc",
+            (unsigned long long)hash_fnv1a (String_cbegin (content),
+                                            String_len (content)));
+  String path = String_from_cstring (dir);
+  String_push (&path, '/');
+  String_push_cstring (&path, name);
+  return path;
+}
+
+static bool
+Cache_write_padding (FILE *file, size_t len)
+{
+  static const char zeros[8] = { 0 };
+  size_t padding = align8 (len) - len;
+  return fwrite (zeros, 1, padding, file) == padding;
+}
+
+/* Writes LEN bytes and pads them to a multiple of 8.  */
+static bool
+Cache_write_section (FILE *file, const void *data, size_t len)
+{
+  return fwrite (data, 1, len, file) == len && Cache_write_padding (file, len);
+}
+
+static bool
+Cache_write (FILE *file, const String *content, const Vec_Token *tokens,
+             const ASTNodeManager *ast_mgr, ASTNodeId root,
+             const ASTNodeIdToTypeIdMap *node_type_map)
+{
+  CacheHeader header = { .version_ = NEO_CACHE_VERSION,
+                         .hash_ = hash_fnv1a (String_cbegin (content),
+                                              String_len (content)),
+                         .content_len_ = String_len (content),
+                         .num_tokens_ = Vec_Token_len (tokens),
+                         .num_nodes_ = ASTNodeManager_num_nodes (ast_mgr),
+                         .num_ids_ = ASTNodeManager_num_ids (ast_mgr),
+                         .root_ = root,
+                         .token_size_ = sizeof (Token),
+                         .payload_size_ = sizeof (ASTPayload) };
+  memcpy (header.magic_, CACHE_MAGIC, sizeof (CACHE_MAGIC));
+  size_t num_nodes = header.num_nodes_;
+  bool ok
+      = Cache_write_section (file, &header, sizeof (header))
+        && Cache_write_section (file, String_cbegin (content),
+                                String_len (content))
+        && Cache_write_section (file, Vec_Token_cbegin (tokens),
+                                Vec_Token_len (tokens) * sizeof (Token));
+  /* The columns are gathered one node at a time so that the file does not
+   * depend on NEO_AST_AOS.  */
+  for (ASTNodeId id = 0; ok && id < num_nodes; id++)
+    {
+      enum ASTKind kind = ASTNodeManager_get_kind (ast_mgr, id);
+      ok = fwrite (&kind, sizeof (kind), 1, file) == 1;
+    }
+  ok = ok && Cache_write_padding (file, num_nodes * sizeof (enum ASTKind));
+  for (ASTNodeId id = 0; ok && id < num_nodes; id++)
+    {
+      ok = fwrite (ASTNodeManager_get_span (ast_mgr, id), sizeof (CompactSpan),
+                   1, file)
+           == 1;
+    }
+  ok = ok && Cache_write_padding (file, num_nodes * sizeof (CompactSpan));
+  for (ASTNodeId id = 0; ok && id < num_nodes; id++)
+    {
+      ok = fwrite (ASTNodeManager_get_payload (ast_mgr, id),
+                   sizeof (ASTPayload), 1, file)
+           == 1;
+    }
+  ok = ok && Cache_write_padding (file, num_nodes * sizeof (ASTPayload));
+  ok = ok
+       && Cache_write_section (file, ASTNodeManager_get_ids (ast_mgr),
+                               header.num_ids_ * sizeof (ASTNodeId));
+  for (ASTNodeId id = 0; ok && id < num_nodes; id++)
+    {
+      TypeId type_id = ASTNodeIdToTypeIdMap_get (node_type_map, id);
+      assert (type_id < TYPE_NUM_BUILT_IN);
+      ok = fwrite (&type_id, sizeof (type_id), 1, file) == 1;
+    }
+  return ok && Cache_write_padding (file, num_nodes * sizeof (TypeId));
+}
+
+bool
+Cache_store (const char *path, const String *content, const Vec_Token *tokens,
+             const ASTNodeManager *ast_mgr, ASTNodeId root,
+             const ASTNodeIdToTypeIdMap *node_type_map)
+{
+  String tmp_path = String_from_cstring (path);
+  String_push_cstring (&tmp_path, ".tmp.");
+  String_push_u64 (&tmp_path, getpid ());
+  String_push (&tmp_path, '\0');
+  FILE *file = fopen (String_cbegin (&tmp_path), "wb");
+  bool ok = file != NULL;
+  if (ok)
+    {
+      ok = Cache_write (file, content, tokens, ast_mgr, root, node_type_map);
+      ok = fclose (file) == 0 && ok;
+      /* Renaming is atomic, so a concurrent reader sees the old entry or
+       * the new one.  */
+      ok = ok && rename (String_cbegin (&tmp_path), path) == 0;
+      if (!ok)
+        {
+          remove (String_cbegin (&tmp_path));
+        }
+    }
+  String_drop (&tmp_path);
+  return ok;
+}
+
+static const CacheHeader *
+CacheEntry_get_header (const CacheEntry *self)
+{
+  return self->map_;
+}
+
+static CacheLayout
+CacheEntry_get_layout (const CacheEntry *self)
+{
+  return CacheLayout_new (CacheEntry_get_header (self));
+}
+
+static const char *
+CacheEntry_at (const CacheEntry *self, size_t offset)
+{
+  return (const char *)self->map_ + offset;
+}
+
+static bool
+CacheEntry_is_valid (const CacheEntry *self, const String *content)
+{
+  if (self->size_ < sizeof (CacheHeader))
+    {
+      return false;
+    }
+  const CacheHeader *header = CacheEntry_get_header (self);
+  if (memcmp (header->magic_, CACHE_MAGIC, sizeof (CACHE_MAGIC))
+      || header->version_ != NEO_CACHE_VERSION
+      || header->token_size_ != sizeof (Token)
+      || header->payload_size_ != sizeof (ASTPayload)
+      || header->content_len_ != String_len (content)
+      || header->root_ >= header->num_nodes_)
+    {
+      return false;
+    }
+  CacheLayout layout = CacheLayout_new (header);
+  /* The hash only names the file, so the source itself decides a hit.  */
+  if (layout.size_ != self->size_
+      || header->hash_
+             != hash_fnv1a (String_cbegin (content), String_len (content))
+      || memcmp (CacheEntry_at (self, layout.content_),
+                 String_cbegin (content), String_len (content)))
+    {
+      return false;
+    }
+  const TypeId *types = (const TypeId *)CacheEntry_at (self, layout.types_);
+  for (ASTNodeId id = 0; id < header->num_nodes_; id++)
+    {
+      if (types[id] >= TYPE_NUM_BUILT_IN)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+bool
+CacheEntry_load (CacheEntry *self, const char *path, const String *content)
+{
+  int fd = open (path, O_RDONLY);
+  if (fd < 0)
+    {
+      return false;
+    }
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat (fd, &st) == 0 && st.st_size > 0)
+    {
+      map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      return false;
+    }
+  *self = (CacheEntry){ .map_ = map, .size_ = st.st_size };
+  if (!CacheEntry_is_valid (self, content))
+    {
+      CacheEntry_drop (self);
+      return false;
+    }
+  return true;
+}
+
+void
+CacheEntry_drop (CacheEntry *self)
+{
+  munmap (self->map_, self->size_);
+  self->map_ = NULL;
+  self->size_ = 0;
+}
+
+size_t
+CacheEntry_num_tokens (const CacheEntry *self)
+{
+  return CacheEntry_get_header (self)->num_tokens_;
+}
+
+const Token *
+CacheEntry_get_tokens (const CacheEntry *self)
+{
+  return (const Token *)CacheEntry_at (self,
+                                       CacheEntry_get_layout (self).tokens_);
+}
+
+size_t
+CacheEntry_num_nodes (const CacheEntry *self)
+{
+  return CacheEntry_get_header (self)->num_nodes_;
+}
+
+const enum ASTKind *
+CacheEntry_get_kinds (const CacheEntry *self)
+{
+  return (const enum ASTKind *)CacheEntry_at (
+      self, CacheEntry_get_layout (self).kinds_);
+}
+
+const CompactSpan *
+CacheEntry_get_spans (const CacheEntry *self)
+{
+  return (const CompactSpan *)CacheEntry_at (
+      self, CacheEntry_get_layout (self).spans_);
+}
+
+const ASTPayload *
+CacheEntry_get_payloads (const CacheEntry *self)
+{
+  return (const ASTPayload *)CacheEntry_at (
+      self, CacheEntry_get_layout (self).payloads_);
+}
+
+size_t
+CacheEntry_num_ids (const CacheEntry *self)
+{
+  return CacheEntry_get_header (self)->num_ids_;
+}
+
+const ASTNodeId *
+CacheEntry_get_ids (const CacheEntry *self)
+{
+  return (const ASTNodeId *)CacheEntry_at (self,
+                                           CacheEntry_get_layout (self).ids_);
+}
+
+ASTNodeId
+CacheEntry_get_root (const CacheEntry *self)
+{
+  return CacheEntry_get_header (self)->root_;
+}
+
+TypeId
+CacheEntry_get_type (const CacheEntry *self, ASTNodeId id)
+{
+  assert (id < CacheEntry_num_nodes (self));
+  return ((const TypeId *)CacheEntry_at (
+      self, CacheEntry_get_layout (self).types_))[id];
+}
+
+#ifdef TESTS
+#include "test.h"
+
+#include <stdlib.h>
+
+#include "diagnostic.h"
+#include "lexer.h"
+#include "parser.h"
+
+/* A whole pass over a source, as `neo check` runs it on a miss.  */
+typedef struct CacheTest
+{
+  char dir_[32];
+  String path_;
+  SourceFile file_;
+  Vec_Token tokens_;
+  ASTNodeManager ast_mgr_;
+  DiagnosticManager diag_mgr_;
+  ASTNodeId root_;
+  TypeManager type_mgr_;
+  ASTNodeIdToTypeIdMap node_type_map_;
+} CacheTest;
+
+static void
+CacheTest_init (CacheTest *self, const char *content)
+{
+  strcpy (self->dir_, "/tmp/neo-cache-XXXXXX");
+  const char *dir = mkdtemp (self->dir_);
+  assert (dir);
+  (void)dir;
+  self->file_ = SourceFile_new (String_from_cstring ("test"),
+                                String_from_cstring (content));
+  const String *text = SourceFile_get_content (&self->file_);
+  self->path_ = Cache_path (self->dir_, text);
+  String_push (&self->path_, '\0');
+  Span span = Span_from_string (text);
+  Lexer lexer = Lexer_new (&span);
+  self->tokens_ = Vec_Token_new ();
+  Token token;
+  do
+    {
+      token = Lexer_next (&lexer);
+      Vec_Token_push (&self->tokens_, token);
+    }
+  while (!Token_is_eof (&token));
+  self->ast_mgr_ = ASTNodeManager_new ();
+  self->diag_mgr_ = DiagnosticManager_new (&self->file_);
+  Parser parser = Parser_new (&self->tokens_, &self->diag_mgr_,
+                              &self->ast_mgr_);
+  self->root_ = Parser_parse (&parser);
+  Parser_drop (&parser);
+  self->type_mgr_ = TypeManager_new ();
+  TypeChecker checker
+      = TypeChecker_new (&self->ast_mgr_, &self->diag_mgr_, &self->type_mgr_);
+  self->node_type_map_ = TypeChecker_check (&checker, self->root_);
+}
+
+static const char *
+CacheTest_get_path (const CacheTest *self)
+{
+  return String_cbegin (&self->path_);
+}
+
+static bool
+CacheTest_store (const CacheTest *self)
+{
+  return Cache_store (CacheTest_get_path (self),
+                      SourceFile_get_content (&self->file_), &self->tokens_,
+                      &self->ast_mgr_, self->root_, &self->node_type_map_);
+}
+
+static void
+CacheTest_drop (CacheTest *self)
+{
+  remove (CacheTest_get_path (self));
+  rmdir (self->dir_);
+  String_drop (&self->path_);
+  ASTNodeIdToTypeIdMap_drop (&self->node_type_map_);
+  TypeManager_drop (&self->type_mgr_);
+  DiagnosticManager_drop (&self->diag_mgr_);
+  ASTNodeManager_drop (&self->ast_mgr_);
+  Vec_Token_drop (&self->tokens_);
+  SourceFile_drop (&self->file_);
+}
+
+NEO_TEST (test_cache_load_00)
+{
+  CacheTest tester;
+  CacheTest_init (&tester, "if true then (true, false) else (false, true)");
+  ASSERT_U64_EQ (CacheTest_store (&tester), true);
+  CacheEntry entry;
+  ASSERT_U64_EQ (CacheEntry_load (&entry, CacheTest_get_path (&tester),
+                                  SourceFile_get_content (&tester.file_)),
+                 true);
+  size_t num_tokens = Vec_Token_len (&tester.tokens_);
+  ASSERT_U64_EQ (CacheEntry_num_tokens (&entry), num_tokens);
+  ASSERT_I64_EQ (memcmp (CacheEntry_get_tokens (&entry),
+                         Vec_Token_cbegin (&tester.tokens_),
+                         num_tokens * sizeof (Token)),
+                 0);
+  ASSERT_U64_EQ (CacheEntry_num_nodes (&entry),
+                 ASTNodeManager_num_nodes (&tester.ast_mgr_));
+  for (ASTNodeId id = 0; id < CacheEntry_num_nodes (&entry); id++)
+    {
+      ASSERT_U64_EQ (CacheEntry_get_kinds (&entry)[id],
+                     ASTNodeManager_get_kind (&tester.ast_mgr_, id));
+      ASSERT_I64_EQ (memcmp (CacheEntry_get_spans (&entry) + id,
+                             ASTNodeManager_get_span (&tester.ast_mgr_, id),
+                             sizeof (CompactSpan)),
+                     0);
+      ASSERT_U64_EQ (CacheEntry_get_type (&entry, id),
+                     ASTNodeIdToTypeIdMap_get (&tester.node_type_map_, id));
+    }
+  ASSERT_U64_EQ (CacheEntry_num_ids (&entry),
+                 ASTNodeManager_num_ids (&tester.ast_mgr_));
+  ASSERT_I64_EQ (memcmp (CacheEntry_get_ids (&entry),
+                         ASTNodeManager_get_ids (&tester.ast_mgr_),
+                         CacheEntry_num_ids (&entry) * sizeof (ASTNodeId)),
+                 0);
+  ASSERT_U64_EQ (CacheEntry_get_root (&entry), tester.root_);
+  CacheEntry_drop (&entry);
+  CacheTest_drop (&tester);
+}
+
+static void
+overwrite_file (const char *path, long offset, const void *data, size_t len)
+{
+  FILE *file = fopen (path, "r+b");
+  assert (file);
+  fseek (file, offset, SEEK_SET);
+  fwrite (data, 1, len, file);
+  fclose (file);
+}
+
+NEO_TEST (test_cache_invalidate_00)
+{
+  CacheTest tester;
+  CacheTest_init (&tester, "if true then true else false");
+  const char *path = CacheTest_get_path (&tester);
+  const String *content = SourceFile_get_content (&tester.file_);
+  CacheEntry entry;
+  /* Nothing stored yet.  */
+  ASSERT_U64_EQ (CacheEntry_load (&entry, path, content), false);
+  ASSERT_U64_EQ (CacheTest_store (&tester), true);
+  /* An edit of the same length.  */
+  String edited = String_from_cstring ("if true then true else falsE");
+  ASSERT_U64_EQ (CacheEntry_load (&entry, path, &edited), false);
+  String edited_path = Cache_path (tester.dir_, &edited);
+  ASSERT_U64_EQ (String_len (&edited_path) == String_len (&tester.path_) - 1
+                     && !memcmp (String_cbegin (&edited_path), path,
+                                 String_len (&edited_path)),
+                 false);
+  String_drop (&edited_path);
+  String_drop (&edited);
+  /* Another version of the compiler.  */
+  uint32_t version = NEO_CACHE_VERSION + 1;
+  overwrite_file (path, offsetof (CacheHeader, version_), &version,
+                  sizeof (version));
+  ASSERT_U64_EQ (CacheEntry_load (&entry, path, content), false);
+  /* A truncated entry.  */
+  ASSERT_U64_EQ (CacheTest_store (&tester), true);
+  ASSERT_U64_EQ (CacheEntry_load (&entry, path, content), true);
+  size_t size = entry.size_;
+  CacheEntry_drop (&entry);
+  ASSERT_I64_EQ (truncate (path, size - 8), 0);
+  ASSERT_U64_EQ (CacheEntry_load (&entry, path, content), false);
+  /* A type that no fresh TypeManager knows.  */
+  ASSERT_U64_EQ (CacheTest_store (&tester), true);
+  ASSERT_U64_EQ (CacheEntry_load (&entry, path, content), true);
+  size_t types = CacheEntry_get_layout (&entry).types_;
+  CacheEntry_drop (&entry);
+  TypeId type_id = TYPE_NUM_BUILT_IN;
+  overwrite_file (path, types + tester.root_ * sizeof (TypeId), &type_id,
+                  sizeof (type_id));
+  ASSERT_U64_EQ (CacheEntry_load (&entry, path, content), false);
+  CacheTest_drop (&tester);
+}
+
+NEO_TESTS (cache_tests, test_cache_load_00, test_cache_invalidate_00)
+#endif
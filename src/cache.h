@@ -0,0 +1,65 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_CACHE_H
+#define NEO_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast_node.h"
+#include "span.h"
+#include "string.h"
+#include "token.h"
+#include "type.h"
+#include "type_checker.h"
+
+/* Bumped whenever the layout of a cache file, or of anything stored in it,
+ * changes.  */
+#define NEO_CACHE_VERSION (4)
+
+uint64_t hash_fnv1a (const char *data, size_t len);
+
+/* A read-only mapping of a cache file that matched its source.  */
+typedef struct CacheEntry
+{
+  void *map_;
+  size_t size_;
+} CacheEntry;
+
+/* Returns DIR/HASH.neoc, where HASH is taken over CONTENT.  */
+String Cache_path (const char *dir, const String *content);
+/* Writes the results of a whole pass over CONTENT to PATH, through a
+ * temporary file so that readers never see a partial entry.  Returns false
+ * if the file could not be written, which callers may ignore.  Only the
+ * type ids are stored, not the types, so every type of NODE_TYPE_MAP must
+ * be built in, below TYPE_NUM_BUILT_IN, to be read back through any
+ * TypeManager.  A checker that interns compound types must store its type
+ * table along with them, and bump NEO_CACHE_VERSION.  */
+bool Cache_store (const char *path, const String *content,
+                  const Vec_Token *tokens, const ASTNodeManager *ast_mgr,
+                  ASTNodeId root, const ASTNodeIdToTypeIdMap *node_type_map);
+
+/* Maps PATH and returns true if it is a valid entry for exactly CONTENT.
+ * Any mismatch, including a different version or a type that is not built
+ * in, is a miss.  */
+bool CacheEntry_load (CacheEntry *self, const char *path,
+                      const String *content);
+void CacheEntry_drop (CacheEntry *self);
+size_t CacheEntry_num_tokens (const CacheEntry *self);
+const Token *CacheEntry_get_tokens (const CacheEntry *self);
+size_t CacheEntry_num_nodes (const CacheEntry *self);
+const enum ASTKind *CacheEntry_get_kinds (const CacheEntry *self);
+const CompactSpan *CacheEntry_get_spans (const CacheEntry *self);
+const ASTPayload *CacheEntry_get_payloads (const CacheEntry *self);
+size_t CacheEntry_num_ids (const CacheEntry *self);
+const ASTNodeId *CacheEntry_get_ids (const CacheEntry *self);
+ASTNodeId CacheEntry_get_root (const CacheEntry *self);
+TypeId CacheEntry_get_type (const CacheEntry *self, ASTNodeId id);
+
+#ifdef TESTS
+#include "test.h"
+Tests cache_tests ();
+#endif
+
+#endif
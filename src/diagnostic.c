@@ -5,12 +5,16 @@
 #include <assert.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "ast_node.h"
+#include "json.h"
 #include "span.h"
 #include "string.h"
 #include "token.h"
+#include "type.h"
+#include "vec.h"
 #include "vec_macro.h"
 
 #define ESC_DEFAULT "\e[0m"
@@ -20,148 +24,263 @@
 #define ESC_YELLOW "\e[1;33m"
 #define ESC_BLUE "\e[1;34m"
 
-NEO_IMPL_VEC (SpanInfo, SpanInfo)
-NEO_IMPL_VEC (DiagnosticId, DiagnosticId)
 NEO_IMPL_VEC (Diagnostic, Diagnostic)
 
-static String
-Span_fmt (const Span *self)
+enum DiagnosticLevel
+Diagnostic_get_level (const Diagnostic *self)
 {
-  if (self && Span_len (self))
+  switch (self->name_)
     {
-      String output = String_from_cstring ("`");
-      String_push_carray (&output, Span_cbegin (self), Span_len (self));
-      String_push_cstring (&output, "`");
-      return output;
+#define NEO_DIAGNOSTIC(NAME, LEVEL)                                           \
+  case DIAGNOSTIC_##NAME:                                                     \
+    return DIAG_LEVEL_##LEVEL;
+#include "diagnostic.def"
+#undef NEO_DIAGNOSTIC
     }
-  return String_from_cstring ("<eof>");
+  return DIAG_LEVEL_ERROR;
 }
 
-static SpanInfo
-SpanInfo_new (Span span, String label)
+CompactSpan
+Diagnostic_get_span (const Diagnostic *self)
 {
-  return (SpanInfo){ .span_ = span, .label_ = label };
+  return self->span_;
 }
 
-static void
-SpanInfo_drop (SpanInfo *self)
+DiagnosticManager
+DiagnosticManager_new (const SourceFile *file)
 {
-  String_drop (&self->label_);
+  return (DiagnosticManager){ .file_ = file,
+                              .type_mgr_ = NULL,
+                              .colored_ = true,
+                              .display_ = true,
+                              .diagnostics_ = Vec_Diagnostic_new (),
+                              .args_ = Vec_u32_new (),
+                              .limit_ = SIZE_MAX,
+                              .num_total_ = 0 };
 }
 
-static void
-SpanInfo_set_label (SpanInfo *self, String label)
+void
+DiagnosticManager_drop (DiagnosticManager *self)
 {
-  String_drop (&self->label_);
-  self->label_ = label;
+  Vec_Diagnostic_drop (&self->diagnostics_);
+  Vec_u32_drop (&self->args_);
 }
 
-static Diagnostic
-Diagnostic_new (enum DiagnosticName name, Span span)
+size_t
+DiagnosticManager_num_total (const DiagnosticManager *self)
 {
-  switch (name)
-    {
-#define NEO_DIAGNOSTIC(NAME, LEVEL)                                           \
-  case DIAGNOSTIC_##NAME:                                                     \
-    {                                                                         \
-      Vec_SpanInfo span_infos = Vec_SpanInfo_new ();                          \
-      Vec_SpanInfo_push (&span_infos, SpanInfo_new (span, String_new ()));    \
-      return (Diagnostic){ .name_ = DIAGNOSTIC_##NAME,                        \
-                           .level_ = DIAG_LEVEL_##LEVEL,                      \
-                           .message_ = String_new (),                         \
-                           .span_infos_ = span_infos,                         \
-                           .children_ = Vec_DiagnosticId_new () };            \
-    }
-#include "diagnostic.def"
-#undef NEO_DIAGNOSTIC
-    }
-  return (Diagnostic){};
+  return self->num_total_;
 }
 
-static void
-Diagnostic_drop (Diagnostic *self)
+size_t
+DiagnosticManager_num_stored (const DiagnosticManager *self)
 {
-  String_drop (&self->message_);
-  for (SpanInfo *span_info = Vec_SpanInfo_begin (&self->span_infos_);
-       span_info < Vec_SpanInfo_end (&self->span_infos_); span_info++)
-    {
-      SpanInfo_drop (span_info);
-    }
-  Vec_SpanInfo_drop (&self->span_infos_);
-  Vec_DiagnosticId_drop (&self->children_);
+  return Vec_Diagnostic_len (&self->diagnostics_);
 }
 
-static void
-Diagnostic_set_message (Diagnostic *self, String message)
+const Diagnostic *
+DiagnosticManager_get (const DiagnosticManager *self, DiagnosticId id)
 {
-  String_drop (&self->message_);
-  self->message_ = message;
+  assert (id < Vec_Diagnostic_len (&self->diagnostics_));
+  return Vec_Diagnostic_cbegin (&self->diagnostics_) + id;
 }
 
-static void
-Diagnostic_push_span_info (Diagnostic *self, SpanInfo span_info)
+void
+DiagnosticManager_set_colored (DiagnosticManager *self, bool colored)
 {
-  Vec_SpanInfo_push (&self->span_infos_, span_info);
+  self->colored_ = colored;
 }
 
-static void
-Diagnostic_set_span_info_label (Diagnostic *self, size_t span_info_id,
-                                String label)
+void
+DiagnosticManager_set_display (DiagnosticManager *self, bool display)
 {
-  assert (span_info_id < Vec_SpanInfo_len (&self->span_infos_));
-  SpanInfo_set_label (Vec_SpanInfo_begin (&self->span_infos_), label);
+  self->display_ = display;
 }
 
-DiagnosticManager
-DiagnosticManager_new (const SourceFile *file)
+void
+DiagnosticManager_set_type_manager (DiagnosticManager *self,
+                                    const TypeManager *type_mgr)
 {
-  return (DiagnosticManager){ .file_ = file,
-                              .colored_ = true,
-                              .display_ = true,
-                              .diagnostics_ = Vec_Diagnostic_new () };
+  self->type_mgr_ = type_mgr;
 }
 
 void
-DiagnosticManager_drop (DiagnosticManager *self)
+DiagnosticManager_set_limit (DiagnosticManager *self, size_t limit)
 {
-  for (Diagnostic *diag = Vec_Diagnostic_begin (&self->diagnostics_);
-       diag < Vec_Diagnostic_end (&self->diagnostics_); diag++)
+  self->limit_ = limit;
+}
+
+static const uint32_t *
+DiagnosticManager_get_args (const DiagnosticManager *self,
+                            const Diagnostic *diag)
+{
+  return Vec_u32_cbegin (&self->args_) + diag->args_;
+}
+
+static void
+DiagnosticManager_push_span (const DiagnosticManager *self, String *output,
+                             CompactSpan span)
+{
+  if (CompactSpan_len (&span))
     {
-      Diagnostic_drop (diag);
+      Span text = SourceFile_get_span (self->file_, span);
+      String_push (output, '`');
+      String_push_carray (output, Span_cbegin (&text), Span_len (&text));
+      String_push (output, '`');
+    }
+  else
+    {
+      String_push_cstring (output, "<eof>");
     }
-  Vec_Diagnostic_drop (&self->diagnostics_);
 }
 
-size_t
-DiagnosticManager_num_total (const DiagnosticManager *self)
+static void
+push_token_kind (String *output, enum TokenKind token)
 {
-  return Vec_Diagnostic_len (&self->diagnostics_);
+  switch (token)
+    {
+#define NEO_TOKEN_LIT(NAME, LITERAL)                                          \
+  case TOKEN_##NAME:                                                          \
+    {                                                                         \
+      String_push_cstring (output, "`" #LITERAL "`");                         \
+      break;                                                                  \
+    }
+#include "token_lit.def"
+#undef NEO_TOKEN_LIT
+#define NEO_TOKEN(NAME)                                                       \
+  case TOKEN_##NAME:                                                          \
+    {                                                                         \
+      String_push_cstring (output, "<" #NAME ">");                            \
+      break;                                                                  \
+    }
+#include "token.def"
+#undef NEO_TOKEN
+    }
 }
 
-void
-DiagnosticManager_set_colored (DiagnosticManager *self, bool colored)
+static void
+push_ast_kind (String *output, enum ASTKind node)
 {
-  self->colored_ = colored;
+  switch (node)
+    {
+#define NEO_ASTKIND(NAME, LABEL)                                              \
+  case AST_##NAME:                                                            \
+    {                                                                         \
+      String_push_cstring (output, "<" #LABEL ">");                           \
+      break;                                                                  \
+    }
+#include "ast_kind.def"
+#undef NEO_ASTKIND
+    }
 }
 
-void
-DiagnosticManager_set_display (DiagnosticManager *self, bool display)
+/* Appends the one-line message of DIAG to MESSAGE.  */
+static void
+DiagnosticManager_push_message (const DiagnosticManager *self,
+                                const Diagnostic *diag, String *message)
 {
-  self->display_ = display;
+  const uint32_t *args = DiagnosticManager_get_args (self, diag);
+  switch (diag->name_)
+    {
+    case DIAGNOSTIC_INVALID_TOKEN:
+      String_push_cstring (message, "invalid token: ");
+      break;
+    case DIAGNOSTIC_EXPECTED_TOKENS_OR_NODES:
+    case DIAGNOSTIC_EXPECTED_TOKEN:
+    case DIAGNOSTIC_EXPECTED_NODE:
+      String_push_cstring (message, "expected ");
+      for (size_t i = 0; i < diag->num_args_; i++)
+        {
+          if (i < diag->num_tokens_)
+            {
+              push_token_kind (message, args[i]);
+            }
+          else
+            {
+              push_ast_kind (message, args[i]);
+            }
+          String_push_cstring (message, ", ");
+          if (i + 2 == diag->num_args_)
+            {
+              String_push_cstring (message, "or ");
+            }
+        }
+      String_push_cstring (message, "found ");
+      break;
+    case DIAGNOSTIC_UNEXPECTED_TOKEN:
+      String_push_cstring (message, "unexpected token: ");
+      break;
+    case DIAGNOSTIC_UNCLOSED_DELIMITER:
+      String_push_cstring (message, "unclosed delimiter: ");
+      break;
+    case DIAGNOSTIC_INVALID_TYPE:
+      String_push_cstring (message, "invalid type: ");
+      break;
+    case DIAGNOSTIC_IF_EXPR_NOT_BOOL:
+      String_push_cstring (message, "condition is not a subtype of Bool: ");
+      break;
+    case DIAGNOSTIC_THEN_ELSE_NOT_EQUAL:
+      String_push_cstring (message, "types of then and else are not equal");
+      return;
+    case DIAGNOSTIC_LET_TYPE_NOT_EQUAL:
+      String_push_cstring (message,
+                           "type of the init is not the annotated type");
+      return;
+    case DIAGNOSTIC_VAR_NOT_BOUND:
+      String_push_cstring (message, "the variable is not bound: ");
+      break;
+    case DIAGNOSTIC_OPERAND_NOT_INTEGER:
+      String_push_cstring (message, "operand is not an integer: ");
+      break;
+    case DIAGNOSTIC_INTEGER_OUT_OF_RANGE:
+      String_push_cstring (message, "integer literal out of range of Int64: ");
+      break;
+    }
+  DiagnosticManager_push_span (self, message, diag->span_);
 }
 
-const Diagnostic *
-DiagnosticManager_get (const DiagnosticManager *self, DiagnosticId id)
+String
+DiagnosticManager_fmt_message (const DiagnosticManager *self,
+                               DiagnosticId id)
 {
-  return Vec_Diagnostic_cbegin (&self->diagnostics_) + id;
+  String message = String_new ();
+  DiagnosticManager_push_message (self, DiagnosticManager_get (self, id),
+                                  &message);
+  return message;
 }
 
-static DiagnosticId
-DiagnosticManager_push (DiagnosticManager *self, Diagnostic diag)
+/* Appends the label under the Ith span of DIAG, which may be empty.  */
+static void
+DiagnosticManager_push_label (const DiagnosticManager *self,
+                              const Diagnostic *diag, size_t i, String *label)
 {
-  DiagnosticId id = Vec_Diagnostic_len (&self->diagnostics_);
-  Vec_Diagnostic_push (&self->diagnostics_, diag);
-  return id;
+  if (diag->name_ == DIAGNOSTIC_IF_EXPR_NOT_BOOL
+      || diag->name_ == DIAGNOSTIC_THEN_ELSE_NOT_EQUAL
+      || diag->name_ == DIAGNOSTIC_LET_TYPE_NOT_EQUAL
+      || diag->name_ == DIAGNOSTIC_OPERAND_NOT_INTEGER)
+    {
+      assert (self->type_mgr_ && i < diag->num_args_);
+      String_push_cstring (label, "is of type `");
+      String_push_cstring (
+          label, TypeManager_get_name (
+                     self->type_mgr_,
+                     DiagnosticManager_get_args (self, diag)[i]));
+      String_push (label, '`');
+    }
+}
+
+static const char *
+name_to_cstring (enum DiagnosticName name)
+{
+  switch (name)
+    {
+#define NEO_DIAGNOSTIC(NAME, LEVEL)                                           \
+  case DIAGNOSTIC_##NAME:                                                     \
+    return #NAME;
+#include "diagnostic.def"
+#undef NEO_DIAGNOSTIC
+    }
+  return NULL;
 }
 
 static const char *
@@ -211,14 +330,14 @@ get_num_digits (size_t n)
 
 static String
 DiagnosticManager_fmt_span_info (const DiagnosticManager *self,
-                                 const SpanInfo *span_info)
+                                 CompactSpan compact, const String *label)
 {
   String output = String_new ();
   const SourceFile *file = self->file_;
-  const Span *span = &span_info->span_;
-  Position begin_pos = SourceFile_lookup_position (file, Span_cbegin (span));
+  Span span = SourceFile_get_span (file, compact);
+  Position begin_pos = SourceFile_lookup_position (file, Span_cbegin (&span));
   Position end_pos = SourceFile_lookup_position (
-      file, Span_len (span) ? Span_cend (span) - 1 : Span_cend (span));
+      file, Span_len (&span) ? Span_cend (&span) - 1 : Span_cend (&span));
   size_t begin_pos_line = Position_get_line (&begin_pos);
   if (!begin_pos_line)
     {
@@ -262,46 +381,230 @@ DiagnosticManager_fmt_span_info (const DiagnosticManager *self,
   String_push_cstring (&output, vertical_bar_to_cstring (self->colored_));
   String_push_repeat (&output, ' ', begin_pos_column + 1);
   String_push_cstring_repeat (&output, caret_to_cstring (self->colored_),
-                              Span_len (span) ? Span_len (span) : 1);
-  if (String_len (&span_info->label_))
+                              Span_len (&span) ? Span_len (&span) : 1);
+  if (String_len (label))
     {
       String_push (&output, ' ');
-      String_push_string (&output, &span_info->label_);
+      String_push_string (&output, label);
     }
   String_push (&output, '\n');
   return output;
 }
 
-static String
+static size_t
+Diagnostic_num_spans (const Diagnostic *self)
+{
+  return self->name_ == DIAGNOSTIC_THEN_ELSE_NOT_EQUAL
+                 || self->name_ == DIAGNOSTIC_LET_TYPE_NOT_EQUAL
+             ? 2
+             : 1;
+}
+
+static CompactSpan
+Diagnostic_get_nth_span (const Diagnostic *self, size_t i)
+{
+  return i ? self->other_span_ : self->span_;
+}
+
+String
 DiagnosticManager_fmt_diagnostic (const DiagnosticManager *self,
                                   DiagnosticId id)
 {
   const Diagnostic *diag = DiagnosticManager_get (self, id);
   String output = String_new ();
-  String_push_cstring (&output,
-                       level_to_cstring (diag->level_, self->colored_));
+  String_push_cstring (&output, level_to_cstring (Diagnostic_get_level (diag),
+                                                  self->colored_));
   if (self->colored_)
     {
       String_push_cstring (&output, ESC_BOLD);
     }
   String_push_cstring (&output, ": ");
-  String_push_string (&output, &diag->message_);
+  DiagnosticManager_push_message (self, diag, &output);
   if (self->colored_)
     {
       String_push_cstring (&output, ESC_DEFAULT);
     }
   String_push_cstring (&output, "\n");
-  for (const SpanInfo *span_info = Vec_SpanInfo_cbegin (&diag->span_infos_);
-       span_info < Vec_SpanInfo_cend (&diag->span_infos_); span_info++)
+  for (size_t i = 0; i < Diagnostic_num_spans (diag); i++)
     {
-      String span_info_output
-          = DiagnosticManager_fmt_span_info (self, span_info);
+      String label = String_new ();
+      DiagnosticManager_push_label (self, diag, i, &label);
+      String span_info_output = DiagnosticManager_fmt_span_info (
+          self, Diagnostic_get_nth_span (diag, i), &label);
       String_push_string (&output, &span_info_output);
       String_drop (&span_info_output);
+      String_drop (&label);
     }
   return output;
 }
 
+/* Writes where SPAN begins and ends as 1-based lines and columns, the end
+ * being exclusive.  Diagnostics mostly come in the order of the text, so
+ * CURSOR seldom has to search.  */
+static void
+DiagnosticManager_write_region (const DiagnosticManager *self,
+                                PositionCursor *cursor, JsonWriter *writer,
+                                CompactSpan compact, const char *const keys[4])
+{
+  Span span = SourceFile_get_span (self->file_, compact);
+  Position begin = PositionCursor_lookup (cursor, Span_cbegin (&span));
+  Position end = PositionCursor_lookup (cursor, Span_cend (&span));
+  JsonWriter_key (writer, keys[0]);
+  JsonWriter_u64 (writer, Position_get_line (&begin));
+  JsonWriter_key (writer, keys[1]);
+  JsonWriter_u64 (writer, Position_get_column (&begin) + 1);
+  JsonWriter_key (writer, keys[2]);
+  JsonWriter_u64 (writer, Position_get_line (&end));
+  JsonWriter_key (writer, keys[3]);
+  JsonWriter_u64 (writer, Position_get_column (&end) + 1);
+}
+
+void
+DiagnosticManager_write_jsonl (const DiagnosticManager *self,
+                               JsonWriter *writer)
+{
+  static const char *const keys[4] = { "line", "column", "end_line",
+                                       "end_column" };
+  /* Reused by every message and label.  */
+  String scratch = String_new ();
+  PositionCursor cursor = PositionCursor_new (self->file_);
+  for (size_t id = 0; id < DiagnosticManager_num_stored (self); id++)
+    {
+      const Diagnostic *diag = DiagnosticManager_get (self, id);
+      JsonWriter_begin_object (writer);
+      JsonWriter_key (writer, "name");
+      JsonWriter_cstring (writer, name_to_cstring (diag->name_));
+      JsonWriter_key (writer, "level");
+      JsonWriter_cstring (
+          writer, level_to_cstring (Diagnostic_get_level (diag), false));
+      JsonWriter_key (writer, "message");
+      String_clear (&scratch);
+      DiagnosticManager_push_message (self, diag, &scratch);
+      JsonWriter_string (writer, String_cbegin (&scratch),
+                         String_len (&scratch));
+      JsonWriter_key (writer, "path");
+      const String *path = SourceFile_get_path (self->file_);
+      JsonWriter_string (writer, String_cbegin (path), String_len (path));
+      JsonWriter_key (writer, "spans");
+      JsonWriter_begin_array (writer);
+      for (size_t i = 0; i < Diagnostic_num_spans (diag); i++)
+        {
+          JsonWriter_begin_object (writer);
+          DiagnosticManager_write_region (
+              self, &cursor, writer, Diagnostic_get_nth_span (diag, i), keys);
+          String_clear (&scratch);
+          DiagnosticManager_push_label (self, diag, i, &scratch);
+          if (String_len (&scratch))
+            {
+              JsonWriter_key (writer, "label");
+              JsonWriter_string (writer, String_cbegin (&scratch),
+                                 String_len (&scratch));
+            }
+          JsonWriter_end_object (writer);
+        }
+      JsonWriter_end_array (writer);
+      JsonWriter_end_object (writer);
+      JsonWriter_newline (writer);
+    }
+  String_drop (&scratch);
+}
+
+void
+DiagnosticManager_write_sarif (const DiagnosticManager *self,
+                               JsonWriter *writer)
+{
+  static const char *const keys[4] = { "startLine", "startColumn", "endLine",
+                                       "endColumn" };
+  String scratch = String_new ();
+  PositionCursor cursor = PositionCursor_new (self->file_);
+  JsonWriter_begin_object (writer);
+  JsonWriter_key (writer, "version");
+  JsonWriter_cstring (writer, "2.1.0");
+  JsonWriter_key (writer, "$schema");
+  JsonWriter_cstring (writer, "https://json.schemastore.org/sarif-2.1.0.json");
+  JsonWriter_key (writer, "runs");
+  JsonWriter_begin_array (writer);
+  JsonWriter_begin_object (writer);
+  JsonWriter_key (writer, "tool");
+  JsonWriter_begin_object (writer);
+  JsonWriter_key (writer, "driver");
+  JsonWriter_begin_object (writer);
+  JsonWriter_key (writer, "name");
+  JsonWriter_cstring (writer, "neo");
+  JsonWriter_key (writer, "rules");
+  JsonWriter_begin_array (writer);
+#define NEO_DIAGNOSTIC(NAME, LEVEL)                                           \
+  JsonWriter_begin_object (writer);                                           \
+  JsonWriter_key (writer, "id");                                              \
+  JsonWriter_cstring (writer, #NAME);                                         \
+  JsonWriter_end_object (writer);
+#include "diagnostic.def"
+#undef NEO_DIAGNOSTIC
+  JsonWriter_end_array (writer);
+  JsonWriter_end_object (writer);
+  JsonWriter_end_object (writer);
+  JsonWriter_key (writer, "results");
+  JsonWriter_begin_array (writer);
+  for (size_t id = 0; id < DiagnosticManager_num_stored (self); id++)
+    {
+      const Diagnostic *diag = DiagnosticManager_get (self, id);
+      JsonWriter_begin_object (writer);
+      JsonWriter_key (writer, "ruleId");
+      JsonWriter_cstring (writer, name_to_cstring (diag->name_));
+      JsonWriter_key (writer, "level");
+      JsonWriter_cstring (
+          writer, level_to_cstring (Diagnostic_get_level (diag), false));
+      JsonWriter_key (writer, "message");
+      JsonWriter_begin_object (writer);
+      JsonWriter_key (writer, "text");
+      String_clear (&scratch);
+      DiagnosticManager_push_message (self, diag, &scratch);
+      JsonWriter_string (writer, String_cbegin (&scratch),
+                         String_len (&scratch));
+      JsonWriter_end_object (writer);
+      JsonWriter_key (writer, "locations");
+      JsonWriter_begin_array (writer);
+      for (size_t i = 0; i < Diagnostic_num_spans (diag); i++)
+        {
+          JsonWriter_begin_object (writer);
+          JsonWriter_key (writer, "physicalLocation");
+          JsonWriter_begin_object (writer);
+          JsonWriter_key (writer, "artifactLocation");
+          JsonWriter_begin_object (writer);
+          JsonWriter_key (writer, "uri");
+          const String *path = SourceFile_get_path (self->file_);
+          JsonWriter_string (writer, String_cbegin (path), String_len (path));
+          JsonWriter_end_object (writer);
+          JsonWriter_key (writer, "region");
+          JsonWriter_begin_object (writer);
+          DiagnosticManager_write_region (
+              self, &cursor, writer, Diagnostic_get_nth_span (diag, i), keys);
+          JsonWriter_end_object (writer);
+          JsonWriter_end_object (writer);
+          String_clear (&scratch);
+          DiagnosticManager_push_label (self, diag, i, &scratch);
+          if (String_len (&scratch))
+            {
+              JsonWriter_key (writer, "message");
+              JsonWriter_begin_object (writer);
+              JsonWriter_key (writer, "text");
+              JsonWriter_string (writer, String_cbegin (&scratch),
+                                 String_len (&scratch));
+              JsonWriter_end_object (writer);
+            }
+          JsonWriter_end_object (writer);
+        }
+      JsonWriter_end_array (writer);
+      JsonWriter_end_object (writer);
+    }
+  JsonWriter_end_array (writer);
+  JsonWriter_end_object (writer);
+  JsonWriter_end_array (writer);
+  JsonWriter_end_object (writer);
+  JsonWriter_newline (writer);
+  String_drop (&scratch);
+}
+
 static void
 DiagnosticManager_display (const DiagnosticManager *self, DiagnosticId id)
 {
@@ -314,22 +617,64 @@ DiagnosticManager_display (const DiagnosticManager *self, DiagnosticId id)
   String_drop (&output);
 }
 
-void
-DiagnosticManager_diagnose_invalid_token (DiagnosticManager *self, Span span)
-{
-  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_INVALID_TOKEN, span);
-  String message = String_from_cstring ("invalid token: ");
-  String span_output = Span_fmt (&span);
-  String_push_string (&message, &span_output);
-  String_drop (&span_output);
-  Diagnostic_set_message (&diag, message);
-  DiagnosticId id = DiagnosticManager_push (self, diag);
+/* Records a diagnostic with ARGS, and displays it unless it is past the
+ * limit.  */
+static void
+DiagnosticManager_report (DiagnosticManager *self, Diagnostic diag,
+                          const uint32_t *args)
+{
+  self->num_total_++;
+  if (Vec_Diagnostic_len (&self->diagnostics_) >= self->limit_)
+    {
+      return;
+    }
+  diag.args_ = Vec_u32_len (&self->args_);
+  for (size_t i = 0; i < diag.num_args_; i++)
+    {
+      Vec_u32_push (&self->args_, args[i]);
+    }
+  DiagnosticId id = Vec_Diagnostic_len (&self->diagnostics_);
+  Vec_Diagnostic_push (&self->diagnostics_, diag);
   DiagnosticManager_display (self, id);
 }
 
+void
+DiagnosticManager_append (DiagnosticManager *self,
+                          const DiagnosticManager *other)
+{
+  for (DiagnosticId id = 0; id < DiagnosticManager_num_stored (other); id++)
+    {
+      const Diagnostic *diag = DiagnosticManager_get (other, id);
+      DiagnosticManager_report (self, *diag,
+                                DiagnosticManager_get_args (other, diag));
+    }
+  /* Those past the limit of OTHER came after all that it stored.  */
+  self->num_total_
+      += other->num_total_ - DiagnosticManager_num_stored (other);
+}
+
+static Diagnostic
+Diagnostic_new (enum DiagnosticName name, CompactSpan span)
+{
+  return (Diagnostic){ .name_ = name,
+                       .span_ = span,
+                       .other_span_ = CompactSpan_new (0, 0),
+                       .args_ = 0,
+                       .num_args_ = 0,
+                       .num_tokens_ = 0 };
+}
+
+void
+DiagnosticManager_diagnose_invalid_token (DiagnosticManager *self,
+                                          CompactSpan span)
+{
+  DiagnosticManager_report (
+      self, Diagnostic_new (DIAGNOSTIC_INVALID_TOKEN, span), NULL);
+}
+
 void
 DiagnosticManager_diagnose_expected_tokens_or_nodes (DiagnosticManager *self,
-                                                     Span span,
+                                                     CompactSpan span,
                                                      Array_TokenKind tokens,
                                                      Array_ASTKind nodes)
 {
@@ -350,74 +695,28 @@ DiagnosticManager_diagnose_expected_tokens_or_nodes (DiagnosticManager *self,
     {
       diag_name = DIAGNOSTIC_EXPECTED_TOKENS_OR_NODES;
     }
-  size_t num_candidates
-      = Array_TokenKind_len (&tokens) + Array_ASTKind_len (&nodes);
-  Diagnostic diag = Diagnostic_new (diag_name, span);
-  String message = String_from_cstring ("expected ");
-  size_t num_candidates_pushed = 0;
-  for (const enum TokenKind *token = Array_TokenKind_cbegin (&tokens);
-       token < Array_TokenKind_cend (&tokens); token++)
+  size_t num_tokens = Array_TokenKind_len (&tokens);
+  size_t num_candidates = num_tokens + Array_ASTKind_len (&nodes);
+  /* The parser never expects more than a few candidates.  */
+  uint32_t args[32];
+  assert (num_candidates <= sizeof (args) / sizeof (args[0]));
+  for (size_t i = 0; i < num_tokens; i++)
     {
-      switch (*token)
-        {
-#define NEO_TOKEN_LIT(NAME, LITERAL)                                          \
-  case TOKEN_##NAME:                                                          \
-    {                                                                         \
-      String_push_cstring (&message, "`" #LITERAL "`");                       \
-      break;                                                                  \
-    }
-#include "token_lit.def"
-#undef NEO_TOKEN_LIT
-#define NEO_TOKEN(NAME)                                                       \
-  case TOKEN_##NAME:                                                          \
-    {                                                                         \
-      String_push_cstring (&message, "<" #NAME ">");                          \
-      break;                                                                  \
+      args[i] = Array_TokenKind_cbegin (&tokens)[i];
     }
-#include "token.def"
-#undef NEO_TOKEN
-        }
-      String_push_cstring (&message, ", ");
-      num_candidates_pushed++;
-      if (num_candidates_pushed == num_candidates - 1)
-        {
-          String_push_cstring (&message, "or ");
-        }
-    }
-  for (const enum ASTKind *node = Array_ASTKind_cbegin (&nodes);
-       node < Array_ASTKind_cend (&nodes); node++)
+  for (size_t i = num_tokens; i < num_candidates; i++)
     {
-      switch (*node)
-        {
-#define NEO_ASTKIND(NAME, LABEL)                                              \
-  case AST_##NAME:                                                            \
-    {                                                                         \
-      String_push_cstring (&message, "<");                                    \
-      String_push_cstring (&message, #LABEL);                                 \
-      String_push_cstring (&message, ">");                                    \
-      break;                                                                  \
-    }
-#include "ast_kind.def"
-#undef NEO_ASTKIND
-        }
-      String_push_cstring (&message, ", ");
-      num_candidates_pushed++;
-      if (num_candidates_pushed == num_candidates - 1)
-        {
-          String_push_cstring (&message, "or ");
-        }
+      args[i] = Array_ASTKind_cbegin (&nodes)[i - num_tokens];
     }
-  String_push_cstring (&message, "found ");
-  String span_output = Span_fmt (&span);
-  String_push_string (&message, &span_output);
-  String_drop (&span_output);
-  Diagnostic_set_message (&diag, message);
-  DiagnosticId id = DiagnosticManager_push (self, diag);
-  DiagnosticManager_display (self, id);
+  Diagnostic diag = Diagnostic_new (diag_name, span);
+  diag.num_args_ = num_candidates;
+  diag.num_tokens_ = num_tokens;
+  DiagnosticManager_report (self, diag, args);
 }
 
 void
-DiagnosticManager_diagnose_expected_token (DiagnosticManager *self, Span span,
+DiagnosticManager_diagnose_expected_token (DiagnosticManager *self,
+                                           CompactSpan span,
                                            enum TokenKind token)
 {
   return DiagnosticManager_diagnose_expected_tokens_or_nodes (
@@ -426,8 +725,8 @@ DiagnosticManager_diagnose_expected_token (DiagnosticManager *self, Span span,
 }
 
 void
-DiagnosticManager_diagnose_expected_node (DiagnosticManager *self, Span span,
-                                          enum ASTKind node)
+DiagnosticManager_diagnose_expected_node (DiagnosticManager *self,
+                                          CompactSpan span, enum ASTKind node)
 {
   return DiagnosticManager_diagnose_expected_tokens_or_nodes (
       self, span, Array_TokenKind_new (NULL, 0), Array_ASTKind_new (&node, 1));
@@ -435,97 +734,355 @@ DiagnosticManager_diagnose_expected_node (DiagnosticManager *self, Span span,
 
 void
 DiagnosticManager_diagnose_unexpected_token (DiagnosticManager *self,
-                                             Span span)
-{
-  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_UNEXPECTED_TOKEN, span);
-  String message = String_from_cstring ("unexpected token: ");
-  String span_output = Span_fmt (&span);
-  String_push_string (&message, &span_output);
-  String_drop (&span_output);
-  Diagnostic_set_message (&diag, message);
-  DiagnosticId id = DiagnosticManager_push (self, diag);
-  DiagnosticManager_display (self, id);
+                                             CompactSpan span)
+{
+  DiagnosticManager_report (
+      self, Diagnostic_new (DIAGNOSTIC_UNEXPECTED_TOKEN, span), NULL);
 }
 
 void
 DiagnosticManager_diagnose_unclosed_dilimiter (DiagnosticManager *self,
-                                               Span span)
-{
-  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_UNEXPECTED_TOKEN, span);
-  String message = String_from_cstring ("unclosed delimiter: ");
-  String span_output = Span_fmt (&span);
-  String_push_string (&message, &span_output);
-  String_drop (&span_output);
-  Diagnostic_set_message (&diag, message);
-  DiagnosticId id = DiagnosticManager_push (self, diag);
-  DiagnosticManager_display (self, id);
+                                               CompactSpan span)
+{
+  DiagnosticManager_report (
+      self, Diagnostic_new (DIAGNOSTIC_UNCLOSED_DELIMITER, span), NULL);
 }
 
 void
-DiagnosticManager_diagnose_invalid_type (DiagnosticManager *self, Span span)
-{
-  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_INVALID_TYPE, span);
-  String message = String_from_cstring ("invalid type: ");
-  String span_output = Span_fmt (&span);
-  String_push_string (&message, &span_output);
-  String_drop (&span_output);
-  Diagnostic_set_message (&diag, message);
-  DiagnosticId id = DiagnosticManager_push (self, diag);
-  DiagnosticManager_display (self, id);
+DiagnosticManager_diagnose_invalid_type (DiagnosticManager *self,
+                                         CompactSpan span)
+{
+  DiagnosticManager_report (
+      self, Diagnostic_new (DIAGNOSTIC_INVALID_TYPE, span), NULL);
 }
 
 void
 DiagnosticManager_diagnose_if_expr_not_bool (DiagnosticManager *self,
-                                             Span span, String type)
-{
-  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_INVALID_TYPE, span);
-  String message
-      = String_from_cstring ("condition is not a subtype of Bool: ");
-  String span_output = Span_fmt (&span);
-  String_push_string (&message, &span_output);
-  String_drop (&span_output);
-  Diagnostic_set_message (&diag, message);
-  String label = String_from_cstring ("is of type `");
-  String_push_string (&label, &type);
-  String_push (&label, '`');
-  String_drop (&type);
-  Diagnostic_set_span_info_label (&diag, 0, label);
-  DiagnosticId id = DiagnosticManager_push (self, diag);
-  DiagnosticManager_display (self, id);
+                                             CompactSpan span, TypeId type)
+{
+  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_IF_EXPR_NOT_BOOL, span);
+  diag.num_args_ = 1;
+  DiagnosticManager_report (self, diag, &type);
 }
 
 void
 DiagnosticManager_diagnose_expr_types_not_equal (DiagnosticManager *self,
-                                                 Span span1, String type1,
-                                                 Span span2, String type2)
-{
-  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_INVALID_TYPE, span1);
-  String message
-      = String_from_cstring ("types of then and else are not equal");
-  Diagnostic_set_message (&diag, message);
-  String then_label = String_from_cstring ("is of type `");
-  String_push_string (&then_label, &type1);
-  String_push (&then_label, '`');
-  String_drop (&type1);
-  Diagnostic_set_span_info_label (&diag, 0, then_label);
-  String else_label = String_from_cstring ("is of type `");
-  String_push_string (&else_label, &type2);
-  String_push (&else_label, '`');
-  String_drop (&type2);
-  Diagnostic_push_span_info (&diag, SpanInfo_new (span2, else_label));
-  DiagnosticId id = DiagnosticManager_push (self, diag);
-  DiagnosticManager_display (self, id);
+                                                 CompactSpan span1,
+                                                 TypeId type1,
+                                                 CompactSpan span2,
+                                                 TypeId type2)
+{
+  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_THEN_ELSE_NOT_EQUAL, span1);
+  diag.other_span_ = span2;
+  diag.num_args_ = 2;
+  TypeId types[] = { type1, type2 };
+  DiagnosticManager_report (self, diag, types);
 }
 
 void
-DiagnosticManager_diagnose_var_not_bound (DiagnosticManager *self, Span span)
-{
-  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_INVALID_TYPE, span);
-  String message = String_from_cstring ("the variable is not bound: ");
-  String span_output = Span_fmt (&span);
-  String_push_string (&message, &span_output);
-  String_drop (&span_output);
-  Diagnostic_set_message (&diag, message);
-  DiagnosticId id = DiagnosticManager_push (self, diag);
-  DiagnosticManager_display (self, id);
+DiagnosticManager_diagnose_let_type_not_equal (DiagnosticManager *self,
+                                               CompactSpan span1,
+                                               TypeId type1,
+                                               CompactSpan span2,
+                                               TypeId type2)
+{
+  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_LET_TYPE_NOT_EQUAL, span1);
+  diag.other_span_ = span2;
+  diag.num_args_ = 2;
+  TypeId types[] = { type1, type2 };
+  DiagnosticManager_report (self, diag, types);
 }
+
+void
+DiagnosticManager_diagnose_var_not_bound (DiagnosticManager *self,
+                                          CompactSpan span)
+{
+  DiagnosticManager_report (
+      self, Diagnostic_new (DIAGNOSTIC_VAR_NOT_BOUND, span), NULL);
+}
+
+void
+DiagnosticManager_diagnose_operand_not_integer (DiagnosticManager *self,
+                                                CompactSpan span, TypeId type)
+{
+  Diagnostic diag = Diagnostic_new (DIAGNOSTIC_OPERAND_NOT_INTEGER, span);
+  diag.num_args_ = 1;
+  DiagnosticManager_report (self, diag, &type);
+}
+
+void
+DiagnosticManager_diagnose_integer_out_of_range (DiagnosticManager *self,
+                                                 CompactSpan span)
+{
+  DiagnosticManager_report (
+      self, Diagnostic_new (DIAGNOSTIC_INTEGER_OUT_OF_RANGE, span), NULL);
+}
+
+#ifdef TESTS
+#include "test.h"
+
+#include <string.h>
+
+static void
+assert_string_eq (TestFnWrapper *test_fn_wrapper_, String str,
+                  const char *expect)
+{
+  ASSERT_U64_EQ (String_len (&str), strlen (expect));
+  ASSERT_I64_EQ (memcmp (String_cbegin (&str), expect, strlen (expect)), 0);
+  String_drop (&str);
+}
+
+NEO_TEST (test_diagnostic_fmt_message_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("test"),
+                                    String_from_cstring ("if x then"));
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  enum TokenKind tokens[] = { TOKEN_THEN, TOKEN_ELSE };
+  enum ASTKind nodes[] = { AST_EXPR };
+  DiagnosticManager_diagnose_expected_tokens_or_nodes (
+      &diag_mgr, CompactSpan_new (3, 1), Array_TokenKind_new (tokens, 2),
+      Array_ASTKind_new (nodes, 1));
+  DiagnosticManager_diagnose_expected_node (&diag_mgr, CompactSpan_new (9, 0),
+                                            AST_EXPR);
+  DiagnosticManager_diagnose_unclosed_dilimiter (&diag_mgr,
+                                                 CompactSpan_new (0, 2));
+  ASSERT_U64_EQ (DiagnosticManager_num_total (&diag_mgr), 3);
+  ASSERT_U64_EQ (DiagnosticManager_get (&diag_mgr, 0)->name_,
+                 DIAGNOSTIC_EXPECTED_TOKENS_OR_NODES);
+  assert_string_eq (test_fn_wrapper_,
+                    DiagnosticManager_fmt_message (&diag_mgr, 0),
+                    "expected `\"then\"`, `\"else\"`, or <expr>, found `x`");
+  assert_string_eq (test_fn_wrapper_,
+                    DiagnosticManager_fmt_message (&diag_mgr, 1),
+                    "expected <expr>, found <eof>");
+  assert_string_eq (test_fn_wrapper_,
+                    DiagnosticManager_fmt_message (&diag_mgr, 2),
+                    "unclosed delimiter: `if`");
+  DiagnosticManager_drop (&diag_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_TEST (test_diagnostic_fmt_diagnostic_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("test"),
+                                    String_from_cstring ("if x then x"));
+  TypeManager type_mgr = TypeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  DiagnosticManager_set_colored (&diag_mgr, false);
+  DiagnosticManager_set_type_manager (&diag_mgr, &type_mgr);
+  DiagnosticManager_diagnose_expr_types_not_equal (
+      &diag_mgr, CompactSpan_new (3, 1), TypeManager_get_bool (&type_mgr),
+      CompactSpan_new (10, 1), TypeManager_get_invalid (&type_mgr));
+  assert_string_eq (test_fn_wrapper_,
+                    DiagnosticManager_fmt_diagnostic (&diag_mgr, 0),
+                    "error: types of then and else are not equal\n"
+                    " --> test:1:4\n"
+                    "  |\n"
+                    "1 | if x then x\n"
+                    "  |    ^ is of type `Bool`\n"
+                    " --> test:1:11\n"
+                    "  |\n"
+                    "1 | if x then x\n"
+                    "  |           ^ is of type `Invalid`\n");
+  DiagnosticManager_drop (&diag_mgr);
+  TypeManager_drop (&type_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_TEST (test_diagnostic_limit_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("test"),
+                                    String_from_cstring ("x"));
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  DiagnosticManager_set_limit (&diag_mgr, 2);
+  for (int i = 0; i < 5; i++)
+    {
+      DiagnosticManager_diagnose_var_not_bound (&diag_mgr,
+                                                CompactSpan_new (0, 1));
+    }
+  ASSERT_U64_EQ (DiagnosticManager_num_total (&diag_mgr), 5);
+  ASSERT_U64_EQ (DiagnosticManager_num_stored (&diag_mgr), 2);
+  ASSERT_U64_EQ (sizeof (Diagnostic) <= 32, true);
+  DiagnosticManager_drop (&diag_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_TEST (test_diagnostic_write_jsonl_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("a\"b"),
+                                    String_from_cstring ("\nif x then x"));
+  TypeManager type_mgr = TypeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  DiagnosticManager_set_type_manager (&diag_mgr, &type_mgr);
+  DiagnosticManager_diagnose_var_not_bound (&diag_mgr, CompactSpan_new (4, 1));
+  DiagnosticManager_diagnose_if_expr_not_bool (
+      &diag_mgr, CompactSpan_new (4, 1), TypeManager_get_invalid (&type_mgr));
+  JsonWriter writer = JsonWriter_new (NULL);
+  DiagnosticManager_write_jsonl (&diag_mgr, &writer);
+  const String *output = JsonWriter_get_buffer (&writer);
+  const char *expect
+      = "{\"name\":\"VAR_NOT_BOUND\",\"level\":\"error\","
+        "\"message\":\"the variable is not bound: `x`\",\"path\":\"a\\\"b\","
+        "\"spans\":[{\"line\":2,\"column\":4,\"end_line\":2,"
+        "\"end_column\":5}]}\n"
+        "{\"name\":\"IF_EXPR_NOT_BOOL\",\"level\":\"error\","
+        "\"message\":\"condition is not a subtype of Bool: `x`\","
+        "\"path\":\"a\\\"b\",\"spans\":[{\"line\":2,\"column\":4,"
+        "\"end_line\":2,\"end_column\":5,"
+        "\"label\":\"is of type `Invalid`\"}]}\n";
+  ASSERT_U64_EQ (String_len (output), strlen (expect));
+  ASSERT_I64_EQ (memcmp (String_cbegin (output), expect, strlen (expect)), 0);
+  JsonWriter_drop (&writer);
+  DiagnosticManager_drop (&diag_mgr);
+  TypeManager_drop (&type_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_TEST (test_diagnostic_write_sarif_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("test"),
+                                    String_from_cstring ("if x then x"));
+  TypeManager type_mgr = TypeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  DiagnosticManager_set_type_manager (&diag_mgr, &type_mgr);
+  DiagnosticManager_diagnose_expr_types_not_equal (
+      &diag_mgr, CompactSpan_new (3, 1), TypeManager_get_bool (&type_mgr),
+      CompactSpan_new (10, 1), TypeManager_get_invalid (&type_mgr));
+  JsonWriter writer = JsonWriter_new (NULL);
+  DiagnosticManager_write_sarif (&diag_mgr, &writer);
+  const String *output = JsonWriter_get_buffer (&writer);
+  Json log;
+  bool ok = Json_parse (&log, String_cbegin (output), String_len (output));
+  ASSERT_U64_EQ (ok, true);
+  const Json *run = Json_at (Json_get (&log, "runs"), 0);
+  ASSERT_U64_EQ (Json_len (Json_get (Json_get (Json_get (run, "tool"),
+                                               "driver"),
+                                     "rules")),
+                 DIAGNOSTIC_INTEGER_OUT_OF_RANGE + 1);
+  const Json *result = Json_at (Json_get (run, "results"), 0);
+  ASSERT_U64_EQ (Json_len (Json_get (run, "results")), 1);
+  ASSERT_U64_EQ (Json_len (Json_get (result, "locations")), 2);
+  const Json *location = Json_at (Json_get (result, "locations"), 1);
+  const Json *region
+      = Json_get (Json_get (location, "physicalLocation"), "region");
+  ASSERT_I64_EQ (Json_get_number (Json_get (region, "startLine")), 1);
+  ASSERT_I64_EQ (Json_get_number (Json_get (region, "startColumn")), 11);
+  ASSERT_I64_EQ (Json_get_number (Json_get (region, "endColumn")), 12);
+  const String *label
+      = Json_get_string (Json_get (Json_get (location, "message"), "text"));
+  ASSERT_U64_EQ (String_len (label), strlen ("is of type `Invalid`"));
+  Json_drop (&log);
+  JsonWriter_drop (&writer);
+  DiagnosticManager_drop (&diag_mgr);
+  TypeManager_drop (&type_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_TESTS (diagnostic_tests, test_diagnostic_fmt_message_00,
+           test_diagnostic_fmt_diagnostic_00, test_diagnostic_limit_00,
+           test_diagnostic_write_jsonl_00, test_diagnostic_write_sarif_00)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+NEO_BENCH (bench_diagnostic_report_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"),
+                                    String_from_cstring ("if x then x"));
+  TypeManager type_mgr = TypeManager_new ();
+  size_t num_diags = 0;
+  BENCH_ITER
+  {
+    /* What a file full of errors costs a checker that does not display.  */
+    DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+    DiagnosticManager_set_display (&diag_mgr, false);
+    DiagnosticManager_set_type_manager (&diag_mgr, &type_mgr);
+    for (int i = 0; i < 4096; i++)
+      {
+        DiagnosticManager_diagnose_var_not_bound (&diag_mgr,
+                                                  CompactSpan_new (3, 1));
+        DiagnosticManager_diagnose_if_expr_not_bool (
+            &diag_mgr, CompactSpan_new (3, 1),
+            TypeManager_get_invalid (&type_mgr));
+      }
+    num_diags += DiagnosticManager_num_total (&diag_mgr);
+    DiagnosticManager_drop (&diag_mgr);
+  }
+  Bencher_report_u64 (bencher_, "diagnostics", num_diags);
+  TypeManager_drop (&type_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCH (bench_diagnostic_write_jsonl_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"),
+                                    String_from_cstring ("if x then x"));
+  TypeManager type_mgr = TypeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  DiagnosticManager_set_type_manager (&diag_mgr, &type_mgr);
+  for (int i = 0; i < 4096; i++)
+    {
+      DiagnosticManager_diagnose_var_not_bound (&diag_mgr,
+                                                CompactSpan_new (3, 1));
+      DiagnosticManager_diagnose_if_expr_not_bool (
+          &diag_mgr, CompactSpan_new (3, 1),
+          TypeManager_get_invalid (&type_mgr));
+    }
+  FILE *out = fopen ("/dev/null", "w");
+  size_t num_diags = 0;
+  BENCH_ITER
+  {
+    JsonWriter writer = JsonWriter_new (out);
+    DiagnosticManager_write_jsonl (&diag_mgr, &writer);
+    JsonWriter_drop (&writer);
+    num_diags += DiagnosticManager_num_stored (&diag_mgr);
+  }
+  Bencher_report_u64 (bencher_, "diagnostics", num_diags);
+  fclose (out);
+  DiagnosticManager_drop (&diag_mgr);
+  TypeManager_drop (&type_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCH (bench_diagnostic_fmt_diagnostic_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"),
+                                    String_from_cstring ("if x then x"));
+  TypeManager type_mgr = TypeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  DiagnosticManager_set_type_manager (&diag_mgr, &type_mgr);
+  for (int i = 0; i < 4096; i++)
+    {
+      DiagnosticManager_diagnose_expr_types_not_equal (
+          &diag_mgr, CompactSpan_new (3, 1), TypeManager_get_bool (&type_mgr),
+          CompactSpan_new (10, 1), TypeManager_get_invalid (&type_mgr));
+    }
+  size_t num_bytes = 0;
+  BENCH_ITER
+  {
+    for (DiagnosticId id = 0; id < DiagnosticManager_num_stored (&diag_mgr);
+         id++)
+      {
+        String output = DiagnosticManager_fmt_diagnostic (&diag_mgr, id);
+        num_bytes += String_len (&output);
+        String_drop (&output);
+      }
+  }
+  Bencher_report_u64 (bencher_, "bytes", num_bytes);
+  DiagnosticManager_drop (&diag_mgr);
+  TypeManager_drop (&type_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCHES (diagnostic_benches, bench_diagnostic_report_00,
+             bench_diagnostic_write_jsonl_00,
+             bench_diagnostic_fmt_diagnostic_00)
+#endif
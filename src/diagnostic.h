@@ -8,9 +8,12 @@
 #include <stdint.h>
 
 #include "ast_node.h"
+#include "json.h"
 #include "span.h"
 #include "string.h"
 #include "token.h"
+#include "type.h"
+#include "vec.h"
 #include "vec_macro.h"
 
 enum DiagnosticLevel
@@ -27,65 +30,125 @@ enum DiagnosticName
 #undef NEO_DIAGNOSTIC
 };
 
-typedef struct SpanInfo
-{
-  Span span_;
-  String label_;
-} SpanInfo;
-
-NEO_DECL_VEC (SpanInfo, SpanInfo)
-
 typedef uint32_t DiagnosticId;
 
-NEO_DECL_VEC (DiagnosticId, DiagnosticId)
-
+/* A diagnostic as it was reported, which is formatted only when it is
+ * displayed or serialized.  */
 typedef struct Diagnostic
 {
   enum DiagnosticName name_;
-  enum DiagnosticLevel level_;
-  String message_;
-  Vec_SpanInfo span_infos_;
-  Vec_DiagnosticId children_;
+  /* Relative to the content of the file.  */
+  CompactSpan span_;
+  /* The second place that a type mismatch points at.  */
+  CompactSpan other_span_;
+  /* Into the argument pool of the manager.  Expected token kinds come first,
+   * then expected node kinds.  Type diagnostics hold the type of each span
+   * instead.  */
+  uint32_t args_;
+  uint16_t num_args_;
+  uint16_t num_tokens_;
 } Diagnostic;
 
 NEO_DECL_VEC (Diagnostic, Diagnostic)
 
+enum DiagnosticLevel Diagnostic_get_level (const Diagnostic *self);
+CompactSpan Diagnostic_get_span (const Diagnostic *self);
+
 typedef struct DiagnosticManager
 {
   const SourceFile *file_;
+  /* Names the types in type diagnostics.  Set by the type checker that
+   * reports them.  */
+  const TypeManager *type_mgr_;
   bool colored_;
   bool display_;
   Vec_Diagnostic diagnostics_;
+  Vec_u32 args_;
+  /* Diagnostics past the limit are counted, but neither stored nor
+   * displayed.  */
+  size_t limit_;
+  size_t num_total_;
 } DiagnosticManager;
 
 DiagnosticManager DiagnosticManager_new (const SourceFile *);
 void DiagnosticManager_drop (DiagnosticManager *self);
+/* Counts every diagnostic reported, stored or not.  */
 size_t DiagnosticManager_num_total (const DiagnosticManager *self);
+size_t DiagnosticManager_num_stored (const DiagnosticManager *self);
+const Diagnostic *DiagnosticManager_get (const DiagnosticManager *self,
+                                         DiagnosticId id);
 void DiagnosticManager_set_colored (DiagnosticManager *self, bool colored);
 void DiagnosticManager_set_display (DiagnosticManager *self, bool display);
+void DiagnosticManager_set_type_manager (DiagnosticManager *self,
+                                         const TypeManager *type_mgr);
+/* Stores at most LIMIT diagnostics from now on.  */
+void DiagnosticManager_set_limit (DiagnosticManager *self, size_t limit);
+/* Reports the diagnostics of OTHER to SELF in order, as if they had been
+ * reported to SELF in the first place, and counts those that OTHER did not
+ * store as well.  */
+void DiagnosticManager_append (DiagnosticManager *self,
+                               const DiagnosticManager *other);
+/* Returns the one-line message of ID.  */
+String DiagnosticManager_fmt_message (const DiagnosticManager *self,
+                                      DiagnosticId id);
+/* Returns ID as it is displayed, with the lines it points at.  */
+String DiagnosticManager_fmt_diagnostic (const DiagnosticManager *self,
+                                         DiagnosticId id);
+/* Writes the stored diagnostics as JSON Lines, one object each.  */
+void DiagnosticManager_write_jsonl (const DiagnosticManager *self,
+                                    JsonWriter *writer);
+/* Writes the stored diagnostics as a SARIF 2.1.0 log of a single run.  */
+void DiagnosticManager_write_sarif (const DiagnosticManager *self,
+                                    JsonWriter *writer);
 void DiagnosticManager_diagnose_invalid_token (DiagnosticManager *self,
-                                               Span span);
+                                               CompactSpan span);
 void DiagnosticManager_diagnose_expected_tokens_or_nodes (
-    DiagnosticManager *self, Span span, Array_TokenKind tokens,
+    DiagnosticManager *self, CompactSpan span, Array_TokenKind tokens,
     Array_ASTKind nodes);
 void DiagnosticManager_diagnose_expected_token (DiagnosticManager *self,
-                                                Span span,
+                                                CompactSpan span,
                                                 enum TokenKind token);
 void DiagnosticManager_diagnose_expected_node (DiagnosticManager *self,
-                                               Span span, enum ASTKind node);
+                                               CompactSpan span,
+                                               enum ASTKind node);
 void DiagnosticManager_diagnose_unexpected_token (DiagnosticManager *self,
-                                                  Span span);
+                                                  CompactSpan span);
 void DiagnosticManager_diagnose_unclosed_dilimiter (DiagnosticManager *self,
-                                                    Span span);
+                                                    CompactSpan span);
 void DiagnosticManager_diagnose_invalid_type (DiagnosticManager *self,
-                                              Span span);
+                                              CompactSpan span);
 void DiagnosticManager_diagnose_if_expr_not_bool (DiagnosticManager *self,
-                                                  Span span, String type);
+                                                  CompactSpan span,
+                                                  TypeId type);
 void DiagnosticManager_diagnose_expr_types_not_equal (DiagnosticManager *self,
-                                                      Span span1, String type1,
-                                                      Span span2,
-                                                      String type2);
+                                                      CompactSpan span1,
+                                                      TypeId type1,
+                                                      CompactSpan span2,
+                                                      TypeId type2);
+/* Of a var annotated with TYPE1 at SPAN1, bound to an init of TYPE2 at
+ * SPAN2.  */
+void DiagnosticManager_diagnose_let_type_not_equal (DiagnosticManager *self,
+                                                    CompactSpan span1,
+                                                    TypeId type1,
+                                                    CompactSpan span2,
+                                                    TypeId type2);
 void DiagnosticManager_diagnose_var_not_bound (DiagnosticManager *self,
-                                               Span span);
+                                               CompactSpan span);
+void DiagnosticManager_diagnose_operand_not_integer (DiagnosticManager *self,
+                                                     CompactSpan span,
+                                                     TypeId type);
+/* Of an integer literal that does not fit in the Int64 it is bound to.  */
+void DiagnosticManager_diagnose_integer_out_of_range (DiagnosticManager *self,
+                                                      CompactSpan span);
+
+#ifdef TESTS
+#include "test.h"
+Tests diagnostic_tests ();
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+Benches diagnostic_benches ();
+#endif
 
 #endif
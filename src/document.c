@@ -0,0 +1,1030 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "document.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast_node.h"
+#include "diagnostic.h"
+#include "lexer.h"
+#include "parser.h"
+#include "span.h"
+#include "string.h"
+#include "token.h"
+
+TextEdit
+TextEdit_new (CompactSpan range, Span text)
+{
+  return (TextEdit){ .range_ = range, .text_ = text };
+}
+
+static void
+Document_parse_all (Document *self)
+{
+  ASTNodeManager_drop (&self->ast_mgr_);
+  DiagnosticManager_drop (&self->diag_mgr_);
+  self->ast_mgr_ = ASTNodeManager_new ();
+  self->diag_mgr_ = DiagnosticManager_new (&self->file_);
+  DiagnosticManager_set_display (&self->diag_mgr_, false);
+  Parser parser
+      = Parser_new (&self->tokens_, &self->diag_mgr_, &self->ast_mgr_);
+  self->root_ = Parser_parse (&parser);
+  Parser_drop (&parser);
+  /* The parser reserved for a node per token.  */
+  ASTNodeManager_shrink_to_fit (&self->ast_mgr_);
+  self->num_parsed_nodes_ = ASTNodeManager_num_nodes (&self->ast_mgr_);
+  self->checked_ = false;
+}
+
+void
+Document_init (Document *self, String path, String content)
+{
+  self->file_ = SourceFile_new (path, content);
+  Span content_span = Span_from_string (SourceFile_get_content (&self->file_));
+  Lexer lexer = Lexer_new (&content_span);
+  self->tokens_ = Vec_Token_new ();
+  Token token;
+  do
+    {
+      token = Lexer_next (&lexer);
+      Vec_Token_push (&self->tokens_, token);
+    }
+  while (!Token_is_eof (&token));
+  Vec_Token_shrink_to_fit (&self->tokens_);
+  self->ast_mgr_ = ASTNodeManager_new ();
+  self->diag_mgr_ = DiagnosticManager_new (&self->file_);
+  Document_parse_all (self);
+  self->type_mgr_ = TypeManager_new ();
+  self->check_diag_mgr_ = DiagnosticManager_new (&self->file_);
+  DiagnosticManager_set_display (&self->check_diag_mgr_, false);
+  self->checker_ = TypeChecker_new (&self->ast_mgr_, &self->check_diag_mgr_,
+                                    &self->type_mgr_);
+  self->cancel_ = NULL;
+}
+
+void
+Document_drop (Document *self)
+{
+  TypeChecker_drop (&self->checker_);
+  DiagnosticManager_drop (&self->check_diag_mgr_);
+  TypeManager_drop (&self->type_mgr_);
+  DiagnosticManager_drop (&self->diag_mgr_);
+  ASTNodeManager_drop (&self->ast_mgr_);
+  Vec_Token_drop (&self->tokens_);
+  SourceFile_drop (&self->file_);
+}
+
+const SourceFile *
+Document_get_file (const Document *self)
+{
+  return &self->file_;
+}
+
+const Vec_Token *
+Document_get_tokens (const Document *self)
+{
+  return &self->tokens_;
+}
+
+const ASTNodeManager *
+Document_get_ast_manager (const Document *self)
+{
+  return &self->ast_mgr_;
+}
+
+const DiagnosticManager *
+Document_get_diagnostic_manager (const Document *self)
+{
+  return &self->diag_mgr_;
+}
+
+ASTNodeId
+Document_get_root (const Document *self)
+{
+  return self->root_;
+}
+
+const TypeManager *
+Document_get_type_manager (const Document *self)
+{
+  return &self->type_mgr_;
+}
+
+const DiagnosticManager *
+Document_get_check_diagnostic_manager (const Document *self)
+{
+  return &self->check_diag_mgr_;
+}
+
+/* Returns the index of the first token at or after OFFSET.  */
+static size_t
+lower_bound_token (const Vec_Token *tokens, uint32_t offset)
+{
+  size_t lo = 0, hi = Vec_Token_len (tokens);
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if (CompactSpan_get_offset (&Vec_Token_cbegin (tokens)[mid].span_)
+          < offset)
+        {
+          lo = mid + 1;
+        }
+      else
+        {
+          hi = mid;
+        }
+    }
+  return lo;
+}
+
+static bool
+is_blank (const String *content, uint32_t begin, uint32_t end)
+{
+  for (uint32_t i = begin; i < end; i++)
+    {
+      char c = String_cbegin (content)[i];
+      if (c != ' ' && c != '\n')
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+static bool
+Token_eq (const Token *self, const Token *other)
+{
+  return self->kind_ == other->kind_
+         && CompactSpan_get_offset (&self->span_)
+                == CompactSpan_get_offset (&other->span_)
+         && CompactSpan_len (&self->span_) == CompactSpan_len (&other->span_);
+}
+
+/* Relexes the text around an edit of [BEGIN, OLD_END) into [BEGIN, NEW_END)
+ * until the tokens agree with the old ones again, and returns the old range
+ * that the replaced tokens covered.  */
+static CompactSpan
+Document_relex (Document *self, uint32_t begin, uint32_t old_end,
+                uint32_t new_end)
+{
+  int64_t delta = (int64_t)new_end - old_end;
+  const String *content = SourceFile_get_content (&self->file_);
+  size_t first = lower_bound_token (&self->tokens_, begin);
+  /* Lexing must start outside tokens and comments, and a token touching
+   * the edit may merge with the new text.  */
+  uint32_t start = begin;
+  if (first == 0)
+    {
+      start = is_blank (content, 0, begin) ? begin : 0;
+    }
+  else
+    {
+      const CompactSpan *prev
+          = &Vec_Token_cbegin (&self->tokens_)[first - 1].span_;
+      if (CompactSpan_get_end (prev) >= begin
+          || !is_blank (content, CompactSpan_get_end (prev), begin))
+        {
+          first--;
+          start = CompactSpan_get_offset (prev);
+        }
+    }
+  size_t last = lower_bound_token (&self->tokens_, old_end);
+  uint32_t damaged_end = old_end;
+  Span content_span = Span_from_string (content);
+  Lexer lexer = Lexer_new_at (&content_span, start);
+  Vec_Token fresh = Vec_Token_new ();
+  while (true)
+    {
+      Token token = Lexer_next (&lexer);
+      uint32_t offset = CompactSpan_get_offset (&token.span_);
+      if (offset >= new_end)
+        {
+          /* Past the edit the old tokens are still valid once one of them
+           * is lexed again, and the old EOF always is.  */
+          Token old = { .kind_ = token.kind_,
+                        .span_ = CompactSpan_new (
+                            offset - delta, CompactSpan_len (&token.span_)) };
+          const Token *tokens = Vec_Token_cbegin (&self->tokens_);
+          while (CompactSpan_get_offset (&tokens[last].span_)
+                 < CompactSpan_get_offset (&old.span_))
+            {
+              last++;
+            }
+          if (Token_eq (&tokens[last], &old))
+            {
+              break;
+            }
+        }
+      if (CompactSpan_get_end (&token.span_) > new_end)
+        {
+          uint32_t end = CompactSpan_get_end (&token.span_) - delta;
+          damaged_end = end > damaged_end ? end : damaged_end;
+        }
+      Vec_Token_push (&fresh, token);
+    }
+  if (last > first)
+    {
+      uint32_t end = CompactSpan_get_end (
+          &Vec_Token_cbegin (&self->tokens_)[last - 1].span_);
+      damaged_end = end > damaged_end ? end : damaged_end;
+    }
+  Vec_Token_splice (&self->tokens_, first, last - first,
+                    Vec_Token_cbegin (&fresh), Vec_Token_len (&fresh));
+  for (Token *token = Vec_Token_begin (&self->tokens_) + first
+                      + Vec_Token_len (&fresh);
+       token < Vec_Token_end (&self->tokens_); token++)
+    {
+      token->span_.offset_ += delta;
+    }
+  Vec_Token_drop (&fresh);
+  return CompactSpan_new (start, damaged_end - start);
+}
+
+/* Returns the child of ID whose span contains DAMAGED, or the null id.  */
+static ASTNodeId
+find_child (const ASTNodeManager *ast_mgr, ASTNodeId id,
+            const CompactSpan *damaged, Vec_ASTNodeId *children)
+{
+  const ASTNodeId *begin;
+  size_t len;
+  if (ASTNodeManager_get_kind (ast_mgr, id) == AST_TUPLE)
+    {
+      /* Top-level tuples can be long, but their args are sorted.  */
+      const ASTTuple *tuple
+          = &ASTNodeManager_get_payload (ast_mgr, id)->tuple_;
+      begin = ASTNodeManager_get_tuple_args (ast_mgr, tuple);
+      size_t lo = 0, hi = tuple->num_args_;
+      while (lo < hi)
+        {
+          size_t mid = lo + (hi - lo) / 2;
+          if (CompactSpan_get_offset (ASTNodeManager_get_span (ast_mgr,
+                                                               begin[mid]))
+              <= CompactSpan_get_offset (damaged))
+            {
+              lo = mid + 1;
+            }
+          else
+            {
+              hi = mid;
+            }
+        }
+      begin += lo ? lo - 1 : 0;
+      len = lo ? 1 : 0;
+    }
+  else
+    {
+      Vec_ASTNodeId_resize (children, 0, 0);
+      ASTNodeManager_push_children (ast_mgr, id, children);
+      begin = Vec_ASTNodeId_cbegin (children);
+      len = Vec_ASTNodeId_len (children);
+    }
+  for (size_t i = 0; i < len; i++)
+    {
+      if (!is_null_ast_node_id (begin[i]) && !is_invalid_ast_node_id (begin[i])
+          && CompactSpan_contains (ASTNodeManager_get_span (ast_mgr, begin[i]),
+                                   damaged))
+        {
+          return begin[i];
+        }
+    }
+  return get_null_ast_node_id ();
+}
+
+/* Whether the last child of ID, transitively, is an expression that would
+ * take any operator or call that follows it.  */
+static bool
+ends_open (const ASTNodeManager *ast_mgr, ASTNodeId id)
+{
+  while (true)
+    {
+      const ASTPayload *payload = ASTNodeManager_get_payload (ast_mgr, id);
+      switch (ASTNodeManager_get_kind (ast_mgr, id))
+        {
+        case AST_IF_THEN_ELSE:
+        case AST_LET:
+        case AST_LAMBDA:
+          return true;
+        case AST_POSITIVE:
+        case AST_NEGATIVE:
+          id = payload->unary_.expr_;
+          break;
+        case AST_ADD:
+        case AST_SUB:
+        case AST_MUL:
+        case AST_DIV:
+        case AST_EQ:
+        case AST_NEQ:
+        case AST_LE:
+        case AST_GE:
+        case AST_LT:
+        case AST_GT:
+          id = payload->binary_.right_;
+          break;
+        default:
+          return false;
+        }
+    }
+}
+
+static bool
+continues_expr (enum TokenKind kind)
+{
+  switch (kind)
+    {
+    case TOKEN_LPAREN:
+    case TOKEN_PLUS:
+    case TOKEN_HYPHEN:
+    case TOKEN_ASTERISK:
+    case TOKEN_SLASH:
+    case TOKEN_EQ_EQ:
+    case TOKEN_SLASH_EQ:
+    case TOKEN_LT_EQ:
+    case TOKEN_GT_EQ:
+    case TOKEN_LT:
+    case TOKEN_GT:
+      return true;
+    default:
+      return false;
+    }
+}
+
+/* Parses the tokens that now stand where OLD_ID was, and returns the new
+ * node, or the invalid id if it could not replace OLD_ID in place.  */
+static ASTNodeId
+Document_reparse_node (Document *self, ASTNodeId old_id, int64_t delta)
+{
+  const CompactSpan *old_span
+      = ASTNodeManager_get_span (&self->ast_mgr_, old_id);
+  size_t begin = lower_bound_token (&self->tokens_,
+                                    CompactSpan_get_offset (old_span));
+  size_t end = lower_bound_token (&self->tokens_,
+                                  CompactSpan_get_end (old_span) + delta);
+  if (begin == end)
+    {
+      return get_invalid_ast_node_id ();
+    }
+  const Token *tokens = Vec_Token_cbegin (&self->tokens_);
+  Vec_Token window = Vec_Token_new ();
+  Vec_Token_reserve (&window, end - begin + 1);
+  Vec_Token_splice (&window, 0, 0, tokens + begin, end - begin);
+  Vec_Token_push (&window,
+                  (Token){ .kind_ = TOKEN_EOF,
+                           .span_ = CompactSpan_new (
+                               CompactSpan_get_end (&tokens[end - 1].span_),
+                               0) });
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&self->file_);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  Parser parser = Parser_new (&window, &diag_mgr, &self->ast_mgr_);
+  ASTNodeId id = Parser_parse (&parser);
+  /* A node of the same kind binds to its neighbours as the old one did,
+   * unless it now ends in a body that would extend over the next token.  */
+  bool valid = !is_invalid_ast_node_id (id)
+               && DiagnosticManager_num_total (&diag_mgr) == 0
+               && ASTNodeManager_get_kind (&self->ast_mgr_, id)
+                      == ASTNodeManager_get_kind (&self->ast_mgr_, old_id)
+               && !(ends_open (&self->ast_mgr_, id)
+                    && continues_expr (tokens[end].kind_));
+  Parser_drop (&parser);
+  DiagnosticManager_drop (&diag_mgr);
+  Vec_Token_drop (&window);
+  return valid ? id : get_invalid_ast_node_id ();
+}
+
+/* Reparses the deepest node on PATH that can be reparsed alone and links it
+ * into the tree.  The root is left to a full parse.  */
+static bool
+Document_reparse_path (Document *self, const Vec_ASTNodeId *path,
+                       int64_t delta)
+{
+  const ASTNodeId *ids = Vec_ASTNodeId_cbegin (path);
+  for (size_t i = Vec_ASTNodeId_len (path) - 1; i > 0; i--)
+    {
+      size_t num_nodes = ASTNodeManager_num_nodes (&self->ast_mgr_);
+      size_t num_ids = ASTNodeManager_num_ids (&self->ast_mgr_);
+      ASTNodeId id = Document_reparse_node (self, ids[i], delta);
+      if (is_invalid_ast_node_id (id))
+        {
+          ASTNodeManager_truncate (&self->ast_mgr_, num_nodes, num_ids);
+          continue;
+        }
+      CompactSpan old_span
+          = *ASTNodeManager_get_span (&self->ast_mgr_, ids[i]);
+      ASTNodeManager_shift_spans (&self->ast_mgr_, num_nodes,
+                                  CompactSpan_get_end (&old_span), delta);
+      ASTNodeManager_replace_child (&self->ast_mgr_, ids[i - 1], ids[i], id);
+      /* Ancestors share a bound with the child they begin or end with.  */
+      CompactSpan new_span = *ASTNodeManager_get_span (&self->ast_mgr_, id);
+      for (size_t j = i; j-- > 0;)
+        {
+          CompactSpan span
+              = *ASTNodeManager_get_span (&self->ast_mgr_, ids[j]);
+          uint32_t begin = CompactSpan_get_offset (&span)
+                                   == CompactSpan_get_offset (&old_span)
+                               ? CompactSpan_get_offset (&new_span)
+                               : CompactSpan_get_offset (&span);
+          uint32_t end = CompactSpan_get_end (&span)
+                                 == CompactSpan_get_end (&old_span)
+                             ? CompactSpan_get_end (&new_span)
+                             : CompactSpan_get_end (&span) + delta;
+          old_span = span;
+          new_span = CompactSpan_new (begin, end - begin);
+          ASTNodeManager_set_span (&self->ast_mgr_, ids[j], new_span);
+        }
+      if (self->checked_)
+        {
+          TypeChecker_invalidate (&self->checker_, ids, i);
+        }
+      return true;
+    }
+  return false;
+}
+
+enum DocumentReparse
+Document_edit (Document *self, TextEdit edit)
+{
+  uint32_t begin = CompactSpan_get_offset (&edit.range_);
+  uint32_t old_end = CompactSpan_get_end (&edit.range_);
+  uint32_t new_end = begin + Span_len (&edit.text_);
+  SourceFile_edit (&self->file_, edit.range_, edit.text_);
+  CompactSpan damaged = Document_relex (self, begin, old_end, new_end);
+  /* Old diagnostics may be anywhere, and garbage is only reclaimed by a
+   * full parse.  */
+  if (DiagnosticManager_num_total (&self->diag_mgr_) == 0
+      && ASTNodeManager_num_nodes (&self->ast_mgr_)
+             <= 2 * self->num_parsed_nodes_)
+    {
+      Vec_ASTNodeId path = Vec_ASTNodeId_new ();
+      Vec_ASTNodeId children = Vec_ASTNodeId_new ();
+      ASTNodeId id = self->root_;
+      while (!is_null_ast_node_id (id)
+             && CompactSpan_contains (
+                 ASTNodeManager_get_span (&self->ast_mgr_, id), &damaged))
+        {
+          Vec_ASTNodeId_push (&path, id);
+          id = find_child (&self->ast_mgr_, id, &damaged, &children);
+        }
+      bool reparsed
+          = !Vec_ASTNodeId_is_empty (&path)
+            && Document_reparse_path (self, &path,
+                                      (int64_t)new_end - old_end);
+      Vec_ASTNodeId_drop (&children);
+      Vec_ASTNodeId_drop (&path);
+      if (reparsed)
+        {
+          return DOCUMENT_REPARSE_SUBTREE;
+        }
+    }
+  Document_parse_all (self);
+  return DOCUMENT_REPARSE_ALL;
+}
+
+TypeId
+Document_check (Document *self)
+{
+  /* The subtrees that reported diagnostics are typed again and report them
+   * to a fresh manager.  */
+  DiagnosticManager_drop (&self->check_diag_mgr_);
+  self->check_diag_mgr_ = DiagnosticManager_new (&self->file_);
+  DiagnosticManager_set_display (&self->check_diag_mgr_, false);
+  DiagnosticManager_set_type_manager (&self->check_diag_mgr_,
+                                      &self->type_mgr_);
+  if (!self->checked_)
+    {
+      TypeChecker_drop (&self->checker_);
+      self->checker_ = TypeChecker_new (
+          &self->ast_mgr_, &self->check_diag_mgr_, &self->type_mgr_);
+      TypeChecker_set_cancel (&self->checker_, self->cancel_);
+      self->checked_ = true;
+    }
+  return TypeChecker_recheck (&self->checker_, self->root_);
+}
+
+void
+Document_set_cancel (Document *self, const atomic_bool *cancel)
+{
+  self->cancel_ = cancel;
+  TypeChecker_set_cancel (&self->checker_, cancel);
+}
+
+TypeId
+Document_get_type (const Document *self, ASTNodeId id)
+{
+  const ASTNodeIdToTypeIdMap *map = TypeChecker_get_map (&self->checker_);
+  if (!self->checked_ || id >= Vec_TypeId_len (&map->map_))
+    {
+      return TYPE_UNKNOWN;
+    }
+  return ASTNodeIdToTypeIdMap_get (map, id);
+}
+
+ASTNodeId
+Document_find_node (const Document *self, uint32_t offset)
+{
+  CompactSpan point = CompactSpan_new (offset, 1);
+  Vec_ASTNodeId children = Vec_ASTNodeId_new ();
+  ASTNodeId found = get_null_ast_node_id ();
+  ASTNodeId id = self->root_;
+  while (!is_null_ast_node_id (id) && !is_invalid_ast_node_id (id)
+         && CompactSpan_contains (
+             ASTNodeManager_get_span (&self->ast_mgr_, id), &point))
+    {
+      found = id;
+      id = find_child (&self->ast_mgr_, id, &point, &children);
+    }
+  Vec_ASTNodeId_drop (&children);
+  return found;
+}
+
+#ifdef TESTS
+#include "test.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "bench.h"
+
+static bool
+ast_eq (const ASTNodeManager *ast_mgr, ASTNodeId id,
+        const ASTNodeManager *other_mgr, ASTNodeId other_id)
+{
+  if (ASTNodeManager_get_kind (ast_mgr, id)
+      != ASTNodeManager_get_kind (other_mgr, other_id))
+    {
+      return false;
+    }
+  if (is_null_ast_node_id (id))
+    {
+      return true;
+    }
+  const CompactSpan *span = ASTNodeManager_get_span (ast_mgr, id);
+  const CompactSpan *other_span
+      = ASTNodeManager_get_span (other_mgr, other_id);
+  if (CompactSpan_get_offset (span) != CompactSpan_get_offset (other_span)
+      || CompactSpan_len (span) != CompactSpan_len (other_span))
+    {
+      return false;
+    }
+  Vec_ASTNodeId children = Vec_ASTNodeId_new ();
+  Vec_ASTNodeId other_children = Vec_ASTNodeId_new ();
+  ASTNodeManager_push_children (ast_mgr, id, &children);
+  ASTNodeManager_push_children (other_mgr, other_id, &other_children);
+  bool eq
+      = Vec_ASTNodeId_len (&children) == Vec_ASTNodeId_len (&other_children);
+  for (size_t i = 0; eq && i < Vec_ASTNodeId_len (&children); i++)
+    {
+      eq = ast_eq (ast_mgr, Vec_ASTNodeId_cbegin (&children)[i], other_mgr,
+                   Vec_ASTNodeId_cbegin (&other_children)[i]);
+    }
+  Vec_ASTNodeId_drop (&other_children);
+  Vec_ASTNodeId_drop (&children);
+  return eq;
+}
+
+/* Whether the document is in the state a fresh one of its text would be.  */
+static bool
+Document_matches_fresh (const Document *self)
+{
+  String content = String_new ();
+  String_push_string (&content, SourceFile_get_content (&self->file_));
+  Document fresh;
+  Document_init (&fresh, String_from_cstring ("fresh"), content);
+  bool eq = Vec_Token_len (&self->tokens_) == Vec_Token_len (&fresh.tokens_)
+            && DiagnosticManager_num_total (&self->diag_mgr_)
+                   == DiagnosticManager_num_total (&fresh.diag_mgr_);
+  for (size_t i = 0; eq && i < Vec_Token_len (&self->tokens_); i++)
+    {
+      eq = Token_eq (Vec_Token_cbegin (&self->tokens_) + i,
+                     Vec_Token_cbegin (&fresh.tokens_) + i);
+    }
+  if (eq && DiagnosticManager_num_total (&fresh.diag_mgr_) == 0)
+    {
+      eq = ast_eq (&self->ast_mgr_, self->root_, &fresh.ast_mgr_,
+                   fresh.root_);
+    }
+  Document_drop (&fresh);
+  return eq;
+}
+
+static enum DocumentReparse
+Document_replace (Document *self, uint32_t offset, uint32_t len,
+                  const char *text)
+{
+  return Document_edit (self, TextEdit_new (CompactSpan_new (offset, len),
+                                            Span_from_cstring (text)));
+}
+
+NEO_TEST (test_document_edit_00)
+{
+  Document doc;
+  Document_init (&doc, String_from_cstring ("test"),
+                 String_from_cstring ("(let x = 1 + 2 in x, f (true), y)"));
+  ASSERT_U64_EQ (DiagnosticManager_num_total (&doc.diag_mgr_), 0);
+  ASTNodeId root = doc.root_;
+  const ASTTuple *tuple
+      = &ASTNodeManager_get_payload (&doc.ast_mgr_, root)->tuple_;
+  ASTNodeId call = ASTNodeManager_get_tuple_args (&doc.ast_mgr_, tuple)[1];
+  ASTNodeId var = ASTNodeManager_get_tuple_args (&doc.ast_mgr_, tuple)[2];
+  ASSERT_U64_EQ (Document_replace (&doc, 13, 1, "23"),
+                 DOCUMENT_REPARSE_SUBTREE);
+  ASSERT_U64_EQ (doc.root_, root);
+  tuple = &ASTNodeManager_get_payload (&doc.ast_mgr_, root)->tuple_;
+  ASSERT_U64_EQ (ASTNodeManager_get_tuple_args (&doc.ast_mgr_, tuple)[1],
+                 call);
+  ASSERT_U64_EQ (ASTNodeManager_get_tuple_args (&doc.ast_mgr_, tuple)[2],
+                 var);
+  ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+  /* The argument of the call, then the name of the var.  */
+  ASSERT_U64_EQ (Document_replace (&doc, 25, 4, "false"),
+                 DOCUMENT_REPARSE_SUBTREE);
+  ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+  ASSERT_U64_EQ (Document_replace (&doc, 33, 1, "yy"),
+                 DOCUMENT_REPARSE_SUBTREE);
+  ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+  Document_drop (&doc);
+}
+
+NEO_TEST (test_document_edit_01)
+{
+  Document doc;
+  Document_init (&doc, String_from_cstring ("test"),
+                 String_from_cstring ("(a + b, c)"));
+  /* The sum takes the product whole.  */
+  ASSERT_U64_EQ (Document_replace (&doc, 5, 1, "b * d"),
+                 DOCUMENT_REPARSE_SUBTREE);
+  ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+  /* A lower operator would regroup the sum, so the tuple is parsed again,
+   * and being the root, all of it is.  */
+  ASSERT_U64_EQ (Document_replace (&doc, 9, 1, "d == e"),
+                 DOCUMENT_REPARSE_ALL);
+  ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+  Document_drop (&doc);
+}
+
+NEO_TEST (test_document_edit_02)
+{
+  Document doc;
+  Document_init (&doc, String_from_cstring ("test"),
+                 String_from_cstring ("(x * y + z, w)"));
+  /* An else branch would take the sum that follows.  */
+  ASSERT_U64_EQ (Document_replace (&doc, 5, 1, "if a then b else y"),
+                 DOCUMENT_REPARSE_ALL);
+  ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+  Document_drop (&doc);
+}
+
+NEO_TEST (test_document_edit_03)
+{
+  Document doc;
+  Document_init (&doc, String_from_cstring ("test"),
+                 String_from_cstring ("(f (a, b), c)"));
+  ASSERT_U64_EQ (Document_replace (&doc, 8, 0, " +"), DOCUMENT_REPARSE_ALL);
+  ASSERT_U64_EQ (DiagnosticManager_num_total (&doc.diag_mgr_) > 0, true);
+  ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+  ASSERT_U64_EQ (Document_replace (&doc, 8, 2, ""), DOCUMENT_REPARSE_ALL);
+  ASSERT_U64_EQ (DiagnosticManager_num_total (&doc.diag_mgr_), 0);
+  ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+  /* Comments are relexed as well.  */
+  ASSERT_U64_EQ (Document_replace (&doc, 8, 0, "// b\n, d"),
+                 DOCUMENT_REPARSE_SUBTREE);
+  ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+  Document_drop (&doc);
+}
+
+NEO_TEST (test_document_edit_04)
+{
+  static const char *const texts[]
+      = { "", " ", "x", "1", "+", "*", "(", ")", ",", "if", "//", "\n" };
+  Document doc;
+  Document_init (&doc, String_from_cstring ("test"),
+                 bench_gen_source (1 << 12, 7));
+  uint64_t state = 7;
+  size_t num_subtrees = 0;
+  for (size_t i = 0; i < 500; i++)
+    {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      uint32_t len = String_len (SourceFile_get_content (&doc.file_));
+      uint32_t offset = state % (len + 1);
+      char removed[2] = { 0 };
+      if (offset < len && (state >> 32) % 2)
+        {
+          removed[0]
+              = String_cbegin (SourceFile_get_content (&doc.file_))[offset];
+        }
+      const char *text = texts[(state >> 40) % (sizeof (texts)
+                                                  / sizeof (texts[0]))];
+      /* Undoing each edit keeps the text mostly well-formed.  */
+      num_subtrees += Document_replace (&doc, offset, strlen (removed), text)
+                      == DOCUMENT_REPARSE_SUBTREE;
+      ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+      num_subtrees += Document_replace (&doc, offset, strlen (text), removed)
+                      == DOCUMENT_REPARSE_SUBTREE;
+      ASSERT_U64_EQ (Document_matches_fresh (&doc), true);
+    }
+  ASSERT_U64_EQ (num_subtrees > 0, true);
+  Document_drop (&doc);
+}
+
+/* Whether the trees have the same types, node by node, where OTHER was
+ * checked.  Checking SELF again may skip some nodes, whose types stay those
+ * of their last check.  */
+static bool
+types_eq (const Document *self, ASTNodeId id, const Document *other,
+          ASTNodeId other_id)
+{
+  if (is_null_ast_node_id (id)
+      || Document_get_type (other, other_id) == TYPE_UNKNOWN)
+    {
+      return true;
+    }
+  if (Document_get_type (self, id) != Document_get_type (other, other_id))
+    {
+      return false;
+    }
+  Vec_ASTNodeId children = Vec_ASTNodeId_new ();
+  Vec_ASTNodeId other_children = Vec_ASTNodeId_new ();
+  ASTNodeManager_push_children (&self->ast_mgr_, id, &children);
+  ASTNodeManager_push_children (&other->ast_mgr_, other_id, &other_children);
+  bool eq = true;
+  for (size_t i = 0; eq && i < Vec_ASTNodeId_len (&children); i++)
+    {
+      eq = types_eq (self, Vec_ASTNodeId_cbegin (&children)[i], other,
+                     Vec_ASTNodeId_cbegin (&other_children)[i]);
+    }
+  Vec_ASTNodeId_drop (&other_children);
+  Vec_ASTNodeId_drop (&children);
+  return eq;
+}
+
+/* Whether checking the document found what checking a fresh one of its
+ * text does.  */
+static bool
+Document_check_matches_fresh (Document *self)
+{
+  String content = String_new ();
+  String_push_string (&content, SourceFile_get_content (&self->file_));
+  Document fresh;
+  Document_init (&fresh, String_from_cstring ("fresh"), content);
+  Document_check (&fresh);
+  bool eq = Document_matches_fresh (self)
+            && DiagnosticManager_num_total (&self->check_diag_mgr_)
+                   == DiagnosticManager_num_total (&fresh.check_diag_mgr_)
+            && types_eq (self, self->root_, &fresh, fresh.root_);
+  for (DiagnosticId id = 0;
+       eq && id < DiagnosticManager_num_stored (&self->check_diag_mgr_);
+       id++)
+    {
+      String message
+          = DiagnosticManager_fmt_message (&self->check_diag_mgr_, id);
+      String fresh_message
+          = DiagnosticManager_fmt_message (&fresh.check_diag_mgr_, id);
+      Span span = Span_from_string (&message);
+      Span fresh_span = Span_from_string (&fresh_message);
+      CompactSpan at = Diagnostic_get_span (
+          DiagnosticManager_get (&self->check_diag_mgr_, id));
+      CompactSpan fresh_at = Diagnostic_get_span (
+          DiagnosticManager_get (&fresh.check_diag_mgr_, id));
+      eq = Span_eq (&span, &fresh_span)
+           && CompactSpan_get_offset (&at)
+                  == CompactSpan_get_offset (&fresh_at);
+      String_drop (&message);
+      String_drop (&fresh_message);
+    }
+  Document_drop (&fresh);
+  return eq;
+}
+
+NEO_TEST (test_document_check_00)
+{
+  Document doc;
+  Document_init (
+      &doc, String_from_cstring ("test"),
+      String_from_cstring (
+          "let y = true, z = false in let x = y in if x then x else z"));
+  ASSERT_U64_EQ (Document_check (&doc), TYPE_BOOL);
+  ASSERT_U64_EQ (Document_check_matches_fresh (&doc), true);
+  /* Both lets and the new init, the binding of x is still a Bool.  */
+  size_t num_typed = doc.checker_.num_typed_;
+  ASSERT_U64_EQ (Document_replace (&doc, 35, 1, "z"),
+                 DOCUMENT_REPARSE_SUBTREE);
+  ASSERT_U64_EQ (Document_check (&doc), TYPE_BOOL);
+  ASSERT_U64_EQ (doc.checker_.num_typed_ - num_typed, 3);
+  ASSERT_U64_EQ (Document_check_matches_fresh (&doc), true);
+  Document_drop (&doc);
+}
+
+NEO_TEST (test_document_check_01)
+{
+  Document doc;
+  Document_init (
+      &doc, String_from_cstring ("test"),
+      String_from_cstring (
+          "let y = true, z = false in let x = y in if x then x else z"));
+  Document_check (&doc);
+  /* Renaming the var unbinds the uses in its scope.  */
+  ASSERT_U64_EQ (Document_replace (&doc, 31, 1, "w"),
+                 DOCUMENT_REPARSE_SUBTREE);
+  ASSERT_U64_EQ (Document_check (&doc), TYPE_INVALID);
+  ASSERT_U64_EQ (
+      DiagnosticManager_num_total (&doc.check_diag_mgr_) > 0, true);
+  ASSERT_U64_EQ (Document_check_matches_fresh (&doc), true);
+  ASSERT_U64_EQ (Document_replace (&doc, 31, 1, "x"),
+                 DOCUMENT_REPARSE_SUBTREE);
+  ASSERT_U64_EQ (Document_check (&doc), TYPE_BOOL);
+  ASSERT_U64_EQ (DiagnosticManager_num_total (&doc.check_diag_mgr_), 0);
+  ASSERT_U64_EQ (Document_check_matches_fresh (&doc), true);
+  Document_drop (&doc);
+}
+
+NEO_TEST (test_document_check_02)
+{
+  Document doc;
+  Document_init (
+      &doc, String_from_cstring ("test"),
+      String_from_cstring (
+          "let y = 1 == 1, z = false in let x = y in if x then x + 1 else z"));
+  Document_check (&doc);
+  size_t num_diags = DiagnosticManager_num_total (&doc.check_diag_mgr_);
+  ASSERT_U64_EQ (num_diags > 0, true);
+  /* Both lets, the new init, and the if and the sum, which report their
+   * diagnostics again.  */
+  size_t num_typed = doc.checker_.num_typed_;
+  ASSERT_U64_EQ (Document_replace (&doc, 37, 1, "z"),
+                 DOCUMENT_REPARSE_SUBTREE);
+  Document_check (&doc);
+  ASSERT_U64_EQ (doc.checker_.num_typed_ - num_typed, 5);
+  ASSERT_U64_EQ (DiagnosticManager_num_total (&doc.check_diag_mgr_),
+                 num_diags);
+  ASSERT_U64_EQ (Document_check_matches_fresh (&doc), true);
+  /* The diagnostics point where their nodes were shifted to.  */
+  ASSERT_U64_EQ (Document_replace (&doc, 8, 1, "10"),
+                 DOCUMENT_REPARSE_SUBTREE);
+  Document_check (&doc);
+  ASSERT_U64_EQ (Document_check_matches_fresh (&doc), true);
+  Document_drop (&doc);
+}
+
+/* Sets CANCEL once the thread has yielded NUM_YIELDS times.  */
+typedef struct CancelAfter
+{
+  atomic_bool *cancel_;
+  size_t num_yields_;
+} CancelAfter;
+
+static int
+cancel_after (void *arg)
+{
+  CancelAfter *self = arg;
+  for (size_t i = 0; i < self->num_yields_; i++)
+    {
+      thrd_yield ();
+    }
+  atomic_store (self->cancel_, true);
+  return 0;
+}
+
+/* Returns the offset of some `true` in the text of SELF picked by STATE.  */
+static uint32_t
+Document_pick_true (const Document *self, uint64_t state)
+{
+  const char *content = String_cbegin (SourceFile_get_content (&self->file_));
+  size_t num_trues = 0;
+  for (const char *at = strstr (content, "true"); at;
+       at = strstr (at + 1, "true"))
+    {
+      num_trues++;
+    }
+  const char *at = strstr (content, "true");
+  for (size_t i = state % num_trues; i > 0; i--)
+    {
+      at = strstr (at + 1, "true");
+    }
+  return at - content;
+}
+
+/* Checks SELF with a thread that cancels each check sooner or later, until
+ * one finishes.  */
+static TypeId
+Document_check_cancelled (Document *self, atomic_bool *cancel)
+{
+  TypeId type_id = TYPE_UNKNOWN;
+  for (size_t num_yields = 0; type_id == TYPE_UNKNOWN;
+       num_yields = num_yields * 2 + 1)
+    {
+      atomic_store (cancel, false);
+      CancelAfter after = { .cancel_ = cancel, .num_yields_ = num_yields };
+      thrd_t thread;
+      if (thrd_create (&thread, cancel_after, &after) != thrd_success)
+        {
+          abort ();
+        }
+      type_id = Document_check (self);
+      thrd_join (thread, NULL);
+    }
+  return type_id;
+}
+
+NEO_TEST (test_document_check_03)
+{
+  Document doc;
+  Document_init (&doc, String_from_cstring ("test"),
+                 bench_gen_let_source (16, 6, 7));
+  atomic_bool cancel;
+  atomic_init (&cancel, true);
+  Document_set_cancel (&doc, &cancel);
+  ASSERT_U64_EQ (Document_check (&doc), TYPE_UNKNOWN);
+  ASSERT_U64_EQ (doc.checker_.num_typed_, 0);
+  /* Wherever a check gives up, the next one carries on from there.  */
+  Document_check_cancelled (&doc, &cancel);
+  ASSERT_U64_EQ (Document_check_matches_fresh (&doc), true);
+  uint64_t state = 7;
+  for (size_t i = 0; i < 4; i++)
+    {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      uint32_t offset = Document_pick_true (&doc, state);
+      Document_replace (&doc, offset, 4, "false");
+      Document_check_cancelled (&doc, &cancel);
+      ASSERT_U64_EQ (Document_check_matches_fresh (&doc), true);
+      Document_replace (&doc, offset, 5, "true");
+    }
+  Document_drop (&doc);
+}
+
+NEO_TESTS (document_tests, test_document_edit_00, test_document_edit_01,
+           test_document_edit_02, test_document_edit_03,
+           test_document_edit_04, test_document_check_00,
+           test_document_check_01, test_document_check_02,
+           test_document_check_03)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+#include <string.h>
+
+NEO_BENCH (bench_document_edit_00)
+{
+  Document doc;
+  Document_init (&doc, String_from_cstring ("bench"),
+                 bench_gen_source (1 << 20, 42));
+  const String *content = SourceFile_get_content (&doc.file_);
+  const char *middle = String_cbegin (content) + String_len (content) / 2;
+  uint32_t offset = strstr (middle, "true") - String_cbegin (content);
+  size_t num_edits = 0, num_subtrees = 0;
+  BENCH_ITER
+  {
+    /* Toggles a literal into a var and back.  */
+    const char *text = num_edits++ % 2 ? "t" : "x";
+    TextEdit edit
+        = TextEdit_new (CompactSpan_new (offset, 1), Span_from_cstring (text));
+    if (Document_edit (&doc, edit) == DOCUMENT_REPARSE_SUBTREE)
+      {
+        num_subtrees++;
+      }
+  }
+  Bencher_report_u64 (bencher_, "bytes", String_len (content));
+  Bencher_report_u64 (bencher_, "edits", num_edits);
+  Bencher_report_u64 (bencher_, "subtrees", num_subtrees);
+  Document_drop (&doc);
+}
+
+NEO_BENCH (bench_document_check_00)
+{
+  Document doc;
+  Document_init (&doc, String_from_cstring ("bench"),
+                 bench_gen_if_source (11, 42));
+  Document_check (&doc);
+  const String *content = SourceFile_get_content (&doc.file_);
+  const char *middle = String_cbegin (content) + String_len (content) / 2;
+  uint32_t offset = strstr (middle, "true") - String_cbegin (content);
+  size_t num_nodes = ASTNodeManager_num_nodes (&doc.ast_mgr_);
+  size_t num_typed = doc.checker_.num_typed_;
+  size_t num_edits = 0, num_diags = 0;
+  BENCH_ITER
+  {
+    /* Both literals keep every if well-typed.  */
+    bool is_false = num_edits++ % 2;
+    Document_edit (&doc,
+                   TextEdit_new (CompactSpan_new (offset, is_false ? 5 : 4),
+                                 Span_from_cstring (is_false ? "true"
+                                                             : "false")));
+    Document_check (&doc);
+    num_diags += DiagnosticManager_num_total (&doc.check_diag_mgr_);
+  }
+  Bencher_report_u64 (bencher_, "nodes", num_nodes);
+  Bencher_report_f64 (bencher_, "typed/edit",
+                      (double)(doc.checker_.num_typed_ - num_typed)
+                          / num_edits);
+  Bencher_report_u64 (bencher_, "diags", num_diags);
+  Document_drop (&doc);
+}
+
+NEO_BENCHES (document_benches, bench_document_edit_00,
+             bench_document_check_00)
+#endif
@@ -0,0 +1,96 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_DOCUMENT_H
+#define NEO_DOCUMENT_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "ast_node.h"
+#include "diagnostic.h"
+#include "span.h"
+#include "string.h"
+#include "token.h"
+#include "type.h"
+#include "type_checker.h"
+
+/* Replaces RANGE of the current text with TEXT.  */
+typedef struct TextEdit
+{
+  CompactSpan range_;
+  Span text_;
+} TextEdit;
+
+TextEdit TextEdit_new (CompactSpan range, Span text);
+
+enum DocumentReparse
+{
+  /* Only the smallest enclosing subtree was parsed again.  */
+  DOCUMENT_REPARSE_SUBTREE,
+  DOCUMENT_REPARSE_ALL
+};
+
+/* A source file kept lexed and parsed across edits, as an editor holds it.
+ * The diagnostic manager points to the file, so a document must not be
+ * moved once initialized.  */
+typedef struct Document
+{
+  SourceFile file_;
+  Vec_Token tokens_;
+  ASTNodeManager ast_mgr_;
+  /* Does not display, the owner decides what to show.  */
+  DiagnosticManager diag_mgr_;
+  ASTNodeId root_;
+  /* Nodes after the last full parse, which bounds the garbage that
+   * replaced subtrees leave behind.  */
+  size_t num_parsed_nodes_;
+  TypeManager type_mgr_;
+  /* Keeps its map from one check to the next while the tree is only edited
+   * in place.  */
+  TypeChecker checker_;
+  DiagnosticManager check_diag_mgr_;
+  bool checked_;
+  /* Passed on to the checker, see TypeChecker_set_cancel.  */
+  const atomic_bool *cancel_;
+} Document;
+
+void Document_init (Document *self, String path, String content);
+void Document_drop (Document *self);
+const SourceFile *Document_get_file (const Document *self);
+const Vec_Token *Document_get_tokens (const Document *self);
+const ASTNodeManager *Document_get_ast_manager (const Document *self);
+const DiagnosticManager *
+Document_get_diagnostic_manager (const Document *self);
+ASTNodeId Document_get_root (const Document *self);
+const TypeManager *Document_get_type_manager (const Document *self);
+const DiagnosticManager *
+Document_get_check_diagnostic_manager (const Document *self);
+/* Applies EDIT, relexing only the tokens it damaged and reparsing only the
+ * smallest subtree that encloses them.  Nodes outside that subtree keep
+ * their ids.  */
+enum DocumentReparse Document_edit (Document *self, TextEdit edit);
+/* Returns the type of the root.  After edits in place, only the subtrees
+ * they changed, their ancestors, the scopes of changed bindings and the
+ * subtrees that reported diagnostics are typed again.  */
+TypeId Document_check (Document *self);
+/* Makes Document_check give up once CANCEL is set, with TYPE_UNKNOWN and no
+ * more than some of its diagnostics.  The types it found are kept.  */
+void Document_set_cancel (Document *self, const atomic_bool *cancel);
+/* Returns the type that the last check found for ID, or TYPE_UNKNOWN if it
+ * found none, as for nodes added since.  */
+TypeId Document_get_type (const Document *self, ASTNodeId id);
+/* Returns the innermost node that covers the char at OFFSET, or the null
+ * id.  */
+ASTNodeId Document_find_node (const Document *self, uint32_t offset);
+
+#ifdef TESTS
+#include "test.h"
+Tests document_tests ();
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+Benches document_benches ();
+#endif
+
+#endif
@@ -0,0 +1,905 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "folder.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast_node.h"
+#include "ast_visitor.h"
+#include "big_int.h"
+#include "int64.h"
+#include "span.h"
+#include "token.h"
+#include "vec_macro.h"
+
+Folder
+Folder_new (const ASTNodeManager *src, const SourceFile *file,
+            ASTNodeManager *dst)
+{
+  return (Folder){ .src_ = src,
+                   .file_ = file,
+                   .dst_ = dst,
+                   .vars_ = Vec_ASTNodeId_new (),
+                   .types_ = Vec_ASTNodeId_new (),
+                   .exprs_ = Vec_ASTNodeId_new (),
+                   .num_folded_ = 0 };
+}
+
+void
+Folder_drop (Folder *self)
+{
+  Vec_ASTNodeId_drop (&self->vars_);
+  Vec_ASTNodeId_drop (&self->types_);
+  Vec_ASTNodeId_drop (&self->exprs_);
+}
+
+/* Whether the integer literal NODE_ID of DST is an Int64, as the checker
+ * types it, and if so sets VALUE to it.  */
+static bool
+Folder_get_int64 (const Folder *self, ASTNodeId node_id, int64_t *value)
+{
+  return ASTNodeManager_get_int64 (self->dst_, self->file_, node_id, value);
+}
+
+static BigInt
+Folder_get_integer (const Folder *self, ASTNodeId node_id)
+{
+  return ASTNodeManager_get_integer (self->dst_, self->file_, node_id);
+}
+
+static ASTNodeId
+Folder_push_bool (Folder *self, CompactSpan span, bool value)
+{
+  self->num_folded_++;
+  return ASTNodeManager_push_lit (self->dst_, span,
+                                  value ? AST_LIT_TRUE : AST_LIT_FALSE);
+}
+
+/* Takes VALUE, which is an Int.  */
+static ASTNodeId
+Folder_push_integer (Folder *self, CompactSpan span, BigInt value)
+{
+  self->num_folded_++;
+  return ASTNodeManager_push_integer (self->dst_, span, value);
+}
+
+static ASTNodeId
+Folder_push_int64 (Folder *self, CompactSpan span, int64_t value)
+{
+  self->num_folded_++;
+  return ASTNodeManager_push_int64 (self->dst_, span, value);
+}
+
+static bool
+Folder_is_bool (const Folder *self, ASTNodeId id)
+{
+  enum ASTKind kind = ASTNodeManager_get_kind (self->dst_, id);
+  return kind == AST_LIT_TRUE || kind == AST_LIT_FALSE;
+}
+
+static bool
+Folder_is_integer (const Folder *self, ASTNodeId id)
+{
+  return ASTNodeManager_get_kind (self->dst_, id) == AST_LIT_INTEGER;
+}
+
+static enum TokenKind
+ast_to_op (enum ASTKind kind)
+{
+  switch (kind)
+    {
+    case AST_POSITIVE:
+    case AST_ADD:
+      return TOKEN_PLUS;
+    case AST_NEGATIVE:
+    case AST_SUB:
+      return TOKEN_HYPHEN;
+    case AST_MUL:
+      return TOKEN_ASTERISK;
+    case AST_DIV:
+      return TOKEN_SLASH;
+    case AST_EQ:
+      return TOKEN_EQ_EQ;
+    case AST_NEQ:
+      return TOKEN_SLASH_EQ;
+    case AST_LE:
+      return TOKEN_LT_EQ;
+    case AST_GE:
+      return TOKEN_GT_EQ;
+    case AST_LT:
+      return TOKEN_LT;
+    case AST_GT:
+      return TOKEN_GT;
+    default:
+      {
+        assert (false);
+        return TOKEN_INVALID;
+      }
+    }
+}
+
+static bool
+cmp_holds (enum ASTKind kind, int cmp)
+{
+  switch (kind)
+    {
+    case AST_EQ:
+      return cmp == 0;
+    case AST_NEQ:
+      return cmp != 0;
+    case AST_LE:
+      return cmp <= 0;
+    case AST_GE:
+      return cmp >= 0;
+    case AST_LT:
+      return cmp < 0;
+    case AST_GT:
+      return cmp > 0;
+    default:
+      {
+        assert (false);
+        return false;
+      }
+    }
+}
+
+/* Evaluates KIND on the Int64 values LEFT and RIGHT, without boxing them,
+ * as Folder_eval_integers does.  Returns the null id for an overflow as
+ * well, which is left to fail at run time rather than widened.  */
+static ASTNodeId
+Folder_eval_int64s (Folder *self, enum ASTKind kind, CompactSpan span,
+                    int64_t left, int64_t right, size_t num_nodes,
+                    size_t num_ids)
+{
+  int64_t value = 0;
+  bool fits = false;
+  switch (kind)
+    {
+    case AST_ADD:
+      fits = Int64_add (left, right, &value);
+      break;
+    case AST_SUB:
+      fits = Int64_sub (left, right, &value);
+      break;
+    case AST_MUL:
+      fits = Int64_mul (left, right, &value);
+      break;
+    case AST_DIV:
+      fits = Int64_div (left, right, &value);
+      break;
+    default:
+      ASTNodeManager_truncate (self->dst_, num_nodes, num_ids);
+      return Folder_push_bool (
+          self, span, cmp_holds (kind, (left > right) - (left < right)));
+    }
+  if (!fits)
+    {
+      return get_null_ast_node_id ();
+    }
+  ASTNodeManager_truncate (self->dst_, num_nodes, num_ids);
+  return Folder_push_int64 (self, span, value);
+}
+
+/* Evaluates KIND on the integer literals LEFT and RIGHT of DST, which come
+ * after NUM_NODES nodes and NUM_IDS pooled ids, and pushes the result in
+ * their place.  Returns the null id for a division by zero, which is left
+ * to run.  */
+static ASTNodeId
+Folder_eval_integers (Folder *self, enum ASTKind kind, CompactSpan span,
+                      ASTNodeId left, ASTNodeId right, size_t num_nodes,
+                      size_t num_ids)
+{
+  int64_t left_int64;
+  int64_t right_int64;
+  if (Folder_get_int64 (self, left, &left_int64)
+      && Folder_get_int64 (self, right, &right_int64))
+    {
+      return Folder_eval_int64s (self, kind, span, left_int64, right_int64,
+                                 num_nodes, num_ids);
+    }
+  BigInt left_value = Folder_get_integer (self, left);
+  BigInt right_value = Folder_get_integer (self, right);
+  ASTNodeId id = get_null_ast_node_id ();
+  if (kind != AST_DIV || !BigInt_is_zero (&right_value))
+    {
+      ASTNodeManager_truncate (self->dst_, num_nodes, num_ids);
+      switch (kind)
+        {
+        case AST_ADD:
+          id = Folder_push_integer (self, span,
+                                    BigInt_add (&left_value, &right_value));
+          break;
+        case AST_SUB:
+          id = Folder_push_integer (self, span,
+                                    BigInt_sub (&left_value, &right_value));
+          break;
+        case AST_MUL:
+          id = Folder_push_integer (self, span,
+                                    BigInt_mul (&left_value, &right_value));
+          break;
+        case AST_DIV:
+          id = Folder_push_integer (self, span,
+                                    BigInt_div (&left_value, &right_value));
+          break;
+        default:
+          id = Folder_push_bool (
+              self, span,
+              cmp_holds (kind, BigInt_cmp (&left_value, &right_value)));
+          break;
+        }
+    }
+  BigInt_drop (&left_value);
+  BigInt_drop (&right_value);
+  return id;
+}
+
+static ASTNodeId
+Folder_fold_binary (Folder *self, ASTNodeId node_id)
+{
+  enum ASTKind kind = ASTNodeManager_get_kind (self->src_, node_id);
+  const ASTBinary *binary
+      = &ASTNodeManager_get_payload (self->src_, node_id)->binary_;
+  CompactSpan span = *ASTNodeManager_get_span (self->src_, node_id);
+  size_t num_nodes = ASTNodeManager_num_nodes (self->dst_);
+  size_t num_ids = ASTNodeManager_num_ids (self->dst_);
+  ASTNodeId left = Folder_fold (self, binary->left_);
+  ASTNodeId right = Folder_fold (self, binary->right_);
+  if (Folder_is_integer (self, left) && Folder_is_integer (self, right))
+    {
+      ASTNodeId id = Folder_eval_integers (self, kind, span, left, right,
+                                           num_nodes, num_ids);
+      if (!is_null_ast_node_id (id))
+        {
+          return id;
+        }
+    }
+  else if (Folder_is_bool (self, left) && Folder_is_bool (self, right)
+           && (kind == AST_EQ || kind == AST_NEQ))
+    {
+      bool eq = ASTNodeManager_get_kind (self->dst_, left)
+                == ASTNodeManager_get_kind (self->dst_, right);
+      ASTNodeManager_truncate (self->dst_, num_nodes, num_ids);
+      return Folder_push_bool (self, span, eq == (kind == AST_EQ));
+    }
+  return ASTNodeManager_push_binary (self->dst_, span, ast_to_op (kind), left,
+                                     right);
+}
+
+static ASTNodeId
+Folder_fold_unary (Folder *self, ASTNodeId node_id)
+{
+  enum ASTKind kind = ASTNodeManager_get_kind (self->src_, node_id);
+  CompactSpan span = *ASTNodeManager_get_span (self->src_, node_id);
+  size_t num_nodes = ASTNodeManager_num_nodes (self->dst_);
+  size_t num_ids = ASTNodeManager_num_ids (self->dst_);
+  ASTNodeId expr = Folder_fold (
+      self, ASTNodeManager_get_payload (self->src_, node_id)->unary_.expr_);
+  if (!Folder_is_integer (self, expr))
+    {
+      return ASTNodeManager_push_unary (self->dst_, span, ast_to_op (kind),
+                                        expr);
+    }
+  int64_t int64;
+  if (Folder_get_int64 (self, expr, &int64))
+    {
+      /* Only the negation of the least Int64 overflows.  */
+      if (kind == AST_NEGATIVE && !Int64_neg (int64, &int64))
+        {
+          return ASTNodeManager_push_unary (self->dst_, span,
+                                            ast_to_op (kind), expr);
+        }
+      ASTNodeManager_truncate (self->dst_, num_nodes, num_ids);
+      return Folder_push_int64 (self, span, int64);
+    }
+  BigInt value = Folder_get_integer (self, expr);
+  ASTNodeManager_truncate (self->dst_, num_nodes, num_ids);
+  if (kind == AST_POSITIVE)
+    {
+      return Folder_push_integer (self, span, value);
+    }
+  BigInt neg = BigInt_neg (&value);
+  BigInt_drop (&value);
+  return Folder_push_integer (self, span, neg);
+}
+
+static ASTNodeId
+Folder_fold_if_then_else (Folder *self, ASTNodeId node_id)
+{
+  const ASTIfThenElse *if_then_else
+      = &ASTNodeManager_get_payload (self->src_, node_id)->if_then_else_;
+  size_t num_nodes = ASTNodeManager_num_nodes (self->dst_);
+  size_t num_ids = ASTNodeManager_num_ids (self->dst_);
+  ASTNodeId if_expr = Folder_fold (self, if_then_else->if_expr_);
+  if (Folder_is_bool (self, if_expr))
+    {
+      bool cond
+          = ASTNodeManager_get_kind (self->dst_, if_expr) == AST_LIT_TRUE;
+      ASTNodeManager_truncate (self->dst_, num_nodes, num_ids);
+      self->num_folded_++;
+      return Folder_fold (self, cond ? if_then_else->then_expr_
+                                     : if_then_else->else_expr_);
+    }
+  ASTNodeId then_expr = Folder_fold (self, if_then_else->then_expr_);
+  ASTNodeId else_expr = Folder_fold (self, if_then_else->else_expr_);
+  return ASTNodeManager_push_if_then_else (
+      self->dst_, *ASTNodeManager_get_span (self->src_, node_id), if_expr,
+      then_expr, else_expr);
+}
+
+/* Pushes the child lists of a let, once its vars, types and inits have been
+ * pushed to the stacks past VARS_LEN and EXPRS_LEN, and pops them.  */
+static ASTNodeId
+Folder_push_let (Folder *self, CompactSpan span, size_t vars_len,
+                 size_t exprs_len, ASTNodeId body)
+{
+  ASTNodeId id = ASTNodeManager_push_let (
+      self->dst_, span, Vec_ASTNodeId_cbegin (&self->vars_) + vars_len,
+      Vec_ASTNodeId_cbegin (&self->types_) + vars_len,
+      Vec_ASTNodeId_cbegin (&self->exprs_) + exprs_len,
+      Vec_ASTNodeId_len (&self->vars_) - vars_len, body);
+  Vec_ASTNodeId_resize (&self->vars_, vars_len, 0);
+  Vec_ASTNodeId_resize (&self->types_, vars_len, 0);
+  Vec_ASTNodeId_resize (&self->exprs_, exprs_len, 0);
+  return id;
+}
+
+static ASTNodeId
+Folder_fold_let (Folder *self, ASTNodeId node_id)
+{
+  const ASTLet *let = &ASTNodeManager_get_payload (self->src_, node_id)->let_;
+  const ASTNodeId *vars = ASTNodeManager_get_let_vars (self->src_, let);
+  const ASTNodeId *types = ASTNodeManager_get_let_types (self->src_, let);
+  const ASTNodeId *inits = ASTNodeManager_get_let_inits (self->src_, let);
+  size_t vars_len = Vec_ASTNodeId_len (&self->vars_);
+  size_t exprs_len = Vec_ASTNodeId_len (&self->exprs_);
+  for (uint32_t i = 0; i < let->num_vars_; i++)
+    {
+      Vec_ASTNodeId_push (&self->vars_, Folder_fold (self, vars[i]));
+      Vec_ASTNodeId_push (&self->types_, Folder_fold (self, types[i]));
+      Vec_ASTNodeId_push (&self->exprs_, Folder_fold (self, inits[i]));
+    }
+  ASTNodeId body = Folder_fold (self, let->body_);
+  return Folder_push_let (self, *ASTNodeManager_get_span (self->src_, node_id),
+                          vars_len, exprs_len, body);
+}
+
+static ASTNodeId
+Folder_fold_lambda (Folder *self, ASTNodeId node_id)
+{
+  const ASTLambda *lambda
+      = &ASTNodeManager_get_payload (self->src_, node_id)->lambda_;
+  const ASTNodeId *vars = ASTNodeManager_get_lambda_vars (self->src_, lambda);
+  const ASTNodeId *types
+      = ASTNodeManager_get_lambda_types (self->src_, lambda);
+  size_t vars_len = Vec_ASTNodeId_len (&self->vars_);
+  for (uint32_t i = 0; i < lambda->num_vars_; i++)
+    {
+      Vec_ASTNodeId_push (&self->vars_, Folder_fold (self, vars[i]));
+      Vec_ASTNodeId_push (&self->types_, Folder_fold (self, types[i]));
+    }
+  ASTNodeId body = Folder_fold (self, lambda->body_);
+  ASTNodeId id = ASTNodeManager_push_lambda (
+      self->dst_, *ASTNodeManager_get_span (self->src_, node_id),
+      Vec_ASTNodeId_cbegin (&self->vars_) + vars_len,
+      Vec_ASTNodeId_cbegin (&self->types_) + vars_len,
+      Vec_ASTNodeId_len (&self->vars_) - vars_len, body);
+  Vec_ASTNodeId_resize (&self->vars_, vars_len, 0);
+  Vec_ASTNodeId_resize (&self->types_, vars_len, 0);
+  return id;
+}
+
+static ASTNodeId
+Folder_fold_tuple (Folder *self, ASTNodeId node_id)
+{
+  const ASTTuple *tuple
+      = &ASTNodeManager_get_payload (self->src_, node_id)->tuple_;
+  size_t exprs_len = Vec_ASTNodeId_len (&self->exprs_);
+  for (uint32_t i = 0; i < tuple->num_args_; i++)
+    {
+      Vec_ASTNodeId_push (
+          &self->exprs_,
+          Folder_fold (self,
+                       ASTNodeManager_get_tuple_args (self->src_, tuple)[i]));
+    }
+  ASTNodeId id = ASTNodeManager_push_tuple (
+      self->dst_, *ASTNodeManager_get_span (self->src_, node_id),
+      Vec_ASTNodeId_cbegin (&self->exprs_) + exprs_len,
+      Vec_ASTNodeId_len (&self->exprs_) - exprs_len);
+  Vec_ASTNodeId_resize (&self->exprs_, exprs_len, 0);
+  return id;
+}
+
+/* Looks for the names of PARAMS among the vars of a subtree of SRC.  */
+typedef struct CaptureCheck
+{
+  const Folder *folder_;
+  const ASTNodeId *params_;
+  size_t num_params_;
+  bool captured_;
+} CaptureCheck;
+
+static bool
+CaptureCheck_visit_var (void *check_arg, const ASTNodeManager *ast_mgr,
+                        ASTNodeId id)
+{
+  CaptureCheck *check = check_arg;
+  const SourceFile *file = check->folder_->file_;
+  Span name
+      = SourceFile_get_span (file, *ASTNodeManager_get_span (ast_mgr, id));
+  for (size_t i = 0; i < check->num_params_; i++)
+    {
+      Span param = SourceFile_get_span (
+          file, *ASTNodeManager_get_span (ast_mgr, check->params_[i]));
+      check->captured_ = check->captured_ || Span_eq (&name, &param);
+    }
+  return false;
+}
+
+static bool
+CaptureCheck_visit (void *check, const ASTNodeManager *ast_mgr, ASTNodeId id)
+{
+  (void)ast_mgr;
+  (void)id;
+  return !((CaptureCheck *)check)->captured_;
+}
+
+/* Returns the lambda that CALL applies to as many args as it has params, if
+ * binding them in turn by a let means the same: no arg may name a param
+ * before its own, which the let would bind first.  Returns the null id
+ * otherwise.  Parentheses around the lambda are a one-element tuple.  */
+static ASTNodeId
+Folder_applied_lambda (const Folder *self, const ASTCall *call)
+{
+  ASTNodeId base = call->base_;
+  const ASTPayload *payload = ASTNodeManager_get_payload (self->src_, base);
+  if (ASTNodeManager_get_kind (self->src_, base) == AST_TUPLE
+      && payload->tuple_.num_args_ == 1)
+    {
+      base = ASTNodeManager_get_tuple_args (self->src_, &payload->tuple_)[0];
+    }
+  if (ASTNodeManager_get_kind (self->src_, base) != AST_LAMBDA
+      || ASTNodeManager_get_kind (self->src_, call->tuple_) != AST_TUPLE)
+    {
+      return get_null_ast_node_id ();
+    }
+  const ASTLambda *lambda
+      = &ASTNodeManager_get_payload (self->src_, base)->lambda_;
+  const ASTTuple *tuple
+      = &ASTNodeManager_get_payload (self->src_, call->tuple_)->tuple_;
+  if (lambda->num_vars_ != tuple->num_args_)
+    {
+      return get_null_ast_node_id ();
+    }
+  CaptureCheck check
+      = { .folder_ = self,
+          .params_ = ASTNodeManager_get_lambda_vars (self->src_, lambda),
+          .num_params_ = 0,
+          .captured_ = false };
+  ASTVisitor visitor = ASTVisitor_new (&check);
+  visitor.pre_ = CaptureCheck_visit;
+  visitor.pre_var_ = CaptureCheck_visit_var;
+  ASTWalker walker = ASTWalker_new ();
+  ASTWalker_add (&walker, visitor);
+  for (uint32_t i = 1; i < tuple->num_args_ && !check.captured_; i++)
+    {
+      check.num_params_ = i;
+      ASTWalker_walk (&walker, self->src_,
+                      ASTNodeManager_get_tuple_args (self->src_, tuple)[i]);
+    }
+  ASTWalker_drop (&walker);
+  return check.captured_ ? get_null_ast_node_id () : base;
+}
+
+/* Binds the args of the call NODE_ID to the params of LAMBDA by a let
+ * around its body.  */
+static ASTNodeId
+Folder_beta_reduce (Folder *self, ASTNodeId node_id, ASTNodeId lambda_id)
+{
+  const ASTCall *call
+      = &ASTNodeManager_get_payload (self->src_, node_id)->call_;
+  const ASTLambda *lambda
+      = &ASTNodeManager_get_payload (self->src_, lambda_id)->lambda_;
+  const ASTTuple *tuple
+      = &ASTNodeManager_get_payload (self->src_, call->tuple_)->tuple_;
+  self->num_folded_++;
+  if (!lambda->num_vars_)
+    {
+      return Folder_fold (self, lambda->body_);
+    }
+  const ASTNodeId *vars = ASTNodeManager_get_lambda_vars (self->src_, lambda);
+  const ASTNodeId *types
+      = ASTNodeManager_get_lambda_types (self->src_, lambda);
+  const ASTNodeId *args = ASTNodeManager_get_tuple_args (self->src_, tuple);
+  size_t vars_len = Vec_ASTNodeId_len (&self->vars_);
+  size_t exprs_len = Vec_ASTNodeId_len (&self->exprs_);
+  for (uint32_t i = 0; i < lambda->num_vars_; i++)
+    {
+      Vec_ASTNodeId_push (&self->vars_, Folder_fold (self, vars[i]));
+      Vec_ASTNodeId_push (&self->types_, Folder_fold (self, types[i]));
+      Vec_ASTNodeId_push (&self->exprs_, Folder_fold (self, args[i]));
+    }
+  ASTNodeId body = Folder_fold (self, lambda->body_);
+  return Folder_push_let (self, *ASTNodeManager_get_span (self->src_, node_id),
+                          vars_len, exprs_len, body);
+}
+
+static ASTNodeId
+Folder_fold_call (Folder *self, ASTNodeId node_id)
+{
+  const ASTCall *call
+      = &ASTNodeManager_get_payload (self->src_, node_id)->call_;
+  ASTNodeId lambda = Folder_applied_lambda (self, call);
+  if (!is_null_ast_node_id (lambda))
+    {
+      return Folder_beta_reduce (self, node_id, lambda);
+    }
+  ASTNodeId base = Folder_fold (self, call->base_);
+  ASTNodeId tuple = Folder_fold (self, call->tuple_);
+  return ASTNodeManager_push_call (
+      self->dst_, *ASTNodeManager_get_span (self->src_, node_id), base, tuple);
+}
+
+ASTNodeId
+Folder_fold (Folder *self, ASTNodeId node_id)
+{
+  const CompactSpan *span = ASTNodeManager_get_span (self->src_, node_id);
+  switch (ASTNodeManager_get_kind (self->src_, node_id))
+    {
+    case AST_NULL:
+    case AST_INVALID:
+      {
+        return node_id;
+      }
+    case AST_LIT_TRUE:
+    case AST_LIT_FALSE:
+    case AST_LIT_INTEGER:
+      {
+        return ASTNodeManager_push_lit (
+            self->dst_, *span, ASTNodeManager_get_kind (self->src_, node_id));
+      }
+    case AST_VAR:
+      {
+        return ASTNodeManager_push_var (self->dst_, *span);
+      }
+    case AST_TYPE:
+      {
+        return ASTNodeManager_push_type (self->dst_, *span);
+      }
+    case AST_IF_THEN_ELSE:
+      {
+        return Folder_fold_if_then_else (self, node_id);
+      }
+    case AST_LET:
+      {
+        return Folder_fold_let (self, node_id);
+      }
+    case AST_LAMBDA:
+      {
+        return Folder_fold_lambda (self, node_id);
+      }
+    case AST_TUPLE:
+      {
+        return Folder_fold_tuple (self, node_id);
+      }
+    case AST_CALL:
+      {
+        return Folder_fold_call (self, node_id);
+      }
+    case AST_POSITIVE:
+    case AST_NEGATIVE:
+      {
+        return Folder_fold_unary (self, node_id);
+      }
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MUL:
+    case AST_DIV:
+    case AST_EQ:
+    case AST_NEQ:
+    case AST_LE:
+    case AST_GE:
+    case AST_LT:
+    case AST_GT:
+      {
+        return Folder_fold_binary (self, node_id);
+      }
+    default:
+      {
+        assert (false);
+        return get_invalid_ast_node_id ();
+      }
+    }
+}
+
+#ifdef TESTS
+#include "test.h"
+
+#include <string.h>
+
+#include "diagnostic.h"
+#include "parser.h"
+
+typedef struct FolderTest
+{
+  SourceFile file_;
+  ASTNodeManager ast_mgr_;
+  ASTNodeId node_id_;
+} FolderTest;
+
+static void
+FolderTest_init (FolderTest *self, const char *content)
+{
+  self->file_ = SourceFile_new (String_from_cstring ("test"),
+                                String_from_cstring (content));
+  self->ast_mgr_ = ASTNodeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&self->file_);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  self->node_id_
+      = Parser_parse_file (&self->file_, &diag_mgr, &self->ast_mgr_);
+  DiagnosticManager_drop (&diag_mgr);
+}
+
+static void
+FolderTest_drop (FolderTest *self)
+{
+  SourceFile_drop (&self->file_);
+  ASTNodeManager_drop (&self->ast_mgr_);
+}
+
+/* Whether ID of the folded tree and EXPECTED_ID of EXPECTED are the same
+ * tree, with the same names and the same integers.  */
+static bool
+trees_eq (const Folder *folder, ASTNodeId id, const FolderTest *expected,
+          ASTNodeId expected_id)
+{
+  const ASTNodeManager *ast_mgr = folder->dst_;
+  const ASTNodeManager *expected_mgr = &expected->ast_mgr_;
+  enum ASTKind kind = ASTNodeManager_get_kind (ast_mgr, id);
+  if (kind != ASTNodeManager_get_kind (expected_mgr, expected_id))
+    {
+      return false;
+    }
+  if (kind == AST_VAR || kind == AST_TYPE)
+    {
+      Span name = SourceFile_get_span (folder->file_,
+                                       *ASTNodeManager_get_span (ast_mgr, id));
+      Span expected_name = SourceFile_get_span (
+          &expected->file_,
+          *ASTNodeManager_get_span (expected_mgr, expected_id));
+      return Span_eq (&name, &expected_name);
+    }
+  if (kind == AST_LIT_INTEGER)
+    {
+      BigInt value = Folder_get_integer (folder, id);
+      Span text = SourceFile_get_span (
+          &expected->file_,
+          *ASTNodeManager_get_span (expected_mgr, expected_id));
+      Option_BigInt expected_value
+          = BigInt_from_str (Span_cbegin (&text), Span_len (&text));
+      BigInt expected_int = Option_BigInt_unwrap (&expected_value);
+      bool eq = BigInt_cmp (&value, &expected_int) == 0;
+      BigInt_drop (&value);
+      BigInt_drop (&expected_int);
+      return eq;
+    }
+  Vec_ASTNodeId children = Vec_ASTNodeId_new ();
+  Vec_ASTNodeId expected_children = Vec_ASTNodeId_new ();
+  if (!is_null_ast_node_id (id) && !is_invalid_ast_node_id (id))
+    {
+      ASTNodeManager_push_children (ast_mgr, id, &children);
+      ASTNodeManager_push_children (expected_mgr, expected_id,
+                                    &expected_children);
+    }
+  bool eq = Vec_ASTNodeId_len (&children)
+            == Vec_ASTNodeId_len (&expected_children);
+  for (size_t i = 0; eq && i < Vec_ASTNodeId_len (&children); i++)
+    {
+      eq = trees_eq (folder, Vec_ASTNodeId_cbegin (&children)[i], expected,
+                     Vec_ASTNodeId_cbegin (&expected_children)[i]);
+    }
+  Vec_ASTNodeId_drop (&children);
+  Vec_ASTNodeId_drop (&expected_children);
+  return eq;
+}
+
+/* Counts the differences between CONTENT folded and EXPECTED, which must
+ * not leave behind any node that it folded away.  */
+static size_t
+fold_num_mismatches (const char *content, const char *expected)
+{
+  FolderTest tester;
+  FolderTest expected_tester;
+  FolderTest_init (&tester, content);
+  FolderTest_init (&expected_tester, expected);
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  Folder folder = Folder_new (&tester.ast_mgr_, &tester.file_, &ast_mgr);
+  ASTNodeId id = Folder_fold (&folder, tester.node_id_);
+  size_t num_mismatches
+      = !trees_eq (&folder, id, &expected_tester, expected_tester.node_id_);
+  num_mismatches += ASTNodeManager_num_nodes (&ast_mgr)
+                    != ASTNodeManager_num_nodes (&expected_tester.ast_mgr_);
+  Folder_drop (&folder);
+  ASTNodeManager_drop (&ast_mgr);
+  FolderTest_drop (&tester);
+  FolderTest_drop (&expected_tester);
+  return num_mismatches;
+}
+
+NEO_TEST (test_fold_00)
+{
+  static const char *const cases[][2] = {
+    { "true", "true" },
+    { "if true then x else y", "x" },
+    { "if false then x else if y then 1 else 2", "if y then 1 else 2" },
+    { "1 + 2 * 3", "7" },
+    { "(1 + 2, 10 / 3, 7 - 2 * 3, 2 * 3 / 4)", "(3, 3, 1, 1)" },
+    { "if 1 < 2 then a else b", "a" },
+    { "if 3 <= 2 then a else b", "b" },
+    { "1 + 2 == 3", "true" },
+    { "true == false", "false" },
+    { "true /= false", "true" },
+    { "x + (1 + 2)", "x + (3)" },
+    { "1 / 0", "1 / 0" },
+    { "1 / (2 - 2)", "1 / (0)" },
+    { "f(if true then 1 else x, 2 > 1)", "f(1, true)" },
+    { "let x = if true then 4 + 6 else y in x", "let x = 10 in x" },
+    { "((a, b: Bool) +> if a then b else c)(true, false)",
+      "let a = true, b: Bool = false in if a then b else c" },
+    { "(x: Bool +> x)(1 + 1)", "let x: Bool = 2 in x" },
+    { "(() +> 1 + 1)()", "2" },
+    /* Int64 arithmetic that overflows is left to run, but arithmetic with
+     * an Int is widened.  */
+    { "9223372036854775807 + 1", "9223372036854775807 + 1" },
+    { "4611686018427387904 * 2 / 2 == 1",
+      "4611686018427387904 * 2 / 2 == 1" },
+    { "99999999999999999999 - 99999999999999999998 + 9223372036854775807",
+      "9223372036854775808" },
+    /* The let would bind the first param before the second arg.  */
+    { "((a, b) +> a)(1, a)", "((a, b) +> a)(1, a)" },
+    { "((a, b) +> a)(1)", "((a, b) +> a)(1)" },
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      ASSERT_U64_EQ (fold_num_mismatches (cases[i][0], cases[i][1]), 0);
+    }
+}
+
+NEO_TEST (test_fold_01)
+{
+  FolderTest tester;
+  FolderTest_init (&tester, "(4 - 6, 2 * 3 - 4 * 5 / 3)");
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  Folder folder = Folder_new (&tester.ast_mgr_, &tester.file_, &ast_mgr);
+  ASTNodeId id = Folder_fold (&folder, tester.node_id_);
+  const ASTTuple *tuple = &ASTNodeManager_get_payload (&ast_mgr, id)->tuple_;
+  static const char *const values[] = { "-2", "0" };
+  for (uint32_t i = 0; i < tuple->num_args_; i++)
+    {
+      BigInt value = Folder_get_integer (
+          &folder, ASTNodeManager_get_tuple_args (&ast_mgr, tuple)[i]);
+      Option_BigInt expected = BigInt_from_str (values[i], strlen (values[i]));
+      BigInt expected_value = Option_BigInt_unwrap (&expected);
+      ASSERT_I64_EQ (BigInt_cmp (&value, &expected_value), 0);
+      BigInt_drop (&value);
+      BigInt_drop (&expected_value);
+    }
+  ASSERT_U64_EQ (folder.num_folded_, 5);
+  Folder_drop (&folder);
+  ASTNodeManager_drop (&ast_mgr);
+  FolderTest_drop (&tester);
+}
+
+NEO_TESTS (folder_tests, test_fold_00, test_fold_01)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+#include "diagnostic.h"
+#include "parser.h"
+#include "type_checker.h"
+
+/* Folds SOURCE, which it takes.  If CHECK, the folded tree is checked by a
+ * sweep instead, to be set against the check of the tree as parsed.  */
+static void
+fold_bench (Bencher *bencher_, String source, bool check)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"), source);
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  ASTNodeId node_id = Parser_parse_file (&file, &diag_mgr, &ast_mgr);
+  ASTNodeManager folded = ASTNodeManager_new ();
+  size_t num_folded = 0;
+  if (check)
+    {
+      Folder folder = Folder_new (&ast_mgr, &file, &folded);
+      ASTNodeId folded_id = Folder_fold (&folder, node_id);
+      num_folded = folder.num_folded_;
+      Folder_drop (&folder);
+      BENCH_ITER
+      {
+        TypeManager type_mgr = TypeManager_new ();
+        TypeChecker checker
+            = TypeChecker_new (&folded, &diag_mgr, &type_mgr);
+        ASTNodeIdToTypeIdMap node_type_map
+            = TypeChecker_check_sweep (&checker, folded_id);
+        ASTNodeIdToTypeIdMap_drop (&node_type_map);
+        TypeManager_drop (&type_mgr);
+      }
+    }
+  else
+    {
+      BENCH_ITER
+      {
+        ASTNodeManager_drop (&folded);
+        folded = ASTNodeManager_new ();
+        Folder folder = Folder_new (&ast_mgr, &file, &folded);
+        Folder_fold (&folder, node_id);
+        num_folded = folder.num_folded_;
+        Folder_drop (&folder);
+      }
+    }
+  Bencher_report_u64 (bencher_, "nodes", ASTNodeManager_num_nodes (&ast_mgr));
+  Bencher_report_u64 (bencher_, "folded nodes",
+                      ASTNodeManager_num_nodes (&folded));
+  Bencher_report_u64 (bencher_, "folded", num_folded);
+  DiagnosticManager_drop (&diag_mgr);
+  ASTNodeManager_drop (&folded);
+  ASTNodeManager_drop (&ast_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCH (bench_fold_00)
+{
+  fold_bench (bencher_, bench_gen_source (1 << 20, 42), false);
+}
+
+NEO_BENCH (bench_fold_let_00)
+{
+  fold_bench (bencher_, bench_gen_let_source (1000, 4, 42), false);
+}
+
+NEO_BENCH (bench_fold_check_sweep_let_00)
+{
+  fold_bench (bencher_, bench_gen_let_source (1000, 4, 42), true);
+}
+
+/* Returns a sum of NUM_TERMS products, of literals that are Int64 unless
+ * WIDE, which makes them Int.  */
+static String
+gen_sum_source (size_t num_terms, bool wide)
+{
+  String source = String_new ();
+  for (size_t i = 0; i < num_terms; i++)
+    {
+      if (i)
+        {
+          String_push_cstring (&source, " + ");
+        }
+      if (wide)
+        {
+          String_push_cstring (&source, "100000000000000000000");
+        }
+      String_push_u64 (&source, i);
+      String_push_cstring (&source, " * 3");
+    }
+  return source;
+}
+
+NEO_BENCH (bench_fold_int64_00)
+{
+  fold_bench (bencher_, gen_sum_source (1 << 12, false), false);
+}
+
+NEO_BENCH (bench_fold_int_00)
+{
+  fold_bench (bencher_, gen_sum_source (1 << 12, true), false);
+}
+
+NEO_BENCHES (folder_benches, bench_fold_00, bench_fold_let_00,
+             bench_fold_check_sweep_let_00, bench_fold_int64_00,
+             bench_fold_int_00)
+#endif
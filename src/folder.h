@@ -0,0 +1,55 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_FOLDER_H
+#define NEO_FOLDER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast_node.h"
+#include "big_int.h"
+#include "span.h"
+#include "vec_macro.h"
+
+/* Copies a tree into another manager with its closed subexpressions
+ * evaluated: Bool and integer operators on literals, ifs on literal
+ * conditions, and lambdas applied where they are written, which become
+ * lets.  The tree should have checked clean, since the branch that is not
+ * taken goes with its errors.  Folded nodes keep the span of what they
+ * replace, and a folded integer keeps in DST its value and whether it is
+ * an Int64, so that the folded tree checks as the tree did.  Operators on
+ * Int64 literals are evaluated in Int64, and left to run if they overflow,
+ * as are divisions by zero.  */
+typedef struct Folder
+{
+  const ASTNodeManager *src_;
+  const SourceFile *file_;
+  ASTNodeManager *dst_;
+  /* Stacks of the child lists being copied, shared by nested nodes, as in
+   * the parser.  */
+  Vec_ASTNodeId vars_;
+  Vec_ASTNodeId types_;
+  Vec_ASTNodeId exprs_;
+  /* Operators, ifs and calls done away with.  */
+  size_t num_folded_;
+} Folder;
+
+/* FILE holds the text of SRC, and so of the literals in DST.  */
+Folder Folder_new (const ASTNodeManager *src, const SourceFile *file,
+                   ASTNodeManager *dst);
+void Folder_drop (Folder *self);
+/* Returns the id in DST of NODE_ID of SRC, folded.  */
+ASTNodeId Folder_fold (Folder *self, ASTNodeId node_id);
+
+#ifdef TESTS
+#include "test.h"
+Tests folder_tests ();
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+Benches folder_benches ();
+#endif
+
+#endif
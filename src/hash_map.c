@@ -0,0 +1,194 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "hash_map.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hash_map_macro.h"
+
+uint64_t
+u64_hash (const uint64_t *n)
+{
+  return neo_hash_u64 (*n);
+}
+
+bool
+u64_eq (const uint64_t *x, const uint64_t *y)
+{
+  return *x == *y;
+}
+
+NEO_IMPL_HASHMAP (u64_u64, uint64_t, uint64_t, u64_hash, u64_eq)
+NEO_IMPL_HASHSET (u64, uint64_t, u64_hash, u64_eq)
+
+#ifdef TESTS
+#include "test.h"
+
+NEO_TEST (test_hash_map_00)
+{
+  HashMap_u64_u64 map = HashMap_u64_u64_new ();
+  uint64_t key = 1;
+  ASSERT_U64_EQ (HashMap_u64_u64_get (&map, &key) == NULL, true);
+  ASSERT_U64_EQ (HashMap_u64_u64_remove (&map, &key), false);
+  for (uint64_t i = 0; i < 1000; i++)
+    {
+      ASSERT_U64_EQ (HashMap_u64_u64_insert (&map, i, i * i), true);
+    }
+  ASSERT_U64_EQ (HashMap_u64_u64_insert (&map, 7, 0), false);
+  ASSERT_U64_EQ (HashMap_u64_u64_len (&map), 1000);
+  for (uint64_t i = 0; i < 1000; i++)
+    {
+      const uint64_t *value = HashMap_u64_u64_cget (&map, &i);
+      ASSERT_U64_EQ (value != NULL, true);
+      ASSERT_U64_EQ (*value, i == 7 ? 0 : i * i);
+    }
+  key = 1000;
+  ASSERT_U64_EQ (HashMap_u64_u64_contains (&map, &key), false);
+  ASSERT_U64_EQ (*HashMap_u64_u64_get_or_insert (&map, 3, 5), 9);
+  ASSERT_U64_EQ (*HashMap_u64_u64_get_or_insert (&map, 1000, 5), 5);
+  /* At most 7 of every 8 slots are full.  */
+  ASSERT_U64_EQ (HashMap_u64_u64_capacity (&map), 2048);
+  HashMap_u64_u64_drop (&map);
+}
+
+NEO_TEST (test_hash_map_01)
+{
+  /* Keys removed and inserted over and over leave deleted slots behind,
+   * which must neither hide keys nor grow the table.  */
+  HashMap_u64_u64 map = HashMap_u64_u64_with_capacity (100);
+  size_t capacity = HashMap_u64_u64_capacity (&map);
+  for (uint64_t i = 0; i < 100000; i++)
+    {
+      HashMap_u64_u64_insert (&map, i, i);
+      if (i >= 50)
+        {
+          uint64_t old = i - 50;
+          ASSERT_U64_EQ (HashMap_u64_u64_remove (&map, &old), true);
+        }
+    }
+  ASSERT_U64_EQ (HashMap_u64_u64_len (&map), 50);
+  ASSERT_U64_EQ (HashMap_u64_u64_capacity (&map), capacity);
+  uint64_t sum = 0;
+  size_t index = 0;
+  const HashMapEntry_u64_u64 *entry;
+  while ((entry = HashMap_u64_u64_next (&map, &index)))
+    {
+      ASSERT_U64_EQ (entry->key_, entry->value_);
+      sum += entry->key_;
+    }
+  ASSERT_U64_EQ (sum, 50 * 99950 + 50 * 49 / 2);
+  HashMap_u64_u64_clear (&map);
+  ASSERT_U64_EQ (HashMap_u64_u64_is_empty (&map), true);
+  uint64_t key = 99999;
+  ASSERT_U64_EQ (HashMap_u64_u64_contains (&map, &key), false);
+  HashMap_u64_u64_drop (&map);
+}
+
+NEO_TEST (test_hash_set_00)
+{
+  HashSet_u64 set = HashSet_u64_new ();
+  for (uint64_t i = 0; i < 300; i++)
+    {
+      ASSERT_U64_EQ (HashSet_u64_insert (&set, i % 100), i < 100);
+    }
+  ASSERT_U64_EQ (HashSet_u64_len (&set), 100);
+  uint64_t key = 42;
+  ASSERT_U64_EQ (HashSet_u64_remove (&set, &key), true);
+  ASSERT_U64_EQ (HashSet_u64_contains (&set, &key), false);
+  key = 43;
+  ASSERT_U64_EQ (HashSet_u64_contains (&set, &key), true);
+  HashSet_u64_drop (&set);
+}
+
+NEO_TESTS (hash_map_tests, test_hash_map_00, test_hash_map_01,
+           test_hash_set_00)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+#define HASH_MAP_BENCH_LEN (1 << 16)
+
+/* Spreads the keys like pointers or offsets would be.  */
+static uint64_t
+bench_key (uint64_t i)
+{
+  return i * 40 + 8;
+}
+
+static HashMap_u64_u64
+bench_map ()
+{
+  HashMap_u64_u64 map = HashMap_u64_u64_new ();
+  for (uint64_t i = 0; i < HASH_MAP_BENCH_LEN; i++)
+    {
+      HashMap_u64_u64_insert (&map, bench_key (i), i);
+    }
+  return map;
+}
+
+NEO_BENCH (bench_hash_map_insert_00)
+{
+  size_t num_keys = 0;
+  BENCH_ITER
+  {
+    HashMap_u64_u64 map = bench_map ();
+    num_keys += HashMap_u64_u64_len (&map);
+    HashMap_u64_u64_drop (&map);
+  }
+  Bencher_report_u64 (bencher_, "keys", num_keys);
+}
+
+NEO_BENCH (bench_hash_map_lookup_hit_00)
+{
+  HashMap_u64_u64 map = bench_map ();
+  uint64_t sum = 0;
+  BENCH_ITER
+  {
+    for (uint64_t i = 0; i < HASH_MAP_BENCH_LEN; i++)
+      {
+        uint64_t key = bench_key (i);
+        sum += *HashMap_u64_u64_cget (&map, &key);
+      }
+  }
+  Bencher_report_u64 (bencher_, "sum", sum);
+  HashMap_u64_u64_drop (&map);
+}
+
+NEO_BENCH (bench_hash_map_lookup_miss_00)
+{
+  HashMap_u64_u64 map = bench_map ();
+  size_t num_found = 0;
+  BENCH_ITER
+  {
+    for (uint64_t i = 0; i < HASH_MAP_BENCH_LEN; i++)
+      {
+        uint64_t key = bench_key (i) + 1;
+        num_found += HashMap_u64_u64_contains (&map, &key);
+      }
+  }
+  Bencher_report_u64 (bencher_, "found", num_found);
+  HashMap_u64_u64_drop (&map);
+}
+
+NEO_BENCH (bench_hash_map_erase_00)
+{
+  size_t num_removed = 0;
+  BENCH_ITER
+  {
+    HashMap_u64_u64 map = bench_map ();
+    for (uint64_t i = 0; i < HASH_MAP_BENCH_LEN; i++)
+      {
+        uint64_t key = bench_key (i);
+        num_removed += HashMap_u64_u64_remove (&map, &key);
+      }
+    HashMap_u64_u64_drop (&map);
+  }
+  Bencher_report_u64 (bencher_, "removed", num_removed);
+}
+
+NEO_BENCHES (hash_map_benches, bench_hash_map_insert_00,
+             bench_hash_map_lookup_hit_00, bench_hash_map_lookup_miss_00,
+             bench_hash_map_erase_00)
+#endif
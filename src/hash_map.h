@@ -0,0 +1,27 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_HASH_MAP_H
+#define NEO_HASH_MAP_H
+
+#include "hash_map_macro.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+uint64_t u64_hash (const uint64_t *n);
+bool u64_eq (const uint64_t *x, const uint64_t *y);
+
+NEO_DECL_HASHMAP (u64_u64, uint64_t, uint64_t)
+NEO_DECL_HASHSET (u64, uint64_t)
+
+#ifdef TESTS
+#include "test.h"
+Tests hash_map_tests ();
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+Benches hash_map_benches ();
+#endif
+
+#endif
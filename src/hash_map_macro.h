@@ -0,0 +1,452 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_HASH_MAP_MACRO_H
+#define NEO_HASH_MAP_MACRO_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Open addressing in the style of Swiss tables.  Every slot has a control
+ * byte, which is empty, deleted, or the low 7 bits of the hash of its key.
+ * Probing loads a group of control bytes at once and compares all of them
+ * with those 7 bits, so that keys are only compared on a likely match.  The
+ * other bits of the hash pick the group to start from.  */
+
+#define NEO_HASH_CTRL_EMPTY ((uint8_t)0x80)
+#define NEO_HASH_CTRL_DELETED ((uint8_t)0xfe)
+
+#ifdef __SSE2__
+#define NEO_HASH_GROUP_WIDTH (16)
+
+/* One bit for each slot in a group that matches.  */
+typedef uint32_t NeoHashMask;
+
+static inline NeoHashMask
+neo_hash_group_match (const uint8_t *ctrl, uint8_t h2)
+{
+  __m128i group = _mm_loadu_si128 ((const __m128i *)ctrl);
+  return _mm_movemask_epi8 (_mm_cmpeq_epi8 (group, _mm_set1_epi8 (h2)));
+}
+
+static inline NeoHashMask
+neo_hash_group_match_empty (const uint8_t *ctrl)
+{
+  return neo_hash_group_match (ctrl, NEO_HASH_CTRL_EMPTY);
+}
+
+static inline NeoHashMask
+neo_hash_group_match_free (const uint8_t *ctrl)
+{
+  /* Only empty and deleted bytes have their high bit set.  */
+  return _mm_movemask_epi8 (_mm_loadu_si128 ((const __m128i *)ctrl));
+}
+
+/* Returns the index of the lowest match and clears it.  */
+static inline size_t
+neo_hash_mask_next (NeoHashMask *mask)
+{
+  size_t index = __builtin_ctz (*mask);
+  *mask &= *mask - 1;
+  return index;
+}
+#else
+#define NEO_HASH_GROUP_WIDTH (8)
+
+/* The high bit of each byte of a group that matches.  */
+typedef uint64_t NeoHashMask;
+
+#define NEO_HASH_LSBS (0x0101010101010101ull)
+#define NEO_HASH_MSBS (0x8080808080808080ull)
+
+static inline uint64_t
+neo_hash_group_load (const uint8_t *ctrl)
+{
+  uint64_t group;
+  memcpy (&group, ctrl, sizeof (group));
+  return group;
+}
+
+/* May match a full byte next to a real match, whose key is then compared in
+ * vain, but never an empty or deleted one.  */
+static inline NeoHashMask
+neo_hash_group_match (const uint8_t *ctrl, uint8_t h2)
+{
+  uint64_t x = neo_hash_group_load (ctrl) ^ (NEO_HASH_LSBS * h2);
+  return (x - NEO_HASH_LSBS) & ~x & NEO_HASH_MSBS;
+}
+
+static inline NeoHashMask
+neo_hash_group_match_empty (const uint8_t *ctrl)
+{
+  /* Deleted bytes have bit 1 set, empty ones do not.  */
+  uint64_t group = neo_hash_group_load (ctrl);
+  return group & ~(group << 6) & NEO_HASH_MSBS;
+}
+
+static inline NeoHashMask
+neo_hash_group_match_free (const uint8_t *ctrl)
+{
+  return neo_hash_group_load (ctrl) & NEO_HASH_MSBS;
+}
+
+static inline size_t
+neo_hash_mask_next (NeoHashMask *mask)
+{
+  size_t index = __builtin_ctzll (*mask) / 8;
+  *mask &= *mask - 1;
+  return index;
+}
+#endif
+
+/* Mixes the bits of N, so that both the low 7 bits and the rest of the hash
+ * depend on all of them.  */
+static inline uint64_t
+neo_hash_u64 (uint64_t n)
+{
+  n ^= n >> 33;
+  n *= 0xff51afd7ed558ccdull;
+  n ^= n >> 33;
+  n *= 0xc4ceb9fe1a85ec53ull;
+  n ^= n >> 33;
+  return n;
+}
+
+static inline uint64_t
+neo_hash_bytes (const void *bytes, size_t len)
+{
+  /* FNV-1a, finished by a mix.  */
+  const unsigned char *ptr = bytes;
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < len; i++)
+    {
+      hash = (hash ^ ptr[i]) * 0x100000001b3ull;
+    }
+  return neo_hash_u64 (hash);
+}
+
+/* The table under both hash maps and hash sets.  E is the type of a slot,
+ * whose first member is the key K.  */
+#define NEO_DECL_HASH_TABLE_(P, E, K)                                         \
+  typedef struct P                                                            \
+  {                                                                           \
+    /* CAPACITY bytes, followed by a copy of the first group, so that a       \
+     * group can be loaded at any slot.  */                                   \
+    uint8_t *ctrl_;                                                           \
+    E *slots_;                                                                \
+    /* 0, or a power of 2 no less than the group width.  */                   \
+    size_t capacity_;                                                         \
+    size_t len_;                                                              \
+    /* How many more keys fit before the table is rebuilt.  */                \
+    size_t growth_left_;                                                      \
+  } P;                                                                        \
+                                                                              \
+  P P##_new ();                                                               \
+  P P##_with_capacity (size_t capacity);                                      \
+  void P##_drop (P *self);                                                    \
+  bool P##_is_empty (const P *self);                                          \
+  size_t P##_len (const P *self);                                             \
+  size_t P##_capacity (const P *self);                                        \
+  void P##_clear (P *self);                                                   \
+  void P##_reserve (P *self, size_t additional);                              \
+  bool P##_contains (const P *self, K const *key);                            \
+  bool P##_remove (P *self, K const *key);                                    \
+  /* Returns the slot after *INDEX that holds a key, in no particular         \
+   * order, or NULL past the last one.  Start with *INDEX at 0.  */           \
+  E const *P##_next (const P *self, size_t *index);
+
+#define NEO_IMPL_HASH_TABLE_(P, E, K, HASH, EQ)                               \
+  /* Keeps at most 7 of every 8 slots full.  */                               \
+  static size_t P##_max_len_ (size_t capacity)                                \
+  {                                                                           \
+    return capacity - capacity / 8;                                           \
+  }                                                                           \
+                                                                              \
+  static void P##_set_ctrl_ (P *self, size_t index, uint8_t ctrl)             \
+  {                                                                           \
+    self->ctrl_[index] = ctrl;                                                \
+    if (index < NEO_HASH_GROUP_WIDTH)                                         \
+      {                                                                       \
+        self->ctrl_[self->capacity_ + index] = ctrl;                          \
+      }                                                                       \
+  }                                                                           \
+                                                                              \
+  /* Returns the first free slot on the probe sequence of HASH.  */           \
+  static size_t P##_find_free_ (const P *self, uint64_t hash)                 \
+  {                                                                           \
+    size_t mask = self->capacity_ - 1;                                        \
+    size_t pos = (hash >> 7) & mask;                                          \
+    size_t stride = 0;                                                        \
+    for (;;)                                                                  \
+      {                                                                       \
+        NeoHashMask free = neo_hash_group_match_free (self->ctrl_ + pos);     \
+        if (free)                                                             \
+          {                                                                   \
+            return (pos + neo_hash_mask_next (&free)) & mask;                 \
+          }                                                                   \
+        stride += NEO_HASH_GROUP_WIDTH;                                       \
+        pos = (pos + stride) & mask;                                          \
+      }                                                                       \
+  }                                                                           \
+                                                                              \
+  /* Rebuilds the table with CAPACITY slots, which also drops the deleted     \
+   * ones.  */                                                                \
+  static void P##_rehash_ (P *self, size_t capacity)                          \
+  {                                                                           \
+    P old = *self;                                                            \
+    self->capacity_ = capacity;                                               \
+    self->ctrl_ = malloc (capacity + NEO_HASH_GROUP_WIDTH);                   \
+    self->slots_ = malloc (sizeof (E) * capacity);                            \
+    if (self->ctrl_ == NULL || self->slots_ == NULL)                          \
+      {                                                                       \
+        abort ();                                                             \
+      }                                                                       \
+    memset (self->ctrl_, NEO_HASH_CTRL_EMPTY,                                 \
+            capacity + NEO_HASH_GROUP_WIDTH);                                 \
+    for (size_t i = 0; i < old.capacity_; i++)                                \
+      {                                                                       \
+        if (!(old.ctrl_[i] & 0x80))                                           \
+          {                                                                   \
+            uint64_t hash = HASH (&old.slots_[i].key_);                       \
+            size_t index = P##_find_free_ (self, hash);                       \
+            P##_set_ctrl_ (self, index, hash & 0x7f);                         \
+            self->slots_[index] = old.slots_[i];                              \
+          }                                                                   \
+      }                                                                       \
+    self->growth_left_ = P##_max_len_ (capacity) - self->len_;                \
+    free (old.ctrl_);                                                         \
+    free (old.slots_);                                                        \
+  }                                                                           \
+                                                                              \
+  /* Returns the slot of KEY, or NULL if there is none.  */                   \
+  static E *P##_find_ (const P *self, K const *key, uint64_t hash)            \
+  {                                                                           \
+    if (self->capacity_ == 0)                                                 \
+      {                                                                       \
+        return NULL;                                                          \
+      }                                                                       \
+    size_t mask = self->capacity_ - 1;                                        \
+    size_t pos = (hash >> 7) & mask;                                          \
+    size_t stride = 0;                                                        \
+    for (;;)                                                                  \
+      {                                                                       \
+        const uint8_t *group = self->ctrl_ + pos;                             \
+        NeoHashMask match = neo_hash_group_match (group, hash & 0x7f);        \
+        while (match)                                                         \
+          {                                                                   \
+            size_t index = (pos + neo_hash_mask_next (&match)) & mask;        \
+            if (EQ (&self->slots_[index].key_, key))                          \
+              {                                                               \
+                return self->slots_ + index;                                  \
+              }                                                               \
+          }                                                                   \
+        /* The key would have gone into the empty slot.  */                   \
+        if (neo_hash_group_match_empty (group))                               \
+          {                                                                   \
+            return NULL;                                                      \
+          }                                                                   \
+        stride += NEO_HASH_GROUP_WIDTH;                                       \
+        pos = (pos + stride) & mask;                                          \
+      }                                                                       \
+  }                                                                           \
+                                                                              \
+  /* Returns the slot of KEY, which is claimed for it, with nothing but the   \
+   * key written, if there was none.  */                                      \
+  static E *P##_find_or_insert_ (P *self, K key, bool *inserted)              \
+  {                                                                           \
+    uint64_t hash = HASH (&key);                                              \
+    E *slot = P##_find_ (self, &key, hash);                                   \
+    *inserted = slot == NULL;                                                 \
+    if (slot)                                                                 \
+      {                                                                       \
+        return slot;                                                          \
+      }                                                                       \
+    size_t index = self->capacity_ ? P##_find_free_ (self, hash) : 0;         \
+    if (self->capacity_ == 0                                                  \
+        || (self->growth_left_ == 0                                           \
+            && self->ctrl_[index] == NEO_HASH_CTRL_EMPTY))                    \
+      {                                                                       \
+        P##_reserve (self, 1);                                                \
+        index = P##_find_free_ (self, hash);                                  \
+      }                                                                       \
+    if (self->ctrl_[index] == NEO_HASH_CTRL_EMPTY)                            \
+      {                                                                       \
+        self->growth_left_--;                                                 \
+      }                                                                       \
+    P##_set_ctrl_ (self, index, hash & 0x7f);                                 \
+    self->len_++;                                                             \
+    self->slots_[index].key_ = key;                                           \
+    return self->slots_ + index;                                              \
+  }                                                                           \
+                                                                              \
+  P P##_new ()                                                                \
+  {                                                                           \
+    return (P){ .ctrl_ = NULL,                                                \
+                .slots_ = NULL,                                               \
+                .capacity_ = 0,                                               \
+                .len_ = 0,                                                    \
+                .growth_left_ = 0 };                                          \
+  }                                                                           \
+                                                                              \
+  P P##_with_capacity (size_t capacity)                                       \
+  {                                                                           \
+    P res = P##_new ();                                                       \
+    P##_reserve (&res, capacity);                                             \
+    return res;                                                               \
+  }                                                                           \
+                                                                              \
+  void P##_drop (P *self)                                                     \
+  {                                                                           \
+    free (self->ctrl_);                                                       \
+    free (self->slots_);                                                      \
+    *self = P##_new ();                                                       \
+  }                                                                           \
+                                                                              \
+  bool P##_is_empty (const P *self) { return self->len_ == 0; }               \
+                                                                              \
+  size_t P##_len (const P *self) { return self->len_; }                       \
+                                                                              \
+  size_t P##_capacity (const P *self) { return self->capacity_; }             \
+                                                                              \
+  void P##_clear (P *self)                                                    \
+  {                                                                           \
+    if (self->capacity_)                                                      \
+      {                                                                       \
+        memset (self->ctrl_, NEO_HASH_CTRL_EMPTY,                             \
+                self->capacity_ + NEO_HASH_GROUP_WIDTH);                      \
+      }                                                                       \
+    self->len_ = 0;                                                           \
+    self->growth_left_ = P##_max_len_ (self->capacity_);                      \
+  }                                                                           \
+                                                                              \
+  /* Makes room for ADDITIONAL more keys.  A full table of deleted slots is   \
+   * rebuilt in place rather than grown.  */                                  \
+  void P##_reserve (P *self, size_t additional)                               \
+  {                                                                           \
+    if (additional <= self->growth_left_)                                     \
+      {                                                                       \
+        return;                                                               \
+      }                                                                       \
+    size_t capacity = NEO_HASH_GROUP_WIDTH;                                   \
+    while (P##_max_len_ (capacity) < self->len_ + additional)                 \
+      {                                                                       \
+        capacity *= 2;                                                        \
+      }                                                                       \
+    P##_rehash_ (self, capacity < self->capacity_ ? self->capacity_           \
+                                                  : capacity);                \
+  }                                                                           \
+                                                                              \
+  bool P##_contains (const P *self, K const *key)                             \
+  {                                                                           \
+    return P##_find_ (self, key, HASH (key)) != NULL;                         \
+  }                                                                           \
+                                                                              \
+  bool P##_remove (P *self, K const *key)                                     \
+  {                                                                           \
+    E *slot = P##_find_ (self, key, HASH (key));                              \
+    if (slot == NULL)                                                         \
+      {                                                                       \
+        return false;                                                         \
+      }                                                                       \
+    /* Probes for other keys may have passed this slot, so it cannot be       \
+     * emptied.  */                                                           \
+    P##_set_ctrl_ (self, slot - self->slots_, NEO_HASH_CTRL_DELETED);         \
+    self->len_--;                                                             \
+    return true;                                                              \
+  }                                                                           \
+                                                                              \
+  E const *P##_next (const P *self, size_t *index)                            \
+  {                                                                           \
+    while (*index < self->capacity_)                                          \
+      {                                                                       \
+        size_t i = (*index)++;                                                \
+        if (!(self->ctrl_[i] & 0x80))                                         \
+          {                                                                   \
+            return self->slots_ + i;                                          \
+          }                                                                   \
+      }                                                                       \
+    return NULL;                                                              \
+  }
+
+/* A map from K to V.  HASH and EQ, given to the implementation, take
+ * pointers to keys.  */
+#define NEO_DECL_HASHMAP(N, K, V)                                             \
+  typedef struct HashMapEntry_##N                                             \
+  {                                                                           \
+    K key_;                                                                   \
+    V value_;                                                                 \
+  } HashMapEntry_##N;                                                         \
+                                                                              \
+  NEO_DECL_HASH_TABLE_ (HashMap_##N, HashMapEntry_##N, K)                     \
+                                                                              \
+  V *HashMap_##N##_get (HashMap_##N *self, K const *key);                     \
+  V const *HashMap_##N##_cget (const HashMap_##N *self, K const *key);        \
+  /* Returns true if KEY was not in the map before.  */                       \
+  bool HashMap_##N##_insert (HashMap_##N *self, K key, V value);              \
+  /* Returns the value of KEY, which is VALUE if KEY was not in the map.  */  \
+  V *HashMap_##N##_get_or_insert (HashMap_##N *self, K key, V value);
+
+#define NEO_IMPL_HASHMAP(N, K, V, HASH, EQ)                                   \
+  NEO_IMPL_HASH_TABLE_ (HashMap_##N, HashMapEntry_##N, K, HASH, EQ)           \
+                                                                              \
+  V *HashMap_##N##_get (HashMap_##N *self, K const *key)                      \
+  {                                                                           \
+    HashMapEntry_##N *entry = HashMap_##N##_find_ (self, key, HASH (key));    \
+    return entry ? &entry->value_ : NULL;                                     \
+  }                                                                           \
+                                                                              \
+  V const *HashMap_##N##_cget (const HashMap_##N *self, K const *key)         \
+  {                                                                           \
+    HashMapEntry_##N *entry = HashMap_##N##_find_ (self, key, HASH (key));    \
+    return entry ? &entry->value_ : NULL;                                     \
+  }                                                                           \
+                                                                              \
+  bool HashMap_##N##_insert (HashMap_##N *self, K key, V value)               \
+  {                                                                           \
+    bool inserted;                                                            \
+    HashMap_##N##_find_or_insert_ (self, key, &inserted)->value_ = value;     \
+    return inserted;                                                          \
+  }                                                                           \
+                                                                              \
+  V *HashMap_##N##_get_or_insert (HashMap_##N *self, K key, V value)          \
+  {                                                                           \
+    bool inserted;                                                            \
+    HashMapEntry_##N *entry                                                   \
+        = HashMap_##N##_find_or_insert_ (self, key, &inserted);               \
+    if (inserted)                                                             \
+      {                                                                       \
+        entry->value_ = value;                                                \
+      }                                                                       \
+    return &entry->value_;                                                    \
+  }
+
+/* A set of K, hashed and compared like the keys of a map.  */
+#define NEO_DECL_HASHSET(N, K)                                                \
+  typedef struct HashSetEntry_##N                                             \
+  {                                                                           \
+    K key_;                                                                   \
+  } HashSetEntry_##N;                                                         \
+                                                                              \
+  NEO_DECL_HASH_TABLE_ (HashSet_##N, HashSetEntry_##N, K)                     \
+                                                                              \
+  /* Returns true if KEY was not in the set before.  */                       \
+  bool HashSet_##N##_insert (HashSet_##N *self, K key);
+
+#define NEO_IMPL_HASHSET(N, K, HASH, EQ)                                      \
+  NEO_IMPL_HASH_TABLE_ (HashSet_##N, HashSetEntry_##N, K, HASH, EQ)           \
+                                                                              \
+  bool HashSet_##N##_insert (HashSet_##N *self, K key)                        \
+  {                                                                           \
+    bool inserted;                                                            \
+    HashSet_##N##_find_or_insert_ (self, key, &inserted);                     \
+    return inserted;                                                          \
+  }
+
+#endif
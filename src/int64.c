@@ -0,0 +1,148 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "int64.h"
+
+bool
+Int64_from_str (const char *src, size_t len, int64_t *result)
+{
+  const char *src_cend = src + len;
+  bool negative = false;
+  if (src < src_cend && (*src == '+' || *src == '-'))
+    {
+      negative = *src == '-';
+      src++;
+    }
+  if (src == src_cend)
+    {
+      return false;
+    }
+  /* Accumulated negated, since INT64_MIN has no positive counterpart.  */
+  int64_t value = 0;
+  for (; src < src_cend; src++)
+    {
+      if (*src < '0' || *src > '9')
+        {
+          return false;
+        }
+      if (__builtin_mul_overflow (value, 10, &value)
+          || __builtin_sub_overflow (value, *src - '0', &value))
+        {
+          return false;
+        }
+    }
+  if (!negative && value == INT64_MIN)
+    {
+      return false;
+    }
+  *result = negative ? value : -value;
+  return true;
+}
+
+bool
+Int64_neg (int64_t value, int64_t *result)
+{
+  return !__builtin_sub_overflow ((int64_t)0, value, result);
+}
+
+bool
+Int64_add (int64_t left, int64_t right, int64_t *result)
+{
+  return !__builtin_add_overflow (left, right, result);
+}
+
+bool
+Int64_sub (int64_t left, int64_t right, int64_t *result)
+{
+  return !__builtin_sub_overflow (left, right, result);
+}
+
+bool
+Int64_mul (int64_t left, int64_t right, int64_t *result)
+{
+  return !__builtin_mul_overflow (left, right, result);
+}
+
+bool
+Int64_div (int64_t left, int64_t right, int64_t *result)
+{
+  if (right == 0 || (left == INT64_MIN && right == -1))
+    {
+      return false;
+    }
+  *result = left / right;
+  return true;
+}
+
+#ifdef TESTS
+#include "test.h"
+
+#include <string.h>
+
+static size_t
+from_str_num_mismatches (const char *src, bool expect_ok, int64_t expect)
+{
+  int64_t value = 0;
+  bool ok = Int64_from_str (src, strlen (src), &value);
+  return ok != expect_ok || (ok && value != expect);
+}
+
+NEO_TEST (test_from_str_00)
+{
+  size_t num_mismatches = 0;
+  num_mismatches += from_str_num_mismatches ("0", true, 0);
+  num_mismatches += from_str_num_mismatches ("42", true, 42);
+  num_mismatches += from_str_num_mismatches ("-42", true, -42);
+  num_mismatches += from_str_num_mismatches ("+7", true, 7);
+  num_mismatches += from_str_num_mismatches ("007", true, 7);
+  num_mismatches
+      += from_str_num_mismatches ("9223372036854775807", true, INT64_MAX);
+  num_mismatches
+      += from_str_num_mismatches ("-9223372036854775808", true, INT64_MIN);
+  num_mismatches += from_str_num_mismatches ("9223372036854775808", false, 0);
+  num_mismatches
+      += from_str_num_mismatches ("-9223372036854775809", false, 0);
+  num_mismatches
+      += from_str_num_mismatches ("100000000000000000000", false, 0);
+  num_mismatches += from_str_num_mismatches ("", false, 0);
+  num_mismatches += from_str_num_mismatches ("-", false, 0);
+  num_mismatches += from_str_num_mismatches ("1a", false, 0);
+  ASSERT_U64_EQ (num_mismatches, 0);
+}
+
+static size_t
+op_num_mismatches (bool (*op) (int64_t, int64_t, int64_t *), int64_t left,
+                   int64_t right, bool expect_ok, int64_t expect)
+{
+  int64_t value = 0;
+  bool ok = op (left, right, &value);
+  return ok != expect_ok || (ok && value != expect);
+}
+
+NEO_TEST (test_arith_00)
+{
+  size_t num_mismatches = 0;
+  num_mismatches += op_num_mismatches (Int64_add, 1, 2, true, 3);
+  num_mismatches += op_num_mismatches (Int64_add, INT64_MAX, 1, false, 0);
+  num_mismatches += op_num_mismatches (Int64_add, INT64_MIN, -1, false, 0);
+  num_mismatches
+      += op_num_mismatches (Int64_add, INT64_MAX, INT64_MIN, true, -1);
+  num_mismatches += op_num_mismatches (Int64_sub, 1, 2, true, -1);
+  num_mismatches += op_num_mismatches (Int64_sub, INT64_MIN, 1, false, 0);
+  num_mismatches += op_num_mismatches (Int64_sub, 0, INT64_MIN, false, 0);
+  num_mismatches += op_num_mismatches (Int64_mul, -3, 4, true, -12);
+  num_mismatches
+      += op_num_mismatches (Int64_mul, 4294967296, 4294967296, false, 0);
+  num_mismatches += op_num_mismatches (Int64_mul, INT64_MIN, -1, false, 0);
+  num_mismatches += op_num_mismatches (Int64_div, 7, 2, true, 3);
+  num_mismatches += op_num_mismatches (Int64_div, -7, 2, true, -3);
+  num_mismatches += op_num_mismatches (Int64_div, 7, 0, false, 0);
+  num_mismatches += op_num_mismatches (Int64_div, INT64_MIN, -1, false, 0);
+  int64_t value = 0;
+  num_mismatches += !Int64_neg (INT64_MAX, &value) || value != -INT64_MAX;
+  num_mismatches += Int64_neg (INT64_MIN, &value);
+  ASSERT_U64_EQ (num_mismatches, 0);
+}
+
+NEO_TESTS (int64_tests, test_from_str_00, test_arith_00)
+
+#endif
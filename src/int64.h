@@ -0,0 +1,27 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_INT64_H
+#define NEO_INT64_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Arithmetic on Int64, where a result out of range is an overflow rather
+ * than wrapped.  Each returns false on overflow and leaves RESULT alone.  */
+
+/* Parses decimal digits, with an optional sign.  */
+bool Int64_from_str (const char *src, size_t len, int64_t *result);
+bool Int64_neg (int64_t value, int64_t *result);
+bool Int64_add (int64_t left, int64_t right, int64_t *result);
+bool Int64_sub (int64_t left, int64_t right, int64_t *result);
+bool Int64_mul (int64_t left, int64_t right, int64_t *result);
+/* Rounds toward zero.  Also returns false if RIGHT is zero.  */
+bool Int64_div (int64_t left, int64_t right, int64_t *result);
+
+#ifdef TESTS
+#include "test.h"
+Tests int64_tests ();
+#endif
+
+#endif
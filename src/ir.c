@@ -0,0 +1,1138 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "ir.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast_node.h"
+#include "big_int.h"
+#include "hash_map_macro.h"
+#include "int64.h"
+#include "span.h"
+#include "string.h"
+#include "type.h"
+#include "vec_macro.h"
+
+#define IR_NONE (UINT32_MAX)
+
+NEO_IMPL_VEC (IRValueId, IRValueId)
+NEO_IMPL_VEC (IRKind, enum IRKind)
+NEO_IMPL_VEC (IRType, enum IRType)
+NEO_IMPL_VEC (IRPayload, IRPayload)
+NEO_IMPL_VEC (IRBlock, IRBlock)
+NEO_IMPL_VEC (IRFunction, IRFunction)
+
+IRModule
+IRModule_new ()
+{
+  return (IRModule){ .kinds_ = Vec_IRKind_new (),
+                     .types_ = Vec_IRType_new (),
+                     .payloads_ = Vec_IRPayload_new (),
+                     .ids_ = Vec_IRValueId_new (),
+                     .blocks_ = Vec_IRBlock_new (),
+                     .functions_ = Vec_IRFunction_new (),
+                     .integers_ = Vec_BigInt_new (),
+                     .pending_ = Vec_IRValueId_new (),
+                     .main_ = IR_NONE };
+}
+
+void
+IRModule_drop (IRModule *self)
+{
+  for (BigInt *ptr = Vec_BigInt_begin (&self->integers_);
+       ptr < Vec_BigInt_end (&self->integers_); ptr++)
+    {
+      BigInt_drop (ptr);
+    }
+  Vec_IRKind_drop (&self->kinds_);
+  Vec_IRType_drop (&self->types_);
+  Vec_IRPayload_drop (&self->payloads_);
+  Vec_IRValueId_drop (&self->ids_);
+  Vec_IRBlock_drop (&self->blocks_);
+  Vec_IRFunction_drop (&self->functions_);
+  Vec_BigInt_drop (&self->integers_);
+  Vec_IRValueId_drop (&self->pending_);
+}
+
+size_t
+IRModule_num_values (const IRModule *self)
+{
+  return Vec_IRKind_len (&self->kinds_);
+}
+
+enum IRKind
+IRModule_get_kind (const IRModule *self, IRValueId id)
+{
+  assert (id < Vec_IRKind_len (&self->kinds_));
+  return Vec_IRKind_cbegin (&self->kinds_)[id];
+}
+
+enum IRType
+IRModule_get_type (const IRModule *self, IRValueId id)
+{
+  assert (id < Vec_IRType_len (&self->types_));
+  return Vec_IRType_cbegin (&self->types_)[id];
+}
+
+void
+IRModule_set_type (IRModule *self, IRValueId id, enum IRType type)
+{
+  assert (id < Vec_IRType_len (&self->types_));
+  Vec_IRType_begin (&self->types_)[id] = type;
+}
+
+const IRPayload *
+IRModule_get_payload (const IRModule *self, IRValueId id)
+{
+  assert (id < Vec_IRPayload_len (&self->payloads_));
+  return Vec_IRPayload_cbegin (&self->payloads_) + id;
+}
+
+const IRValueId *
+IRModule_get_ids (const IRModule *self, uint32_t ids)
+{
+  assert (ids <= Vec_IRValueId_len (&self->ids_));
+  return Vec_IRValueId_cbegin (&self->ids_) + ids;
+}
+
+const BigInt *
+IRModule_get_integer (const IRModule *self, IRValueId id)
+{
+  assert (IRModule_get_kind (self, id) == IR_INTEGER);
+  return Vec_BigInt_cbegin (&self->integers_)
+         + IRModule_get_payload (self, id)->integer_;
+}
+
+const IRBlock *
+IRModule_get_block (const IRModule *self, IRBlockId id)
+{
+  assert (id < Vec_IRBlock_len (&self->blocks_));
+  return Vec_IRBlock_cbegin (&self->blocks_) + id;
+}
+
+const IRFunction *
+IRModule_get_function (const IRModule *self, IRFunctionId id)
+{
+  assert (id < Vec_IRFunction_len (&self->functions_));
+  return Vec_IRFunction_cbegin (&self->functions_) + id;
+}
+
+void
+IRModule_push_operands (const IRModule *self, IRValueId id,
+                        Vec_IRValueId *operands)
+{
+  const IRPayload *payload = IRModule_get_payload (self, id);
+  switch (IRModule_get_kind (self, id))
+    {
+    case IR_COPY:
+    case IR_NEG:
+      {
+        Vec_IRValueId_push (operands, payload->unary_.value_);
+        break;
+      }
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_EQ:
+    case IR_NEQ:
+    case IR_LE:
+    case IR_GE:
+    case IR_LT:
+    case IR_GT:
+      {
+        Vec_IRValueId_push (operands, payload->binary_.left_);
+        Vec_IRValueId_push (operands, payload->binary_.right_);
+        break;
+      }
+    case IR_IF:
+      {
+        Vec_IRValueId_push (operands, payload->if_.cond_);
+        break;
+      }
+    case IR_TUPLE:
+      {
+        const IRValueId *values
+            = IRModule_get_ids (self, payload->tuple_.ids_);
+        Vec_IRValueId_extend (operands, values, payload->tuple_.num_values_);
+        break;
+      }
+    case IR_CALL:
+      {
+        const IRValueId *args = IRModule_get_ids (self, payload->call_.ids_);
+        Vec_IRValueId_push (operands, payload->call_.callee_);
+        Vec_IRValueId_extend (operands, args, payload->call_.num_args_);
+        break;
+      }
+    case IR_CLOSURE:
+      {
+        const IRValueId *captured
+            = IRModule_get_ids (self, payload->closure_.ids_);
+        const IRFunction *function
+            = IRModule_get_function (self, payload->closure_.function_);
+        Vec_IRValueId_extend (operands, captured, function->num_captures_);
+        break;
+      }
+    default:
+      break;
+    }
+}
+
+/* Whether ID is an integer literal in the range of Int64, and if so sets
+ * VALUE to it.  */
+static bool
+IRModule_get_int64 (const IRModule *self, IRValueId id, int64_t *value)
+{
+  return IRModule_get_kind (self, id) == IR_INTEGER
+         && BigInt_to_i64 (IRModule_get_integer (self, id), value);
+}
+
+/* Whether arithmetic ID, done in Int64, may overflow: unless its operands
+ * are literals that it does not overflow on, or it divides by a literal
+ * other than -1.  */
+static bool
+IRModule_may_overflow (const IRModule *self, IRValueId id)
+{
+  const IRPayload *payload = IRModule_get_payload (self, id);
+  enum IRKind kind = IRModule_get_kind (self, id);
+  int64_t left;
+  int64_t right;
+  int64_t value;
+  if (kind == IR_NEG)
+    {
+      return !IRModule_get_int64 (self, payload->unary_.value_, &left)
+             || !Int64_neg (left, &value);
+    }
+  if (!IRModule_get_int64 (self, payload->binary_.right_, &right))
+    {
+      return true;
+    }
+  if (kind == IR_DIV && right != -1)
+    {
+      return false;
+    }
+  if (!IRModule_get_int64 (self, payload->binary_.left_, &left))
+    {
+      return true;
+    }
+  switch (kind)
+    {
+    case IR_ADD:
+      return !Int64_add (left, right, &value);
+    case IR_SUB:
+      return !Int64_sub (left, right, &value);
+    case IR_MUL:
+      return !Int64_mul (left, right, &value);
+    default:
+      return !Int64_div (left, right, &value);
+    }
+}
+
+bool
+IRModule_has_effect (const IRModule *self, IRValueId id)
+{
+  switch (IRModule_get_kind (self, id))
+    {
+    case IR_UNBOUND:
+    case IR_CALL:
+      return true;
+    case IR_NEG:
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+      return IRModule_get_type (self, id) != IR_TYPE_INT
+             && IRModule_may_overflow (self, id);
+    case IR_DIV:
+      {
+        IRValueId right = IRModule_get_payload (self, id)->binary_.right_;
+        return IRModule_get_kind (self, right) != IR_INTEGER
+               || BigInt_is_zero (IRModule_get_integer (self, right))
+               || (IRModule_get_type (self, id) != IR_TYPE_INT
+                   && IRModule_may_overflow (self, id));
+      }
+    default:
+      return false;
+    }
+}
+
+/* Pushes an instruction outside of any block.  */
+static IRValueId
+IRModule_push (IRModule *self, enum IRKind kind, enum IRType type,
+               IRPayload payload)
+{
+  IRValueId id = Vec_IRKind_len (&self->kinds_);
+  Vec_IRKind_push (&self->kinds_, kind);
+  Vec_IRType_push (&self->types_, type);
+  Vec_IRPayload_push (&self->payloads_, payload);
+  return id;
+}
+
+static IRValueId
+IRModule_push_inst (IRModule *self, enum IRKind kind, enum IRType type,
+                    IRPayload payload)
+{
+  IRValueId id = IRModule_push (self, kind, type, payload);
+  Vec_IRValueId_push (&self->pending_, id);
+  return id;
+}
+
+/* Returns where the ids were put in the pool.  */
+static uint32_t
+IRModule_push_ids (IRModule *self, const IRValueId *ids, uint32_t num_ids)
+{
+  uint32_t begin = Vec_IRValueId_len (&self->ids_);
+  Vec_IRValueId_extend (&self->ids_, ids, num_ids);
+  return begin;
+}
+
+IRValueId
+IRModule_push_param (IRModule *self, uint32_t index)
+{
+  return IRModule_push (self, IR_PARAM, IR_TYPE_UNKNOWN,
+                        (IRPayload){ .index_ = index });
+}
+
+IRValueId
+IRModule_push_capture (IRModule *self, uint32_t index)
+{
+  return IRModule_push (self, IR_CAPTURE, IR_TYPE_UNKNOWN,
+                        (IRPayload){ .index_ = index });
+}
+
+IRValueId
+IRModule_push_bool (IRModule *self, bool value)
+{
+  return IRModule_push_inst (self, value ? IR_TRUE : IR_FALSE,
+                             IR_TYPE_UNKNOWN, (IRPayload){ 0 });
+}
+
+IRValueId
+IRModule_push_integer (IRModule *self, BigInt value, enum IRType type)
+{
+  assert (type == IR_TYPE_INT || type == IR_TYPE_INT64);
+  uint32_t integer = Vec_BigInt_len (&self->integers_);
+  Vec_BigInt_push (&self->integers_, value);
+  return IRModule_push_inst (self, IR_INTEGER, type,
+                             (IRPayload){ .integer_ = integer });
+}
+
+IRValueId
+IRModule_push_unbound (IRModule *self)
+{
+  return IRModule_push_inst (self, IR_UNBOUND, IR_TYPE_UNKNOWN,
+                             (IRPayload){ 0 });
+}
+
+IRValueId
+IRModule_push_unary (IRModule *self, enum IRKind kind, IRValueId value)
+{
+  assert (kind == IR_COPY || kind == IR_NEG);
+  return IRModule_push_inst (
+      self, kind, IRModule_get_type (self, value),
+      (IRPayload){ .unary_ = (IRUnary){ .value_ = value } });
+}
+
+IRValueId
+IRModule_push_binary (IRModule *self, enum IRKind kind, IRValueId left,
+                      IRValueId right)
+{
+  assert (kind >= IR_ADD && kind <= IR_GT);
+  /* Arithmetic stays in Int64 only if both operands are Int64, and is
+   * widened to Int if either is Int.  */
+  enum IRType type = IR_TYPE_UNKNOWN;
+  if (kind <= IR_DIV)
+    {
+      enum IRType left_type = IRModule_get_type (self, left);
+      enum IRType right_type = IRModule_get_type (self, right);
+      if (left_type == IR_TYPE_INT || right_type == IR_TYPE_INT)
+        {
+          type = IR_TYPE_INT;
+        }
+      else if (left_type == IR_TYPE_INT64 && right_type == IR_TYPE_INT64)
+        {
+          type = IR_TYPE_INT64;
+        }
+    }
+  return IRModule_push_inst (
+      self, kind, type,
+      (IRPayload){ .binary_ = (IRBinary){ .left_ = left, .right_ = right } });
+}
+
+IRValueId
+IRModule_push_if (IRModule *self, IRValueId cond, IRBlockId then,
+                  IRBlockId else_)
+{
+  enum IRType type = IRModule_get_type (
+      self, IRModule_get_block (self, then)->result_);
+  if (type != IRModule_get_type (self,
+                                 IRModule_get_block (self, else_)->result_))
+    {
+      type = IR_TYPE_UNKNOWN;
+    }
+  return IRModule_push_inst (
+      self, IR_IF, type,
+      (IRPayload){ .if_
+                   = (IRIf){ .cond_ = cond, .then_ = then, .else_ = else_ } });
+}
+
+IRValueId
+IRModule_push_tuple (IRModule *self, const IRValueId *values,
+                     uint32_t num_values)
+{
+  uint32_t ids = IRModule_push_ids (self, values, num_values);
+  return IRModule_push_inst (
+      self, IR_TUPLE, IR_TYPE_UNKNOWN,
+      (IRPayload){ .tuple_
+                   = (IRTuple){ .ids_ = ids, .num_values_ = num_values } });
+}
+
+IRValueId
+IRModule_push_call (IRModule *self, IRValueId callee, const IRValueId *args,
+                    uint32_t num_args)
+{
+  uint32_t ids = IRModule_push_ids (self, args, num_args);
+  return IRModule_push_inst (self, IR_CALL, IR_TYPE_UNKNOWN,
+                             (IRPayload){ .call_ = (IRCall){
+                                              .callee_ = callee,
+                                              .ids_ = ids,
+                                              .num_args_ = num_args } });
+}
+
+IRValueId
+IRModule_push_closure (IRModule *self, IRFunctionId function,
+                       const IRValueId *captured)
+{
+  uint32_t ids = IRModule_push_ids (
+      self, captured, IRModule_get_function (self, function)->num_captures_);
+  return IRModule_push_inst (
+      self, IR_CLOSURE, IR_TYPE_UNKNOWN,
+      (IRPayload){ .closure_
+                   = (IRClosure){ .function_ = function, .ids_ = ids } });
+}
+
+size_t
+IRModule_begin_block (IRModule *self)
+{
+  return Vec_IRValueId_len (&self->pending_);
+}
+
+IRBlockId
+IRModule_end_block (IRModule *self, size_t begin, IRValueId result)
+{
+  size_t len = Vec_IRValueId_len (&self->pending_);
+  assert (begin <= len);
+  IRBlockId id = Vec_IRBlock_len (&self->blocks_);
+  Vec_IRBlock_push (
+      &self->blocks_,
+      (IRBlock){ .ids_ = IRModule_push_ids (
+                     self, Vec_IRValueId_cbegin (&self->pending_) + begin,
+                     len - begin),
+                 .num_insts_ = len - begin,
+                 .result_ = result });
+  Vec_IRValueId_resize (&self->pending_, begin, 0);
+  return id;
+}
+
+IRFunctionId
+IRModule_push_function (IRModule *self, const IRValueId *params,
+                        uint32_t num_params, const IRValueId *captures,
+                        uint32_t num_captures, IRBlockId body)
+{
+  IRFunctionId id = Vec_IRFunction_len (&self->functions_);
+  uint32_t ids = IRModule_push_ids (self, params, num_params);
+  IRModule_push_ids (self, captures, num_captures);
+  Vec_IRFunction_push (&self->functions_,
+                       (IRFunction){ .ids_ = ids,
+                                     .num_params_ = num_params,
+                                     .num_captures_ = num_captures,
+                                     .body_ = body });
+  return id;
+}
+
+/* Numbers values as they are written.  */
+typedef struct IRWriter
+{
+  const IRModule *module_;
+  String *str_;
+  Vec_IRValueId names_;
+  uint32_t num_names_;
+} IRWriter;
+
+static void
+IRWriter_name (IRWriter *self, IRValueId id)
+{
+  IRValueId *name = Vec_IRValueId_begin (&self->names_) + id;
+  assert (*name == IR_NONE);
+  *name = self->num_names_++;
+}
+
+static void
+IRWriter_value (IRWriter *self, IRValueId id)
+{
+  IRValueId name = Vec_IRValueId_cbegin (&self->names_)[id];
+  assert (name != IR_NONE);
+  String_push (self->str_, '%');
+  String_push_u64 (self->str_, name);
+}
+
+/* Writes the values of IDS, each after SEP.  */
+static void
+IRWriter_values (IRWriter *self, const char *sep, const IRValueId *ids,
+                 uint32_t num_ids)
+{
+  for (uint32_t i = 0; i < num_ids; i++)
+    {
+      String_push_cstring (self->str_, sep);
+      IRWriter_value (self, ids[i]);
+    }
+}
+
+static void IRWriter_block (IRWriter *self, IRBlockId id, size_t indent,
+                            const char *end);
+
+static void
+IRWriter_closure (IRWriter *self, IRValueId id, size_t indent)
+{
+  const IRModule *module = self->module_;
+  const IRClosure *closure = &IRModule_get_payload (module, id)->closure_;
+  const IRFunction *function
+      = IRModule_get_function (module, closure->function_);
+  const IRValueId *values = IRModule_get_ids (module, function->ids_);
+  const IRValueId *captured = IRModule_get_ids (module, closure->ids_);
+  String_push_cstring (self->str_, " (");
+  for (uint32_t i = 0; i < function->num_params_; i++)
+    {
+      IRWriter_name (self, values[i]);
+      String_push_cstring (self->str_, i ? ", " : "");
+      IRWriter_value (self, values[i]);
+    }
+  String_push_cstring (self->str_, ") [");
+  for (uint32_t i = 0; i < function->num_captures_; i++)
+    {
+      IRValueId capture = values[function->num_params_ + i];
+      IRWriter_name (self, capture);
+      String_push_cstring (self->str_, i ? ", " : "");
+      IRWriter_value (self, capture);
+      String_push_cstring (self->str_, " = ");
+      IRWriter_value (self, captured[i]);
+    }
+  String_push_cstring (self->str_, "]\n");
+  IRWriter_block (self, function->body_, indent + 1, "return");
+}
+
+static void
+IRWriter_inst (IRWriter *self, IRValueId id, size_t indent)
+{
+  const IRModule *module = self->module_;
+  const IRPayload *payload = IRModule_get_payload (module, id);
+  enum IRKind kind = IRModule_get_kind (module, id);
+  String_push_cstring_repeat (self->str_, "  ", indent);
+  IRWriter_name (self, id);
+  IRWriter_value (self, id);
+  String_push_cstring (self->str_, " = ");
+  switch (kind)
+    {
+#define NEO_IRKIND(NAME, TEXT)                                                \
+  case IR_##NAME:                                                             \
+    {                                                                         \
+      String_push_cstring (self->str_, TEXT);                                 \
+      break;                                                                  \
+    }
+#include "ir_kind.def"
+#undef NEO_IRKIND
+    }
+  switch (kind)
+    {
+    case IR_INTEGER:
+      {
+        String_push (self->str_, ' ');
+        BigInt_write (IRModule_get_integer (module, id), self->str_);
+        String_push (self->str_, '\n');
+        break;
+      }
+    case IR_IF:
+      {
+        IRWriter_values (self, " ", &payload->if_.cond_, 1);
+        String_push (self->str_, '\n');
+        IRWriter_block (self, payload->if_.then_, indent + 1, "yield");
+        String_push_cstring_repeat (self->str_, "  ", indent);
+        String_push_cstring (self->str_, "else\n");
+        IRWriter_block (self, payload->if_.else_, indent + 1, "yield");
+        break;
+      }
+    case IR_CLOSURE:
+      {
+        IRWriter_closure (self, id, indent);
+        break;
+      }
+    default:
+      {
+        Vec_IRValueId operands = Vec_IRValueId_new ();
+        IRModule_push_operands (module, id, &operands);
+        IRWriter_values (self, " ", Vec_IRValueId_cbegin (&operands),
+                         Vec_IRValueId_len (&operands));
+        Vec_IRValueId_drop (&operands);
+        String_push (self->str_, '\n');
+        break;
+      }
+    }
+}
+
+/* Writes the instructions of block ID, then END and its result.  */
+static void
+IRWriter_block (IRWriter *self, IRBlockId id, size_t indent, const char *end)
+{
+  const IRBlock *block = IRModule_get_block (self->module_, id);
+  const IRValueId *insts = IRModule_get_ids (self->module_, block->ids_);
+  for (uint32_t i = 0; i < block->num_insts_; i++)
+    {
+      IRWriter_inst (self, insts[i], indent);
+    }
+  String_push_cstring_repeat (self->str_, "  ", indent);
+  String_push_cstring (self->str_, end);
+  IRWriter_values (self, " ", &block->result_, 1);
+  String_push (self->str_, '\n');
+}
+
+void
+IRModule_write (const IRModule *self, String *str)
+{
+  IRWriter writer = { .module_ = self,
+                      .str_ = str,
+                      .names_ = Vec_IRValueId_new (),
+                      .num_names_ = 0 };
+  Vec_IRValueId_resize (&writer.names_, IRModule_num_values (self), IR_NONE);
+  const IRFunction *main = IRModule_get_function (self, self->main_);
+  IRWriter_block (&writer, main->body_, 0, "return");
+  Vec_IRValueId_drop (&writer.names_);
+}
+
+/* A name in scope, bound in the function of frame FRAME_.  */
+typedef struct IREnvEntry
+{
+  Span name_;
+  IRValueId value_;
+  uint32_t frame_;
+  /* The entry of the same name that this one shadows, if any.  */
+  uint32_t shadowed_;
+} IREnvEntry;
+
+/* A value of an enclosing function, read through capture INNER_.  */
+typedef struct IRCapture
+{
+  uint32_t entry_;
+  IRValueId inner_;
+  IRValueId outer_;
+} IRCapture;
+
+NEO_DECL_VEC (IREnvEntry, IREnvEntry)
+NEO_IMPL_VEC (IREnvEntry, IREnvEntry)
+NEO_DECL_VEC (IRCapture, IRCapture)
+NEO_IMPL_VEC (IRCapture, IRCapture)
+NEO_DECL_VEC (Vec_IRCapture, Vec_IRCapture)
+NEO_IMPL_VEC (Vec_IRCapture, Vec_IRCapture)
+NEO_DECL_HASHMAP (Span_IREnv, Span, uint32_t)
+NEO_IMPL_HASHMAP (Span_IREnv, Span, uint32_t, Span_hash, Span_eq)
+
+/* Lowers a tree into a module.  Names are looked up like in the type
+ * checker, and each lambda being lowered has a frame holding the captures
+ * found so far in its body.  */
+typedef struct IRLowerer
+{
+  const ASTNodeManager *ast_mgr_;
+  const SourceFile *file_;
+  IRModule *module_;
+  Vec_IREnvEntry entries_;
+  HashMap_Span_IREnv innermost_;
+  Vec_Vec_IRCapture frames_;
+  /* Operands of the tuples and calls being lowered, shared by nested ones,
+   * as in the parser.  */
+  Vec_IRValueId values_;
+} IRLowerer;
+
+static void
+IRLowerer_bind (IRLowerer *self, ASTNodeId var, IRValueId value)
+{
+  Span name = SourceFile_get_span (
+      self->file_, *ASTNodeManager_get_span (self->ast_mgr_, var));
+  uint32_t index = Vec_IREnvEntry_len (&self->entries_);
+  uint32_t *innermost
+      = HashMap_Span_IREnv_get_or_insert (&self->innermost_, name, index);
+  Vec_IREnvEntry_push (
+      &self->entries_,
+      (IREnvEntry){ .name_ = name,
+                    .value_ = value,
+                    .frame_ = Vec_Vec_IRCapture_len (&self->frames_) - 1,
+                    .shadowed_ = *innermost == index ? IR_NONE : *innermost });
+  *innermost = index;
+}
+
+/* Unbinds the entries past LEN, bringing back the ones they shadowed.  */
+static void
+IRLowerer_truncate (IRLowerer *self, size_t len)
+{
+  while (Vec_IREnvEntry_len (&self->entries_) > len)
+    {
+      IREnvEntry entry = Vec_IREnvEntry_pop (&self->entries_);
+      if (entry.shadowed_ == IR_NONE)
+        {
+          HashMap_Span_IREnv_remove (&self->innermost_, &entry.name_);
+        }
+      else
+        {
+          *HashMap_Span_IREnv_get (&self->innermost_, &entry.name_)
+              = entry.shadowed_;
+        }
+    }
+}
+
+/* Returns the value of entry ENTRY in the function of frame FRAME, which
+ * captures it, along with the functions between, if it is bound
+ * outside.  */
+static IRValueId
+IRLowerer_read (IRLowerer *self, uint32_t entry, uint32_t frame)
+{
+  const IREnvEntry *env_entry
+      = Vec_IREnvEntry_cbegin (&self->entries_) + entry;
+  if (env_entry->frame_ == frame)
+    {
+      return env_entry->value_;
+    }
+  const Vec_IRCapture *captures
+      = Vec_Vec_IRCapture_cbegin (&self->frames_) + frame;
+  for (const IRCapture *capture = Vec_IRCapture_cbegin (captures);
+       capture < Vec_IRCapture_cend (captures); capture++)
+    {
+      if (capture->entry_ == entry)
+        {
+          return capture->inner_;
+        }
+    }
+  IRValueId outer = IRLowerer_read (self, entry, frame - 1);
+  /* Reading it outside may have captured it in the enclosing frame.  */
+  Vec_IRCapture *frame_captures
+      = Vec_Vec_IRCapture_begin (&self->frames_) + frame;
+  IRValueId inner = IRModule_push_capture (
+      self->module_, Vec_IRCapture_len (frame_captures));
+  IRModule_set_type (self->module_, inner,
+                     IRModule_get_type (self->module_, outer));
+  Vec_IRCapture_push (
+      frame_captures,
+      (IRCapture){ .entry_ = entry, .inner_ = inner, .outer_ = outer });
+  return inner;
+}
+
+static IRValueId IRLowerer_lower (IRLowerer *self, ASTNodeId id);
+
+static IRValueId
+IRLowerer_lower_var (IRLowerer *self, ASTNodeId id)
+{
+  Span name = SourceFile_get_span (
+      self->file_, *ASTNodeManager_get_span (self->ast_mgr_, id));
+  const uint32_t *entry = HashMap_Span_IREnv_cget (&self->innermost_, &name);
+  if (!entry)
+    {
+      return IRModule_push_unbound (self->module_);
+    }
+  return IRLowerer_read (self, *entry,
+                         Vec_Vec_IRCapture_len (&self->frames_) - 1);
+}
+
+static IRValueId
+IRLowerer_lower_integer (IRLowerer *self, ASTNodeId id)
+{
+  int64_t value;
+  enum IRType type
+      = ASTNodeManager_get_int64 (self->ast_mgr_, self->file_, id, &value)
+            ? IR_TYPE_INT64
+            : IR_TYPE_INT;
+  return IRModule_push_integer (
+      self->module_,
+      ASTNodeManager_get_integer (self->ast_mgr_, self->file_, id), type);
+}
+
+/* Types VALUE, bound to a var annotated with TYPE, as the annotation says
+ * if it names an integer type.  */
+static void
+IRLowerer_annotate (IRLowerer *self, IRValueId value, ASTNodeId type)
+{
+  if (is_null_ast_node_id (type))
+    {
+      return;
+    }
+  Span name = SourceFile_get_span (
+      self->file_, *ASTNodeManager_get_span (self->ast_mgr_, type));
+  if (Span_cmp_cstring (&name, TypeKind_get_name (TYPE_INT)) == 0)
+    {
+      IRModule_set_type (self->module_, value, IR_TYPE_INT);
+    }
+  else if (Span_cmp_cstring (&name, TypeKind_get_name (TYPE_INT64)) == 0)
+    {
+      IRModule_set_type (self->module_, value, IR_TYPE_INT64);
+    }
+}
+
+static IRValueId
+IRLowerer_lower_if (IRLowerer *self, const ASTIfThenElse *if_then_else)
+{
+  IRValueId cond = IRLowerer_lower (self, if_then_else->if_expr_);
+  size_t begin = IRModule_begin_block (self->module_);
+  IRBlockId then = IRModule_end_block (
+      self->module_, begin, IRLowerer_lower (self, if_then_else->then_expr_));
+  begin = IRModule_begin_block (self->module_);
+  IRBlockId else_ = IRModule_end_block (
+      self->module_, begin, IRLowerer_lower (self, if_then_else->else_expr_));
+  return IRModule_push_if (self->module_, cond, then, else_);
+}
+
+static IRValueId
+IRLowerer_lower_let (IRLowerer *self, const ASTLet *let)
+{
+  const ASTNodeId *vars = ASTNodeManager_get_let_vars (self->ast_mgr_, let);
+  const ASTNodeId *types = ASTNodeManager_get_let_types (self->ast_mgr_, let);
+  const ASTNodeId *inits = ASTNodeManager_get_let_inits (self->ast_mgr_, let);
+  size_t env_len = Vec_IREnvEntry_len (&self->entries_);
+  for (uint32_t i = 0; i < let->num_vars_; i++)
+    {
+      IRValueId init = IRLowerer_lower (self, inits[i]);
+      IRValueId copy = IRModule_push_unary (self->module_, IR_COPY, init);
+      IRLowerer_annotate (self, copy, types[i]);
+      IRLowerer_bind (self, vars[i], copy);
+    }
+  IRValueId body = IRLowerer_lower (self, let->body_);
+  IRLowerer_truncate (self, env_len);
+  return body;
+}
+
+static IRValueId
+IRLowerer_lower_lambda (IRLowerer *self, const ASTLambda *lambda)
+{
+  const ASTNodeId *vars
+      = ASTNodeManager_get_lambda_vars (self->ast_mgr_, lambda);
+  const ASTNodeId *types
+      = ASTNodeManager_get_lambda_types (self->ast_mgr_, lambda);
+  size_t env_len = Vec_IREnvEntry_len (&self->entries_);
+  size_t values_len = Vec_IRValueId_len (&self->values_);
+  Vec_Vec_IRCapture_push (&self->frames_, Vec_IRCapture_new ());
+  for (uint32_t i = 0; i < lambda->num_vars_; i++)
+    {
+      IRValueId param = IRModule_push_param (self->module_, i);
+      IRLowerer_annotate (self, param, types[i]);
+      Vec_IRValueId_push (&self->values_, param);
+      IRLowerer_bind (self, vars[i], param);
+    }
+  size_t begin = IRModule_begin_block (self->module_);
+  IRBlockId body = IRModule_end_block (
+      self->module_, begin, IRLowerer_lower (self, lambda->body_));
+  IRLowerer_truncate (self, env_len);
+  Vec_IRCapture captures = Vec_Vec_IRCapture_pop (&self->frames_);
+  for (const IRCapture *capture = Vec_IRCapture_cbegin (&captures);
+       capture < Vec_IRCapture_cend (&captures); capture++)
+    {
+      Vec_IRValueId_push (&self->values_, capture->inner_);
+    }
+  for (const IRCapture *capture = Vec_IRCapture_cbegin (&captures);
+       capture < Vec_IRCapture_cend (&captures); capture++)
+    {
+      Vec_IRValueId_push (&self->values_, capture->outer_);
+    }
+  uint32_t num_captures = Vec_IRCapture_len (&captures);
+  Vec_IRCapture_drop (&captures);
+  const IRValueId *values = Vec_IRValueId_cbegin (&self->values_) + values_len;
+  IRFunctionId function = IRModule_push_function (
+      self->module_, values, lambda->num_vars_, values + lambda->num_vars_,
+      num_captures, body);
+  IRValueId closure = IRModule_push_closure (
+      self->module_, function, values + lambda->num_vars_ + num_captures);
+  Vec_IRValueId_resize (&self->values_, values_len, 0);
+  return closure;
+}
+
+/* Lowers the values of TUPLE to the operand stack.  */
+static void
+IRLowerer_lower_args (IRLowerer *self, const ASTTuple *tuple)
+{
+  const ASTNodeId *args
+      = ASTNodeManager_get_tuple_args (self->ast_mgr_, tuple);
+  for (uint32_t i = 0; i < tuple->num_args_; i++)
+    {
+      IRValueId arg = IRLowerer_lower (self, args[i]);
+      Vec_IRValueId_push (&self->values_, arg);
+    }
+}
+
+static IRValueId
+IRLowerer_lower_tuple (IRLowerer *self, const ASTTuple *tuple)
+{
+  /* Parentheses around an expression.  */
+  if (tuple->num_args_ == 1)
+    {
+      return IRLowerer_lower (
+          self, ASTNodeManager_get_tuple_args (self->ast_mgr_, tuple)[0]);
+    }
+  size_t values_len = Vec_IRValueId_len (&self->values_);
+  IRLowerer_lower_args (self, tuple);
+  IRValueId id = IRModule_push_tuple (
+      self->module_, Vec_IRValueId_cbegin (&self->values_) + values_len,
+      tuple->num_args_);
+  Vec_IRValueId_resize (&self->values_, values_len, 0);
+  return id;
+}
+
+static IRValueId
+IRLowerer_lower_call (IRLowerer *self, const ASTCall *call)
+{
+  IRValueId callee = IRLowerer_lower (self, call->base_);
+  const ASTTuple *tuple
+      = &ASTNodeManager_get_payload (self->ast_mgr_, call->tuple_)->tuple_;
+  size_t values_len = Vec_IRValueId_len (&self->values_);
+  IRLowerer_lower_args (self, tuple);
+  IRValueId id = IRModule_push_call (
+      self->module_, callee,
+      Vec_IRValueId_cbegin (&self->values_) + values_len, tuple->num_args_);
+  Vec_IRValueId_resize (&self->values_, values_len, 0);
+  return id;
+}
+
+static enum IRKind
+ast_to_ir_kind (enum ASTKind kind)
+{
+  switch (kind)
+    {
+    case AST_ADD:
+      return IR_ADD;
+    case AST_SUB:
+      return IR_SUB;
+    case AST_MUL:
+      return IR_MUL;
+    case AST_DIV:
+      return IR_DIV;
+    case AST_EQ:
+      return IR_EQ;
+    case AST_NEQ:
+      return IR_NEQ;
+    case AST_LE:
+      return IR_LE;
+    case AST_GE:
+      return IR_GE;
+    case AST_LT:
+      return IR_LT;
+    case AST_GT:
+      return IR_GT;
+    default:
+      assert (0);
+      return IR_ADD;
+    }
+}
+
+static IRValueId
+IRLowerer_lower (IRLowerer *self, ASTNodeId id)
+{
+  const ASTPayload *payload = ASTNodeManager_get_payload (self->ast_mgr_, id);
+  enum ASTKind kind = ASTNodeManager_get_kind (self->ast_mgr_, id);
+  switch (kind)
+    {
+    case AST_LIT_TRUE:
+    case AST_LIT_FALSE:
+      return IRModule_push_bool (self->module_, kind == AST_LIT_TRUE);
+    case AST_LIT_INTEGER:
+      return IRLowerer_lower_integer (self, id);
+    case AST_IF_THEN_ELSE:
+      return IRLowerer_lower_if (self, &payload->if_then_else_);
+    case AST_LET:
+      return IRLowerer_lower_let (self, &payload->let_);
+    case AST_VAR:
+      return IRLowerer_lower_var (self, id);
+    case AST_LAMBDA:
+      return IRLowerer_lower_lambda (self, &payload->lambda_);
+    case AST_TUPLE:
+      return IRLowerer_lower_tuple (self, &payload->tuple_);
+    case AST_CALL:
+      return IRLowerer_lower_call (self, &payload->call_);
+    case AST_POSITIVE:
+      return IRModule_push_unary (
+          self->module_, IR_COPY,
+          IRLowerer_lower (self, payload->unary_.expr_));
+    case AST_NEGATIVE:
+      return IRModule_push_unary (
+          self->module_, IR_NEG,
+          IRLowerer_lower (self, payload->unary_.expr_));
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MUL:
+    case AST_DIV:
+    case AST_EQ:
+    case AST_NEQ:
+    case AST_LE:
+    case AST_GE:
+    case AST_LT:
+    case AST_GT:
+      {
+        IRValueId left = IRLowerer_lower (self, payload->binary_.left_);
+        IRValueId right = IRLowerer_lower (self, payload->binary_.right_);
+        return IRModule_push_binary (self->module_, ast_to_ir_kind (kind),
+                                     left, right);
+      }
+    default:
+      /* Types only appear in bindings, and invalid nodes do not check.  */
+      assert (0);
+      return IRModule_push_unbound (self->module_);
+    }
+}
+
+IRModule
+IRModule_lower (const ASTNodeManager *ast_mgr, const SourceFile *file,
+                ASTNodeId root)
+{
+  IRModule module = IRModule_new ();
+  IRLowerer lowerer = { .ast_mgr_ = ast_mgr,
+                        .file_ = file,
+                        .module_ = &module,
+                        .entries_ = Vec_IREnvEntry_new (),
+                        .innermost_ = HashMap_Span_IREnv_new (),
+                        .frames_ = Vec_Vec_IRCapture_new (),
+                        .values_ = Vec_IRValueId_new () };
+  Vec_Vec_IRCapture_push (&lowerer.frames_, Vec_IRCapture_new ());
+  size_t begin = IRModule_begin_block (&module);
+  IRBlockId body
+      = IRModule_end_block (&module, begin, IRLowerer_lower (&lowerer, root));
+  module.main_ = IRModule_push_function (&module, NULL, 0, NULL, 0, body);
+  Vec_IRCapture main_captures = Vec_Vec_IRCapture_pop (&lowerer.frames_);
+  assert (Vec_IRCapture_is_empty (&main_captures));
+  Vec_IRCapture_drop (&main_captures);
+  Vec_Vec_IRCapture_drop (&lowerer.frames_);
+  HashMap_Span_IREnv_drop (&lowerer.innermost_);
+  Vec_IREnvEntry_drop (&lowerer.entries_);
+  Vec_IRValueId_drop (&lowerer.values_);
+  return module;
+}
+
+#ifdef TESTS
+#include "test.h"
+
+#include <string.h>
+
+#include "diagnostic.h"
+#include "folder.h"
+#include "parser.h"
+
+/* Returns 1 unless CONTENT lowers to the text EXPECTED, after it is folded
+ * if FOLD.  */
+static size_t
+lower_num_mismatches (const char *content, bool fold, const char *expected)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("test"),
+                                    String_from_cstring (content));
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  ASTNodeId node_id = Parser_parse_file (&file, &diag_mgr, &ast_mgr);
+  ASTNodeManager folded = ASTNodeManager_new ();
+  if (fold)
+    {
+      Folder folder = Folder_new (&ast_mgr, &file, &folded);
+      node_id = Folder_fold (&folder, node_id);
+      Folder_drop (&folder);
+    }
+  IRModule module
+      = IRModule_lower (fold ? &folded : &ast_mgr, &file, node_id);
+  String str = String_new ();
+  IRModule_write (&module, &str);
+  size_t num_mismatches
+      = String_len (&str) != strlen (expected)
+        || memcmp (String_cbegin (&str), expected, String_len (&str));
+  String_drop (&str);
+  IRModule_drop (&module);
+  DiagnosticManager_drop (&diag_mgr);
+  ASTNodeManager_drop (&folded);
+  ASTNodeManager_drop (&ast_mgr);
+  SourceFile_drop (&file);
+  return num_mismatches;
+}
+
+NEO_TEST (test_lower_00)
+{
+  static const char *const cases[][2] = {
+    { "true", "%0 = true\n"
+              "return %0\n" },
+    { "let x = 1 in (x, x + 2)", "%0 = int 1\n"
+                                 "%1 = copy %0\n"
+                                 "%2 = int 2\n"
+                                 "%3 = add %1 %2\n"
+                                 "%4 = tuple %1 %3\n"
+                                 "return %4\n" },
+    { "let x = 1, f = (a, b) +> if a then b else x in f(true, (2, 3))",
+      "%0 = int 1\n"
+      "%1 = copy %0\n"
+      "%2 = closure (%3, %4) [%5 = %1]\n"
+      "  %6 = if %3\n"
+      "    yield %4\n"
+      "  else\n"
+      "    yield %5\n"
+      "  return %6\n"
+      "%7 = copy %2\n"
+      "%8 = true\n"
+      "%9 = int 2\n"
+      "%10 = int 3\n"
+      "%11 = tuple %9 %10\n"
+      "%12 = call %7 %8 %11\n"
+      "return %12\n" },
+    /* Captures are passed down through the lambdas between.  */
+    { "a +> b +> c +> a + b + c", "%0 = closure (%1) []\n"
+                                  "  %2 = closure (%3) [%4 = %1]\n"
+                                  "    %5 = closure (%6) [%7 = %4, %8 = %3]\n"
+                                  "      %9 = add %7 %8\n"
+                                  "      %10 = add %9 %6\n"
+                                  "      return %10\n"
+                                  "    return %5\n"
+                                  "  return %2\n"
+                                  "return %0\n" },
+    { "a +> let a = a + 1, b: Bool = a == 2 in b", "%0 = closure (%1) []\n"
+                                                   "  %2 = int 1\n"
+                                                   "  %3 = add %1 %2\n"
+                                                   "  %4 = copy %3\n"
+                                                   "  %5 = int 2\n"
+                                                   "  %6 = eq %4 %5\n"
+                                                   "  %7 = copy %6\n"
+                                                   "  return %7\n"
+                                                   "return %0\n" },
+    { "x +> y", "%0 = closure (%1) []\n"
+                "  %2 = unbound\n"
+                "  return %2\n"
+                "return %0\n" },
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      ASSERT_U64_EQ (lower_num_mismatches (cases[i][0], false, cases[i][1]),
+                     0);
+    }
+}
+
+/* Folded integers have no text of their own to be lowered from.  */
+NEO_TEST (test_lower_01)
+{
+  static const char *const cases[][2] = {
+    { "let x = 4 + 6 in x", "%0 = int 10\n"
+                            "%1 = copy %0\n"
+                            "return %1\n" },
+    { "(2 * 3 - 10, 99999999999999999999 + 1, x + (1 + 2))",
+      "%0 = int -4\n"
+      "%1 = int 100000000000000000000\n"
+      "%2 = unbound\n"
+      "%3 = int 3\n"
+      "%4 = add %2 %3\n"
+      "%5 = tuple %0 %1 %4\n"
+      "return %5\n" },
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      ASSERT_U64_EQ (lower_num_mismatches (cases[i][0], true, cases[i][1]),
+                     0);
+    }
+}
+
+NEO_TESTS (ir_tests, test_lower_00, test_lower_01)
+#endif
@@ -0,0 +1,215 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_IR_H
+#define NEO_IR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast_node.h"
+#include "big_int.h"
+#include "span.h"
+#include "string.h"
+#include "vec_macro.h"
+
+/* Every instruction defines one value, named by the id of the instruction,
+ * and is never assigned again.  */
+typedef uint32_t IRValueId;
+typedef uint32_t IRBlockId;
+typedef uint32_t IRFunctionId;
+
+NEO_DECL_VEC (IRValueId, IRValueId)
+
+enum IRKind
+{
+#define NEO_IRKIND(NAME, UNUSED) IR_##NAME,
+#include "ir_kind.def"
+#undef NEO_IRKIND
+};
+
+/* What is known of the type of a value.  The lowerer types integers as
+ * the checker does, so that Int64 arithmetic, which fails on overflow, is
+ * told from Int arithmetic, which does not.  */
+enum IRType
+{
+  /* Not an integer, or not known, as in lambda bodies, which are not
+   * checked.  */
+  IR_TYPE_UNKNOWN,
+  IR_TYPE_INT,
+  IR_TYPE_INT64
+};
+
+typedef struct IRUnary
+{
+  IRValueId value_;
+} IRUnary;
+
+typedef struct IRBinary
+{
+  IRValueId left_;
+  IRValueId right_;
+} IRBinary;
+
+typedef struct IRIf
+{
+  IRValueId cond_;
+  IRBlockId then_;
+  IRBlockId else_;
+} IRIf;
+
+/* Variable-length operand lists live in the module's id pool, like the
+ * child lists of the AST.  */
+typedef struct IRTuple
+{
+  uint32_t ids_;
+  uint32_t num_values_;
+} IRTuple;
+
+typedef struct IRCall
+{
+  IRValueId callee_;
+  uint32_t ids_;
+  uint32_t num_args_;
+} IRCall;
+
+/* The values captured, one for each capture of the function.  */
+typedef struct IRClosure
+{
+  IRFunctionId function_;
+  uint32_t ids_;
+} IRClosure;
+
+/* The operands of an instruction, selected by its kind.  */
+typedef union IRPayload
+{
+  /* Of a param or a capture of the function it is in.  */
+  uint32_t index_;
+  /* Into the integers of the module.  */
+  uint32_t integer_;
+  IRUnary unary_;
+  IRBinary binary_;
+  IRIf if_;
+  IRTuple tuple_;
+  IRCall call_;
+  IRClosure closure_;
+} IRPayload;
+
+/* The instructions run in order, then the block evaluates to RESULT_.  */
+typedef struct IRBlock
+{
+  uint32_t ids_;
+  uint32_t num_insts_;
+  IRValueId result_;
+} IRBlock;
+
+/* Params and captures are stored back to back.  They are values of the
+ * function, outside of its blocks, and a closure binds the captures.  */
+typedef struct IRFunction
+{
+  uint32_t ids_;
+  uint32_t num_params_;
+  uint32_t num_captures_;
+  IRBlockId body_;
+} IRFunction;
+
+NEO_DECL_VEC (IRKind, enum IRKind)
+NEO_DECL_VEC (IRType, enum IRType)
+NEO_DECL_VEC (IRPayload, IRPayload)
+NEO_DECL_VEC (IRBlock, IRBlock)
+NEO_DECL_VEC (IRFunction, IRFunction)
+
+/* A program in A-normal form: every operand is a value defined before it,
+ * by an instruction of an enclosing block or by the function.  A function
+ * only reads values of its own, so what a closure needs from outside is
+ * passed as its captures.  Instructions are numbered in the order they are
+ * built, so that operands, the blocks of an if and the body of a closure
+ * come before the instruction using them.  */
+typedef struct IRModule
+{
+  Vec_IRKind kinds_;
+  Vec_IRType types_;
+  Vec_IRPayload payloads_;
+  Vec_IRValueId ids_;
+  Vec_IRBlock blocks_;
+  Vec_IRFunction functions_;
+  Vec_BigInt integers_;
+  /* The instructions of the blocks being built, innermost last.  */
+  Vec_IRValueId pending_;
+  IRFunctionId main_;
+} IRModule;
+
+IRModule IRModule_new ();
+void IRModule_drop (IRModule *self);
+size_t IRModule_num_values (const IRModule *self);
+enum IRKind IRModule_get_kind (const IRModule *self, IRValueId id);
+enum IRType IRModule_get_type (const IRModule *self, IRValueId id);
+/* Overrides the type that ID was pushed with, as for a value bound with a
+ * type annotation.  */
+void IRModule_set_type (IRModule *self, IRValueId id, enum IRType type);
+const IRPayload *IRModule_get_payload (const IRModule *self, IRValueId id);
+const IRValueId *IRModule_get_ids (const IRModule *self, uint32_t ids);
+const BigInt *IRModule_get_integer (const IRModule *self, IRValueId id);
+const IRBlock *IRModule_get_block (const IRModule *self, IRBlockId id);
+const IRFunction *IRModule_get_function (const IRModule *self,
+                                         IRFunctionId id);
+/* Pushes the values that ID reads to OPERANDS, in order.  The blocks of an
+ * if and the function of a closure are not values.  */
+void IRModule_push_operands (const IRModule *self, IRValueId id,
+                             Vec_IRValueId *operands);
+/* Whether running ID may fail or never end, so that it must run even if
+ * its value is not used.  Arithmetic that is not known to be in Int may
+ * overflow Int64, unless it is seen not to on its literal operands, and a
+ * division fails unless it is by a literal other than zero.  An if also
+ * has the effects of its blocks, which this does not look into.  */
+bool IRModule_has_effect (const IRModule *self, IRValueId id);
+
+/* Instructions other than params and captures join the innermost block
+ * being built.  Each is typed from its operands as the checker would type
+ * it, and params and captures are of unknown type.  */
+IRValueId IRModule_push_param (IRModule *self, uint32_t index);
+IRValueId IRModule_push_capture (IRModule *self, uint32_t index);
+IRValueId IRModule_push_bool (IRModule *self, bool value);
+/* TYPE is IR_TYPE_INT or IR_TYPE_INT64.  */
+IRValueId IRModule_push_integer (IRModule *self, BigInt value,
+                                 enum IRType type);
+IRValueId IRModule_push_unbound (IRModule *self);
+IRValueId IRModule_push_unary (IRModule *self, enum IRKind kind,
+                               IRValueId value);
+IRValueId IRModule_push_binary (IRModule *self, enum IRKind kind,
+                                IRValueId left, IRValueId right);
+IRValueId IRModule_push_if (IRModule *self, IRValueId cond, IRBlockId then,
+                            IRBlockId else_);
+IRValueId IRModule_push_tuple (IRModule *self, const IRValueId *values,
+                               uint32_t num_values);
+IRValueId IRModule_push_call (IRModule *self, IRValueId callee,
+                              const IRValueId *args, uint32_t num_args);
+/* CAPTURED holds a value for each capture of FUNCTION.  */
+IRValueId IRModule_push_closure (IRModule *self, IRFunctionId function,
+                                 const IRValueId *captured);
+/* Returns the mark to end the block with.  */
+size_t IRModule_begin_block (IRModule *self);
+IRBlockId IRModule_end_block (IRModule *self, size_t begin, IRValueId result);
+IRFunctionId IRModule_push_function (IRModule *self, const IRValueId *params,
+                                     uint32_t num_params,
+                                     const IRValueId *captures,
+                                     uint32_t num_captures, IRBlockId body);
+
+/* Appends the program to STR as text, values numbered in the order they
+ * are written, so that modules built in a different order but with the
+ * same code are written the same.  */
+void IRModule_write (const IRModule *self, String *str);
+
+/* Lowers the tree at ROOT, whose text is in FILE.  The tree should have
+ * checked clean, though names left unbound in lambda bodies, which are not
+ * checked, are lowered to instructions that fail.  Only integer types are
+ * kept, and each let binding is a copy of its init.  */
+IRModule IRModule_lower (const ASTNodeManager *ast_mgr, const SourceFile *file,
+                         ASTNodeId root);
+
+#ifdef TESTS
+#include "test.h"
+Tests ir_tests ();
+#endif
+
+#endif
@@ -0,0 +1,1412 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "ir_pass.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "big_int.h"
+#include "int64.h"
+#include "ir.h"
+#include "vec.h"
+#include "vec_macro.h"
+
+#define IR_NONE (UINT32_MAX)
+/* Functions with more instructions, counting those of nested blocks and
+ * closures, are not inlined.  */
+#define IR_INLINE_MAX_VALUES (32)
+/* Bodies inlined into bodies being inlined, so that a chain of small
+ * functions calling each other twice does not grow without bound.  */
+#define IR_INLINE_MAX_DEPTH (4)
+
+NEO_IMPL_VEC (IRPassRun, IRPassRun)
+
+typedef struct IRRewriter IRRewriter;
+
+/* Rewrites source instruction ID into the block being built, and returns
+ * the value standing for it, or IR_NONE if there is none.  */
+typedef IRValueId (*IRRewriteFn) (IRRewriter *self, IRValueId id);
+/* Called when the copy of source block ID begins.  */
+typedef void (*IRBeginBlockFn) (IRRewriter *self, IRBlockId id);
+
+/* Copies a module into a new one, instruction by instruction, through the
+ * hooks of a pass.  */
+struct IRRewriter
+{
+  const IRModule *src_;
+  IRModule dst_;
+  /* The value standing for each source value in the new module.  */
+  Vec_IRValueId map_;
+  /* The source function of each new function.  */
+  Vec_u32 functions_;
+  /* Operands of the instructions being copied, shared by nested ones.  */
+  Vec_IRValueId values_;
+  IRRewriteFn rewrite_;
+  IRBeginBlockFn begin_block_;
+  void *data_;
+};
+
+static IRValueId
+IRRewriter_get (const IRRewriter *self, IRValueId id)
+{
+  IRValueId value = Vec_IRValueId_cbegin (&self->map_)[id];
+  assert (value != IR_NONE);
+  return value;
+}
+
+static void
+IRRewriter_set (IRRewriter *self, IRValueId id, IRValueId value)
+{
+  Vec_IRValueId_begin (&self->map_)[id] = value;
+}
+
+static IRBlockId IRRewriter_block (IRRewriter *self, IRBlockId id);
+static IRFunctionId IRRewriter_function (IRRewriter *self, IRFunctionId id);
+
+/* Pushes the new values of the source values IDS to the operand stack.  */
+static void
+IRRewriter_push_values (IRRewriter *self, const IRValueId *ids,
+                        uint32_t num_ids)
+{
+  for (uint32_t i = 0; i < num_ids; i++)
+    {
+      Vec_IRValueId_push (&self->values_, IRRewriter_get (self, ids[i]));
+    }
+}
+
+/* Copies ID with its operands replaced by their new values, and its
+ * type.  */
+static IRValueId
+IRRewriter_copy (IRRewriter *self, IRValueId id)
+{
+  const IRModule *src = self->src_;
+  IRModule *dst = &self->dst_;
+  const IRPayload *payload = IRModule_get_payload (src, id);
+  enum IRKind kind = IRModule_get_kind (src, id);
+  size_t values_len = Vec_IRValueId_len (&self->values_);
+  IRValueId value;
+  switch (kind)
+    {
+    case IR_TRUE:
+    case IR_FALSE:
+      return IRModule_push_bool (dst, kind == IR_TRUE);
+    case IR_INTEGER:
+      return IRModule_push_integer (
+          dst, BigInt_clone (IRModule_get_integer (src, id)),
+          IRModule_get_type (src, id));
+    case IR_UNBOUND:
+      return IRModule_push_unbound (dst);
+    case IR_COPY:
+    case IR_NEG:
+      value = IRModule_push_unary (
+          dst, kind, IRRewriter_get (self, payload->unary_.value_));
+      break;
+    case IR_IF:
+      {
+        IRValueId cond = IRRewriter_get (self, payload->if_.cond_);
+        IRBlockId then = IRRewriter_block (self, payload->if_.then_);
+        IRBlockId else_ = IRRewriter_block (self, payload->if_.else_);
+        value = IRModule_push_if (dst, cond, then, else_);
+        break;
+      }
+    case IR_TUPLE:
+      {
+        IRRewriter_push_values (
+            self, IRModule_get_ids (src, payload->tuple_.ids_),
+            payload->tuple_.num_values_);
+        value = IRModule_push_tuple (
+            dst, Vec_IRValueId_cbegin (&self->values_) + values_len,
+            payload->tuple_.num_values_);
+        break;
+      }
+    case IR_CALL:
+      {
+        IRRewriter_push_values (self,
+                                IRModule_get_ids (src, payload->call_.ids_),
+                                payload->call_.num_args_);
+        value = IRModule_push_call (
+            dst, IRRewriter_get (self, payload->call_.callee_),
+            Vec_IRValueId_cbegin (&self->values_) + values_len,
+            payload->call_.num_args_);
+        break;
+      }
+    case IR_CLOSURE:
+      {
+        IRFunctionId function
+            = IRRewriter_function (self, payload->closure_.function_);
+        IRRewriter_push_values (
+            self, IRModule_get_ids (src, payload->closure_.ids_),
+            IRModule_get_function (dst, function)->num_captures_);
+        value = IRModule_push_closure (
+            dst, function, Vec_IRValueId_cbegin (&self->values_) + values_len);
+        break;
+      }
+    case IR_PARAM:
+    case IR_CAPTURE:
+      /* Bound when their function is copied.  */
+      assert (0);
+      return IR_NONE;
+    default:
+      value = IRModule_push_binary (
+          dst, kind, IRRewriter_get (self, payload->binary_.left_),
+          IRRewriter_get (self, payload->binary_.right_));
+      break;
+    }
+  Vec_IRValueId_resize (&self->values_, values_len, 0);
+  IRModule_set_type (dst, value, IRModule_get_type (src, id));
+  return value;
+}
+
+/* Rewrites the instructions of block ID into the block being built, and
+ * returns the value standing for its result.  */
+static IRValueId
+IRRewriter_splice (IRRewriter *self, IRBlockId id)
+{
+  const IRBlock *block = IRModule_get_block (self->src_, id);
+  const IRValueId *insts = IRModule_get_ids (self->src_, block->ids_);
+  for (uint32_t i = 0; i < block->num_insts_; i++)
+    {
+      IRRewriter_set (self, insts[i], self->rewrite_ (self, insts[i]));
+    }
+  return IRRewriter_get (self, block->result_);
+}
+
+static IRBlockId
+IRRewriter_block (IRRewriter *self, IRBlockId id)
+{
+  size_t begin = IRModule_begin_block (&self->dst_);
+  if (self->begin_block_)
+    {
+      self->begin_block_ (self, id);
+    }
+  IRValueId result = IRRewriter_splice (self, id);
+  return IRModule_end_block (&self->dst_, begin, result);
+}
+
+static IRFunctionId
+IRRewriter_function (IRRewriter *self, IRFunctionId id)
+{
+  const IRFunction *function = IRModule_get_function (self->src_, id);
+  const IRValueId *values = IRModule_get_ids (self->src_, function->ids_);
+  size_t values_len = Vec_IRValueId_len (&self->values_);
+  for (uint32_t i = 0; i < function->num_params_; i++)
+    {
+      IRValueId param = IRModule_push_param (&self->dst_, i);
+      IRModule_set_type (&self->dst_, param,
+                         IRModule_get_type (self->src_, values[i]));
+      IRRewriter_set (self, values[i], param);
+      Vec_IRValueId_push (&self->values_, param);
+    }
+  for (uint32_t i = 0; i < function->num_captures_; i++)
+    {
+      IRValueId capture = IRModule_push_capture (&self->dst_, i);
+      IRModule_set_type (
+          &self->dst_, capture,
+          IRModule_get_type (self->src_, values[function->num_params_ + i]));
+      IRRewriter_set (self, values[function->num_params_ + i], capture);
+      Vec_IRValueId_push (&self->values_, capture);
+    }
+  IRBlockId body = IRRewriter_block (self, function->body_);
+  const IRValueId *new_values
+      = Vec_IRValueId_cbegin (&self->values_) + values_len;
+  IRFunctionId new_id = IRModule_push_function (
+      &self->dst_, new_values, function->num_params_,
+      new_values + function->num_params_, function->num_captures_, body);
+  Vec_IRValueId_resize (&self->values_, values_len, 0);
+  Vec_u32_push (&self->functions_, id);
+  return new_id;
+}
+
+/* Rewrites SRC through REWRITE, which may leave instructions to
+ * IRRewriter_copy, and BEGIN_BLOCK if it is not NULL.  */
+static IRModule
+IRRewriter_run (const IRModule *src, IRRewriteFn rewrite,
+                IRBeginBlockFn begin_block, void *data)
+{
+  IRRewriter self = { .src_ = src,
+                      .dst_ = IRModule_new (),
+                      .map_ = Vec_IRValueId_new (),
+                      .functions_ = Vec_u32_new (),
+                      .values_ = Vec_IRValueId_new (),
+                      .rewrite_ = rewrite,
+                      .begin_block_ = begin_block,
+                      .data_ = data };
+  Vec_IRValueId_resize (&self.map_, IRModule_num_values (src), IR_NONE);
+  self.dst_.main_ = IRRewriter_function (&self, src->main_);
+  Vec_IRValueId_drop (&self.map_);
+  Vec_u32_drop (&self.functions_);
+  Vec_IRValueId_drop (&self.values_);
+  return self.dst_;
+}
+
+/* Where each instruction is: the block holding it, and for each block, the
+ * block holding its if and how many ifs are around it in its function.  */
+typedef struct IRLayout
+{
+  Vec_u32 blocks_;
+  Vec_u32 parents_;
+  Vec_u32 depths_;
+} IRLayout;
+
+static void
+IRLayout_block (IRLayout *self, const IRModule *module, IRBlockId id,
+                IRBlockId parent, uint32_t depth)
+{
+  Vec_u32_begin (&self->parents_)[id] = parent;
+  Vec_u32_begin (&self->depths_)[id] = depth;
+  const IRBlock *block = IRModule_get_block (module, id);
+  const IRValueId *insts = IRModule_get_ids (module, block->ids_);
+  for (uint32_t i = 0; i < block->num_insts_; i++)
+    {
+      Vec_u32_begin (&self->blocks_)[insts[i]] = id;
+      const IRPayload *payload = IRModule_get_payload (module, insts[i]);
+      switch (IRModule_get_kind (module, insts[i]))
+        {
+        case IR_IF:
+          {
+            IRLayout_block (self, module, payload->if_.then_, id, depth + 1);
+            IRLayout_block (self, module, payload->if_.else_, id, depth + 1);
+            break;
+          }
+        case IR_CLOSURE:
+          {
+            IRLayout_block (
+                self, module,
+                IRModule_get_function (module, payload->closure_.function_)
+                    ->body_,
+                IR_NONE, 0);
+            break;
+          }
+        default:
+          break;
+        }
+    }
+}
+
+static IRLayout
+IRLayout_new (const IRModule *module)
+{
+  IRLayout self = { .blocks_ = Vec_u32_new (),
+                    .parents_ = Vec_u32_new (),
+                    .depths_ = Vec_u32_new () };
+  size_t num_blocks = Vec_IRBlock_len (&module->blocks_);
+  Vec_u32_resize (&self.blocks_, IRModule_num_values (module), IR_NONE);
+  Vec_u32_resize (&self.parents_, num_blocks, IR_NONE);
+  Vec_u32_resize (&self.depths_, num_blocks, 0);
+  IRLayout_block (&self, module,
+                  IRModule_get_function (module, module->main_)->body_,
+                  IR_NONE, 0);
+  return self;
+}
+
+static void
+IRLayout_drop (IRLayout *self)
+{
+  Vec_u32_drop (&self->blocks_);
+  Vec_u32_drop (&self->parents_);
+  Vec_u32_drop (&self->depths_);
+}
+
+/* Returns the innermost block holding both blocks of a function, either of
+ * which may be IR_NONE.  */
+static IRBlockId
+IRLayout_common (const IRLayout *self, IRBlockId left, IRBlockId right)
+{
+  if (left == IR_NONE)
+    {
+      return right;
+    }
+  if (right == IR_NONE)
+    {
+      return left;
+    }
+  const uint32_t *parents = Vec_u32_cbegin (&self->parents_);
+  const uint32_t *depths = Vec_u32_cbegin (&self->depths_);
+  while (depths[left] > depths[right])
+    {
+      left = parents[left];
+    }
+  while (depths[right] > depths[left])
+    {
+      right = parents[right];
+    }
+  while (left != right)
+    {
+      left = parents[left];
+      right = parents[right];
+    }
+  return left;
+}
+
+/* The number of instructions of block ID, counting those of the blocks of
+ * its ifs and of the functions of its closures, whose counts go to
+ * FUNCTION_SIZES.  */
+static uint32_t
+block_size (const IRModule *module, IRBlockId id, Vec_u32 *function_sizes)
+{
+  const IRBlock *block = IRModule_get_block (module, id);
+  const IRValueId *insts = IRModule_get_ids (module, block->ids_);
+  uint32_t size = block->num_insts_;
+  for (uint32_t i = 0; i < block->num_insts_; i++)
+    {
+      const IRPayload *payload = IRModule_get_payload (module, insts[i]);
+      switch (IRModule_get_kind (module, insts[i]))
+        {
+        case IR_IF:
+          {
+            size += block_size (module, payload->if_.then_, function_sizes);
+            size += block_size (module, payload->if_.else_, function_sizes);
+            break;
+          }
+        case IR_CLOSURE:
+          {
+            const IRFunction *function = IRModule_get_function (
+                module, payload->closure_.function_);
+            uint32_t function_size
+                = function->num_params_ + function->num_captures_
+                  + block_size (module, function->body_, function_sizes);
+            Vec_u32_begin (function_sizes)[payload->closure_.function_]
+                = function_size;
+            size += function_size;
+            break;
+          }
+        default:
+          break;
+        }
+    }
+  return size;
+}
+
+typedef struct IRInliner
+{
+  Vec_u32 function_sizes_;
+  /* The source functions whose bodies are being inlined.  */
+  Vec_u32 active_;
+} IRInliner;
+
+static bool
+IRInliner_is_active (const IRInliner *self, IRFunctionId function)
+{
+  for (const uint32_t *ptr = Vec_u32_cbegin (&self->active_);
+       ptr < Vec_u32_cend (&self->active_); ptr++)
+    {
+      if (*ptr == function)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Returns the new value of source value ID, seen through copies, which
+ * inlining runs before copy propagation removes them.  */
+static IRValueId
+IRRewriter_closure (const IRRewriter *self, IRValueId id)
+{
+  IRValueId value = IRRewriter_get (self, id);
+  while (IRModule_get_kind (&self->dst_, value) == IR_COPY)
+    {
+      value = IRModule_get_payload (&self->dst_, value)->unary_.value_;
+    }
+  return value;
+}
+
+/* Returns the source function of the closure that CALL calls, if it is
+ * worth inlining, or IR_NONE.  */
+static IRFunctionId
+IRInliner_callee (const IRRewriter *rewriter, const IRInliner *self,
+                  const IRCall *call)
+{
+  const IRModule *dst = &rewriter->dst_;
+  IRValueId callee = IRRewriter_closure (rewriter, call->callee_);
+  if (IRModule_get_kind (dst, callee) != IR_CLOSURE
+      || Vec_u32_len (&self->active_) >= IR_INLINE_MAX_DEPTH)
+    {
+      return IR_NONE;
+    }
+  IRFunctionId function = Vec_u32_cbegin (
+      &rewriter->functions_)[IRModule_get_payload (dst, callee)
+                                 ->closure_.function_];
+  if (IRModule_get_function (rewriter->src_, function)->num_params_
+          != call->num_args_
+      || Vec_u32_cbegin (&self->function_sizes_)[function]
+             > IR_INLINE_MAX_VALUES
+      || IRInliner_is_active (self, function))
+    {
+      return IR_NONE;
+    }
+  return function;
+}
+
+static IRValueId
+inline_rewrite (IRRewriter *self, IRValueId id)
+{
+  IRInliner *inliner = self->data_;
+  if (IRModule_get_kind (self->src_, id) != IR_CALL)
+    {
+      return IRRewriter_copy (self, id);
+    }
+  const IRCall *call = &IRModule_get_payload (self->src_, id)->call_;
+  IRFunctionId function_id = IRInliner_callee (self, inliner, call);
+  if (function_id == IR_NONE)
+    {
+      return IRRewriter_copy (self, id);
+    }
+  /* The body reads the args for the params, and what the closure captured
+   * for the captures.  */
+  const IRFunction *function = IRModule_get_function (self->src_, function_id);
+  const IRValueId *values = IRModule_get_ids (self->src_, function->ids_);
+  const IRValueId *args = IRModule_get_ids (self->src_, call->ids_);
+  for (uint32_t i = 0; i < function->num_params_; i++)
+    {
+      IRRewriter_set (self, values[i], IRRewriter_get (self, args[i]));
+    }
+  const IRClosure *closure
+      = &IRModule_get_payload (&self->dst_,
+                               IRRewriter_closure (self, call->callee_))
+             ->closure_;
+  for (uint32_t i = 0; i < function->num_captures_; i++)
+    {
+      IRRewriter_set (self, values[function->num_params_ + i],
+                      IRModule_get_ids (&self->dst_, closure->ids_)[i]);
+    }
+  Vec_u32_push (&inliner->active_, function_id);
+  IRValueId result = IRRewriter_splice (self, function->body_);
+  Vec_u32_pop (&inliner->active_);
+  return result;
+}
+
+IRModule
+IRPass_inline (const IRModule *src)
+{
+  IRInliner inliner = { .function_sizes_ = Vec_u32_new (),
+                        .active_ = Vec_u32_new () };
+  Vec_u32_resize (&inliner.function_sizes_,
+                  Vec_IRFunction_len (&src->functions_), 0);
+  block_size (src, IRModule_get_function (src, src->main_)->body_,
+              &inliner.function_sizes_);
+  IRModule dst = IRRewriter_run (src, inline_rewrite, NULL, &inliner);
+  Vec_u32_drop (&inliner.function_sizes_);
+  Vec_u32_drop (&inliner.active_);
+  return dst;
+}
+
+static IRValueId
+copy_prop_rewrite (IRRewriter *self, IRValueId id)
+{
+  if (IRModule_get_kind (self->src_, id) == IR_COPY)
+    {
+      return IRRewriter_get (
+          self, IRModule_get_payload (self->src_, id)->unary_.value_);
+    }
+  return IRRewriter_copy (self, id);
+}
+
+IRModule
+IRPass_copy_prop (const IRModule *src)
+{
+  return IRRewriter_run (src, copy_prop_rewrite, NULL, NULL);
+}
+
+static bool
+is_bool_kind (enum IRKind kind)
+{
+  return kind == IR_TRUE || kind == IR_FALSE;
+}
+
+/* Returns the type that arithmetic ID of SRC is done in.  Where it is not
+ * known, as in an inlined body, its operands are literals by now, and it
+ * is typed from them.  */
+static enum IRType
+const_prop_type (const IRRewriter *self, IRValueId id, IRValueId left,
+                 IRValueId right)
+{
+  enum IRType type = IRModule_get_type (self->src_, id);
+  if (type != IR_TYPE_UNKNOWN)
+    {
+      return type;
+    }
+  return IRModule_get_type (&self->dst_, left) == IR_TYPE_INT64
+                 && IRModule_get_type (&self->dst_, right) == IR_TYPE_INT64
+             ? IR_TYPE_INT64
+             : IR_TYPE_INT;
+}
+
+/* Evaluates arithmetic KIND in Int64.  Returns IR_NONE if it overflows or
+ * divides by zero, which is left to fail when it runs.  */
+static IRValueId
+const_prop_int64s (IRModule *dst, enum IRKind kind, const BigInt *left_value,
+                   const BigInt *right_value)
+{
+  int64_t left;
+  int64_t right;
+  int64_t value = 0;
+  if (!BigInt_to_i64 (left_value, &left)
+      || !BigInt_to_i64 (right_value, &right))
+    {
+      return IR_NONE;
+    }
+  bool fits = false;
+  switch (kind)
+    {
+    case IR_ADD:
+      fits = Int64_add (left, right, &value);
+      break;
+    case IR_SUB:
+      fits = Int64_sub (left, right, &value);
+      break;
+    case IR_MUL:
+      fits = Int64_mul (left, right, &value);
+      break;
+    case IR_DIV:
+      fits = Int64_div (left, right, &value);
+      break;
+    default:
+      assert (0);
+      break;
+    }
+  if (!fits)
+    {
+      return IR_NONE;
+    }
+  return IRModule_push_integer (dst, BigInt_from_i64 (value), IR_TYPE_INT64);
+}
+
+/* Returns the constant that binary ID evaluates to, or IR_NONE.  */
+static IRValueId
+const_prop_binary (IRRewriter *self, IRValueId id)
+{
+  IRModule *dst = &self->dst_;
+  const IRBinary *binary = &IRModule_get_payload (self->src_, id)->binary_;
+  enum IRKind kind = IRModule_get_kind (self->src_, id);
+  IRValueId left = IRRewriter_get (self, binary->left_);
+  IRValueId right = IRRewriter_get (self, binary->right_);
+  enum IRKind left_kind = IRModule_get_kind (dst, left);
+  enum IRKind right_kind = IRModule_get_kind (dst, right);
+  if (is_bool_kind (left_kind) && is_bool_kind (right_kind))
+    {
+      if (kind != IR_EQ && kind != IR_NEQ)
+        {
+          return IR_NONE;
+        }
+      return IRModule_push_bool (dst,
+                                 (left_kind == right_kind) == (kind == IR_EQ));
+    }
+  if (left_kind != IR_INTEGER || right_kind != IR_INTEGER)
+    {
+      return IR_NONE;
+    }
+  const BigInt *left_value = IRModule_get_integer (dst, left);
+  const BigInt *right_value = IRModule_get_integer (dst, right);
+  if (kind <= IR_DIV
+      && const_prop_type (self, id, left, right) == IR_TYPE_INT64)
+    {
+      return const_prop_int64s (dst, kind, left_value, right_value);
+    }
+  int cmp = BigInt_cmp (left_value, right_value);
+  switch (kind)
+    {
+    case IR_ADD:
+      return IRModule_push_integer (dst, BigInt_add (left_value, right_value),
+                                    IR_TYPE_INT);
+    case IR_SUB:
+      return IRModule_push_integer (dst, BigInt_sub (left_value, right_value),
+                                    IR_TYPE_INT);
+    case IR_MUL:
+      return IRModule_push_integer (dst, BigInt_mul (left_value, right_value),
+                                    IR_TYPE_INT);
+    case IR_DIV:
+      /* Left to fail when it runs.  */
+      if (BigInt_is_zero (right_value))
+        {
+          return IR_NONE;
+        }
+      return IRModule_push_integer (dst, BigInt_div (left_value, right_value),
+                                    IR_TYPE_INT);
+    case IR_EQ:
+      return IRModule_push_bool (dst, cmp == 0);
+    case IR_NEQ:
+      return IRModule_push_bool (dst, cmp != 0);
+    case IR_LE:
+      return IRModule_push_bool (dst, cmp <= 0);
+    case IR_GE:
+      return IRModule_push_bool (dst, cmp >= 0);
+    case IR_LT:
+      return IRModule_push_bool (dst, cmp < 0);
+    case IR_GT:
+      return IRModule_push_bool (dst, cmp > 0);
+    default:
+      assert (0);
+      return IR_NONE;
+    }
+}
+
+/* Returns the constant that negation ID evaluates to, or IR_NONE.  */
+static IRValueId
+const_prop_neg (IRRewriter *self, IRValueId id)
+{
+  IRModule *dst = &self->dst_;
+  const IRUnary *unary = &IRModule_get_payload (self->src_, id)->unary_;
+  IRValueId value = IRRewriter_get (self, unary->value_);
+  if (IRModule_get_kind (dst, value) != IR_INTEGER)
+    {
+      return IR_NONE;
+    }
+  const BigInt *integer = IRModule_get_integer (dst, value);
+  if (const_prop_type (self, id, value, value) != IR_TYPE_INT64)
+    {
+      return IRModule_push_integer (dst, BigInt_neg (integer), IR_TYPE_INT);
+    }
+  int64_t int64;
+  if (!BigInt_to_i64 (integer, &int64) || !Int64_neg (int64, &int64))
+    {
+      return IR_NONE;
+    }
+  return IRModule_push_integer (dst, BigInt_from_i64 (int64), IR_TYPE_INT64);
+}
+
+static IRValueId
+const_prop_rewrite (IRRewriter *self, IRValueId id)
+{
+  IRModule *dst = &self->dst_;
+  const IRPayload *payload = IRModule_get_payload (self->src_, id);
+  switch (IRModule_get_kind (self->src_, id))
+    {
+    case IR_NEG:
+      {
+        IRValueId value = const_prop_neg (self, id);
+        if (value != IR_NONE)
+          {
+            return value;
+          }
+        break;
+      }
+    case IR_ADD:
+    case IR_SUB:
+    case IR_MUL:
+    case IR_DIV:
+    case IR_EQ:
+    case IR_NEQ:
+    case IR_LE:
+    case IR_GE:
+    case IR_LT:
+    case IR_GT:
+      {
+        IRValueId value = const_prop_binary (self, id);
+        if (value != IR_NONE)
+          {
+            return value;
+          }
+        break;
+      }
+    case IR_IF:
+      {
+        enum IRKind cond_kind = IRModule_get_kind (
+            dst, IRRewriter_get (self, payload->if_.cond_));
+        if (is_bool_kind (cond_kind))
+          {
+            return IRRewriter_splice (self, cond_kind == IR_TRUE
+                                                ? payload->if_.then_
+                                                : payload->if_.else_);
+          }
+        break;
+      }
+    default:
+      break;
+    }
+  return IRRewriter_copy (self, id);
+}
+
+IRModule
+IRPass_const_prop (const IRModule *src)
+{
+  return IRRewriter_run (src, const_prop_rewrite, NULL, NULL);
+}
+
+static IRValueId
+dce_rewrite (IRRewriter *self, IRValueId id)
+{
+  const Vec_char *live = self->data_;
+  return Vec_char_cbegin (live)[id] ? IRRewriter_copy (self, id) : IR_NONE;
+}
+
+/* Marks the result of block ID used, and the block live.  */
+static void
+dce_mark_block (const IRModule *module, IRBlockId id, Vec_char *live_blocks,
+                Vec_char *used)
+{
+  Vec_char_begin (live_blocks)[id] = 1;
+  Vec_char_begin (used)[IRModule_get_block (module, id)->result_] = 1;
+}
+
+/* Whether running block ID may fail or never end, given whether each of
+ * its instructions may.  */
+static bool
+dce_block_has_effect (const IRModule *module, IRBlockId id,
+                      const Vec_char *effects)
+{
+  const IRBlock *block = IRModule_get_block (module, id);
+  const IRValueId *insts = IRModule_get_ids (module, block->ids_);
+  for (uint32_t i = 0; i < block->num_insts_; i++)
+    {
+      if (Vec_char_cbegin (effects)[insts[i]])
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Instructions come after their operands and the blocks and functions they
+ * hold, so a walk from the last one sees every use of an instruction
+ * before the instruction, and whether it is in a block that runs.  */
+IRModule
+IRPass_dce (const IRModule *src)
+{
+  size_t num_values = IRModule_num_values (src);
+  size_t num_blocks = Vec_IRBlock_len (&src->blocks_);
+  IRLayout layout = IRLayout_new (src);
+  const uint32_t *blocks = Vec_u32_cbegin (&layout.blocks_);
+  Vec_char effects = Vec_char_new ();
+  Vec_char_resize (&effects, num_values, 0);
+  for (IRValueId id = 0; id < num_values; id++)
+    {
+      const IRPayload *payload = IRModule_get_payload (src, id);
+      Vec_char_begin (&effects)[id]
+          = IRModule_has_effect (src, id)
+            || (IRModule_get_kind (src, id) == IR_IF
+                && (dce_block_has_effect (src, payload->if_.then_, &effects)
+                    || dce_block_has_effect (src, payload->if_.else_,
+                                             &effects)));
+    }
+  Vec_char live = Vec_char_new ();
+  Vec_char used = Vec_char_new ();
+  Vec_char live_blocks = Vec_char_new ();
+  Vec_char_resize (&live, num_values, 0);
+  Vec_char_resize (&used, num_values, 0);
+  Vec_char_resize (&live_blocks, num_blocks, 0);
+  Vec_IRValueId operands = Vec_IRValueId_new ();
+  dce_mark_block (src, IRModule_get_function (src, src->main_)->body_,
+                  &live_blocks, &used);
+  for (IRValueId id = num_values; id-- > 0;)
+    {
+      if (blocks[id] == IR_NONE || !Vec_char_cbegin (&live_blocks)[blocks[id]]
+          || !(Vec_char_cbegin (&used)[id] || Vec_char_cbegin (&effects)[id]))
+        {
+          continue;
+        }
+      Vec_char_begin (&live)[id] = 1;
+      Vec_IRValueId_clear (&operands);
+      IRModule_push_operands (src, id, &operands);
+      for (const IRValueId *operand = Vec_IRValueId_cbegin (&operands);
+           operand < Vec_IRValueId_cend (&operands); operand++)
+        {
+          Vec_char_begin (&used)[*operand] = 1;
+        }
+      const IRPayload *payload = IRModule_get_payload (src, id);
+      if (IRModule_get_kind (src, id) == IR_IF)
+        {
+          dce_mark_block (src, payload->if_.then_, &live_blocks, &used);
+          dce_mark_block (src, payload->if_.else_, &live_blocks, &used);
+        }
+      else if (IRModule_get_kind (src, id) == IR_CLOSURE)
+        {
+          dce_mark_block (
+              src,
+              IRModule_get_function (src, payload->closure_.function_)->body_,
+              &live_blocks, &used);
+        }
+    }
+  IRModule dst = IRRewriter_run (src, dce_rewrite, NULL, &live);
+  Vec_IRValueId_drop (&operands);
+  Vec_char_drop (&live_blocks);
+  Vec_char_drop (&used);
+  Vec_char_drop (&live);
+  Vec_char_drop (&effects);
+  IRLayout_drop (&layout);
+  return dst;
+}
+
+/* The instructions moved into each block, by ascending id, one range of
+ * INSTS_ for each block.  */
+typedef struct IRFloats
+{
+  const IRLayout *layout_;
+  Vec_u32 begins_;
+  Vec_IRValueId insts_;
+} IRFloats;
+
+static void
+float_in_begin_block (IRRewriter *self, IRBlockId id)
+{
+  const IRFloats *floats = self->data_;
+  const uint32_t *begins = Vec_u32_cbegin (&floats->begins_);
+  for (uint32_t i = begins[id]; i < begins[id + 1]; i++)
+    {
+      IRValueId inst = Vec_IRValueId_cbegin (&floats->insts_)[i];
+      IRRewriter_set (self, inst, IRRewriter_copy (self, inst));
+    }
+}
+
+static IRValueId
+float_in_rewrite (IRRewriter *self, IRValueId id)
+{
+  const IRFloats *floats = self->data_;
+  const Vec_u32 *blocks = &floats->layout_->blocks_;
+  /* Copied where it was moved to, which comes later.  */
+  if (Vec_u32_cbegin (blocks)[id] == IR_NONE)
+    {
+      return IR_NONE;
+    }
+  return IRRewriter_copy (self, id);
+}
+
+static bool
+float_in_can_move (const IRModule *module, IRValueId id)
+{
+  enum IRKind kind = IRModule_get_kind (module, id);
+  return kind != IR_IF && kind != IR_PARAM && kind != IR_CAPTURE
+         && !IRModule_has_effect (module, id);
+}
+
+/* Each instruction goes to the innermost block holding all its uses, which
+ * is known once every instruction after it has been placed.  A use as the
+ * result of a block is in that block.  */
+IRModule
+IRPass_float_in (const IRModule *src)
+{
+  size_t num_values = IRModule_num_values (src);
+  size_t num_blocks = Vec_IRBlock_len (&src->blocks_);
+  IRLayout layout = IRLayout_new (src);
+  Vec_u32 places = Vec_u32_new ();
+  Vec_u32 uses = Vec_u32_new ();
+  Vec_u32_extend (&places, Vec_u32_cbegin (&layout.blocks_), num_values);
+  Vec_u32_resize (&uses, num_values, IR_NONE);
+  uint32_t *place = Vec_u32_begin (&places);
+  uint32_t *use = Vec_u32_begin (&uses);
+  IRBlockId main_body = IRModule_get_function (src, src->main_)->body_;
+  IRValueId main_result = IRModule_get_block (src, main_body)->result_;
+  use[main_result] = IRLayout_common (&layout, use[main_result], main_body);
+  Vec_IRValueId operands = Vec_IRValueId_new ();
+  for (IRValueId id = num_values; id-- > 0;)
+    {
+      if (place[id] == IR_NONE)
+        {
+          continue;
+        }
+      if (use[id] != IR_NONE && use[id] != place[id]
+          && float_in_can_move (src, id))
+        {
+          place[id] = use[id];
+        }
+      Vec_IRValueId_clear (&operands);
+      IRModule_push_operands (src, id, &operands);
+      for (const IRValueId *operand = Vec_IRValueId_cbegin (&operands);
+           operand < Vec_IRValueId_cend (&operands); operand++)
+        {
+          use[*operand] = IRLayout_common (&layout, use[*operand], place[id]);
+        }
+      const IRPayload *payload = IRModule_get_payload (src, id);
+      IRBlockId inner[2] = { IR_NONE, IR_NONE };
+      if (IRModule_get_kind (src, id) == IR_IF)
+        {
+          inner[0] = payload->if_.then_;
+          inner[1] = payload->if_.else_;
+        }
+      else if (IRModule_get_kind (src, id) == IR_CLOSURE)
+        {
+          const IRFunction *function
+              = IRModule_get_function (src, payload->closure_.function_);
+          inner[0] = function->body_;
+        }
+      for (size_t i = 0; i < 2 && inner[i] != IR_NONE; i++)
+        {
+          IRValueId result = IRModule_get_block (src, inner[i])->result_;
+          use[result] = IRLayout_common (&layout, use[result], inner[i]);
+        }
+    }
+  /* Moved instructions are bucketed by the block they go to, and their old
+   * places forgotten.  */
+  IRFloats floats = { .layout_ = &layout,
+                      .begins_ = Vec_u32_new (),
+                      .insts_ = Vec_IRValueId_new () };
+  Vec_u32_resize (&floats.begins_, num_blocks + 1, 0);
+  uint32_t *begins = Vec_u32_begin (&floats.begins_);
+  uint32_t *blocks = Vec_u32_begin (&layout.blocks_);
+  for (IRValueId id = 0; id < num_values; id++)
+    {
+      if (place[id] != blocks[id])
+        {
+          begins[place[id] + 1]++;
+        }
+    }
+  for (size_t i = 0; i < num_blocks; i++)
+    {
+      begins[i + 1] += begins[i];
+    }
+  Vec_IRValueId_resize (&floats.insts_, begins[num_blocks], 0);
+  Vec_u32 ends = Vec_u32_new ();
+  Vec_u32_extend (&ends, begins, num_blocks);
+  for (IRValueId id = 0; id < num_values; id++)
+    {
+      if (place[id] != blocks[id])
+        {
+          Vec_IRValueId_begin (&floats.insts_)[Vec_u32_begin (
+              &ends)[place[id]]++]
+              = id;
+          blocks[id] = IR_NONE;
+        }
+    }
+  IRModule dst = IRRewriter_run (src, float_in_rewrite, float_in_begin_block,
+                                 &floats);
+  Vec_u32_drop (&ends);
+  Vec_u32_drop (&floats.begins_);
+  Vec_IRValueId_drop (&floats.insts_);
+  Vec_IRValueId_drop (&operands);
+  Vec_u32_drop (&uses);
+  Vec_u32_drop (&places);
+  IRLayout_drop (&layout);
+  return dst;
+}
+
+static const IRPass passes[] = {
+  { .name_ = "inline", .run_ = IRPass_inline },
+  { .name_ = "copy-prop", .run_ = IRPass_copy_prop },
+  { .name_ = "const-prop", .run_ = IRPass_const_prop },
+  { .name_ = "dce", .run_ = IRPass_dce },
+  { .name_ = "float-in", .run_ = IRPass_float_in },
+};
+
+IRPassManager
+IRPassManager_new ()
+{
+  return (IRPassManager){ .runs_ = Vec_IRPassRun_new () };
+}
+
+void
+IRPassManager_drop (IRPassManager *self)
+{
+  Vec_IRPassRun_drop (&self->runs_);
+}
+
+static const IRPass *
+find_pass (const char *name, size_t len)
+{
+  for (size_t i = 0; i < sizeof (passes) / sizeof (passes[0]); i++)
+    {
+      if (strlen (passes[i].name_) == len
+          && !memcmp (passes[i].name_, name, len))
+        {
+          return passes + i;
+        }
+    }
+  return NULL;
+}
+
+bool
+IRPassManager_add (IRPassManager *self, const char *names)
+{
+  if (!strcmp (names, "none"))
+    {
+      return true;
+    }
+  size_t len = Vec_IRPassRun_len (&self->runs_);
+  const char *name = names;
+  while (true)
+    {
+      const char *end = strchr (name, ',');
+      size_t name_len = end ? (size_t)(end - name) : strlen (name);
+      const IRPass *pass = find_pass (name, name_len);
+      if (!pass)
+        {
+          Vec_IRPassRun_resize (&self->runs_, len, (IRPassRun){ 0 });
+          return false;
+        }
+      Vec_IRPassRun_push (&self->runs_, (IRPassRun){ .pass_ = *pass });
+      if (!end)
+        {
+          return true;
+        }
+      name = end + 1;
+    }
+}
+
+static double
+timespec_diff_secs (const struct timespec *begin, const struct timespec *end)
+{
+  return (double)(end->tv_sec - begin->tv_sec)
+         + (double)(end->tv_nsec - begin->tv_nsec) / 1000000000.0;
+}
+
+void
+IRPassManager_run (IRPassManager *self, IRModule *module)
+{
+  for (IRPassRun *run = Vec_IRPassRun_begin (&self->runs_);
+       run < Vec_IRPassRun_end (&self->runs_); run++)
+    {
+      struct timespec begin, end;
+      run->num_values_before_ = IRModule_num_values (module);
+      timespec_get (&begin, TIME_UTC);
+      IRModule next = run->pass_.run_ (module);
+      timespec_get (&end, TIME_UTC);
+      IRModule_drop (module);
+      *module = next;
+      run->secs_ = timespec_diff_secs (&begin, &end);
+      run->num_values_after_ = IRModule_num_values (module);
+    }
+}
+
+#if defined(TESTS) || defined(BENCHES)
+#include "diagnostic.h"
+#include "parser.h"
+
+/* Lowers CONTENT, which it takes, and runs PASSES on it.  */
+static IRModule
+lower_source (String content, const char *passes)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("test"), content);
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  ASTNodeId node_id = Parser_parse_file (&file, &diag_mgr, &ast_mgr);
+  IRModule module = IRModule_lower (&ast_mgr, &file, node_id);
+  IRPassManager pass_mgr = IRPassManager_new ();
+  bool ok = IRPassManager_add (&pass_mgr, passes);
+  assert (ok);
+  (void)ok;
+  IRPassManager_run (&pass_mgr, &module);
+  IRPassManager_drop (&pass_mgr);
+  DiagnosticManager_drop (&diag_mgr);
+  ASTNodeManager_drop (&ast_mgr);
+  SourceFile_drop (&file);
+  return module;
+}
+#endif
+
+#ifdef TESTS
+#include "test.h"
+
+/* Returns 1 unless CONTENT after PASSES is written like EXPECTED after
+ * EXPECTED_PASSES.  */
+static size_t
+pass_num_mismatches (const char *passes, const char *content,
+                     const char *expected_passes, const char *expected)
+{
+  IRModule module = lower_source (String_from_cstring (content), passes);
+  IRModule expected_module
+      = lower_source (String_from_cstring (expected), expected_passes);
+  String str = String_new ();
+  String expected_str = String_new ();
+  IRModule_write (&module, &str);
+  IRModule_write (&expected_module, &expected_str);
+  size_t num_mismatches = String_len (&str) != String_len (&expected_str)
+                          || memcmp (String_cbegin (&str),
+                                     String_cbegin (&expected_str),
+                                     String_len (&str));
+  String_drop (&expected_str);
+  String_drop (&str);
+  IRModule_drop (&expected_module);
+  IRModule_drop (&module);
+  return num_mismatches;
+}
+
+/* Returns the number of instructions of KIND in the program of CONTENT
+ * after PASSES.  */
+static size_t
+pass_num_kind (const char *passes, const char *content, enum IRKind kind)
+{
+  IRModule module = lower_source (String_from_cstring (content), passes);
+  size_t num_kind = 0;
+  for (IRValueId id = 0; id < IRModule_num_values (&module); id++)
+    {
+      num_kind += IRModule_get_kind (&module, id) == kind;
+    }
+  IRModule_drop (&module);
+  return num_kind;
+}
+
+NEO_TEST (test_copy_prop_00)
+{
+  static const char *const cases[][2] = {
+    { "let x = 1 in x", "1" },
+    { "a +> let x = a, y = x in (x, y)", "a +> (a, a)" },
+    { "a +> let x = a in x + x", "a +> a + a" },
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      ASSERT_U64_EQ (pass_num_mismatches ("copy-prop", cases[i][0], "none",
+                                          cases[i][1]),
+                     0);
+    }
+}
+
+NEO_TEST (test_const_prop_00)
+{
+  static const char *const cases[][2] = {
+    { "1 + 2 * 3", "7" },
+    { "(10 / 3, 7 - 2 * 3, 2 * 3 / 4)", "(3, 1, 1)" },
+    { "if 1 < 2 then 10 else 20", "10" },
+    { "if 3 <= 2 then 10 else 20", "20" },
+    { "a +> if a then 3 - 1 else 4 / 2", "a +> if a then 2 else 2" },
+    { "a +> (a == true, 2 > 1, true /= false)",
+      "a +> (a == true, true, true)" },
+    { "a +> if 1 == 1 then a + 1 else a(a)", "a +> a + 1" },
+    { "a +> 1 / 0", "a +> 1 / 0" },
+    /* Int64 arithmetic that overflows is left to fail, but Int
+     * arithmetic is not.  */
+    { "9223372036854775807 + 1", "9223372036854775807 + 1" },
+    { "4611686018427387904 * 2 - 1", "4611686018427387904 * 2 - 1" },
+    { "9223372036854775807 + 99999999999999999999 - 99999999999999999999",
+      "9223372036854775807" },
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      ASSERT_U64_EQ (pass_num_mismatches ("const-prop,dce", cases[i][0],
+                                          "none", cases[i][1]),
+                     0);
+    }
+  ASSERT_U64_EQ (
+      pass_num_mismatches ("copy-prop,const-prop,dce",
+                           "let x: Int = 9223372036854775807 in x + 1",
+                           "none", "9223372036854775808"),
+      0);
+  ASSERT_U64_EQ (pass_num_mismatches ("inline,copy-prop,const-prop,dce",
+                                      "(x +> x + 1)(9223372036854775807)",
+                                      "none", "9223372036854775807 + 1"),
+                 0);
+}
+
+NEO_TEST (test_dce_00)
+{
+  static const char *const cases[][2] = {
+    { "a: Int +> let x = a + 1 in a", "a +> a" },
+    { "a +> let f = b +> b, g = f in a", "a +> a" },
+    { "a +> if a then (let x = 1 * 2 in 3) else 4",
+      "a +> if a then 3 else 4" },
+    { "a +> let x = (if a then 1 else 2) in a", "a +> a" },
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      ASSERT_U64_EQ (
+          pass_num_mismatches ("dce", cases[i][0], "none", cases[i][1]), 0);
+    }
+  /* What may fail stays, with the ifs holding it.  */
+  ASSERT_U64_EQ (pass_num_kind ("dce", "a +> let x = a(1) in a", IR_CALL), 1);
+  ASSERT_U64_EQ (pass_num_kind ("dce", "a +> let x = 1 / a in a", IR_DIV), 1);
+  ASSERT_U64_EQ (pass_num_kind ("dce", "a +> let x = 1 / 2 in a", IR_DIV), 0);
+  /* So may Int64 arithmetic, or arithmetic on what may be Int64.  */
+  ASSERT_U64_EQ (pass_num_kind ("dce", "a +> let x = a + 1 in a", IR_ADD), 1);
+  ASSERT_U64_EQ (pass_num_kind ("dce",
+                                "let x = 9223372036854775807 + 1 in 0",
+                                IR_ADD),
+                 1);
+  ASSERT_U64_EQ (pass_num_kind ("dce", "a +> let x = a / 2 in a", IR_DIV), 0);
+  ASSERT_U64_EQ (pass_num_kind ("dce",
+                                "let x: Int = 9223372036854775807 in "
+                                "let y = x + 1 in 0",
+                                IR_ADD),
+                 0);
+  ASSERT_U64_EQ (
+      pass_num_kind ("dce", "a +> let x = if a then a(1) else 2 in a", IR_IF),
+      1);
+  ASSERT_U64_EQ (pass_num_kind ("dce", "a +> let f = b +> b(1) in a", IR_CALL),
+                 0);
+}
+
+NEO_TEST (test_inline_00)
+{
+  static const char *const cases[][4] = {
+    { "(x +> x + 1)(2)", "none", "3" },
+    { "let f = (a, b) +> if a then b else 0 in f(true, 5)", "none", "5" },
+    { "let k = 10, f = a +> a * k in f(2)", "none", "20" },
+    { "let f = a +> a + 1 in (f(1), f(2))", "none", "(2, 3)" },
+    { "(g +> g(1))(x +> x * 2)", "none", "2" },
+    /* Arities that do not match are left to fail.  */
+    { "(x +> x)(1, 2)", "none", "(x +> x)(1, 2)" },
+    /* A function is not inlined into its own body.  */
+    { "(x +> x(x))(x +> x(x))", "copy-prop", "let w = x +> x(x) in w(w)" },
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      ASSERT_U64_EQ (
+          pass_num_mismatches ("inline,copy-prop,const-prop,dce", cases[i][0],
+                               cases[i][1], cases[i][2]),
+          0);
+    }
+}
+
+NEO_TEST (test_float_in_00)
+{
+  static const char *const cases[][2] = {
+    { "q +> let y = 5 * 7 in if q then y else 0",
+      "q +> if q then 5 * 7 else 0" },
+    { "(n: Int, p, q) +> let y = n + 1 in if p then (if q then y else 0) "
+      "else 1",
+      "(n, p, q) +> if p then (if q then n + 1 else 0) else 1" },
+    { "(n: Int, p, q) +> let y = n + 1 in if p then (if q then y else y) "
+      "else 1",
+      "(n, p, q) +> if p then (let y = n + 1 in if q then y else y) else 1" },
+    /* Into the branch, but not into the lambda.  */
+    { "(n: Int, q) +> let y = n + 1 in if q then (z +> y) else 0",
+      "(n, q) +> if q then (let y = n + 1 in z +> y) else 0" },
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      ASSERT_U64_EQ (pass_num_mismatches ("copy-prop,float-in", cases[i][0],
+                                          "copy-prop", cases[i][1]),
+                     0);
+    }
+  /* Used in both branches, or may fail.  */
+  static const char *const unmoved[] = {
+    "(n: Int, q) +> let y = n + 1 in if q then y else y",
+    "(f, q) +> let y = f(1) in if q then y else 0",
+    "(n: Int64, q) +> let y = n + 1 in if q then y else 0",
+  };
+  for (size_t i = 0; i < sizeof (unmoved) / sizeof (unmoved[0]); i++)
+    {
+      ASSERT_U64_EQ (pass_num_mismatches ("copy-prop,float-in", unmoved[i],
+                                          "copy-prop", unmoved[i]),
+                     0);
+    }
+}
+
+NEO_TEST (test_pass_manager_00)
+{
+  IRPassManager pass_mgr = IRPassManager_new ();
+  ASSERT_U64_EQ (IRPassManager_add (&pass_mgr, "dce,bogus"), false);
+  ASSERT_U64_EQ (IRPassManager_add (&pass_mgr, "none"), true);
+  ASSERT_U64_EQ (Vec_IRPassRun_len (&pass_mgr.runs_), 0);
+  ASSERT_U64_EQ (IRPassManager_add (&pass_mgr, IR_DEFAULT_PASSES), true);
+  ASSERT_U64_EQ (IRPassManager_add (&pass_mgr, "dce"), true);
+  ASSERT_U64_EQ (Vec_IRPassRun_len (&pass_mgr.runs_), 6);
+  IRModule module
+      = lower_source (String_from_cstring ("let x = 1 + 2 in x * x"), "none");
+  IRPassManager_run (&pass_mgr, &module);
+  const IRPassRun *runs = Vec_IRPassRun_cbegin (&pass_mgr.runs_);
+  ASSERT_U64_EQ (runs[0].num_values_before_, 5);
+  /* Copy propagation, then the constants are folded and the rest
+   * dropped.  */
+  ASSERT_U64_EQ (runs[1].num_values_after_, 4);
+  ASSERT_U64_EQ (runs[3].num_values_after_, 1);
+  ASSERT_U64_EQ (runs[5].num_values_after_, 1);
+  String str = String_new ();
+  IRModule_write (&module, &str);
+  static const char expected[] = "%0 = int 9\n"
+                                 "return %0\n";
+  ASSERT_U64_EQ (String_len (&str), strlen (expected));
+  ASSERT_U64_EQ (memcmp (String_cbegin (&str), expected, String_len (&str)),
+                 0);
+  String_drop (&str);
+  IRModule_drop (&module);
+  IRPassManager_drop (&pass_mgr);
+}
+
+NEO_TESTS (ir_pass_tests, test_copy_prop_00, test_const_prop_00, test_dce_00,
+           test_inline_00, test_float_in_00, test_pass_manager_00)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+/* Runs PASSES on SOURCE, which it takes, as lowered, or times the lowering
+ * if PASSES is NULL.  */
+static void
+ir_pass_bench (Bencher *bencher_, String source, const char *passes)
+{
+  IRModule module = lower_source (source, "none");
+  size_t num_values = IRModule_num_values (&module);
+  if (!passes)
+    {
+      Bencher_report_u64 (bencher_, "values", num_values);
+      IRModule_drop (&module);
+      return;
+    }
+  IRPassManager pass_mgr = IRPassManager_new ();
+  bool ok = IRPassManager_add (&pass_mgr, passes);
+  assert (ok);
+  (void)ok;
+  const IRPassRun *runs = Vec_IRPassRun_cbegin (&pass_mgr.runs_);
+  size_t num_runs = Vec_IRPassRun_len (&pass_mgr.runs_);
+  BENCH_ITER
+  {
+    IRModule dst = runs[0].pass_.run_ (&module);
+    for (size_t i = 1; i < num_runs; i++)
+      {
+        IRModule next = runs[i].pass_.run_ (&dst);
+        IRModule_drop (&dst);
+        dst = next;
+      }
+    IRModule_drop (&dst);
+  }
+  IRPassManager_run (&pass_mgr, &module);
+  Bencher_report_u64 (bencher_, "values", num_values);
+  Bencher_report_u64 (bencher_, "values after", IRModule_num_values (&module));
+  IRPassManager_drop (&pass_mgr);
+  IRModule_drop (&module);
+}
+
+NEO_BENCH (bench_lower_00)
+{
+  String source = bench_gen_source (1 << 20, 42);
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"), source);
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  ASTNodeId node_id = Parser_parse_file (&file, &diag_mgr, &ast_mgr);
+  size_t num_values = 0;
+  BENCH_ITER
+  {
+    IRModule module = IRModule_lower (&ast_mgr, &file, node_id);
+    num_values = IRModule_num_values (&module);
+    IRModule_drop (&module);
+  }
+  Bencher_report_u64 (bencher_, "nodes", ASTNodeManager_num_nodes (&ast_mgr));
+  Bencher_report_u64 (bencher_, "values", num_values);
+  DiagnosticManager_drop (&diag_mgr);
+  ASTNodeManager_drop (&ast_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCH (bench_inline_00)
+{
+  ir_pass_bench (bencher_, bench_gen_source (1 << 20, 42), "inline");
+}
+
+NEO_BENCH (bench_copy_prop_00)
+{
+  ir_pass_bench (bencher_, bench_gen_source (1 << 20, 42), "copy-prop");
+}
+
+NEO_BENCH (bench_const_prop_00)
+{
+  ir_pass_bench (bencher_, bench_gen_source (1 << 20, 42), "const-prop");
+}
+
+NEO_BENCH (bench_dce_00)
+{
+  ir_pass_bench (bencher_, bench_gen_source (1 << 20, 42), "dce");
+}
+
+NEO_BENCH (bench_float_in_00)
+{
+  ir_pass_bench (bencher_, bench_gen_source (1 << 20, 42), "float-in");
+}
+
+NEO_BENCH (bench_passes_00)
+{
+  ir_pass_bench (bencher_, bench_gen_source (1 << 20, 42), IR_DEFAULT_PASSES);
+}
+
+NEO_BENCH (bench_passes_let_00)
+{
+  ir_pass_bench (bencher_, bench_gen_let_source (1000, 4, 42),
+                 IR_DEFAULT_PASSES);
+}
+
+NEO_BENCHES (ir_pass_benches, bench_lower_00, bench_inline_00,
+             bench_copy_prop_00, bench_const_prop_00, bench_dce_00,
+             bench_float_in_00, bench_passes_00, bench_passes_let_00)
+#endif
@@ -0,0 +1,77 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_IR_PASS_H
+#define NEO_IR_PASS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ir.h"
+#include "vec_macro.h"
+
+/* The passes run by default, in order.  */
+#define IR_DEFAULT_PASSES "inline,copy-prop,const-prop,dce,float-in"
+
+/* Returns a module with the program of SRC transformed.  Passes build a
+ * new module rather than edit one in place, so values stay numbered in the
+ * order they are built.  */
+typedef IRModule (*IRPassFn) (const IRModule *src);
+
+/* Calls of closures known at the call site, whose functions are small, are
+ * replaced by their bodies, with the params bound to the args.  */
+IRModule IRPass_inline (const IRModule *src);
+/* Uses of copies read the copied value instead.  */
+IRModule IRPass_copy_prop (const IRModule *src);
+/* Operators on constants are evaluated, and ifs on constants are replaced
+ * by the block taken.  */
+IRModule IRPass_const_prop (const IRModule *src);
+/* Instructions without effects whose values are not used are dropped.  */
+IRModule IRPass_dce (const IRModule *src);
+/* Instructions without effects that are only used in one branch of an if
+ * are moved into the branch, so that they do not run when it is not
+ * taken.  */
+IRModule IRPass_float_in (const IRModule *src);
+
+typedef struct IRPass
+{
+  const char *name_;
+  IRPassFn run_;
+} IRPass;
+
+/* A pass in a pipeline, with what it did on the last run.  */
+typedef struct IRPassRun
+{
+  IRPass pass_;
+  double secs_;
+  size_t num_values_before_;
+  size_t num_values_after_;
+} IRPassRun;
+
+NEO_DECL_VEC (IRPassRun, IRPassRun)
+
+typedef struct IRPassManager
+{
+  Vec_IRPassRun runs_;
+} IRPassManager;
+
+/* With no passes.  */
+IRPassManager IRPassManager_new ();
+void IRPassManager_drop (IRPassManager *self);
+/* Appends the passes of NAMES, separated by commas, in order; a pass may
+ * be named more than once.  `none` names no pass.  Returns false and adds
+ * nothing if a name is unknown.  */
+bool IRPassManager_add (IRPassManager *self, const char *names);
+/* Runs the passes in order on MODULE, which is replaced, timing each.  */
+void IRPassManager_run (IRPassManager *self, IRModule *module);
+
+#ifdef TESTS
+#include "test.h"
+Tests ir_pass_tests ();
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+Benches ir_pass_benches ();
+#endif
+
+#endif
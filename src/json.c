@@ -0,0 +1,897 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "json.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "string.h"
+#include "vec_macro.h"
+
+NEO_IMPL_VEC (Json, Json)
+NEO_IMPL_VEC (JsonMember, JsonMember)
+
+/* Deeper values are rejected rather than risking the stack.  */
+#define JSON_MAX_DEPTH (256)
+
+Json
+Json_new_null ()
+{
+  return (Json){ .kind_ = JSON_NULL,
+                 .number_ = 0,
+                 .string_ = String_new (),
+                 .items_ = Vec_Json_new (),
+                 .members_ = Vec_JsonMember_new () };
+}
+
+void
+Json_drop (Json *self)
+{
+  String_drop (&self->string_);
+  for (Json *item = Vec_Json_begin (&self->items_);
+       item < Vec_Json_end (&self->items_); item++)
+    {
+      Json_drop (item);
+    }
+  Vec_Json_drop (&self->items_);
+  for (JsonMember *member = Vec_JsonMember_begin (&self->members_);
+       member < Vec_JsonMember_end (&self->members_); member++)
+    {
+      String_drop (&member->key_);
+      Json_drop (&member->value_);
+    }
+  Vec_JsonMember_drop (&self->members_);
+}
+
+typedef struct JsonParser
+{
+  const char *cursor_;
+  const char *end_;
+} JsonParser;
+
+static void
+JsonParser_skip_whitespace (JsonParser *self)
+{
+  while (self->cursor_ < self->end_
+         && (*self->cursor_ == ' ' || *self->cursor_ == '\t'
+             || *self->cursor_ == '\n' || *self->cursor_ == '\r'))
+    {
+      self->cursor_++;
+    }
+}
+
+static bool
+JsonParser_eat (JsonParser *self, char c)
+{
+  JsonParser_skip_whitespace (self);
+  if (self->cursor_ < self->end_ && *self->cursor_ == c)
+    {
+      self->cursor_++;
+      return true;
+    }
+  return false;
+}
+
+static bool
+JsonParser_eat_word (JsonParser *self, const char *word)
+{
+  size_t len = strlen (word);
+  if ((size_t)(self->end_ - self->cursor_) >= len
+      && !memcmp (self->cursor_, word, len))
+    {
+      self->cursor_ += len;
+      return true;
+    }
+  return false;
+}
+
+static bool
+is_digit (char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+static size_t
+JsonParser_eat_digits (JsonParser *self)
+{
+  const char *begin = self->cursor_;
+  while (self->cursor_ < self->end_ && is_digit (*self->cursor_))
+    {
+      self->cursor_++;
+    }
+  return self->cursor_ - begin;
+}
+
+static bool
+JsonParser_parse_number (JsonParser *self, Json *value)
+{
+  const char *begin = self->cursor_;
+  JsonParser_eat_word (self, "-");
+  /* No leading zeros.  */
+  if (!JsonParser_eat_word (self, "0") && !JsonParser_eat_digits (self))
+    {
+      return false;
+    }
+  if (JsonParser_eat_word (self, ".") && !JsonParser_eat_digits (self))
+    {
+      return false;
+    }
+  if (JsonParser_eat_word (self, "e") || JsonParser_eat_word (self, "E"))
+    {
+      if (!JsonParser_eat_word (self, "+"))
+        {
+          JsonParser_eat_word (self, "-");
+        }
+      if (!JsonParser_eat_digits (self))
+        {
+          return false;
+        }
+    }
+  /* strtod needs a terminated copy.  */
+  String number = String_new ();
+  String_push_carray (&number, begin, self->cursor_ - begin);
+  String_push (&number, '\0');
+  value->kind_ = JSON_NUMBER;
+  value->number_ = strtod (String_cbegin (&number), NULL);
+  String_drop (&number);
+  return true;
+}
+
+static int
+hex_value (char c)
+{
+  if (c >= '0' && c <= '9')
+    {
+      return c - '0';
+    }
+  if (c >= 'a' && c <= 'f')
+    {
+      return c - 'a' + 10;
+    }
+  if (c >= 'A' && c <= 'F')
+    {
+      return c - 'A' + 10;
+    }
+  return -1;
+}
+
+/* Reads the four hex digits after a \u.  */
+static bool
+JsonParser_parse_hex4 (JsonParser *self, uint32_t *code)
+{
+  if (self->end_ - self->cursor_ < 4)
+    {
+      return false;
+    }
+  *code = 0;
+  for (int i = 0; i < 4; i++)
+    {
+      int digit = hex_value (*self->cursor_++);
+      if (digit < 0)
+        {
+          return false;
+        }
+      *code = *code << 4 | digit;
+    }
+  return true;
+}
+
+static void
+String_push_utf8 (String *self, uint32_t code)
+{
+  if (code < 0x80)
+    {
+      String_push (self, code);
+    }
+  else if (code < 0x800)
+    {
+      String_push (self, 0xc0 | code >> 6);
+      String_push (self, 0x80 | (code & 0x3f));
+    }
+  else if (code < 0x10000)
+    {
+      String_push (self, 0xe0 | code >> 12);
+      String_push (self, 0x80 | (code >> 6 & 0x3f));
+      String_push (self, 0x80 | (code & 0x3f));
+    }
+  else
+    {
+      String_push (self, 0xf0 | code >> 18);
+      String_push (self, 0x80 | (code >> 12 & 0x3f));
+      String_push (self, 0x80 | (code >> 6 & 0x3f));
+      String_push (self, 0x80 | (code & 0x3f));
+    }
+}
+
+/* Decodes the escape after a backslash into OUT.  Unpaired surrogates
+ * become U+FFFD.  */
+static bool
+JsonParser_parse_escape (JsonParser *self, String *out)
+{
+  if (self->cursor_ == self->end_)
+    {
+      return false;
+    }
+  char c = *self->cursor_++;
+  switch (c)
+    {
+    case '"':
+    case '\\':
+    case '/':
+      String_push (out, c);
+      return true;
+    case 'b':
+      String_push (out, '\b');
+      return true;
+    case 'f':
+      String_push (out, '\f');
+      return true;
+    case 'n':
+      String_push (out, '\n');
+      return true;
+    case 'r':
+      String_push (out, '\r');
+      return true;
+    case 't':
+      String_push (out, '\t');
+      return true;
+    case 'u':
+      {
+        uint32_t code;
+        if (!JsonParser_parse_hex4 (self, &code))
+          {
+            return false;
+          }
+        if (code >= 0xdc00 && code < 0xe000)
+          {
+            code = 0xfffd;
+          }
+        else if (code >= 0xd800 && code < 0xdc00)
+          {
+            const char *save = self->cursor_;
+            uint32_t low;
+            if (JsonParser_eat_word (self, "\\u")
+                && JsonParser_parse_hex4 (self, &low) && low >= 0xdc00
+                && low < 0xe000)
+              {
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+              }
+            else
+              {
+                self->cursor_ = save;
+                code = 0xfffd;
+              }
+          }
+        String_push_utf8 (out, code);
+        return true;
+      }
+    default:
+      return false;
+    }
+}
+
+static bool
+JsonParser_parse_string (JsonParser *self, String *out)
+{
+  if (!JsonParser_eat (self, '"'))
+    {
+      return false;
+    }
+  while (self->cursor_ < self->end_)
+    {
+      const char *run = self->cursor_;
+      while (self->cursor_ < self->end_ && *self->cursor_ != '"'
+             && *self->cursor_ != '\\'
+             && (unsigned char)*self->cursor_ >= 0x20)
+        {
+          self->cursor_++;
+        }
+      String_push_carray (out, run, self->cursor_ - run);
+      if (self->cursor_ == self->end_)
+        {
+          return false;
+        }
+      char c = *self->cursor_++;
+      if (c == '"')
+        {
+          return true;
+        }
+      if (c != '\\' || !JsonParser_parse_escape (self, out))
+        {
+          return false;
+        }
+    }
+  return false;
+}
+
+static bool JsonParser_parse_value (JsonParser *self, Json *value,
+                                    int depth);
+
+static bool
+JsonParser_parse_array (JsonParser *self, Json *value, int depth)
+{
+  value->kind_ = JSON_ARRAY;
+  if (JsonParser_eat (self, ']'))
+    {
+      return true;
+    }
+  do
+    {
+      Vec_Json_push (&value->items_, Json_new_null ());
+      if (!JsonParser_parse_value (self, Vec_Json_end (&value->items_) - 1,
+                                   depth + 1))
+        {
+          return false;
+        }
+    }
+  while (JsonParser_eat (self, ','));
+  return JsonParser_eat (self, ']');
+}
+
+static bool
+JsonParser_parse_object (JsonParser *self, Json *value, int depth)
+{
+  value->kind_ = JSON_OBJECT;
+  if (JsonParser_eat (self, '}'))
+    {
+      return true;
+    }
+  do
+    {
+      Vec_JsonMember_push (
+          &value->members_,
+          (JsonMember){ .key_ = String_new (), .value_ = Json_new_null () });
+      JsonMember *member = Vec_JsonMember_end (&value->members_) - 1;
+      if (!JsonParser_parse_string (self, &member->key_)
+          || !JsonParser_eat (self, ':')
+          || !JsonParser_parse_value (self, &member->value_, depth + 1))
+        {
+          return false;
+        }
+    }
+  while (JsonParser_eat (self, ','));
+  return JsonParser_eat (self, '}');
+}
+
+/* Parses into VALUE, which must be null.  On failure VALUE may hold part of
+ * the value and must still be dropped.  */
+static bool
+JsonParser_parse_value (JsonParser *self, Json *value, int depth)
+{
+  if (depth > JSON_MAX_DEPTH)
+    {
+      return false;
+    }
+  JsonParser_skip_whitespace (self);
+  if (self->cursor_ == self->end_)
+    {
+      return false;
+    }
+  switch (*self->cursor_)
+    {
+    case '{':
+      self->cursor_++;
+      return JsonParser_parse_object (self, value, depth);
+    case '[':
+      self->cursor_++;
+      return JsonParser_parse_array (self, value, depth);
+    case '"':
+      value->kind_ = JSON_STRING;
+      return JsonParser_parse_string (self, &value->string_);
+    case 't':
+      value->kind_ = JSON_TRUE;
+      return JsonParser_eat_word (self, "true");
+    case 'f':
+      value->kind_ = JSON_FALSE;
+      return JsonParser_eat_word (self, "false");
+    case 'n':
+      return JsonParser_eat_word (self, "null");
+    default:
+      return JsonParser_parse_number (self, value);
+    }
+}
+
+bool
+Json_parse (Json *self, const char *text, size_t len)
+{
+  JsonParser parser = { .cursor_ = text, .end_ = text + len };
+  *self = Json_new_null ();
+  bool ok = JsonParser_parse_value (&parser, self, 0);
+  JsonParser_skip_whitespace (&parser);
+  if (!ok || parser.cursor_ != parser.end_)
+    {
+      Json_drop (self);
+      *self = Json_new_null ();
+      return false;
+    }
+  return true;
+}
+
+enum JsonKind
+Json_get_kind (const Json *self)
+{
+  return self ? self->kind_ : JSON_NULL;
+}
+
+bool
+Json_is_null (const Json *self)
+{
+  return !self || self->kind_ == JSON_NULL;
+}
+
+double
+Json_get_number (const Json *self)
+{
+  return self && self->kind_ == JSON_NUMBER ? self->number_ : 0;
+}
+
+const String *
+Json_get_string (const Json *self)
+{
+  return self && self->kind_ == JSON_STRING ? &self->string_ : NULL;
+}
+
+size_t
+Json_len (const Json *self)
+{
+  return self && self->kind_ == JSON_ARRAY ? Vec_Json_len (&self->items_)
+                                            : 0;
+}
+
+const Json *
+Json_at (const Json *self, size_t index)
+{
+  assert (index < Json_len (self));
+  return Vec_Json_cbegin (&self->items_) + index;
+}
+
+const Json *
+Json_get (const Json *self, const char *key)
+{
+  if (!self || self->kind_ != JSON_OBJECT)
+    {
+      return NULL;
+    }
+  size_t len = strlen (key);
+  for (const JsonMember *member = Vec_JsonMember_cend (&self->members_);
+       member > Vec_JsonMember_cbegin (&self->members_);)
+    {
+      member--;
+      if (String_len (&member->key_) == len
+          && !memcmp (String_cbegin (&member->key_), key, len))
+        {
+          return &member->value_;
+        }
+    }
+  return NULL;
+}
+
+void
+String_push_json_string (String *self, const char *array, size_t len)
+{
+  static const char hex[] = "0123456789abcdef";
+  String_push (self, '"');
+  const char *end = array + len;
+  while (array < end)
+    {
+      const char *run = array;
+      while (array < end && *array != '"' && *array != '\\'
+             && (unsigned char)*array >= 0x20)
+        {
+          array++;
+        }
+      String_push_carray (self, run, array - run);
+      if (array == end)
+        {
+          break;
+        }
+      unsigned char c = *array++;
+      String_push (self, '\\');
+      switch (c)
+        {
+        case '"':
+        case '\\':
+          String_push (self, c);
+          break;
+        case '\b':
+          String_push (self, 'b');
+          break;
+        case '\f':
+          String_push (self, 'f');
+          break;
+        case '\n':
+          String_push (self, 'n');
+          break;
+        case '\r':
+          String_push (self, 'r');
+          break;
+        case '\t':
+          String_push (self, 't');
+          break;
+        default:
+          String_push_cstring (self, "u00");
+          String_push (self, hex[c >> 4]);
+          String_push (self, hex[c & 0xf]);
+          break;
+        }
+    }
+  String_push (self, '"');
+}
+
+static void
+String_push_json_number (String *self, double number)
+{
+  /* Ids and positions are integers, which must not come back as 1e+02.  */
+  if (number > -9007199254740992.0 && number < 9007199254740992.0
+      && number == (double)(int64_t)number)
+    {
+      String_push_i64 (self, (int64_t)number);
+      return;
+    }
+  char buf[32];
+  int len = snprintf (buf, sizeof (buf), "%.17g", number);
+  String_push_carray (self, buf, len);
+}
+
+void
+String_push_json (String *self, const Json *json)
+{
+  switch (json->kind_)
+    {
+    case JSON_NULL:
+      String_push_cstring (self, "null");
+      break;
+    case JSON_FALSE:
+      String_push_cstring (self, "false");
+      break;
+    case JSON_TRUE:
+      String_push_cstring (self, "true");
+      break;
+    case JSON_NUMBER:
+      String_push_json_number (self, json->number_);
+      break;
+    case JSON_STRING:
+      String_push_json_string (self, String_cbegin (&json->string_),
+                               String_len (&json->string_));
+      break;
+    case JSON_ARRAY:
+      String_push (self, '[');
+      for (const Json *item = Vec_Json_cbegin (&json->items_);
+           item < Vec_Json_cend (&json->items_); item++)
+        {
+          if (item != Vec_Json_cbegin (&json->items_))
+            {
+              String_push (self, ',');
+            }
+          String_push_json (self, item);
+        }
+      String_push (self, ']');
+      break;
+    case JSON_OBJECT:
+      String_push (self, '{');
+      for (const JsonMember *member = Vec_JsonMember_cbegin (&json->members_);
+           member < Vec_JsonMember_cend (&json->members_); member++)
+        {
+          if (member != Vec_JsonMember_cbegin (&json->members_))
+            {
+              String_push (self, ',');
+            }
+          String_push_json_string (self, String_cbegin (&member->key_),
+                                   String_len (&member->key_));
+          String_push (self, ':');
+          String_push_json (self, &member->value_);
+        }
+      String_push (self, '}');
+      break;
+    }
+}
+
+/* The buffer is flushed once it holds this much.  */
+#define JSON_WRITER_BUFFER_SIZE (1 << 16)
+
+JsonWriter
+JsonWriter_new (FILE *file)
+{
+  String buf = String_new ();
+  Vec_char_reserve (&buf.data_, JSON_WRITER_BUFFER_SIZE);
+  return (JsonWriter){ .file_ = file, .buf_ = buf, .need_comma_ = false };
+}
+
+void
+JsonWriter_drop (JsonWriter *self)
+{
+  JsonWriter_flush (self);
+  String_drop (&self->buf_);
+}
+
+void
+JsonWriter_flush (JsonWriter *self)
+{
+  if (self->file_ && String_len (&self->buf_))
+    {
+      fwrite (String_cbegin (&self->buf_), 1, String_len (&self->buf_),
+              self->file_);
+      String_clear (&self->buf_);
+    }
+}
+
+const String *
+JsonWriter_get_buffer (const JsonWriter *self)
+{
+  return &self->buf_;
+}
+
+/* Called after every value, so that the buffer stays near its size.  */
+static void
+JsonWriter_end_value (JsonWriter *self)
+{
+  self->need_comma_ = true;
+  if (String_len (&self->buf_) >= JSON_WRITER_BUFFER_SIZE)
+    {
+      JsonWriter_flush (self);
+    }
+}
+
+static void
+JsonWriter_begin_value (JsonWriter *self)
+{
+  if (self->need_comma_)
+    {
+      String_push (&self->buf_, ',');
+    }
+}
+
+void
+JsonWriter_begin_object (JsonWriter *self)
+{
+  JsonWriter_begin_value (self);
+  String_push (&self->buf_, '{');
+  self->need_comma_ = false;
+}
+
+void
+JsonWriter_end_object (JsonWriter *self)
+{
+  String_push (&self->buf_, '}');
+  JsonWriter_end_value (self);
+}
+
+void
+JsonWriter_begin_array (JsonWriter *self)
+{
+  JsonWriter_begin_value (self);
+  String_push (&self->buf_, '[');
+  self->need_comma_ = false;
+}
+
+void
+JsonWriter_end_array (JsonWriter *self)
+{
+  String_push (&self->buf_, ']');
+  JsonWriter_end_value (self);
+}
+
+void
+JsonWriter_key (JsonWriter *self, const char *key)
+{
+  JsonWriter_begin_value (self);
+  String_push (&self->buf_, '"');
+  String_push_cstring (&self->buf_, key);
+  String_push_cstring (&self->buf_, "\":");
+  self->need_comma_ = false;
+}
+
+void
+JsonWriter_string (JsonWriter *self, const char *array, size_t len)
+{
+  JsonWriter_begin_value (self);
+  String_push_json_string (&self->buf_, array, len);
+  JsonWriter_end_value (self);
+}
+
+void
+JsonWriter_cstring (JsonWriter *self, const char *cstr)
+{
+  JsonWriter_string (self, cstr, strlen (cstr));
+}
+
+void
+JsonWriter_u64 (JsonWriter *self, uint64_t n)
+{
+  JsonWriter_begin_value (self);
+  String_push_u64 (&self->buf_, n);
+  JsonWriter_end_value (self);
+}
+
+void
+JsonWriter_i64 (JsonWriter *self, int64_t n)
+{
+  JsonWriter_begin_value (self);
+  String_push_i64 (&self->buf_, n);
+  JsonWriter_end_value (self);
+}
+
+void
+JsonWriter_bool (JsonWriter *self, bool value)
+{
+  JsonWriter_begin_value (self);
+  String_push_cstring (&self->buf_, value ? "true" : "false");
+  JsonWriter_end_value (self);
+}
+
+void
+JsonWriter_null (JsonWriter *self)
+{
+  JsonWriter_begin_value (self);
+  String_push_cstring (&self->buf_, "null");
+  JsonWriter_end_value (self);
+}
+
+void
+JsonWriter_newline (JsonWriter *self)
+{
+  String_push (&self->buf_, '\n');
+  self->need_comma_ = false;
+  if (String_len (&self->buf_) >= JSON_WRITER_BUFFER_SIZE)
+    {
+      JsonWriter_flush (self);
+    }
+}
+
+#ifdef TESTS
+#include "test.h"
+
+static void
+assert_roundtrip (TestFnWrapper *test_fn_wrapper_, const char *text,
+                  const char *expect)
+{
+  Json json;
+  ASSERT_U64_EQ (Json_parse (&json, text, strlen (text)), true);
+  String output = String_new ();
+  String_push_json (&output, &json);
+  ASSERT_U64_EQ (String_len (&output), strlen (expect));
+  ASSERT_I64_EQ (memcmp (String_cbegin (&output), expect, strlen (expect)),
+                 0);
+  String_drop (&output);
+  Json_drop (&json);
+}
+
+NEO_TEST (test_json_parse_00)
+{
+  const char *text = " {\"id\": 3, \"method\": \"initialize\", \"params\": "
+                     "{\"a\": [true, false, null, -1.5e2]}} ";
+  Json json;
+  ASSERT_U64_EQ (Json_parse (&json, text, strlen (text)), true);
+  ASSERT_U64_EQ (Json_get_kind (&json), JSON_OBJECT);
+  ASSERT_I64_EQ (Json_get_number (Json_get (&json, "id")), 3);
+  const String *method = Json_get_string (Json_get (&json, "method"));
+  ASSERT_U64_EQ (String_len (method), strlen ("initialize"));
+  ASSERT_U64_EQ (Json_get (&json, "missing") == NULL, true);
+  const Json *array = Json_get (Json_get (&json, "params"), "a");
+  ASSERT_U64_EQ (Json_len (array), 4);
+  ASSERT_U64_EQ (Json_get_kind (Json_at (array, 0)), JSON_TRUE);
+  ASSERT_U64_EQ (Json_get_kind (Json_at (array, 1)), JSON_FALSE);
+  ASSERT_U64_EQ (Json_is_null (Json_at (array, 2)), true);
+  ASSERT_I64_EQ (Json_get_number (Json_at (array, 3)), -150);
+  Json_drop (&json);
+}
+
+NEO_TEST (test_json_parse_01)
+{
+  const char *invalid[]
+      = { "",       "{",          "[1,]",      "{\"a\" 1}", "01",
+          "1.",     "-",          "\"\\x\"",   "\"\t\"",    "tru",
+          "[] []",  "{\"a\":1,}", "\"\\u12\"", "nul",       "[1 2]" };
+  for (size_t i = 0; i < sizeof (invalid) / sizeof (invalid[0]); i++)
+    {
+      Json json;
+      ASSERT_U64_EQ (Json_parse (&json, invalid[i], strlen (invalid[i])),
+                     false);
+      ASSERT_U64_EQ (Json_is_null (&json), true);
+      Json_drop (&json);
+    }
+  String deep = String_new ();
+  String_push_repeat (&deep, '[', JSON_MAX_DEPTH + 2);
+  String_push_repeat (&deep, ']', JSON_MAX_DEPTH + 2);
+  Json json;
+  ASSERT_U64_EQ (Json_parse (&json, String_cbegin (&deep), String_len (&deep)),
+                 false);
+  Json_drop (&json);
+  String_drop (&deep);
+}
+
+NEO_TEST (test_json_roundtrip_00)
+{
+  assert_roundtrip (test_fn_wrapper_, "[ 1 , 2.5, -0, 1e3, 12345678901 ]",
+                    "[1,2.5,0,1000,12345678901]");
+  assert_roundtrip (test_fn_wrapper_, "{\"k\" : {\"\" : []}, \"x\": \"\"}",
+                    "{\"k\":{\"\":[]},\"x\":\"\"}");
+  assert_roundtrip (test_fn_wrapper_, "\"a\\\"b\\\\c\\/\\n\\u0001\"",
+                    "\"a\\\"b\\\\c/\\n\\u0001\"");
+}
+
+NEO_TEST (test_json_unicode_00)
+{
+  const char *text = "\"\\u00e9\\u4e2d\\ud83d\\ude00\\udc00\"";
+  Json json;
+  ASSERT_U64_EQ (Json_parse (&json, text, strlen (text)), true);
+  const char *expect = "\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80\xef\xbf\xbd";
+  const String *str = Json_get_string (&json);
+  ASSERT_U64_EQ (String_len (str), strlen (expect));
+  ASSERT_I64_EQ (memcmp (String_cbegin (str), expect, strlen (expect)), 0);
+  Json_drop (&json);
+}
+
+NEO_TEST (test_json_writer_00)
+{
+  JsonWriter writer = JsonWriter_new (NULL);
+  for (int i = 0; i < 2; i++)
+    {
+      JsonWriter_begin_object (&writer);
+      JsonWriter_key (&writer, "a");
+      JsonWriter_begin_array (&writer);
+      JsonWriter_u64 (&writer, i);
+      JsonWriter_i64 (&writer, -7);
+      JsonWriter_begin_object (&writer);
+      JsonWriter_end_object (&writer);
+      JsonWriter_bool (&writer, true);
+      JsonWriter_null (&writer);
+      JsonWriter_end_array (&writer);
+      JsonWriter_key (&writer, "b");
+      JsonWriter_cstring (&writer, "\"\n");
+      JsonWriter_end_object (&writer);
+      JsonWriter_newline (&writer);
+    }
+  JsonWriter_begin_array (&writer);
+  JsonWriter_u64 (&writer, 100);
+  JsonWriter_i64 (&writer, INT64_MIN);
+  JsonWriter_u64 (&writer, UINT64_MAX);
+  JsonWriter_end_array (&writer);
+  const char *expect = "{\"a\":[0,-7,{},true,null],\"b\":\"\\\"\\n\"}\n"
+                       "{\"a\":[1,-7,{},true,null],\"b\":\"\\\"\\n\"}\n"
+                       "[100,-9223372036854775808,18446744073709551615]";
+  const String *output = JsonWriter_get_buffer (&writer);
+  ASSERT_U64_EQ (String_len (output), strlen (expect));
+  ASSERT_I64_EQ (memcmp (String_cbegin (output), expect, strlen (expect)), 0);
+  JsonWriter_drop (&writer);
+}
+
+NEO_TEST (test_json_writer_01)
+{
+  /* Whatever goes out in pieces must read back whole.  */
+  FILE *file = tmpfile ();
+  JsonWriter writer = JsonWriter_new (file);
+  JsonWriter_begin_array (&writer);
+  for (uint64_t i = 0; i < 100000; i++)
+    {
+      JsonWriter_u64 (&writer, i);
+    }
+  JsonWriter_end_array (&writer);
+  JsonWriter_drop (&writer);
+  String text = String_new ();
+  rewind (file);
+  char buf[4096];
+  size_t len;
+  while ((len = fread (buf, 1, sizeof (buf), file)) > 0)
+    {
+      String_push_carray (&text, buf, len);
+    }
+  fclose (file);
+  Json json;
+  ASSERT_U64_EQ (Json_parse (&json, String_cbegin (&text), String_len (&text)),
+                 true);
+  ASSERT_U64_EQ (Json_len (&json), 100000);
+  ASSERT_I64_EQ (Json_get_number (Json_at (&json, 99999)), 99999);
+  Json_drop (&json);
+  String_drop (&text);
+}
+
+NEO_TESTS (json_tests, test_json_parse_00, test_json_parse_01,
+           test_json_roundtrip_00, test_json_unicode_00, test_json_writer_00,
+           test_json_writer_01)
+#endif
@@ -0,0 +1,108 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_JSON_H
+#define NEO_JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "string.h"
+#include "vec_macro.h"
+
+enum JsonKind
+{
+  JSON_NULL,
+  JSON_FALSE,
+  JSON_TRUE,
+  JSON_NUMBER,
+  JSON_STRING,
+  JSON_ARRAY,
+  JSON_OBJECT
+};
+
+typedef struct Json Json;
+typedef struct JsonMember JsonMember;
+
+NEO_DECL_VEC (Json, Json)
+NEO_DECL_VEC (JsonMember, JsonMember)
+
+/* A parsed JSON value, which owns everything below it.  */
+struct Json
+{
+  enum JsonKind kind_;
+  double number_;
+  String string_;
+  Vec_Json items_;
+  /* In the order of the text, duplicate keys included.  */
+  Vec_JsonMember members_;
+};
+
+struct JsonMember
+{
+  String key_;
+  Json value_;
+};
+
+Json Json_new_null ();
+/* Parses exactly one value from TEXT, surrounded by nothing but whitespace.
+ * Returns false and leaves SELF null if TEXT is not valid JSON.  */
+bool Json_parse (Json *self, const char *text, size_t len);
+void Json_drop (Json *self);
+/* The accessors take the NULL that a missing member gives, and treat it like
+ * a value of another kind, so that lookups can be chained.  */
+enum JsonKind Json_get_kind (const Json *self);
+bool Json_is_null (const Json *self);
+/* Returns 0 unless SELF is a number.  */
+double Json_get_number (const Json *self);
+/* Returns NULL unless SELF is a string.  */
+const String *Json_get_string (const Json *self);
+/* Returns 0 unless SELF is an array.  */
+size_t Json_len (const Json *self);
+const Json *Json_at (const Json *self, size_t index);
+/* Returns the last member named KEY, or NULL if there is none or SELF is not
+ * an object.  */
+const Json *Json_get (const Json *self, const char *key);
+
+/* Appends ARRAY as a quoted JSON string, escaping what must be.  */
+void String_push_json_string (String *self, const char *array, size_t len);
+/* Appends JSON in its shortest form.  */
+void String_push_json (String *self, const Json *json);
+
+/* Streams JSON into a large buffer, which goes out in a single fwrite
+ * whenever it fills up.  Commas are placed by the writer.  */
+typedef struct JsonWriter
+{
+  /* NULL keeps everything in the buffer.  */
+  FILE *file_;
+  String buf_;
+  bool need_comma_;
+} JsonWriter;
+
+JsonWriter JsonWriter_new (FILE *file);
+/* Flushes, then frees the buffer.  */
+void JsonWriter_drop (JsonWriter *self);
+void JsonWriter_flush (JsonWriter *self);
+const String *JsonWriter_get_buffer (const JsonWriter *self);
+void JsonWriter_begin_object (JsonWriter *self);
+void JsonWriter_end_object (JsonWriter *self);
+void JsonWriter_begin_array (JsonWriter *self);
+void JsonWriter_end_array (JsonWriter *self);
+/* Writes KEY, which must not need escaping, for the value written next.  */
+void JsonWriter_key (JsonWriter *self, const char *key);
+void JsonWriter_string (JsonWriter *self, const char *array, size_t len);
+void JsonWriter_cstring (JsonWriter *self, const char *cstr);
+void JsonWriter_u64 (JsonWriter *self, uint64_t n);
+void JsonWriter_i64 (JsonWriter *self, int64_t n);
+void JsonWriter_bool (JsonWriter *self, bool value);
+void JsonWriter_null (JsonWriter *self);
+/* Ends a record of JSON Lines.  */
+void JsonWriter_newline (JsonWriter *self);
+
+#ifdef TESTS
+#include "test.h"
+Tests json_tests ();
+#endif
+
+#endif
@@ -5,9 +5,13 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 
 #include "span.h"
+#include "thread_pool.h"
 #include "token.h"
 
 #define NEO_COMMENT_TOKEN (TOKEN_DOUBLE_SLASH)
@@ -152,7 +156,8 @@ Lexer_skip_whitespace_or_comments (Lexer *self)
           if (skip_count)
             {
               Lexer_skip (self, skip_count);
-              while (!is_newline (*self->cursor_))
+              while (self->cursor_ < Span_cend (&self->span_)
+                     && !is_newline (*self->cursor_))
                 {
                   Lexer_skip (self, 1);
                 }
@@ -184,9 +189,25 @@ Lexer_next_whitespace_or_comments (Lexer *self)
 Lexer
 Lexer_new (const Span *span)
 {
+  assert (Span_len (span) <= UINT32_MAX);
   return (Lexer){ .span_ = *span, .cursor_ = Span_cbegin (span) };
 }
 
+Lexer
+Lexer_new_at (const Span *span, uint32_t offset)
+{
+  assert (offset <= Span_len (span));
+  Lexer self = Lexer_new (span);
+  self.cursor_ += offset;
+  return self;
+}
+
+static CompactSpan
+Lexer_span (const Lexer *self, const char *begin, size_t len)
+{
+  return CompactSpan_new (begin - Span_cbegin (&self->span_), len);
+}
+
 Token
 Lexer_next (Lexer *self)
 {
@@ -199,7 +220,7 @@ Lexer_next (Lexer *self)
       token_begin = self->cursor_;                                            \
       Lexer_skip (self, skip_count);                                          \
       return (Token){ .kind_ = TOKEN_##T,                                     \
-                      .span_ = Span_new (token_begin, skip_count) };          \
+                      .span_ = Lexer_span (self, token_begin, skip_count) };  \
     }
 #include "token_lit.def"
 #undef NEO_TOKEN_LIT
@@ -208,14 +229,14 @@ Lexer_next (Lexer *self)
       token_begin = self->cursor_;
       Lexer_skip (self, skip_count);
       return (Token){ .kind_ = TOKEN_NAME,
-                      .span_ = Span_new (token_begin, skip_count) };
+                      .span_ = Lexer_span (self, token_begin, skip_count) };
     }
   if ((skip_count = Lexer_seeing_nonnegative_integer (self)) != 0)
     {
       token_begin = self->cursor_;
       Lexer_skip (self, skip_count);
       return (Token){ .kind_ = TOKEN_INTEGER,
-                      .span_ = Span_new (token_begin, skip_count) };
+                      .span_ = Lexer_span (self, token_begin, skip_count) };
     }
   if (self->cursor_ < Span_cend (&self->span_))
     {
@@ -223,9 +244,159 @@ Lexer_next (Lexer *self)
       skip_count = Lexer_next_whitespace_or_comments (self);
       Lexer_skip (self, skip_count);
       return (Token){ .kind_ = TOKEN_INVALID,
-                      .span_ = Span_new (token_begin, skip_count) };
+                      .span_ = Lexer_span (self, token_begin, skip_count) };
+    }
+  return (Token){ .kind_ = TOKEN_EOF,
+                  .span_ = Lexer_span (self, self->cursor_, 0) };
+}
+
+/* Lexes from BEGIN up to END, where the chunk ends with a newline or
+ * with SPAN.  The EOF token is kept for the last chunk only.  */
+static void
+lex_chunk (const Span *span, uint32_t begin, uint32_t end, Vec_Token *tokens)
+{
+  Span chunk_span = Span_new (Span_cbegin (span), end);
+  Lexer lexer = Lexer_new_at (&chunk_span, begin);
+  Token token = Lexer_next (&lexer);
+  while (!Token_is_eof (&token))
+    {
+      Vec_Token_push (tokens, token);
+      token = Lexer_next (&lexer);
+    }
+  if (end == Span_len (span))
+    {
+      Vec_Token_push (tokens, token);
+    }
+}
+
+typedef struct LexChunks LexChunks;
+
+typedef struct LexChunk
+{
+  LexChunks *chunks_;
+  uint32_t begin_;
+  uint32_t end_;
+  Vec_Token tokens_;
+} LexChunk;
+
+/* The chunks after the first, which the calling thread waits for.  */
+struct LexChunks
+{
+  const Span *span_;
+  LexChunk *begin_;
+  size_t len_;
+  /* Guards NUM_LEFT.  */
+  mtx_t lock_;
+  cnd_t done_notify_;
+  size_t num_left_;
+};
+
+static void
+LexChunk_run (void *chunk_arg)
+{
+  LexChunk *chunk = chunk_arg;
+  LexChunks *chunks = chunk->chunks_;
+  lex_chunk (chunks->span_, chunk->begin_, chunk->end_, &chunk->tokens_);
+  if (mtx_lock (&chunks->lock_) != thrd_success)
+    {
+      abort ();
+    }
+  if (--chunks->num_left_ == 0
+      && cnd_signal (&chunks->done_notify_) != thrd_success)
+    {
+      abort ();
+    }
+  if (mtx_unlock (&chunks->lock_) != thrd_success)
+    {
+      abort ();
+    }
+}
+
+/* Returns the offset just past the first newline at or after OFFSET, or
+ * the length of SPAN if there is none.  */
+static uint32_t
+chunk_boundary (const Span *span, uint32_t offset)
+{
+  const char *newline = memchr (Span_cbegin (span) + offset, '\n',
+                                Span_len (span) - offset);
+  return newline ? (uint32_t)(newline - Span_cbegin (span)) + 1
+                 : Span_len (span);
+}
+
+void
+Lexer_lex_parallel (const Span *span, ThreadPool *pool, size_t num_chunks,
+                    Vec_Token *tokens)
+{
+  assert (Span_len (span) <= UINT32_MAX);
+  uint32_t len = Span_len (span);
+  if (num_chunks < 2)
+    {
+      lex_chunk (span, 0, len, tokens);
+      return;
     }
-  return (Token){ .kind_ = TOKEN_EOF, .span_ = Span_new (self->cursor_, 0) };
+  uint32_t first_end = chunk_boundary (span, len / num_chunks);
+  LexChunks chunks = { .span_ = span, .len_ = 0, .num_left_ = 0 };
+  chunks.begin_ = (LexChunk *)malloc (num_chunks * sizeof (LexChunk));
+  if (chunks.begin_ == NULL
+      || mtx_init (&chunks.lock_, mtx_plain) != thrd_success
+      || cnd_init (&chunks.done_notify_) != thrd_success)
+    {
+      abort ();
+    }
+  /* Every chunk is counted before any is run, so that the count cannot
+   * drop to zero early.  A long line may swallow the targets of the
+   * chunks after it, which are then skipped.  */
+  uint32_t begin = first_end;
+  for (size_t i = 2; begin < len; i++)
+    {
+      uint64_t target = (uint64_t)len * i / num_chunks;
+      uint32_t end = len;
+      if (i < num_chunks)
+        {
+          end = chunk_boundary (span, target > begin ? target : begin);
+        }
+      chunks.begin_[chunks.len_++] = (LexChunk){ .chunks_ = &chunks,
+                                                 .begin_ = begin,
+                                                 .end_ = end,
+                                                 .tokens_ = Vec_Token_new () };
+      begin = end;
+    }
+  chunks.num_left_ = chunks.len_;
+  for (size_t i = 0; i < chunks.len_; i++)
+    {
+      ThreadPool_execute (pool, LexChunk_run, chunks.begin_ + i);
+    }
+  lex_chunk (span, 0, first_end, tokens);
+  if (mtx_lock (&chunks.lock_) != thrd_success)
+    {
+      abort ();
+    }
+  while (chunks.num_left_)
+    {
+      if (cnd_wait (&chunks.done_notify_, &chunks.lock_) != thrd_success)
+        {
+          abort ();
+        }
+    }
+  if (mtx_unlock (&chunks.lock_) != thrd_success)
+    {
+      abort ();
+    }
+  size_t num_tokens = 0;
+  for (size_t i = 0; i < chunks.len_; i++)
+    {
+      num_tokens += Vec_Token_len (&chunks.begin_[i].tokens_);
+    }
+  Vec_Token_reserve_exact (tokens, num_tokens);
+  for (size_t i = 0; i < chunks.len_; i++)
+    {
+      Vec_Token_extend (tokens, Vec_Token_cbegin (&chunks.begin_[i].tokens_),
+                        Vec_Token_len (&chunks.begin_[i].tokens_));
+      Vec_Token_drop (&chunks.begin_[i].tokens_);
+    }
+  mtx_destroy (&chunks.lock_);
+  cnd_destroy (&chunks.done_notify_);
+  free (chunks.begin_);
 }
 
 #ifdef TESTS
@@ -286,6 +457,100 @@ NEO_TEST (test_lex_true_01)
   Vec_Token_drop (&tokens);
 }
 
+NEO_TEST (test_lex_parallel_00)
+{
+  static const char *const contents[] = {
+    "",
+    "\n\n",
+    "let x = 1 // one\n"
+    "in\n"
+    "\n"
+    "// only a comment\n"
+    "if x < 20 then ($ ?, x) else f(x + 300000, y_1)\n"
+    "(a, b) +> a == b // end",
+    "true\nfalse\n",
+  };
+  ThreadPool pool = ThreadPool_new (3);
+  for (size_t i = 0; i < sizeof (contents) / sizeof (contents[0]); i++)
+    {
+      Vec_Token expected = lex_tokens (contents[i]);
+      Span span = Span_from_cstring (contents[i]);
+      for (size_t num_chunks = 0; num_chunks < 40; num_chunks++)
+        {
+          Vec_Token tokens = Vec_Token_new ();
+          Lexer_lex_parallel (&span, &pool, num_chunks, &tokens);
+          ASSERT_U64_EQ (Vec_Token_len (&tokens), Vec_Token_len (&expected));
+          for (size_t j = 0; j < Vec_Token_len (&tokens); j++)
+            {
+              const Token *x = Vec_Token_cbegin (&tokens) + j;
+              const Token *y = Vec_Token_cbegin (&expected) + j;
+              ASSERT_U64_EQ (x->kind_, y->kind_);
+              ASSERT_U64_EQ (CompactSpan_get_offset (&x->span_),
+                             CompactSpan_get_offset (&y->span_));
+              ASSERT_U64_EQ (CompactSpan_len (&x->span_),
+                             CompactSpan_len (&y->span_));
+            }
+          Vec_Token_drop (&tokens);
+        }
+      Vec_Token_drop (&expected);
+    }
+  ThreadPool_drop (&pool);
+}
+
 NEO_TESTS (lexer_tests, test_seeing_token_lit_00, test_seeing_token_lit_01,
-           test_seeing_token_lit_02, test_lex_true_00, test_lex_true_01)
+           test_seeing_token_lit_02, test_lex_true_00, test_lex_true_01,
+           test_lex_parallel_00)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+#include "string.h"
+
+NEO_BENCH (bench_lex_00)
+{
+  String content = bench_gen_source (1 << 20, 42);
+  Span span = Span_from_string (&content);
+  size_t num_tokens = 0, num_bytes = 0;
+  BENCH_ITER
+  {
+    Lexer lexer = Lexer_new (&span);
+    Vec_Token tokens = Vec_Token_new ();
+    Token token;
+    do
+      {
+        token = Lexer_next (&lexer);
+        Vec_Token_push (&tokens, token);
+      }
+    while (!Token_is_eof (&token));
+    num_tokens = Vec_Token_len (&tokens);
+    num_bytes = Vec_Token_capacity (&tokens) * sizeof (Token);
+    Vec_Token_drop (&tokens);
+  }
+  Bencher_report_u64 (bencher_, "tokens", num_tokens);
+  Bencher_report_u64 (bencher_, "token bytes", num_bytes);
+  String_drop (&content);
+}
+
+/* On the corpus of bench_lex_00, so that the two compare.  */
+NEO_BENCH (bench_lex_parallel_00)
+{
+  String content = bench_gen_source (1 << 20, 42);
+  Span span = Span_from_string (&content);
+  ThreadPool pool = ThreadPool_new (4);
+  size_t num_tokens = 0;
+  BENCH_ITER
+  {
+    Vec_Token tokens = Vec_Token_new ();
+    Lexer_lex_parallel (&span, &pool, 16, &tokens);
+    num_tokens = Vec_Token_len (&tokens);
+    Vec_Token_drop (&tokens);
+  }
+  Bencher_report_u64 (bencher_, "tokens", num_tokens);
+  Bencher_report_u64 (bencher_, "threads", 4);
+  ThreadPool_drop (&pool);
+  String_drop (&content);
+}
+
+NEO_BENCHES (lexer_benches, bench_lex_00, bench_lex_parallel_00)
 #endif
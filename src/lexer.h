@@ -3,7 +3,11 @@
 #ifndef NEO_LEXER_H
 #define NEO_LEXER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "span.h"
+#include "thread_pool.h"
 #include "token.h"
 
 typedef struct Lexer
@@ -13,11 +17,26 @@ typedef struct Lexer
 } Lexer;
 
 Lexer Lexer_new (const Span *span);
+/* Starts lexing at OFFSET, which must not be inside a token or a comment.
+ * Token spans stay relative to the beginning of SPAN.  */
+Lexer Lexer_new_at (const Span *span, uint32_t offset);
 Token Lexer_next (Lexer *self);
+/* Appends to TOKENS what a loop of Lexer_next over SPAN gives, up to the
+ * EOF token included.  Since no token spans a newline, SPAN is cut after
+ * newlines into about NUM_CHUNKS chunks, which are lexed on POOL and by
+ * the calling thread at once.  Only the calling thread touches TOKENS, so
+ * it may live in an arena.  */
+void Lexer_lex_parallel (const Span *span, ThreadPool *pool,
+                         size_t num_chunks, Vec_Token *tokens);
 
 #ifdef TESTS
 #include "test.h"
 Tests lexer_tests ();
 #endif
 
+#ifdef BENCHES
+#include "bench.h"
+Benches lexer_benches ();
+#endif
+
 #endif
@@ -0,0 +1,1050 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "lsp.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include "ast_node.h"
+#include "diagnostic.h"
+#include "document.h"
+#include "json.h"
+#include "span.h"
+#include "string.h"
+#include "thread_pool.h"
+#include "type.h"
+#include "vec_macro.h"
+
+NEO_IMPL_VEC (LspDocumentPtr, LspDocumentPtr)
+
+enum LspErrorCode
+{
+  LSP_PARSE_ERROR = -32700,
+  LSP_INVALID_REQUEST = -32600,
+  LSP_METHOD_NOT_FOUND = -32601
+};
+
+/* Reads the body of the next message into BODY.  Returns false at the end
+ * of input.  */
+static bool
+read_message (FILE *in, String *body)
+{
+  size_t len = 0;
+  bool has_len = false;
+  char line[256];
+  while (true)
+    {
+      if (!fgets (line, sizeof (line), in))
+        {
+          return false;
+        }
+      if (!strcmp (line, "\r\n") || !strcmp (line, "\n"))
+        {
+          if (has_len)
+            {
+              break;
+            }
+          continue;
+        }
+      if (!strncmp (line, "Content-Length:", strlen ("Content-Length:")))
+        {
+          len = strtoull (line + strlen ("Content-Length:"), NULL, 10);
+          has_len = true;
+        }
+    }
+  String_clear (body);
+  char buf[4096];
+  while (len)
+    {
+      size_t num_read
+          = fread (buf, 1, len < sizeof (buf) ? len : sizeof (buf), in);
+      if (!num_read)
+        {
+          return false;
+        }
+      String_push_carray (body, buf, num_read);
+      len -= num_read;
+    }
+  return true;
+}
+
+static String
+copy_string (const String *str)
+{
+  String copy = String_new ();
+  String_push_string (&copy, str);
+  return copy;
+}
+
+static bool
+String_eq (const String *self, const String *other)
+{
+  return String_len (self) == String_len (other)
+         && !memcmp (String_cbegin (self), String_cbegin (other),
+                     String_len (self));
+}
+
+static uint32_t
+json_to_u32 (const Json *json)
+{
+  double number = Json_get_number (json);
+  if (number <= 0)
+    {
+      return 0;
+    }
+  return number < UINT32_MAX ? (uint32_t)number : UINT32_MAX;
+}
+
+/* Neo source is ASCII, where the UTF-16 code units that LSP counts columns
+ * in are bytes.  */
+static uint32_t
+SourceFile_lookup_lsp_offset (const SourceFile *self, const Json *position)
+{
+  return SourceFile_lookup_offset (
+      self,
+      Position_new ((size_t)json_to_u32 (Json_get (position, "line")) + 1,
+                    json_to_u32 (Json_get (position, "character"))));
+}
+
+static void
+String_push_lsp_position (String *self, const SourceFile *file,
+                          uint32_t offset)
+{
+  Position pos = SourceFile_lookup_position (
+      file, String_cbegin (SourceFile_get_content (file)) + offset);
+  String_push_cstring (self, "{\"line\":");
+  String_push_u64 (self, Position_get_line (&pos) - 1);
+  String_push_cstring (self, ",\"character\":");
+  String_push_u64 (self, Position_get_column (&pos));
+  String_push (self, '}');
+}
+
+static void
+String_push_lsp_range (String *self, const SourceFile *file, CompactSpan span)
+{
+  String_push_cstring (self, "{\"start\":");
+  String_push_lsp_position (self, file, CompactSpan_get_offset (&span));
+  String_push_cstring (self, ",\"end\":");
+  String_push_lsp_position (self, file, CompactSpan_get_end (&span));
+  String_push (self, '}');
+}
+
+static const char *
+diagnostic_name_to_cstring (enum DiagnosticName name)
+{
+  switch (name)
+    {
+#define NEO_DIAGNOSTIC(NAME, UNUSED)                                          \
+  case DIAGNOSTIC_##NAME:                                                     \
+    return #NAME;
+#include "diagnostic.def"
+#undef NEO_DIAGNOSTIC
+    }
+  return "";
+}
+
+static int
+diagnostic_level_to_severity (enum DiagnosticLevel level)
+{
+  switch (level)
+    {
+    case DIAG_LEVEL_ERROR:
+      return 1;
+    case DIAG_LEVEL_WARNING:
+      return 2;
+    case DIAG_LEVEL_NOTE:
+      return 3;
+    }
+  return 1;
+}
+
+/* Appends the diagnostics of DIAG_MGR to an array being built, after a
+ * comma unless it is the first.  */
+static void
+String_push_lsp_diagnostics (String *self, const DiagnosticManager *diag_mgr,
+                             const SourceFile *file, bool *first)
+{
+  for (DiagnosticId id = 0; id < DiagnosticManager_num_stored (diag_mgr);
+       id++)
+    {
+      const Diagnostic *diag = DiagnosticManager_get (diag_mgr, id);
+      if (!*first)
+        {
+          String_push (self, ',');
+        }
+      *first = false;
+      String_push_cstring (self, "{\"range\":");
+      String_push_lsp_range (self, file, Diagnostic_get_span (diag));
+      String_push_cstring (self, ",\"severity\":");
+      String_push_u64 (
+          self, diagnostic_level_to_severity (Diagnostic_get_level (diag)));
+      String_push_cstring (self, ",\"code\":\"");
+      String_push_cstring (self, diagnostic_name_to_cstring (diag->name_));
+      String_push_cstring (self, "\",\"source\":\"neo\",\"message\":");
+      String message = DiagnosticManager_fmt_message (diag_mgr, id);
+      String_push_json_string (self, String_cbegin (&message),
+                               String_len (&message));
+      String_drop (&message);
+      String_push (self, '}');
+    }
+}
+
+static LspDocument *
+LspDocument_new (const String *uri)
+{
+  LspDocument *self = (LspDocument *)malloc (sizeof (LspDocument));
+  if (self == NULL)
+    {
+      abort ();
+    }
+  self->uri_ = copy_string (uri);
+  atomic_init (&self->cancel_, false);
+  if (mtx_init (&self->lock_, mtx_plain) != thrd_success)
+    {
+      abort ();
+    }
+  self->open_ = false;
+  self->generation_ = 0;
+  self->version_ = 0;
+  return self;
+}
+
+static void
+LspDocument_drop (LspDocument *self)
+{
+  if (self->open_)
+    {
+      Document_drop (&self->doc_);
+    }
+  mtx_destroy (&self->lock_);
+  String_drop (&self->uri_);
+}
+
+static void
+LspDocument_lock (LspDocument *self)
+{
+  if (mtx_lock (&self->lock_) != thrd_success)
+    {
+      abort ();
+    }
+}
+
+/* Takes the lock for the main loop, cancelling the check that holds it
+ * rather than waiting for the check to finish.  */
+static void
+LspDocument_lock_cancel (LspDocument *self)
+{
+  atomic_store (&self->cancel_, true);
+  LspDocument_lock (self);
+  atomic_store (&self->cancel_, false);
+}
+
+/* Returns false if the lock is held, as by a check in flight.  */
+static bool
+LspDocument_try_lock (LspDocument *self)
+{
+  int status = mtx_trylock (&self->lock_);
+  if (status == thrd_error)
+    {
+      abort ();
+    }
+  return status == thrd_success;
+}
+
+static void
+LspDocument_unlock (LspDocument *self)
+{
+  if (mtx_unlock (&self->lock_) != thrd_success)
+    {
+      abort ();
+    }
+}
+
+static void
+LspServer_lock (LspServer *self)
+{
+  if (mtx_lock (&self->out_lock_) != thrd_success)
+    {
+      abort ();
+    }
+}
+
+static void
+LspServer_unlock (LspServer *self)
+{
+  if (mtx_unlock (&self->out_lock_) != thrd_success)
+    {
+      abort ();
+    }
+}
+
+void
+LspServer_init (LspServer *self, FILE *in, FILE *out, size_t num_threads)
+{
+  self->in_ = in;
+  self->out_ = out;
+  self->docs_ = Vec_LspDocumentPtr_new ();
+  self->pool_ = ThreadPool_new (num_threads);
+  if (mtx_init (&self->out_lock_, mtx_plain) != thrd_success)
+    {
+      abort ();
+    }
+  self->num_analyses_ = 0;
+  self->num_cancelled_ = 0;
+  self->shutdown_ = false;
+  self->exit_ = false;
+}
+
+void
+LspServer_drop (LspServer *self)
+{
+  ThreadPool_drop (&self->pool_);
+  for (LspDocumentPtr *doc = Vec_LspDocumentPtr_begin (&self->docs_);
+       doc < Vec_LspDocumentPtr_end (&self->docs_); doc++)
+    {
+      LspDocument_drop (*doc);
+      free (*doc);
+    }
+  Vec_LspDocumentPtr_drop (&self->docs_);
+  mtx_destroy (&self->out_lock_);
+}
+
+/* Frames and writes BODY.  The caller holds the output lock.  */
+static void
+LspServer_send (LspServer *self, const String *body)
+{
+  fprintf (self->out_, "Content-Length: %zu\r\n\r\n", String_len (body));
+  fwrite (String_cbegin (body), 1, String_len (body), self->out_);
+  fflush (self->out_);
+}
+
+static void
+String_push_lsp_id (String *self, const Json *id)
+{
+  if (id)
+    {
+      String_push_json (self, id);
+    }
+  else
+    {
+      String_push_cstring (self, "null");
+    }
+}
+
+static void
+LspServer_respond (LspServer *self, const Json *id, const String *result)
+{
+  String body = String_from_cstring ("{\"jsonrpc\":\"2.0\",\"id\":");
+  String_push_lsp_id (&body, id);
+  String_push_cstring (&body, ",\"result\":");
+  String_push_string (&body, result);
+  String_push (&body, '}');
+  LspServer_lock (self);
+  LspServer_send (self, &body);
+  LspServer_unlock (self);
+  String_drop (&body);
+}
+
+static void
+LspServer_respond_error (LspServer *self, const Json *id,
+                         enum LspErrorCode code, const char *message)
+{
+  String body = String_from_cstring ("{\"jsonrpc\":\"2.0\",\"id\":");
+  String_push_lsp_id (&body, id);
+  String_push_cstring (&body, ",\"error\":{\"code\":");
+  String_push_i64 (&body, code);
+  String_push_cstring (&body, ",\"message\":");
+  String_push_json_string (&body, message, strlen (message));
+  String_push_cstring (&body, "}}");
+  LspServer_lock (self);
+  LspServer_send (self, &body);
+  LspServer_unlock (self);
+  String_drop (&body);
+}
+
+/* Sends the diagnostics of DOC, or none if it was closed.  The caller holds
+ * the document lock, so that diagnostics of one document go out in the
+ * order of its changes.  */
+static void
+LspServer_publish (LspServer *self, const LspDocument *doc)
+{
+  String body = String_from_cstring (
+      "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\","
+      "\"params\":{\"uri\":");
+  String_push_json_string (&body, String_cbegin (&doc->uri_),
+                           String_len (&doc->uri_));
+  if (doc->open_)
+    {
+      String_push_cstring (&body, ",\"version\":");
+      String_push_i64 (&body, doc->version_);
+    }
+  String_push_cstring (&body, ",\"diagnostics\":[");
+  if (doc->open_)
+    {
+      const SourceFile *file = Document_get_file (&doc->doc_);
+      bool first = true;
+      String_push_lsp_diagnostics (
+          &body, Document_get_diagnostic_manager (&doc->doc_), file, &first);
+      String_push_lsp_diagnostics (
+          &body, Document_get_check_diagnostic_manager (&doc->doc_), file,
+          &first);
+    }
+  String_push_cstring (&body, "]}}");
+  LspServer_lock (self);
+  LspServer_send (self, &body);
+  LspServer_unlock (self);
+  String_drop (&body);
+}
+
+typedef struct LspAnalysis
+{
+  LspServer *server_;
+  LspDocument *doc_;
+  uint64_t generation_;
+} LspAnalysis;
+
+static void
+LspAnalysis_run (void *arg)
+{
+  LspAnalysis *self = arg;
+  LspDocument *doc = self->doc_;
+  LspDocument_lock (doc);
+  /* A newer change has its own analysis queued behind this one, or is about
+   * to once it has cancelled this check.  */
+  bool stale = !doc->open_ || doc->generation_ != self->generation_;
+  if (!stale)
+    {
+      Document_check (&doc->doc_);
+      stale = atomic_load (&doc->cancel_);
+    }
+  if (!stale)
+    {
+      LspServer_publish (self->server_, doc);
+    }
+  LspDocument_unlock (doc);
+  /* Counted once the document is free for hovers.  */
+  LspServer_lock (self->server_);
+  if (stale)
+    {
+      self->server_->num_cancelled_++;
+    }
+  else
+    {
+      self->server_->num_analyses_++;
+    }
+  LspServer_unlock (self->server_);
+  free (self);
+}
+
+static void
+LspServer_analyze (LspServer *self, LspDocument *doc, uint64_t generation)
+{
+  LspAnalysis *analysis = (LspAnalysis *)malloc (sizeof (LspAnalysis));
+  if (analysis == NULL)
+    {
+      abort ();
+    }
+  *analysis = (LspAnalysis){ .server_ = self,
+                             .doc_ = doc,
+                             .generation_ = generation };
+  ThreadPool_execute (&self->pool_, LspAnalysis_run, analysis);
+}
+
+static LspDocument *
+LspServer_find (LspServer *self, const String *uri)
+{
+  for (LspDocumentPtr *doc = Vec_LspDocumentPtr_begin (&self->docs_);
+       doc < Vec_LspDocumentPtr_end (&self->docs_); doc++)
+    {
+      if (String_eq (&(*doc)->uri_, uri))
+        {
+          return *doc;
+        }
+    }
+  return NULL;
+}
+
+static const String *
+get_uri (const Json *params)
+{
+  return Json_get_string (Json_get (Json_get (params, "textDocument"), "uri"));
+}
+
+static void
+LspServer_initialize (LspServer *self, const Json *id)
+{
+  String result = String_from_cstring (
+      "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,"
+      "\"change\":2},\"hoverProvider\":true},"
+      "\"serverInfo\":{\"name\":\"neo\"}}");
+  LspServer_respond (self, id, &result);
+  String_drop (&result);
+}
+
+static void
+LspServer_did_open (LspServer *self, const Json *params)
+{
+  const Json *item = Json_get (params, "textDocument");
+  const String *uri = get_uri (params);
+  const String *text = Json_get_string (Json_get (item, "text"));
+  if (!uri || !text)
+    {
+      return;
+    }
+  LspDocument *doc = LspServer_find (self, uri);
+  if (!doc)
+    {
+      doc = LspDocument_new (uri);
+      Vec_LspDocumentPtr_push (&self->docs_, doc);
+    }
+  LspDocument_lock_cancel (doc);
+  if (doc->open_)
+    {
+      Document_drop (&doc->doc_);
+    }
+  Document_init (&doc->doc_, copy_string (uri), copy_string (text));
+  Document_set_cancel (&doc->doc_, &doc->cancel_);
+  doc->open_ = true;
+  doc->version_ = (int64_t)Json_get_number (Json_get (item, "version"));
+  uint64_t generation = ++doc->generation_;
+  LspDocument_unlock (doc);
+  LspServer_analyze (self, doc, generation);
+}
+
+static void
+LspServer_did_change (LspServer *self, const Json *params)
+{
+  const String *uri = get_uri (params);
+  LspDocument *doc = uri ? LspServer_find (self, uri) : NULL;
+  if (!doc || !doc->open_)
+    {
+      return;
+    }
+  const Json *changes = Json_get (params, "contentChanges");
+  LspDocument_lock_cancel (doc);
+  /* Each change applies to the text the previous one left.  */
+  for (size_t i = 0; i < Json_len (changes); i++)
+    {
+      const Json *change = Json_at (changes, i);
+      const String *text = Json_get_string (Json_get (change, "text"));
+      if (!text)
+        {
+          continue;
+        }
+      const SourceFile *file = Document_get_file (&doc->doc_);
+      uint32_t begin = 0;
+      uint32_t end = String_len (SourceFile_get_content (file));
+      const Json *range = Json_get (change, "range");
+      if (range)
+        {
+          begin
+              = SourceFile_lookup_lsp_offset (file, Json_get (range, "start"));
+          end = SourceFile_lookup_lsp_offset (file, Json_get (range, "end"));
+          end = end < begin ? begin : end;
+        }
+      Document_edit (&doc->doc_,
+                     TextEdit_new (CompactSpan_new (begin, end - begin),
+                                   Span_from_string (text)));
+    }
+  doc->version_ = (int64_t)Json_get_number (
+      Json_get (Json_get (params, "textDocument"), "version"));
+  uint64_t generation = ++doc->generation_;
+  LspDocument_unlock (doc);
+  LspServer_analyze (self, doc, generation);
+}
+
+static void
+LspServer_did_close (LspServer *self, const Json *params)
+{
+  const String *uri = get_uri (params);
+  LspDocument *doc = uri ? LspServer_find (self, uri) : NULL;
+  if (!doc || !doc->open_)
+    {
+      return;
+    }
+  LspDocument_lock_cancel (doc);
+  Document_drop (&doc->doc_);
+  doc->open_ = false;
+  doc->generation_++;
+  LspServer_publish (self, doc);
+  LspDocument_unlock (doc);
+}
+
+static void
+LspServer_hover (LspServer *self, const Json *id, const Json *params)
+{
+  const String *uri = get_uri (params);
+  LspDocument *doc = uri ? LspServer_find (self, uri) : NULL;
+  String result = String_from_cstring ("null");
+  /* Types are those of the last check.  A check in flight will publish
+   * soon, and is neither waited for nor cancelled.  */
+  if (doc && LspDocument_try_lock (doc))
+    {
+      if (doc->open_)
+        {
+          const SourceFile *file = Document_get_file (&doc->doc_);
+          uint32_t offset = SourceFile_lookup_lsp_offset (
+              file, Json_get (params, "position"));
+          ASTNodeId node = Document_find_node (&doc->doc_, offset);
+          const TypeManager *type_mgr
+              = Document_get_type_manager (&doc->doc_);
+          /* Nodes the checker never reached, such as the vars of a tuple,
+           * or those changed since, have no type to show.  */
+          if (!is_null_ast_node_id (node)
+              && !TypeManager_is_unknown (
+                  type_mgr, Document_get_type (&doc->doc_, node)))
+            {
+              TypeId type = Document_get_type (&doc->doc_, node);
+              String type_str = TypeManager_to_string (type_mgr, type);
+              String_clear (&result);
+              String_push_cstring (
+                  &result, "{\"contents\":{\"kind\":\"plaintext\",\"value\":");
+              String_push_json_string (&result, String_cbegin (&type_str),
+                                       String_len (&type_str));
+              String_push_cstring (&result, "},\"range\":");
+              String_push_lsp_range (
+                  &result, file,
+                  *ASTNodeManager_get_span (
+                      Document_get_ast_manager (&doc->doc_), node));
+              String_push (&result, '}');
+              String_drop (&type_str);
+            }
+        }
+      LspDocument_unlock (doc);
+    }
+  LspServer_respond (self, id, &result);
+  String_drop (&result);
+}
+
+void
+LspServer_handle (LspServer *self, const Json *message)
+{
+  const Json *id = Json_get (message, "id");
+  const String *method_str = Json_get_string (Json_get (message, "method"));
+  /* Without a method, it answers a request, and none are ever sent.  */
+  if (!method_str)
+    {
+      return;
+    }
+  Span method = Span_from_string (method_str);
+  const Json *params = Json_get (message, "params");
+  if (!Span_cmp_cstring (&method, "exit"))
+    {
+      self->exit_ = true;
+    }
+  else if (self->shutdown_)
+    {
+      if (id)
+        {
+          LspServer_respond_error (self, id, LSP_INVALID_REQUEST,
+                                   "server is shut down");
+        }
+    }
+  else if (!Span_cmp_cstring (&method, "initialize"))
+    {
+      LspServer_initialize (self, id);
+    }
+  else if (!Span_cmp_cstring (&method, "shutdown"))
+    {
+      self->shutdown_ = true;
+      String result = String_from_cstring ("null");
+      LspServer_respond (self, id, &result);
+      String_drop (&result);
+    }
+  else if (!Span_cmp_cstring (&method, "textDocument/didOpen"))
+    {
+      LspServer_did_open (self, params);
+    }
+  else if (!Span_cmp_cstring (&method, "textDocument/didChange"))
+    {
+      LspServer_did_change (self, params);
+    }
+  else if (!Span_cmp_cstring (&method, "textDocument/didClose"))
+    {
+      LspServer_did_close (self, params);
+    }
+  else if (!Span_cmp_cstring (&method, "textDocument/hover"))
+    {
+      LspServer_hover (self, id, params);
+    }
+  else if (id)
+    {
+      LspServer_respond_error (self, id, LSP_METHOD_NOT_FOUND,
+                               "method not found");
+    }
+}
+
+int
+LspServer_run (LspServer *self)
+{
+  String body = String_new ();
+  while (!self->exit_ && read_message (self->in_, &body))
+    {
+      Json message;
+      if (Json_parse (&message, String_cbegin (&body), String_len (&body)))
+        {
+          LspServer_handle (self, &message);
+        }
+      else
+        {
+          LspServer_respond_error (self, NULL, LSP_PARSE_ERROR,
+                                   "parse error");
+        }
+      Json_drop (&message);
+    }
+  String_drop (&body);
+  return self->exit_ && self->shutdown_ ? 0 : 1;
+}
+
+#ifdef TESTS
+#include "test.h"
+
+static void
+write_message (FILE *file, const char *body)
+{
+  fprintf (file, "Content-Length: %zu\r\n\r\n%s", strlen (body), body);
+}
+
+static void
+read_sent (FILE *out, Vec_Json *sent)
+{
+  rewind (out);
+  String body = String_new ();
+  while (read_message (out, &body))
+    {
+      Json message;
+      Json_parse (&message, String_cbegin (&body), String_len (&body));
+      Vec_Json_push (sent, message);
+    }
+  String_drop (&body);
+}
+
+static void
+drop_sent (Vec_Json *sent)
+{
+  for (Json *message = Vec_Json_begin (sent); message < Vec_Json_end (sent);
+       message++)
+    {
+      Json_drop (message);
+    }
+  Vec_Json_drop (sent);
+}
+
+/* Plays BODIES, as a client would send them, to a fresh server and collects
+ * what it sent back.  Returns the exit code.  */
+static int
+run_session (const char *const *bodies, size_t len, Vec_Json *sent)
+{
+  FILE *in = tmpfile ();
+  FILE *out = tmpfile ();
+  for (size_t i = 0; i < len; i++)
+    {
+      write_message (in, bodies[i]);
+    }
+  rewind (in);
+  LspServer server;
+  LspServer_init (&server, in, out, 2);
+  int code = LspServer_run (&server);
+  LspServer_drop (&server);
+  *sent = Vec_Json_new ();
+  read_sent (out, sent);
+  fclose (out);
+  fclose (in);
+  return code;
+}
+
+static bool
+json_eq_cstring (const Json *json, const char *cstr)
+{
+  const String *str = Json_get_string (json);
+  return str && String_len (str) == strlen (cstr)
+         && !memcmp (String_cbegin (str), cstr, strlen (cstr));
+}
+
+static const Json *
+find_response (const Vec_Json *sent, int64_t id)
+{
+  for (const Json *message = Vec_Json_cbegin (sent);
+       message < Vec_Json_cend (sent); message++)
+    {
+      const Json *message_id = Json_get (message, "id");
+      if (Json_get_kind (message_id) == JSON_NUMBER
+          && Json_get_number (message_id) == id)
+        {
+          return message;
+        }
+    }
+  return NULL;
+}
+
+/* Returns the params of the last diagnostics published for URI.  */
+static const Json *
+last_diagnostics (const Vec_Json *sent, const char *uri)
+{
+  const Json *last = NULL;
+  for (const Json *message = Vec_Json_cbegin (sent);
+       message < Vec_Json_cend (sent); message++)
+    {
+      const Json *params = Json_get (message, "params");
+      if (json_eq_cstring (Json_get (message, "method"),
+                           "textDocument/publishDiagnostics")
+          && json_eq_cstring (Json_get (params, "uri"), uri))
+        {
+          last = params;
+        }
+    }
+  return last;
+}
+
+NEO_TEST (test_lsp_session_00)
+{
+  const char *const bodies[] = {
+    "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\","
+    "\"params\":{\"capabilities\":{}}}",
+    "{\"jsonrpc\":\"2.0\",\"method\":\"initialized\",\"params\":{}}",
+    "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":"
+    "{\"textDocument\":{\"uri\":\"file:///a.neo\",\"languageId\":\"neo\","
+    "\"version\":1,\"text\":\"let x = true in\\nif x then x else false\"}}}",
+    "{\"jsonrpc\":\"2.0\",\"id\":3,\"method\":\"textDocument/hover\","
+    "\"params\":{\"textDocument\":{\"uri\":\"file:///a.neo\"},"
+    "\"position\":{\"line\":7,\"character\":0}}}",
+    "{\"jsonrpc\":\"2.0\",\"id\":4,\"method\":\"textDocument/definition\","
+    "\"params\":{}}",
+    "{\"jsonrpc\":",
+    "{\"jsonrpc\":\"2.0\",\"id\":5,\"method\":\"shutdown\"}",
+    "{\"jsonrpc\":\"2.0\",\"method\":\"exit\"}",
+  };
+  Vec_Json sent;
+  ASSERT_I64_EQ (run_session (bodies, sizeof (bodies) / sizeof (bodies[0]),
+                              &sent),
+                 0);
+  const Json *init = Json_get (find_response (&sent, 1), "result");
+  ASSERT_U64_EQ (Json_get_kind (Json_get (Json_get (init, "capabilities"),
+                                          "hoverProvider")),
+                 JSON_TRUE);
+  ASSERT_U64_EQ (Json_get_kind (Json_get (find_response (&sent, 3), "result")),
+                 JSON_NULL);
+  ASSERT_I64_EQ (Json_get_number (Json_get (
+                     Json_get (find_response (&sent, 4), "error"), "code")),
+                 LSP_METHOD_NOT_FOUND);
+  size_t num_parse_errors = 0;
+  for (const Json *message = Vec_Json_cbegin (&sent);
+       message < Vec_Json_cend (&sent); message++)
+    {
+      num_parse_errors
+          += Json_get_number (Json_get (Json_get (message, "error"), "code"))
+             == LSP_PARSE_ERROR;
+    }
+  ASSERT_U64_EQ (num_parse_errors, 1);
+  ASSERT_U64_EQ (Json_get (find_response (&sent, 5), "result") != NULL, true);
+  const Json *diags = last_diagnostics (&sent, "file:///a.neo");
+  ASSERT_I64_EQ (Json_get_number (Json_get (diags, "version")), 1);
+  ASSERT_U64_EQ (Json_get_kind (Json_get (diags, "diagnostics")), JSON_ARRAY);
+  ASSERT_U64_EQ (Json_len (Json_get (diags, "diagnostics")), 0);
+  drop_sent (&sent);
+}
+
+NEO_TEST (test_lsp_diagnostics_00)
+{
+  /* Broken, then fixed by an incremental change.  */
+  const char *const fixed[] = {
+    "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":"
+    "{\"textDocument\":{\"uri\":\"file:///a.neo\",\"version\":1,"
+    "\"text\":\"if true then\"}}}",
+    "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\",\"params\":"
+    "{\"textDocument\":{\"uri\":\"file:///a.neo\",\"version\":2},"
+    "\"contentChanges\":[{\"range\":{\"start\":{\"line\":0,\"character\":12},"
+    "\"end\":{\"line\":0,\"character\":12}},\"text\":\" false\"},"
+    "{\"range\":{\"start\":{\"line\":0,\"character\":18},"
+    "\"end\":{\"line\":0,\"character\":18}},\"text\":\" else true\"}]}}",
+  };
+  Vec_Json sent;
+  ASSERT_I64_EQ (run_session (fixed, sizeof (fixed) / sizeof (fixed[0]),
+                              &sent),
+                 1);
+  const Json *diags = last_diagnostics (&sent, "file:///a.neo");
+  ASSERT_I64_EQ (Json_get_number (Json_get (diags, "version")), 2);
+  ASSERT_U64_EQ (Json_len (Json_get (diags, "diagnostics")), 0);
+  drop_sent (&sent);
+
+  const char *const broken[] = {
+    "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":"
+    "{\"textDocument\":{\"uri\":\"file:///b.neo\",\"version\":1,"
+    "\"text\":\"true\"}}}",
+    "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\",\"params\":"
+    "{\"textDocument\":{\"uri\":\"file:///b.neo\",\"version\":2},"
+    "\"contentChanges\":[{\"text\":\"\\nif x then true else false\"}]}}",
+  };
+  ASSERT_I64_EQ (run_session (broken, sizeof (broken) / sizeof (broken[0]),
+                              &sent),
+                 1);
+  diags = last_diagnostics (&sent, "file:///b.neo");
+  ASSERT_I64_EQ (Json_get_number (Json_get (diags, "version")), 2);
+  /* The unbound var, then the condition it leaves without a type.  */
+  ASSERT_U64_EQ (Json_len (Json_get (diags, "diagnostics")), 2);
+  const Json *diag = Json_at (Json_get (diags, "diagnostics"), 0);
+  ASSERT_U64_EQ (json_eq_cstring (Json_get (diag, "code"), "VAR_NOT_BOUND"),
+                 true);
+  ASSERT_I64_EQ (Json_get_number (Json_get (diag, "severity")), 1);
+  const Json *range = Json_get (diag, "range");
+  ASSERT_I64_EQ (
+      Json_get_number (Json_get (Json_get (range, "start"), "line")), 1);
+  ASSERT_I64_EQ (
+      Json_get_number (Json_get (Json_get (range, "start"), "character")), 3);
+  ASSERT_I64_EQ (
+      Json_get_number (Json_get (Json_get (range, "end"), "character")), 4);
+  drop_sent (&sent);
+
+  const char *const closed[] = {
+    "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":"
+    "{\"textDocument\":{\"uri\":\"file:///c.neo\",\"version\":1,"
+    "\"text\":\"if\"}}}",
+    "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didClose\",\"params\":"
+    "{\"textDocument\":{\"uri\":\"file:///c.neo\"}}}",
+  };
+  ASSERT_I64_EQ (run_session (closed, sizeof (closed) / sizeof (closed[0]),
+                              &sent),
+                 1);
+  diags = last_diagnostics (&sent, "file:///c.neo");
+  ASSERT_U64_EQ (Json_get (diags, "version") == NULL, true);
+  ASSERT_U64_EQ (Json_len (Json_get (diags, "diagnostics")), 0);
+  drop_sent (&sent);
+}
+
+typedef struct Gate
+{
+  mtx_t lock_;
+  cnd_t open_notify_;
+  bool open_;
+} Gate;
+
+static void
+Gate_wait (void *arg)
+{
+  Gate *self = arg;
+  mtx_lock (&self->lock_);
+  while (!self->open_)
+    {
+      cnd_wait (&self->open_notify_, &self->lock_);
+    }
+  mtx_unlock (&self->lock_);
+}
+
+static void
+Gate_open (Gate *self)
+{
+  mtx_lock (&self->lock_);
+  self->open_ = true;
+  cnd_broadcast (&self->open_notify_);
+  mtx_unlock (&self->lock_);
+}
+
+static void
+handle_cstring (LspServer *self, const char *body)
+{
+  Json message;
+  Json_parse (&message, body, strlen (body));
+  LspServer_handle (self, &message);
+  Json_drop (&message);
+}
+
+NEO_TEST (test_lsp_cancel_00)
+{
+  FILE *out = tmpfile ();
+  LspServer server;
+  LspServer_init (&server, NULL, out, 1);
+  /* Holds the only worker until every change has arrived.  */
+  Gate gate = { .open_ = false };
+  mtx_init (&gate.lock_, mtx_plain);
+  cnd_init (&gate.open_notify_);
+  ThreadPool_execute (&server.pool_, Gate_wait, &gate);
+  handle_cstring (
+      &server,
+      "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":"
+      "{\"textDocument\":{\"uri\":\"file:///a.neo\",\"version\":1,"
+      "\"text\":\"true\"}}}");
+  for (int version = 2; version <= 6; version++)
+    {
+      char body[256];
+      snprintf (body, sizeof (body),
+                "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didChange\","
+                "\"params\":{\"textDocument\":{\"uri\":\"file:///a.neo\","
+                "\"version\":%d},\"contentChanges\":[{\"text\":\"%s\"}]}}",
+                version, version % 2 ? "true" : "if");
+      handle_cstring (&server, body);
+    }
+  Gate_open (&gate);
+  LspServer_drop (&server);
+  mtx_destroy (&gate.lock_);
+  cnd_destroy (&gate.open_notify_);
+  ASSERT_U64_EQ (server.num_cancelled_, 5);
+  ASSERT_U64_EQ (server.num_analyses_, 1);
+  Vec_Json sent = Vec_Json_new ();
+  read_sent (out, &sent);
+  fclose (out);
+  ASSERT_U64_EQ (Vec_Json_len (&sent), 1);
+  const Json *diags = last_diagnostics (&sent, "file:///a.neo");
+  ASSERT_I64_EQ (Json_get_number (Json_get (diags, "version")), 6);
+  ASSERT_U64_EQ (Json_len (Json_get (diags, "diagnostics")) > 0, true);
+  drop_sent (&sent);
+}
+
+/* Waits for the analyses of SELF to publish NUM_ANALYSES times.  */
+static void
+LspServer_wait_analyses (LspServer *self, size_t num_analyses)
+{
+  while (true)
+    {
+      LspServer_lock (self);
+      bool done = self->num_analyses_ >= num_analyses;
+      LspServer_unlock (self);
+      if (done)
+        {
+          break;
+        }
+      thrd_yield ();
+    }
+}
+
+NEO_TEST (test_lsp_hover_00)
+{
+  FILE *out = tmpfile ();
+  LspServer server;
+  LspServer_init (&server, NULL, out, 1);
+  handle_cstring (
+      &server,
+      "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/didOpen\",\"params\":"
+      "{\"textDocument\":{\"uri\":\"file:///a.neo\",\"version\":1,"
+      "\"text\":\"let x = true in\\nif x then x else false\"}}}");
+  /* Hovers are answered from the published check, not by one of their
+   * own.  */
+  LspServer_wait_analyses (&server, 1);
+  handle_cstring (
+      &server,
+      "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"textDocument/hover\","
+      "\"params\":{\"textDocument\":{\"uri\":\"file:///a.neo\"},"
+      "\"position\":{\"line\":1,\"character\":3}}}");
+  LspServer_drop (&server);
+  Vec_Json sent = Vec_Json_new ();
+  read_sent (out, &sent);
+  fclose (out);
+  const Json *hover = Json_get (find_response (&sent, 1), "result");
+  ASSERT_U64_EQ (
+      json_eq_cstring (Json_get (Json_get (hover, "contents"), "value"),
+                       "Bool"),
+      true);
+  const Json *start = Json_get (Json_get (hover, "range"), "start");
+  ASSERT_I64_EQ (Json_get_number (Json_get (start, "line")), 1);
+  ASSERT_I64_EQ (Json_get_number (Json_get (start, "character")), 3);
+  drop_sent (&sent);
+}
+
+NEO_TESTS (lsp_tests, test_lsp_session_00, test_lsp_diagnostics_00,
+           test_lsp_cancel_00, test_lsp_hover_00)
+#endif
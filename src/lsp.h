@@ -0,0 +1,73 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_LSP_H
+#define NEO_LSP_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <threads.h>
+
+#include "document.h"
+#include "json.h"
+#include "string.h"
+#include "thread_pool.h"
+#include "vec_macro.h"
+
+/* An open text document, shared by the main loop, which edits it, and the
+ * analyses, which check it and publish its diagnostics.  */
+typedef struct LspDocument
+{
+  String uri_;
+  /* Set by the main loop before it takes LOCK, so that the check holding
+   * it gives up rather than hold up the messages behind.  Cleared under
+   * LOCK.  */
+  atomic_bool cancel_;
+  /* Guards everything below.  */
+  mtx_t lock_;
+  bool open_;
+  Document doc_;
+  /* Bumped by every change, so that analyses of older text are skipped.  */
+  uint64_t generation_;
+  /* As the client numbered the text.  */
+  int64_t version_;
+} LspDocument;
+
+typedef LspDocument *LspDocumentPtr;
+
+NEO_DECL_VEC (LspDocumentPtr, LspDocumentPtr)
+
+/* A language server speaking JSON-RPC with Content-Length framing.  Edits
+ * are applied as they are read, and checks run on the pool.  */
+typedef struct LspServer
+{
+  FILE *in_;
+  FILE *out_;
+  /* Documents are never freed before the server, since analyses hold them.
+   * Only the main loop touches the vector.  */
+  Vec_LspDocumentPtr docs_;
+  ThreadPool pool_;
+  /* Guards OUT and the counters.  Taken after a document lock.  */
+  mtx_t out_lock_;
+  size_t num_analyses_;
+  size_t num_cancelled_;
+  bool shutdown_;
+  bool exit_;
+} LspServer;
+
+void LspServer_init (LspServer *self, FILE *in, FILE *out,
+                     size_t num_threads);
+/* Waits for the analyses in flight.  */
+void LspServer_drop (LspServer *self);
+void LspServer_handle (LspServer *self, const Json *message);
+/* Serves until exit or the end of input, and returns the exit code.  */
+int LspServer_run (LspServer *self);
+
+#ifdef TESTS
+#include "test.h"
+Tests lsp_tests ();
+#endif
+
+#endif
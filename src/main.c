@@ -1,19 +1,39 @@
 /* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "arena.h"
 #include "ast_node.h"
+#include "cache.h"
 #include "diagnostic.h"
+#include "ir.h"
+#include "ir_pass.h"
+#include "json.h"
 #include "lexer.h"
+#include "lsp.h"
 #include "parser.h"
 #include "span.h"
 #include "string.h"
+#include "thread_pool.h"
 #include "token.h"
 #include "type.h"
 #include "type_checker.h"
 #include "vec.h"
 
 #define INTEGER_BUFFER_SIZE (64)
+/* Checks of one document are serialized, so more threads only help while
+ * several documents change at once.  */
+#define LSP_NUM_THREADS (2)
+/* Smaller files are lexed faster than a pool starts.  */
+#define PARALLEL_LEX_MIN_LEN (1 << 20)
+/* Subtrees typed by a job of their own, when the pool is up.  */
+#define PARALLEL_CHECK_MIN_NODES (1 << 14)
+/* Chunks per thread, so that a slow chunk does not hold the others up.  */
+#define PARALLEL_LEX_CHUNKS_PER_THREAD (4)
 
 static void
 print_copyright ()
@@ -27,49 +47,72 @@ print_prompt ()
   puts ("-------------------------------------------------------------------");
 }
 
-static String
-Position_serialize (const Position *self)
+static void
+print_usage (const char *program)
+{
+  fprintf (stderr,
+           "usage: %s [--arena-stats]\n"
+           "       %s check [--cache-dir DIR] [--max-diagnostics N]\n"
+           "             [--format text|jsonl|sarif] [--jobs N]\n"
+           "             [--passes none|PASS,...] FILE\n"
+           "       %s lsp [--pool-stats]\n",
+           program, program, program);
+}
+
+static void
+Arena_display_stats (const Arena *self)
+{
+  printf ("Arena: %zu allocations, %zu bytes used, %zu bytes reserved in "
+          "%zu chunks\n",
+          Arena_num_allocs (self), Arena_num_bytes (self),
+          Arena_num_reserved_bytes (self), Arena_num_chunks (self));
+}
+
+static void
+Position_write (const Position *self, JsonWriter *writer)
 {
-  String json = String_from_cstring ("{\"line\":");
-  String_push_u64 (&json, Position_get_line (self));
-  String_push_cstring (&json, ",\"column\":");
-  String_push_u64 (&json, Position_get_column (self));
-  String_push_cstring (&json, "}");
-  return json;
+  JsonWriter_begin_object (writer);
+  JsonWriter_key (writer, "line");
+  JsonWriter_u64 (writer, Position_get_line (self));
+  JsonWriter_key (writer, "column");
+  JsonWriter_u64 (writer, Position_get_column (self));
+  JsonWriter_end_object (writer);
 }
 
-static String
-SourceFile_serialize_span (const SourceFile *self, const Span *span)
+/* Spans are written in the order of the text, so that the cursor only
+ * steps forward.  */
+static void
+PositionCursor_write_span (PositionCursor *self, const Span *span,
+                           JsonWriter *writer)
 {
-  String json = String_from_cstring ("{\"path\":\"");
-  String_push_string (&json, SourceFile_get_path (self));
-  String_push_cstring (&json, "\",\"begin\":");
-  Position begin = SourceFile_lookup_position (self, Span_cbegin (span));
-  String begin_json = Position_serialize (&begin);
-  String_push_string (&json, &begin_json);
-  String_drop (&begin_json);
-  String_push_cstring (&json, ",\"end\":");
-  Position end = SourceFile_lookup_position (
+  JsonWriter_begin_object (writer);
+  JsonWriter_key (writer, "path");
+  const String *path = SourceFile_get_path (PositionCursor_get_file (self));
+  JsonWriter_string (writer, String_cbegin (path), String_len (path));
+  JsonWriter_key (writer, "begin");
+  Position begin = PositionCursor_lookup (self, Span_cbegin (span));
+  Position_write (&begin, writer);
+  JsonWriter_key (writer, "end");
+  Position end = PositionCursor_lookup (
       self, Span_len (span) ? Span_cend (span) - 1 : Span_cend (span));
-  String end_json = Position_serialize (&end);
-  String_push_string (&json, &end_json);
-  String_drop (&end_json);
-  String_push_cstring (&json, ",\"content\":\"");
-  String_push_carray (&json, Span_cbegin (span), Span_len (span));
-  String_push_cstring (&json, "\"}");
-  return json;
+  Position_write (&end, writer);
+  JsonWriter_key (writer, "content");
+  JsonWriter_string (writer, Span_cbegin (span), Span_len (span));
+  JsonWriter_end_object (writer);
 }
 
-static String
-SourceFile_serialize_token (const SourceFile *self, const Token *token)
+static void
+PositionCursor_write_token (PositionCursor *self, const Token *token,
+                            JsonWriter *writer)
 {
-  String json;
+  JsonWriter_begin_object (writer);
+  JsonWriter_key (writer, "kind");
   switch (token->kind_)
     {
 #define NEO_TOKEN(T)                                                          \
   case TOKEN_##T:                                                             \
     {                                                                         \
-      json = String_from_cstring ("{\"kind\":\"TOKEN_" #T "\",\"span\":");    \
+      JsonWriter_cstring (writer, "TOKEN_" #T);                               \
       break;                                                                  \
     }
 #include "token.def"
@@ -78,101 +121,116 @@ SourceFile_serialize_token (const SourceFile *self, const Token *token)
 #undef NEO_TOKEN_LIT
 #undef NEO_TOKEN
     }
-  String span_json = SourceFile_serialize_span (self, &token->span_);
-  String_push_string (&json, &span_json);
-  String_drop (&span_json);
-  String_push_cstring (&json, "}");
-  return json;
+  JsonWriter_key (writer, "span");
+  Span span = SourceFile_get_span (PositionCursor_get_file (self),
+                                   token->span_);
+  PositionCursor_write_span (self, &span, writer);
+  JsonWriter_end_object (writer);
 }
 
 static void
-SourceFile_display_token (const SourceFile *self, const Token *token)
+ASTNodeIds_write (const ASTNodeId *ids, size_t len, JsonWriter *writer)
 {
-  String json = SourceFile_serialize_token (self, token);
-  printf ("%.*s", (int)String_len (&json), String_cbegin (&json));
-  String_drop (&json);
+  JsonWriter_begin_array (writer);
+  for (size_t i = 0; i < len; i++)
+    {
+      JsonWriter_u64 (writer, ids[i]);
+    }
+  JsonWriter_end_array (writer);
 }
 
 static void
-Vec_ASTNodeId_display (const Vec_ASTNodeId *self)
+ASTNodeId_write_member (const char *key, ASTNodeId id, JsonWriter *writer)
 {
-  printf ("[");
-  const ASTNodeId *cend = Vec_ASTNodeId_cend (self);
-  const ASTNodeId *ptr = Vec_ASTNodeId_cbegin (self);
-  if (ptr < cend)
-    {
-      printf ("%u", *ptr);
-      ptr++;
-    }
-  while (ptr < cend)
-    {
-      printf (",%u", *ptr);
-      ptr++;
-    }
-  printf ("]");
+  JsonWriter_key (writer, key);
+  JsonWriter_u64 (writer, id);
 }
 
 static void
-ASTNode_display (const ASTNodeManager *ast_mgr, const ASTNode *node)
+ASTNode_write (const ASTNodeManager *ast_mgr, const SourceFile *file,
+               ASTNodeId id, JsonWriter *writer)
 {
-  switch (node->kind_)
+  ASTNode node = ASTNodeManager_get_node (ast_mgr, id);
+  const ASTPayload *payload = &node.payload_;
+  Span span = SourceFile_get_span (file, node.span_);
+  JsonWriter_begin_object (writer);
+  ASTNodeId_write_member ("id", id, writer);
+  JsonWriter_key (writer, "kind");
+  switch (node.kind_)
     {
 #define NEO_ASTKIND(NAME, UNUSED)                                             \
   case AST_##NAME:                                                            \
     {                                                                         \
-      printf ("{\"id\":%u,\"kind\":\"" #NAME "\",\"span\":\"%.*s\"",          \
-              ASTNodeManager_get_id (ast_mgr, node),                          \
-              (int)Span_len (&node->span_), Span_cbegin (&node->span_));      \
+      JsonWriter_cstring (writer, #NAME);                                     \
       break;                                                                  \
     }
 #include "ast_kind.def"
 #undef NEO_ASTKIND
     }
-  switch (node->kind_)
+  JsonWriter_key (writer, "span");
+  JsonWriter_string (writer, Span_cbegin (&span), Span_len (&span));
+  switch (node.kind_)
     {
     case AST_IF_THEN_ELSE:
       {
-        printf (",\"if_expr\":%u,\"then_expr\":%u,\"else_expr\":%u",
-                node->if_then_else_.if_expr_, node->if_then_else_.then_expr_,
-                node->if_then_else_.else_expr_);
+        ASTNodeId_write_member ("if_expr", payload->if_then_else_.if_expr_,
+                                writer);
+        ASTNodeId_write_member ("then_expr",
+                                payload->if_then_else_.then_expr_, writer);
+        ASTNodeId_write_member ("else_expr",
+                                payload->if_then_else_.else_expr_, writer);
         break;
       }
     case AST_LET:
       {
-        printf (",\"vars\":");
-        Vec_ASTNodeId_display (&node->let_.vars_);
-        printf (",\"types\":");
-        Vec_ASTNodeId_display (&node->let_.types_);
-        printf (",\"inits\":");
-        Vec_ASTNodeId_display (&node->let_.inits_);
-        printf (",\"body\":%u", node->let_.body_);
+        size_t num_vars = payload->let_.num_vars_;
+        JsonWriter_key (writer, "vars");
+        ASTNodeIds_write (
+            ASTNodeManager_get_let_vars (ast_mgr, &payload->let_), num_vars,
+            writer);
+        JsonWriter_key (writer, "types");
+        ASTNodeIds_write (
+            ASTNodeManager_get_let_types (ast_mgr, &payload->let_), num_vars,
+            writer);
+        JsonWriter_key (writer, "inits");
+        ASTNodeIds_write (
+            ASTNodeManager_get_let_inits (ast_mgr, &payload->let_), num_vars,
+            writer);
+        ASTNodeId_write_member ("body", payload->let_.body_, writer);
         break;
       }
     case AST_LAMBDA:
       {
-        printf (",\"vars\":");
-        Vec_ASTNodeId_display (&node->lambda_.vars_);
-        printf (",\"types\":");
-        Vec_ASTNodeId_display (&node->lambda_.types_);
-        printf (",\"body\":%u", node->lambda_.body_);
+        size_t num_vars = payload->lambda_.num_vars_;
+        JsonWriter_key (writer, "vars");
+        ASTNodeIds_write (
+            ASTNodeManager_get_lambda_vars (ast_mgr, &payload->lambda_),
+            num_vars, writer);
+        JsonWriter_key (writer, "types");
+        ASTNodeIds_write (
+            ASTNodeManager_get_lambda_types (ast_mgr, &payload->lambda_),
+            num_vars, writer);
+        ASTNodeId_write_member ("body", payload->lambda_.body_, writer);
         break;
       }
     case AST_TUPLE:
       {
-        printf (",\"args\":");
-        Vec_ASTNodeId_display (&node->tuple_.args_);
+        JsonWriter_key (writer, "args");
+        ASTNodeIds_write (
+            ASTNodeManager_get_tuple_args (ast_mgr, &payload->tuple_),
+            payload->tuple_.num_args_, writer);
         break;
       }
     case AST_CALL:
       {
-        printf (",\"base\":%u", node->call_.base_);
-        printf (",\"tuple\":%u", node->call_.tuple_);
+        ASTNodeId_write_member ("base", payload->call_.base_, writer);
+        ASTNodeId_write_member ("tuple", payload->call_.tuple_, writer);
         break;
       }
     case AST_NEGATIVE:
     case AST_POSITIVE:
       {
-        printf (",\"expr\":%u", node->unary_.expr_);
+        ASTNodeId_write_member ("expr", payload->unary_.expr_, writer);
         break;
       }
     case AST_ADD:
@@ -186,25 +244,25 @@ ASTNode_display (const ASTNodeManager *ast_mgr, const ASTNode *node)
     case AST_LT:
     case AST_GT:
       {
-        printf (",\"left\":%u", node->binary_.left_);
-        printf (",\"right\":%u", node->binary_.right_);
+        ASTNodeId_write_member ("left", payload->binary_.left_, writer);
+        ASTNodeId_write_member ("right", payload->binary_.right_, writer);
         break;
       }
     default:
       break;
     }
-  printf ("}");
+  JsonWriter_end_object (writer);
 }
 
+/* Writes every node as a line of JSON.  */
 static void
-ASTNodeManager_display (const ASTNodeManager *ast_mgr)
+ASTNodeManager_write (const ASTNodeManager *ast_mgr, const SourceFile *file,
+                      JsonWriter *writer)
 {
-  for (const ASTNode *node
-       = Vec_ASTNode_cbegin (ASTNodeManager_get_nodes (ast_mgr));
-       node < Vec_ASTNode_cend (ASTNodeManager_get_nodes (ast_mgr)); node++)
+  for (ASTNodeId id = 0; id < ASTNodeManager_num_nodes (ast_mgr); id++)
     {
-      ASTNode_display (ast_mgr, node);
-      puts ("");
+      ASTNode_write (ast_mgr, file, id, writer);
+      JsonWriter_newline (writer);
     }
 }
 
@@ -224,9 +282,345 @@ TypeManager_display_type (const TypeManager *self, TypeId id)
     }
 }
 
+/* How check reports diagnostics.  */
+enum OutputFormat
+{
+  FORMAT_TEXT,
+  FORMAT_JSONL,
+  FORMAT_SARIF
+};
+
+static bool
+parse_format (const char *name, enum OutputFormat *format)
+{
+  if (!strcmp (name, "text"))
+    {
+      *format = FORMAT_TEXT;
+    }
+  else if (!strcmp (name, "jsonl"))
+    {
+      *format = FORMAT_JSONL;
+    }
+  else if (!strcmp (name, "sarif"))
+    {
+      *format = FORMAT_SARIF;
+    }
+  else
+    {
+      return false;
+    }
+  return true;
+}
+
+/* Writes the diagnostics to stdout, unless they were displayed as text.  */
+static void
+write_diagnostics (const DiagnosticManager *diag_mgr,
+                   enum OutputFormat format)
+{
+  JsonWriter writer = JsonWriter_new (stdout);
+  switch (format)
+    {
+    case FORMAT_TEXT:
+      break;
+    case FORMAT_JSONL:
+      DiagnosticManager_write_jsonl (diag_mgr, &writer);
+      break;
+    case FORMAT_SARIF:
+      DiagnosticManager_write_sarif (diag_mgr, &writer);
+      break;
+    }
+  JsonWriter_drop (&writer);
+}
+
+static bool
+read_file (const char *path, String *content)
+{
+  FILE *file = fopen (path, "rb");
+  if (file == NULL)
+    {
+      return false;
+    }
+  *content = String_new ();
+  char buf[4096];
+  size_t len;
+  while ((len = fread (buf, 1, sizeof (buf), file)) > 0)
+    {
+      String_push_carray (content, buf, len);
+    }
+  bool ok = !ferror (file);
+  fclose (file);
+  if (!ok)
+    {
+      String_drop (content);
+    }
+  return ok;
+}
+
+static void
+print_file_type (const char *path, const TypeManager *type_mgr, TypeId id)
+{
+  printf ("%s: ", path);
+  TypeManager_display_type (type_mgr, id);
+  puts ("");
+}
+
+/* Lowers the clean tree at ROOT and runs the passes of PASS_MGR on it,
+ * reporting each on stderr, so that stdout is left to the diagnostics.  */
+static void
+run_passes (IRPassManager *pass_mgr, const ASTNodeManager *ast_mgr,
+            const SourceFile *file, ASTNodeId root)
+{
+  IRModule module = IRModule_lower (ast_mgr, file, root);
+  IRPassManager_run (pass_mgr, &module);
+  const IRPassRun *runs = Vec_IRPassRun_cbegin (&pass_mgr->runs_);
+  for (size_t i = 0; i < Vec_IRPassRun_len (&pass_mgr->runs_); i++)
+    {
+      fprintf (stderr, "pass %s: %.3f ms, %zu -> %zu values\n",
+               runs[i].pass_.name_, runs[i].secs_ * 1e3,
+               runs[i].num_values_before_, runs[i].num_values_after_);
+    }
+  IRModule_drop (&module);
+}
+
+/* Checks the file at PATH.  With a CACHE_DIR, a file whose exact content
+ * was checked cleanly before is answered from its cache entry without
+ * lexing, parsing or checking it again.  Only the first MAX_DIAGS
+ * diagnostics are reported.  Machine-readable formats put nothing but the
+ * diagnostics on stdout.  With a PASS_MGR, a clean file is lowered and the
+ * passes are run on it, which needs the tree, so the cache is not read.  */
+static int
+check_file (const char *path, const char *cache_dir, size_t max_diags,
+            enum OutputFormat format, size_t num_jobs,
+            IRPassManager *pass_mgr)
+{
+  String content;
+  if (!read_file (path, &content))
+    {
+      fprintf (stderr, "error: cannot read '%s'\n", path);
+      return 1;
+    }
+  TypeManager type_mgr = TypeManager_new ();
+  String cache_path = String_new ();
+  if (cache_dir)
+    {
+      String_drop (&cache_path);
+      cache_path = Cache_path (cache_dir, &content);
+      String_push (&cache_path, '\0');
+      CacheEntry entry;
+      if (!pass_mgr
+          && CacheEntry_load (&entry, String_cbegin (&cache_path), &content))
+        {
+          /* Stored types are built in, and so the same in a fresh
+           * manager.  */
+          if (format == FORMAT_TEXT)
+            {
+              print_file_type (
+                  path, &type_mgr,
+                  CacheEntry_get_type (&entry, CacheEntry_get_root (&entry)));
+            }
+          /* A clean file has no diagnostics to point into it.  */
+          DiagnosticManager diag_mgr = DiagnosticManager_new (NULL);
+          write_diagnostics (&diag_mgr, format);
+          DiagnosticManager_drop (&diag_mgr);
+          CacheEntry_drop (&entry);
+          String_drop (&cache_path);
+          TypeManager_drop (&type_mgr);
+          String_drop (&content);
+          return 0;
+        }
+    }
+  SourceFile file = SourceFile_new (String_from_cstring (path), content);
+  Span span = Span_from_string (SourceFile_get_content (&file));
+  Arena arena = Arena_new ();
+  Vec_Token tokens = Vec_Token_new_in (&arena);
+  /* Shared by the lexer and the type checker.  */
+  bool parallel = num_jobs > 1 && Span_len (&span) >= PARALLEL_LEX_MIN_LEN;
+  ThreadPool pool;
+  if (parallel)
+    {
+      pool = ThreadPool_new (num_jobs - 1);
+      Lexer_lex_parallel (&span, &pool,
+                          num_jobs * PARALLEL_LEX_CHUNKS_PER_THREAD, &tokens);
+    }
+  else
+    {
+      Lexer lexer = Lexer_new (&span);
+      Token token;
+      do
+        {
+          token = Lexer_next (&lexer);
+          Vec_Token_push (&tokens, token);
+        }
+      while (!Token_is_eof (&token));
+    }
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_limit (&diag_mgr, max_diags);
+  DiagnosticManager_set_display (&diag_mgr, format == FORMAT_TEXT);
+  ASTNodeManager ast_mgr = ASTNodeManager_new_in (&arena);
+  Parser parser = Parser_new (&tokens, &diag_mgr, &ast_mgr);
+  ASTNodeId node_id = Parser_parse (&parser);
+  Parser_drop (&parser);
+  TypeChecker type_checker = TypeChecker_new (&ast_mgr, &diag_mgr, &type_mgr);
+  ASTNodeIdToTypeIdMap node_type_map;
+  if (parallel)
+    {
+      TypeChecker_set_pool (&type_checker, &pool, PARALLEL_CHECK_MIN_NODES);
+      node_type_map = TypeChecker_check (&type_checker, node_id);
+      ThreadPool_drop (&pool);
+    }
+  else
+    {
+      node_type_map = TypeChecker_check_sweep (&type_checker, node_id);
+    }
+  if (format == FORMAT_TEXT)
+    {
+      print_file_type (path, &type_mgr,
+                       ASTNodeIdToTypeIdMap_get (&node_type_map, node_id));
+    }
+  write_diagnostics (&diag_mgr, format);
+  size_t num_diags = DiagnosticManager_num_total (&diag_mgr);
+  if (num_diags > DiagnosticManager_num_stored (&diag_mgr))
+    {
+      fprintf (stderr, "note: %zu more diagnostics were not reported\n",
+               num_diags - DiagnosticManager_num_stored (&diag_mgr));
+    }
+  if (pass_mgr && !num_diags)
+    {
+      run_passes (pass_mgr, &ast_mgr, &file, node_id);
+    }
+  /* Only clean results are cached, since diagnostics are not stored.  */
+  if (cache_dir && !num_diags)
+    {
+      Cache_store (String_cbegin (&cache_path), SourceFile_get_content (&file),
+                   &tokens, &ast_mgr, node_id, &node_type_map);
+    }
+  ASTNodeIdToTypeIdMap_drop (&node_type_map);
+  ASTNodeManager_drop (&ast_mgr);
+  DiagnosticManager_drop (&diag_mgr);
+  Vec_Token_drop (&tokens);
+  Arena_drop (&arena);
+  SourceFile_drop (&file);
+  String_drop (&cache_path);
+  TypeManager_drop (&type_mgr);
+  return num_diags ? 1 : 0;
+}
+
 int
-main ()
+main (int argc, char *argv[])
 {
+  if (argc > 1 && !strcmp (argv[1], "check"))
+    {
+      const char *cache_dir = NULL;
+      size_t max_diags = SIZE_MAX;
+      enum OutputFormat format = FORMAT_TEXT;
+      size_t num_jobs = 1;
+      IRPassManager pass_mgr = IRPassManager_new ();
+      bool passes = false;
+      int i = 2;
+      while (i + 2 < argc)
+        {
+          if (!strcmp (argv[i], "--cache-dir"))
+            {
+              cache_dir = argv[i + 1];
+            }
+          else if (!strcmp (argv[i], "--max-diagnostics"))
+            {
+              char *end;
+              max_diags = strtoull (argv[i + 1], &end, 10);
+              if (*end || end == argv[i + 1])
+                {
+                  IRPassManager_drop (&pass_mgr);
+                  print_usage (argv[0]);
+                  return 1;
+                }
+            }
+          else if (!strcmp (argv[i], "--jobs"))
+            {
+              char *end;
+              num_jobs = strtoull (argv[i + 1], &end, 10);
+              if (*end || end == argv[i + 1] || num_jobs == 0)
+                {
+                  IRPassManager_drop (&pass_mgr);
+                  print_usage (argv[0]);
+                  return 1;
+                }
+            }
+          else if (!strcmp (argv[i], "--format"))
+            {
+              if (!parse_format (argv[i + 1], &format))
+                {
+                  IRPassManager_drop (&pass_mgr);
+                  print_usage (argv[0]);
+                  return 1;
+                }
+            }
+          else if (!strcmp (argv[i], "--passes"))
+            {
+              if (!IRPassManager_add (&pass_mgr, argv[i + 1]))
+                {
+                  IRPassManager_drop (&pass_mgr);
+                  print_usage (argv[0]);
+                  return 1;
+                }
+              passes = true;
+            }
+          else
+            {
+              break;
+            }
+          i += 2;
+        }
+      if (i + 1 != argc)
+        {
+          IRPassManager_drop (&pass_mgr);
+          print_usage (argv[0]);
+          return 1;
+        }
+      int code = check_file (argv[i], cache_dir, max_diags, format, num_jobs,
+                             passes ? &pass_mgr : NULL);
+      IRPassManager_drop (&pass_mgr);
+      return code;
+    }
+  if (argc > 1 && !strcmp (argv[1], "lsp"))
+    {
+      bool pool_stats = argc == 3 && !strcmp (argv[2], "--pool-stats");
+      if (argc != 2 && !pool_stats)
+        {
+          print_usage (argv[0]);
+          return 1;
+        }
+      LspServer server;
+      LspServer_init (&server, stdin, stdout, LSP_NUM_THREADS);
+      if (pool_stats)
+        {
+          ThreadPool_enable_stats (&server.pool_);
+        }
+      int code = LspServer_run (&server);
+      if (pool_stats)
+        {
+          /* Standard output belongs to the client.  */
+          ThreadPoolStats stats = ThreadPool_get_stats (&server.pool_);
+          JsonWriter writer = JsonWriter_new (stderr);
+          ThreadPoolStats_write (&stats, &writer);
+          JsonWriter_newline (&writer);
+          JsonWriter_drop (&writer);
+        }
+      LspServer_drop (&server);
+      return code;
+    }
+  bool arena_stats = false;
+  for (int i = 1; i < argc; i++)
+    {
+      if (!strcmp (argv[i], "--arena-stats"))
+        {
+          arena_stats = true;
+        }
+      else
+        {
+          print_usage (argv[0]);
+          return 1;
+        }
+    }
   print_copyright ();
   print_prompt ();
   int ch = 0;
@@ -240,27 +634,34 @@ main ()
                                 String_len (&input_buf) - 1);
           SourceFile file
               = SourceFile_new (String_from_cstring ("<stdio>"), input_buf);
+          /* Everything built for this line is freed with the arena.  */
+          Arena arena = Arena_new ();
           /* Lexical analysis: */
           Lexer lexer = Lexer_new (&span);
-          Vec_Token tokens = Vec_Token_new ();
+          Vec_Token tokens = Vec_Token_new_in (&arena);
+          JsonWriter writer = JsonWriter_new (stdout);
           puts ("Tokens:");
+          PositionCursor cursor = PositionCursor_new (&file);
           Token token;
           do
             {
               token = Lexer_next (&lexer);
-              SourceFile_display_token (&file, &token);
-              puts ("");
+              PositionCursor_write_token (&cursor, &token, &writer);
+              JsonWriter_newline (&writer);
               Vec_Token_push (&tokens, token);
             }
           while (!Token_is_eof (&token));
+          JsonWriter_flush (&writer);
           DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
-          ASTNodeManager ast_mgr = ASTNodeManager_new ();
+          ASTNodeManager ast_mgr = ASTNodeManager_new_in (&arena);
           Parser parser = Parser_new (&tokens, &diag_mgr, &ast_mgr);
           ASTNodeId node_id = Parser_parse (&parser);
+          Parser_drop (&parser);
           printf ("ASTNodeId = %u\n", node_id);
           Vec_Token_drop (&tokens);
           puts ("AST Nodes:");
-          ASTNodeManager_display (&ast_mgr);
+          ASTNodeManager_write (&ast_mgr, &file, &writer);
+          JsonWriter_drop (&writer);
           TypeManager type_mgr = TypeManager_new ();
           TypeChecker type_checker
               = TypeChecker_new (&ast_mgr, &diag_mgr, &type_mgr);
@@ -274,6 +675,11 @@ main ()
           TypeManager_drop (&type_mgr);
           ASTNodeManager_drop (&ast_mgr);
           DiagnosticManager_drop (&diag_mgr);
+          if (arena_stats)
+            {
+              Arena_display_stats (&arena);
+            }
+          Arena_drop (&arena);
           /* Clear input buffer and print prompt: */
           SourceFile_drop (&file);
           input_buf = String_new ();
@@ -0,0 +1,160 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_MPMC_QUEUE_MACRO_H
+#define NEO_MPMC_QUEUE_MACRO_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Large enough to keep the two ends of a queue on separate cache lines.  */
+#define NEO_CACHE_LINE_SIZE 64
+
+/* A bounded queue for any number of producers and consumers, which never
+ * takes a lock.  Each cell carries a sequence number telling whose turn it
+ * is: a producer may fill the cell at position POS once the number is POS,
+ * and a consumer may empty it once the number is POS + 1.  The ends are
+ * claimed by compare-and-swap, so a thread only ever waits for a cell that
+ * another thread has claimed but not yet finished with.  Items pushed by a
+ * single producer are popped in the order it pushed them.  */
+#define NEO_DECL_MPMC_QUEUE(N, T)                                             \
+  typedef struct MpmcQueueCell_##N                                            \
+  {                                                                           \
+    atomic_size_t seq_;                                                       \
+    T value_;                                                                 \
+  } MpmcQueueCell_##N;                                                        \
+                                                                              \
+  typedef struct MpmcQueue_##N                                                \
+  {                                                                           \
+    MpmcQueueCell_##N *cells_;                                                \
+    /* The capacity minus one, which is a power of two.  */                   \
+    size_t mask_;                                                             \
+    char pad0_[NEO_CACHE_LINE_SIZE];                                          \
+    atomic_size_t enqueue_pos_;                                               \
+    char pad1_[NEO_CACHE_LINE_SIZE];                                          \
+    atomic_size_t dequeue_pos_;                                               \
+    char pad2_[NEO_CACHE_LINE_SIZE];                                          \
+  } MpmcQueue_##N;                                                            \
+                                                                              \
+  /* Rounds CAPACITY up to a power of two, and to at least 2.  */             \
+  MpmcQueue_##N MpmcQueue_##N##_new (size_t capacity);                        \
+  /* No other thread may be using the queue.  */                              \
+  void MpmcQueue_##N##_drop (MpmcQueue_##N *self);                            \
+  size_t MpmcQueue_##N##_capacity (const MpmcQueue_##N *self);                \
+  /* Returns false if the queue is full.  */                                  \
+  bool MpmcQueue_##N##_try_push (MpmcQueue_##N *self, T value);               \
+  /* Returns false if the queue is empty, leaving VALUE untouched.  */        \
+  bool MpmcQueue_##N##_try_pop (MpmcQueue_##N *self, T *value);
+
+#define NEO_IMPL_MPMC_QUEUE(N, T)                                             \
+                                                                              \
+  MpmcQueue_##N MpmcQueue_##N##_new (size_t capacity)                         \
+  {                                                                           \
+    size_t cap = 2;                                                           \
+    while (cap < capacity)                                                    \
+      {                                                                       \
+        cap *= 2;                                                             \
+      }                                                                       \
+    MpmcQueue_##N self = { .mask_ = cap - 1 };                                \
+    self.cells_                                                               \
+        = (MpmcQueueCell_##N *)malloc (cap * sizeof (MpmcQueueCell_##N));     \
+    if (self.cells_ == NULL)                                                  \
+      {                                                                       \
+        abort ();                                                             \
+      }                                                                       \
+    for (size_t i = 0; i < cap; i++)                                          \
+      {                                                                       \
+        atomic_init (&self.cells_[i].seq_, i);                                \
+      }                                                                       \
+    atomic_init (&self.enqueue_pos_, 0);                                      \
+    atomic_init (&self.dequeue_pos_, 0);                                      \
+    return self;                                                              \
+  }                                                                           \
+                                                                              \
+  void MpmcQueue_##N##_drop (MpmcQueue_##N *self)                             \
+  {                                                                           \
+    free (self->cells_);                                                      \
+    self->cells_ = NULL;                                                      \
+  }                                                                           \
+                                                                              \
+  size_t MpmcQueue_##N##_capacity (const MpmcQueue_##N *self)                 \
+  {                                                                           \
+    return self->mask_ + 1;                                                   \
+  }                                                                           \
+                                                                              \
+  bool MpmcQueue_##N##_try_push (MpmcQueue_##N *self, T value)                \
+  {                                                                           \
+    size_t pos                                                                \
+        = atomic_load_explicit (&self->enqueue_pos_, memory_order_relaxed);   \
+    MpmcQueueCell_##N *cell;                                                  \
+    while (true)                                                              \
+      {                                                                       \
+        cell = &self->cells_[pos & self->mask_];                              \
+        size_t seq                                                            \
+            = atomic_load_explicit (&cell->seq_, memory_order_acquire);       \
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;                        \
+        if (diff == 0)                                                        \
+          {                                                                   \
+            if (atomic_compare_exchange_weak_explicit (                       \
+                    &self->enqueue_pos_, &pos, pos + 1,                       \
+                    memory_order_relaxed, memory_order_relaxed))              \
+              {                                                               \
+                break;                                                        \
+              }                                                               \
+          }                                                                   \
+        else if (diff < 0)                                                    \
+          {                                                                   \
+            /* The cell still holds the item of the previous lap.  */         \
+            return false;                                                     \
+          }                                                                   \
+        else                                                                  \
+          {                                                                   \
+            pos = atomic_load_explicit (&self->enqueue_pos_,                  \
+                                        memory_order_relaxed);                \
+          }                                                                   \
+      }                                                                       \
+    cell->value_ = value;                                                     \
+    atomic_store_explicit (&cell->seq_, pos + 1, memory_order_release);       \
+    return true;                                                              \
+  }                                                                           \
+                                                                              \
+  bool MpmcQueue_##N##_try_pop (MpmcQueue_##N *self, T *value)                \
+  {                                                                           \
+    size_t pos                                                                \
+        = atomic_load_explicit (&self->dequeue_pos_, memory_order_relaxed);   \
+    MpmcQueueCell_##N *cell;                                                  \
+    while (true)                                                              \
+      {                                                                       \
+        cell = &self->cells_[pos & self->mask_];                              \
+        size_t seq                                                            \
+            = atomic_load_explicit (&cell->seq_, memory_order_acquire);       \
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);                  \
+        if (diff == 0)                                                        \
+          {                                                                   \
+            if (atomic_compare_exchange_weak_explicit (                       \
+                    &self->dequeue_pos_, &pos, pos + 1,                       \
+                    memory_order_relaxed, memory_order_relaxed))              \
+              {                                                               \
+                break;                                                        \
+              }                                                               \
+          }                                                                   \
+        else if (diff < 0)                                                    \
+          {                                                                   \
+            /* No item has been published in the cell yet.  */                \
+            return false;                                                     \
+          }                                                                   \
+        else                                                                  \
+          {                                                                   \
+            pos = atomic_load_explicit (&self->dequeue_pos_,                  \
+                                        memory_order_relaxed);                \
+          }                                                                   \
+      }                                                                       \
+    *value = cell->value_;                                                    \
+    atomic_store_explicit (&cell->seq_, pos + self->mask_ + 1,                \
+                           memory_order_release);                             \
+    return true;                                                              \
+  }
+
+#endif
@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "ast_node.h"
 #include "diagnostic.h"
@@ -21,19 +22,31 @@ Parser_new (const Vec_Token *tokens, DiagnosticManager *diag_mgr,
   return (Parser){ .tokens_ = tokens,
                    .diag_mgr_ = diag_mgr,
                    .ast_mgr_ = ast_mgr,
-                   .cursor_ = Vec_Token_cbegin (tokens) };
+                   .cursor_ = Vec_Token_cbegin (tokens),
+                   .vars_ = Vec_ASTNodeId_new_in (ast_mgr->arena_),
+                   .types_ = Vec_ASTNodeId_new_in (ast_mgr->arena_),
+                   .exprs_ = Vec_ASTNodeId_new_in (ast_mgr->arena_) };
 }
 
-static const char *
+void
+Parser_drop (Parser *self)
+{
+  Vec_ASTNodeId_drop (&self->vars_);
+  Vec_ASTNodeId_drop (&self->types_);
+  Vec_ASTNodeId_drop (&self->exprs_);
+}
+
+static uint32_t
 Parser_end_pos (const Parser *self)
 {
-  return String_cend (SourceFile_get_content (self->diag_mgr_->file_));
+  /* The EOF token, which is at the end of the lexed text.  */
+  return CompactSpan_get_offset (&(Vec_Token_cend (self->tokens_) - 1)->span_);
 }
 
-Span
+CompactSpan
 Parser_end_span (const Parser *self)
 {
-  return Span_new (Parser_end_pos (self), 0);
+  return CompactSpan_new (Parser_end_pos (self), 0);
 }
 
 static void
@@ -93,19 +106,19 @@ Parser_expect_and_skip (Parser *self, enum TokenKind kind)
   return false;
 }
 
-static const char *
-Parser_cursor_cbegin (const Parser *self)
+static uint32_t
+Parser_cursor_begin (const Parser *self)
 {
-  return Span_cbegin (&self->cursor_->span_);
+  return CompactSpan_get_offset (&self->cursor_->span_);
 }
 
-static Span
-Parser_span_from_last_node (const Parser *self, const char *cbegin,
-                            ASTNodeId id)
+static CompactSpan
+Parser_span_from_last_node (const Parser *self, uint32_t begin, ASTNodeId id)
 {
-  return Span_new (
-      cbegin, Span_cend (&ASTNodeManager_get_node (self->ast_mgr_, id)->span_)
-                  - cbegin);
+  return CompactSpan_new (
+      begin,
+      CompactSpan_get_end (ASTNodeManager_get_span (self->ast_mgr_, id))
+          - begin);
 }
 
 static ASTNodeId Parser_parse_expr (Parser *self);
@@ -114,7 +127,7 @@ static ASTNodeId
 Parser_parse_if_then_else (Parser *self)
 {
   assert (Parser_seeing (self, TOKEN_IF));
-  const char *cbegin = Parser_cursor_cbegin (self);
+  uint32_t begin = Parser_cursor_begin (self);
   Parser_skip (self, 1);
   ASTNodeId if_expr = Parser_parse_expr (self);
   if (is_invalid_ast_node_id (if_expr)
@@ -134,7 +147,7 @@ Parser_parse_if_then_else (Parser *self)
       return get_invalid_ast_node_id ();
     }
   return ASTNodeManager_push_if_then_else (
-      self->ast_mgr_, Parser_span_from_last_node (self, cbegin, else_expr),
+      self->ast_mgr_, Parser_span_from_last_node (self, begin, else_expr),
       if_expr, then_expr, else_expr);
 }
 
@@ -169,9 +182,9 @@ Parser_parse_lambda_single_param_with_type (Parser *self)
 {
   assert (Parser_seeing (self, TOKEN_NAME));
   assert (Parser_seeing_after (self, 1, TOKEN_COLON));
-  const char *cbegin = Parser_cursor_cbegin (self);
+  uint32_t begin = Parser_cursor_begin (self);
   ASTNodeId var = Parser_parse_var (self);
-  assert (ASTNodeManager_get_node (self->ast_mgr_, var)->kind_ == AST_VAR);
+  assert (ASTNodeManager_get_kind (self->ast_mgr_, var) == AST_VAR);
   Parser_skip (self, 1); /* Skip the colon.  */
   ASTNodeId type = Parser_parse_type (self);
   if (is_invalid_ast_node_id (type)
@@ -184,13 +197,9 @@ Parser_parse_lambda_single_param_with_type (Parser *self)
     {
       return get_invalid_ast_node_id ();
     }
-  Vec_ASTNodeId vars = Vec_ASTNodeId_with_capacity (1);
-  Vec_ASTNodeId_push (&vars, var);
-  Vec_ASTNodeId types = Vec_ASTNodeId_with_capacity (1);
-  Vec_ASTNodeId_push (&types, type);
   return ASTNodeManager_push_lambda (
-      self->ast_mgr_, Parser_span_from_last_node (self, cbegin, body), vars,
-      types, body);
+      self->ast_mgr_, Parser_span_from_last_node (self, begin, body), &var,
+      &type, 1, body);
 }
 
 static ASTNodeId
@@ -198,52 +207,33 @@ Parser_parse_lambda_single_param_without_type (Parser *self)
 {
   assert (Parser_seeing (self, TOKEN_NAME));
   assert (Parser_seeing_after (self, 1, TOKEN_PLUS_GT));
-  const char *cbegin = Parser_cursor_cbegin (self);
+  uint32_t begin = Parser_cursor_begin (self);
   ASTNodeId var = Parser_parse_var (self);
-  assert (ASTNodeManager_get_node (self->ast_mgr_, var)->kind_ == AST_VAR);
+  assert (ASTNodeManager_get_kind (self->ast_mgr_, var) == AST_VAR);
   Parser_skip (self, 1); /* Skip the mapsto symbol.  */
   ASTNodeId body = Parser_parse_expr (self);
   if (is_invalid_ast_node_id (body))
     {
       return get_invalid_ast_node_id ();
     }
-  Vec_ASTNodeId vars = Vec_ASTNodeId_with_capacity (1);
-  Vec_ASTNodeId_push (&vars, var);
-  Vec_ASTNodeId types = Vec_ASTNodeId_with_capacity (1);
-  Vec_ASTNodeId_push (&types, get_null_ast_node_id ());
+  ASTNodeId type = get_null_ast_node_id ();
   return ASTNodeManager_push_lambda (
-      self->ast_mgr_, Parser_span_from_last_node (self, cbegin, body), vars,
-      types, body);
+      self->ast_mgr_, Parser_span_from_last_node (self, begin, body), &var,
+      &type, 1, body);
 }
 
-static ASTNodeId
-invalid_and_drop_ids_1 (Vec_ASTNodeId *v)
-{
-  Vec_ASTNodeId_drop (v);
-  return get_invalid_ast_node_id ();
-}
-
-static ASTNodeId
-invalid_and_drop_ids_2 (Vec_ASTNodeId *v1, Vec_ASTNodeId *v2)
-{
-  Vec_ASTNodeId_drop (v1);
-  Vec_ASTNodeId_drop (v2);
-  return get_invalid_ast_node_id ();
-}
-
-static ASTNodeId
-invalid_and_drop_ids_3 (Vec_ASTNodeId *v1, Vec_ASTNodeId *v2,
-                        Vec_ASTNodeId *v3)
+/* Pops the child lists back to the lengths they had before the current node
+ * started, whether it was pushed or failed.  */
+static void
+Parser_truncate_scratch (Parser *self, size_t vars_len, size_t exprs_len)
 {
-  Vec_ASTNodeId_drop (v1);
-  Vec_ASTNodeId_drop (v2);
-  Vec_ASTNodeId_drop (v3);
-  return get_invalid_ast_node_id ();
+  Vec_ASTNodeId_resize (&self->vars_, vars_len, 0);
+  Vec_ASTNodeId_resize (&self->types_, vars_len, 0);
+  Vec_ASTNodeId_resize (&self->exprs_, exprs_len, 0);
 }
 
 static bool
-Parser_parse_push_var_and_type (Parser *self, Vec_ASTNodeId *vars,
-                                Vec_ASTNodeId *types)
+Parser_parse_push_var_and_type (Parser *self)
 {
   ASTNodeId var = Parser_parse_var (self);
   if (is_invalid_ast_node_id (var))
@@ -260,8 +250,8 @@ Parser_parse_push_var_and_type (Parser *self, Vec_ASTNodeId *vars,
           return false;
         }
     }
-  Vec_ASTNodeId_push (vars, var);
-  Vec_ASTNodeId_push (types, type);
+  Vec_ASTNodeId_push (&self->vars_, var);
+  Vec_ASTNodeId_push (&self->types_, type);
   return true;
 }
 
@@ -269,22 +259,24 @@ static ASTNodeId
 Parser_parse_lambda_paren_params (Parser *self)
 {
   assert (Parser_seeing (self, TOKEN_LPAREN));
-  const char *cbegin = Parser_cursor_cbegin (self);
+  uint32_t begin = Parser_cursor_begin (self);
   Parser_skip (self, 1);
-  Vec_ASTNodeId vars = Vec_ASTNodeId_new ();
-  Vec_ASTNodeId types = Vec_ASTNodeId_new ();
+  size_t vars_len = Vec_ASTNodeId_len (&self->vars_);
+  size_t exprs_len = Vec_ASTNodeId_len (&self->exprs_);
   /* The caller guarantees the parentheses are matched.  */
   if (!Parser_seeing (self, TOKEN_RPAREN)
-      && !Parser_parse_push_var_and_type (self, &vars, &types))
+      && !Parser_parse_push_var_and_type (self))
     {
-      return invalid_and_drop_ids_2 (&vars, &types);
+      Parser_truncate_scratch (self, vars_len, exprs_len);
+      return get_invalid_ast_node_id ();
     }
   while (!Parser_seeing (self, TOKEN_RPAREN))
     {
       if (!Parser_expect_and_skip (self, TOKEN_COMMA)
-          || !Parser_parse_push_var_and_type (self, &vars, &types))
+          || !Parser_parse_push_var_and_type (self))
         {
-          return invalid_and_drop_ids_2 (&vars, &types);
+          Parser_truncate_scratch (self, vars_len, exprs_len);
+          return get_invalid_ast_node_id ();
         }
     }
   Parser_skip (self, 1);
@@ -293,11 +285,16 @@ Parser_parse_lambda_paren_params (Parser *self)
   ASTNodeId body = Parser_parse_expr (self);
   if (is_invalid_ast_node_id (body))
     {
-      return invalid_and_drop_ids_2 (&vars, &types);
+      Parser_truncate_scratch (self, vars_len, exprs_len);
+      return get_invalid_ast_node_id ();
     }
-  return ASTNodeManager_push_lambda (
-      self->ast_mgr_, Parser_span_from_last_node (self, cbegin, body), vars,
-      types, body);
+  ASTNodeId id = ASTNodeManager_push_lambda (
+      self->ast_mgr_, Parser_span_from_last_node (self, begin, body),
+      Vec_ASTNodeId_cbegin (&self->vars_) + vars_len,
+      Vec_ASTNodeId_cbegin (&self->types_) + vars_len,
+      Vec_ASTNodeId_len (&self->vars_) - vars_len, body);
+  Parser_truncate_scratch (self, vars_len, exprs_len);
+  return id;
 }
 
 static const Token *
@@ -335,14 +332,14 @@ find_matched_rparen (const Token *lparen)
 }
 
 static bool
-Parser_parse_push_expr (Parser *self, Vec_ASTNodeId *exprs)
+Parser_parse_push_expr (Parser *self)
 {
   ASTNodeId expr = Parser_parse_expr (self);
   if (is_invalid_ast_node_id (expr))
     {
       return false;
     }
-  Vec_ASTNodeId_push (exprs, expr);
+  Vec_ASTNodeId_push (&self->exprs_, expr);
   return true;
 }
 
@@ -357,26 +354,32 @@ Parser_parse_tuple (Parser *self)
                                                      self->cursor_->span_);
       return get_invalid_ast_node_id ();
     }
-  const char *cbegin = Parser_cursor_cbegin (self);
+  uint32_t begin = Parser_cursor_begin (self);
   Parser_skip (self, 1);
-  Vec_ASTNodeId args = Vec_ASTNodeId_new ();
-  if (!Parser_seeing (self, TOKEN_RPAREN)
-      && !Parser_parse_push_expr (self, &args))
+  size_t vars_len = Vec_ASTNodeId_len (&self->vars_);
+  size_t exprs_len = Vec_ASTNodeId_len (&self->exprs_);
+  if (!Parser_seeing (self, TOKEN_RPAREN) && !Parser_parse_push_expr (self))
     {
-      return invalid_and_drop_ids_1 (&args);
+      Parser_truncate_scratch (self, vars_len, exprs_len);
+      return get_invalid_ast_node_id ();
     }
   while (!Parser_seeing (self, TOKEN_RPAREN))
     {
       if (!Parser_expect_and_skip (self, TOKEN_COMMA)
-          || !Parser_parse_push_expr (self, &args))
+          || !Parser_parse_push_expr (self))
         {
-          return invalid_and_drop_ids_1 (&args);
+          Parser_truncate_scratch (self, vars_len, exprs_len);
+          return get_invalid_ast_node_id ();
         }
     }
-  const char *cend = Span_cend (&self->cursor_->span_);
+  uint32_t end = CompactSpan_get_end (&self->cursor_->span_);
   Parser_skip (self, 1);
-  return ASTNodeManager_push_tuple (self->ast_mgr_,
-                                    Span_new (cbegin, cend - cbegin), args);
+  ASTNodeId id = ASTNodeManager_push_tuple (
+      self->ast_mgr_, CompactSpan_new (begin, end - begin),
+      Vec_ASTNodeId_cbegin (&self->exprs_) + exprs_len,
+      Vec_ASTNodeId_len (&self->exprs_) - exprs_len);
+  Parser_truncate_scratch (self, vars_len, exprs_len);
+  return id;
 }
 
 static ASTNodeId
@@ -417,8 +420,7 @@ Parser_parse_lparen (Parser *self)
 }
 
 static bool
-Parser_parse_push_var_type_init (Parser *self, Vec_ASTNodeId *vars,
-                                 Vec_ASTNodeId *types, Vec_ASTNodeId *inits)
+Parser_parse_push_var_type_init (Parser *self)
 {
   ASTNodeId var = Parser_parse_var (self);
   if (is_invalid_ast_node_id (var))
@@ -444,44 +446,51 @@ Parser_parse_push_var_type_init (Parser *self, Vec_ASTNodeId *vars,
     {
       return false;
     }
-  Vec_ASTNodeId_push (vars, var);
-  Vec_ASTNodeId_push (types, type);
-  Vec_ASTNodeId_push (inits, init);
+  Vec_ASTNodeId_push (&self->vars_, var);
+  Vec_ASTNodeId_push (&self->types_, type);
+  Vec_ASTNodeId_push (&self->exprs_, init);
   return true;
 }
 
 static ASTNodeId
 Parser_parse_let (Parser *self)
 {
-  const char *cbegin = Parser_cursor_cbegin (self);
+  uint32_t begin = Parser_cursor_begin (self);
   if (!Parser_expect_and_skip (self, TOKEN_LET))
     {
       return get_invalid_ast_node_id ();
     }
-  Vec_ASTNodeId vars = Vec_ASTNodeId_new ();
-  Vec_ASTNodeId types = Vec_ASTNodeId_new ();
-  Vec_ASTNodeId inits = Vec_ASTNodeId_new ();
-  if (!Parser_parse_push_var_type_init (self, &vars, &types, &inits))
+  size_t vars_len = Vec_ASTNodeId_len (&self->vars_);
+  size_t exprs_len = Vec_ASTNodeId_len (&self->exprs_);
+  if (!Parser_parse_push_var_type_init (self))
     {
-      return invalid_and_drop_ids_3 (&vars, &types, &inits);
+      Parser_truncate_scratch (self, vars_len, exprs_len);
+      return get_invalid_ast_node_id ();
     }
   while (!Parser_seeing (self, TOKEN_IN))
     {
       if (!Parser_expect_and_skip (self, TOKEN_COMMA)
-          || !Parser_parse_push_var_type_init (self, &vars, &types, &inits))
+          || !Parser_parse_push_var_type_init (self))
         {
-          return invalid_and_drop_ids_3 (&vars, &types, &inits);
+          Parser_truncate_scratch (self, vars_len, exprs_len);
+          return get_invalid_ast_node_id ();
         }
     }
   Parser_skip (self, 1);
   ASTNodeId body = Parser_parse_expr (self);
   if (is_invalid_ast_node_id (body))
     {
-      return invalid_and_drop_ids_3 (&vars, &types, &inits);
+      Parser_truncate_scratch (self, vars_len, exprs_len);
+      return get_invalid_ast_node_id ();
     }
-  return ASTNodeManager_push_let (
-      self->ast_mgr_, Parser_span_from_last_node (self, cbegin, body), vars,
-      types, inits, body);
+  ASTNodeId id = ASTNodeManager_push_let (
+      self->ast_mgr_, Parser_span_from_last_node (self, begin, body),
+      Vec_ASTNodeId_cbegin (&self->vars_) + vars_len,
+      Vec_ASTNodeId_cbegin (&self->types_) + vars_len,
+      Vec_ASTNodeId_cbegin (&self->exprs_) + exprs_len,
+      Vec_ASTNodeId_len (&self->vars_) - vars_len, body);
+  Parser_truncate_scratch (self, vars_len, exprs_len);
+  return id;
 }
 
 static ASTNodeId
@@ -541,15 +550,16 @@ Parser_parse_expr_before_tuple (Parser *self)
     }
 }
 
-static Span
+static CompactSpan
 Parser_span_between_node (const Parser *self, ASTNodeId first, ASTNodeId last)
 {
-  const char *cbegin
-      = Span_cbegin (&ASTNodeManager_get_node (self->ast_mgr_, first)->span_);
-  return Span_new (
-      cbegin,
-      Span_cend (&ASTNodeManager_get_node (self->ast_mgr_, last)->span_)
-          - cbegin);
+  const CompactSpan *first_span
+      = ASTNodeManager_get_span (self->ast_mgr_, first);
+  uint32_t begin = CompactSpan_get_offset (first_span);
+  return CompactSpan_new (
+      begin,
+      CompactSpan_get_end (ASTNodeManager_get_span (self->ast_mgr_, last))
+          - begin);
 }
 
 static ASTNodeId
@@ -574,27 +584,7 @@ Parser_parse_expr_before_operator (Parser *self)
       tuple);
 }
 
-static bool
-is_binary_op (enum TokenKind op)
-{
-  switch (op)
-    {
-    case TOKEN_PLUS:
-    case TOKEN_HYPHEN:
-    case TOKEN_ASTERISK:
-    case TOKEN_SLASH:
-    case TOKEN_EQ_EQ:
-    case TOKEN_SLASH_EQ:
-    case TOKEN_LT_EQ:
-    case TOKEN_GT_EQ:
-    case TOKEN_LT:
-    case TOKEN_GT:
-      return true;
-    default:
-      return false;
-    }
-}
-
+/* Returns 0 for tokens that are not binary operators.  */
 static int
 op_precedence (enum TokenKind op)
 {
@@ -618,72 +608,57 @@ op_precedence (enum TokenKind op)
     }
 }
 
+/* Precedence climbing: folds LEFT with the operators that follow, as long
+ * as they bind at least as tightly as MIN_PRECEDENCE.  Operators of equal
+ * precedence associate to the left.  The recursion goes one level deeper
+ * per level of precedence only, so no stack is needed besides the C one.  */
 static ASTNodeId
-drop_shunting_yard_stacks (Vec_ASTNodeId *expr_stack, Vec_TokenKind *op_stack)
-{
-  Vec_ASTNodeId_drop (expr_stack);
-  Vec_TokenKind_drop (op_stack);
-  return get_invalid_ast_node_id ();
-}
-
-static ASTNodeId
-Parser_parse_expr (Parser *self)
+Parser_parse_binary (Parser *self, ASTNodeId left, int min_precedence)
 {
-  ASTNodeId expr = Parser_parse_expr_before_operator (self);
-  if (is_invalid_ast_node_id (expr))
-    {
-      return get_invalid_ast_node_id ();
-    }
-  /* Shunting yard algorithm.  */
-  Vec_ASTNodeId expr_stack = Vec_ASTNodeId_new ();
-  Vec_ASTNodeId_push (&expr_stack, expr);
-  Vec_TokenKind op_stack = Vec_TokenKind_new ();
-  while (is_binary_op (Parser_cursor_kind (self)))
+  int precedence;
+  while ((precedence = op_precedence (Parser_cursor_kind (self)))
+         >= min_precedence)
     {
       enum TokenKind op = Parser_cursor_kind (self);
       Parser_skip (self, 1);
-      while (!Vec_TokenKind_is_empty (&op_stack)
-             && op_precedence (op)
-                    <= op_precedence (*(Vec_TokenKind_cend (&op_stack) - 1)))
+      ASTNodeId right = Parser_parse_expr_before_operator (self);
+      if (is_invalid_ast_node_id (right))
         {
-          enum TokenKind op_old = Vec_TokenKind_pop (&op_stack);
-          ASTNodeId right = Vec_ASTNodeId_pop (&expr_stack);
-          ASTNodeId left = Vec_ASTNodeId_pop (&expr_stack);
-          Vec_ASTNodeId_push (&expr_stack,
-                              ASTNodeManager_push_binary (
-                                  self->ast_mgr_,
-                                  Parser_span_between_node (self, left, right),
-                                  op_old, left, right));
+          return get_invalid_ast_node_id ();
         }
-      Vec_TokenKind_push (&op_stack, op);
-      expr = Parser_parse_expr_before_operator (self);
-      if (is_invalid_ast_node_id (expr))
+      if (op_precedence (Parser_cursor_kind (self)) > precedence)
         {
-          return drop_shunting_yard_stacks (&expr_stack, &op_stack);
+          right = Parser_parse_binary (self, right, precedence + 1);
+          if (is_invalid_ast_node_id (right))
+            {
+              return get_invalid_ast_node_id ();
+            }
         }
-      Vec_ASTNodeId_push (&expr_stack, expr);
+      left = ASTNodeManager_push_binary (
+          self->ast_mgr_, Parser_span_between_node (self, left, right), op,
+          left, right);
     }
-  while (!Vec_TokenKind_is_empty (&op_stack))
+  return left;
+}
+
+static ASTNodeId
+Parser_parse_expr (Parser *self)
+{
+  ASTNodeId expr = Parser_parse_expr_before_operator (self);
+  if (is_invalid_ast_node_id (expr))
     {
-      enum TokenKind op = Vec_TokenKind_pop (&op_stack);
-      ASTNodeId right = Vec_ASTNodeId_pop (&expr_stack);
-      ASTNodeId left = Vec_ASTNodeId_pop (&expr_stack);
-      Vec_ASTNodeId_push (&expr_stack,
-                          ASTNodeManager_push_binary (
-                              self->ast_mgr_,
-                              Parser_span_between_node (self, left, right), op,
-                              left, right));
+      return get_invalid_ast_node_id ();
     }
-  assert (Vec_ASTNodeId_len (&expr_stack) == 1);
-  expr = Vec_ASTNodeId_pop (&expr_stack);
-  Vec_ASTNodeId_drop (&expr_stack);
-  Vec_TokenKind_drop (&op_stack);
-  return expr;
+  return Parser_parse_binary (self, expr, 1);
 }
 
 ASTNodeId
 Parser_parse (Parser *self)
 {
+  /* Nodes are fewer than the tokens they are parsed from, so the columns
+   * grow once instead of being copied as they double.  */
+  ASTNodeManager_reserve (self->ast_mgr_,
+                          Vec_Token_cend (self->tokens_) - self->cursor_);
   ASTNodeId id = Parser_parse_expr (self);
   if (!is_invalid_ast_node_id (id) && !Token_is_eof (self->cursor_))
     {
@@ -694,6 +669,27 @@ Parser_parse (Parser *self)
   return id;
 }
 
+ASTNodeId
+Parser_parse_file (const SourceFile *file, DiagnosticManager *diag_mgr,
+                   ASTNodeManager *ast_mgr)
+{
+  Span content_span = Span_from_string (SourceFile_get_content (file));
+  Lexer lexer = Lexer_new (&content_span);
+  Vec_Token tokens = Vec_Token_new ();
+  Token token;
+  do
+    {
+      token = Lexer_next (&lexer);
+      Vec_Token_push (&tokens, token);
+    }
+  while (!Token_is_eof (&token));
+  Parser parser = Parser_new (&tokens, diag_mgr, ast_mgr);
+  ASTNodeId node_id = Parser_parse (&parser);
+  Parser_drop (&parser);
+  Vec_Token_drop (&tokens);
+  return node_id;
+}
+
 #ifdef TESTS
 #include "test.h"
 
@@ -723,6 +719,7 @@ ParserTest_init (ParserTest *self, const char *content)
   while (!Token_is_eof (&token));
   self->ast_mgr_ = ASTNodeManager_new ();
   self->diag_mgr_ = DiagnosticManager_new (&self->file_);
+  DiagnosticManager_set_display (&self->diag_mgr_, false);
   self->parser_
       = Parser_new (&self->tokens_, &self->diag_mgr_, &self->ast_mgr_);
 }
@@ -730,6 +727,7 @@ ParserTest_init (ParserTest *self, const char *content)
 static void
 ParserTest_drop (ParserTest *self)
 {
+  Parser_drop (&self->parser_);
   SourceFile_drop (&self->file_);
   Vec_Token_drop (&self->tokens_);
   ASTNodeManager_drop (&self->ast_mgr_);
@@ -814,7 +812,137 @@ NEO_TEST (test_parse_call_00)
                  0);
 }
 
+NEO_TEST (test_parse_let_02)
+{
+  ParserTest parser_test;
+  ParserTest_init (&parser_test, "let x = true, y: Bool = (x, x) in y");
+  ASTNodeId id = Parser_parse (ParserTest_borrow_parser (&parser_test));
+  const ASTNodeManager *ast_mgr = &parser_test.ast_mgr_;
+  ASSERT_U64_EQ (ASTNodeManager_get_kind (ast_mgr, id), AST_LET);
+  const ASTLet *let = &ASTNodeManager_get_payload (ast_mgr, id)->let_;
+  ASSERT_U64_EQ (let->num_vars_, 2);
+  const ASTNodeId *types = ASTNodeManager_get_let_types (ast_mgr, let);
+  ASSERT_U64_EQ (is_null_ast_node_id (types[0]), true);
+  ASSERT_U64_EQ (ASTNodeManager_get_kind (ast_mgr, types[1]), AST_TYPE);
+  const ASTNodeId *inits = ASTNodeManager_get_let_inits (ast_mgr, let);
+  ASSERT_U64_EQ (ASTNodeManager_get_kind (ast_mgr, inits[0]), AST_LIT_TRUE);
+  ASTNode tuple = ASTNodeManager_get_node (ast_mgr, inits[1]);
+  ASSERT_U64_EQ (tuple.kind_, AST_TUPLE);
+  ASSERT_U64_EQ (tuple.payload_.tuple_.num_args_, 2);
+  /* Children of the inner tuple are pooled before those of the let.  */
+  ASSERT_U64_EQ (tuple.payload_.tuple_.ids_ < let->ids_, true);
+  ParserTest_drop (&parser_test);
+}
+
+NEO_TEST (test_parse_binary_00)
+{
+  /* ((1 - 2) - (3 * 4)) < (5 + 6)  */
+  ParserTest parser_test;
+  ParserTest_init (&parser_test, "1 - 2 - 3 * 4 < 5 + 6");
+  ASTNodeId id = Parser_parse (ParserTest_borrow_parser (&parser_test));
+  const ASTNodeManager *ast_mgr = &parser_test.ast_mgr_;
+  ASSERT_U64_EQ (ASTNodeManager_get_kind (ast_mgr, id), AST_LT);
+  const ASTBinary *lt = &ASTNodeManager_get_payload (ast_mgr, id)->binary_;
+  ASSERT_U64_EQ (ASTNodeManager_get_kind (ast_mgr, lt->left_), AST_SUB);
+  ASSERT_U64_EQ (ASTNodeManager_get_kind (ast_mgr, lt->right_), AST_ADD);
+  const ASTBinary *sub
+      = &ASTNodeManager_get_payload (ast_mgr, lt->left_)->binary_;
+  ASSERT_U64_EQ (ASTNodeManager_get_kind (ast_mgr, sub->left_), AST_SUB);
+  ASSERT_U64_EQ (ASTNodeManager_get_kind (ast_mgr, sub->right_), AST_MUL);
+  const CompactSpan *span = ASTNodeManager_get_span (ast_mgr, id);
+  ASSERT_U64_EQ (CompactSpan_get_offset (span), 0);
+  ASSERT_U64_EQ (CompactSpan_get_end (span), 21);
+  ParserTest_drop (&parser_test);
+  ASSERT_U64_EQ (parse_num_diags ("1 + 2 *"), 1);
+}
+
 NEO_TESTS (parser_tests, test_parse_true_00, test_parse_if_00,
-           test_parse_let_00, test_parse_let_01, test_parse_lambda_00,
-           test_parse_call_00)
+           test_parse_let_00, test_parse_let_01, test_parse_let_02,
+           test_parse_lambda_00, test_parse_call_00, test_parse_binary_00)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+#include "arena.h"
+#include "span.h"
+
+NEO_BENCH (bench_parse_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"),
+                                    bench_gen_source (1 << 20, 42));
+  Span content_span = Span_from_string (SourceFile_get_content (&file));
+  Lexer lexer = Lexer_new (&content_span);
+  Vec_Token tokens = Vec_Token_new ();
+  Token token;
+  do
+    {
+      token = Lexer_next (&lexer);
+      Vec_Token_push (&tokens, token);
+    }
+  while (!Token_is_eof (&token));
+  size_t num_nodes = 0, num_bytes = 0, num_diags = 0;
+  BENCH_ITER
+  {
+    ASTNodeManager ast_mgr = ASTNodeManager_new ();
+    DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+    Parser parser = Parser_new (&tokens, &diag_mgr, &ast_mgr);
+    Parser_parse (&parser);
+    Parser_drop (&parser);
+    /* What a document keeps of the tree.  */
+    ASTNodeManager_shrink_to_fit (&ast_mgr);
+    num_nodes = ASTNodeManager_num_nodes (&ast_mgr);
+    num_bytes = ASTNodeManager_num_bytes (&ast_mgr);
+    num_diags = DiagnosticManager_num_total (&diag_mgr);
+    DiagnosticManager_drop (&diag_mgr);
+    ASTNodeManager_drop (&ast_mgr);
+  }
+  Bencher_report_u64 (bencher_, "nodes", num_nodes);
+  Bencher_report_u64 (bencher_, "diags", num_diags);
+  Bencher_report_f64 (bencher_, "bytes/node", (double)num_bytes / num_nodes);
+  Vec_Token_drop (&tokens);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCH (bench_parse_in_arena_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"),
+                                    bench_gen_source (1 << 20, 42));
+  size_t num_nodes = 0, num_allocs = 0, num_bytes = 0;
+  BENCH_ITER
+  {
+    /* As check does it, so that every reallocation shows in the arena,
+     * the parser's own included.  */
+    Arena arena = Arena_new ();
+    Span content_span = Span_from_string (SourceFile_get_content (&file));
+    Lexer lexer = Lexer_new (&content_span);
+    Vec_Token tokens = Vec_Token_new_in (&arena);
+    Token token;
+    do
+      {
+        token = Lexer_next (&lexer);
+        Vec_Token_push (&tokens, token);
+      }
+    while (!Token_is_eof (&token));
+    ASTNodeManager ast_mgr = ASTNodeManager_new_in (&arena);
+    DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+    Parser parser = Parser_new (&tokens, &diag_mgr, &ast_mgr);
+    Parser_parse (&parser);
+    Parser_drop (&parser);
+    num_nodes = ASTNodeManager_num_nodes (&ast_mgr);
+    num_allocs = Arena_num_allocs (&arena);
+    num_bytes = Arena_num_bytes (&arena);
+    DiagnosticManager_drop (&diag_mgr);
+    ASTNodeManager_drop (&ast_mgr);
+    Arena_drop (&arena);
+  }
+  Bencher_report_u64 (bencher_, "nodes", num_nodes);
+  Bencher_report_u64 (bencher_, "allocs", num_allocs);
+  Bencher_report_f64 (bencher_, "allocs/1k nodes",
+                      1000.0 * num_allocs / num_nodes);
+  Bencher_report_u64 (bencher_, "bytes", num_bytes);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCHES (parser_benches, bench_parse_00, bench_parse_in_arena_00)
 #endif
@@ -14,15 +14,32 @@ typedef struct Parser
   DiagnosticManager *diag_mgr_;
   ASTNodeManager *ast_mgr_;
   const Token *cursor_;
+  /* Stacks of the child lists being parsed, shared by nested nodes, and
+   * kept in the arena of the tree if it has one.  Binary operators need no
+   * stack but the C one.  */
+  Vec_ASTNodeId vars_;
+  Vec_ASTNodeId types_;
+  Vec_ASTNodeId exprs_;
 } Parser;
 
 Parser Parser_new (const Vec_Token *tokens, DiagnosticManager *diag_mgr,
                    ASTNodeManager *ast_mgr);
+void Parser_drop (Parser *self);
 ASTNodeId Parser_parse (Parser *self);
+/* Lexes the whole content of FILE and parses it, for a one-shot parse
+ * that does not keep the tokens.  */
+ASTNodeId Parser_parse_file (const SourceFile *file,
+                             DiagnosticManager *diag_mgr,
+                             ASTNodeManager *ast_mgr);
 
 #ifdef TESTS
 #include "test.h"
 Tests parser_tests ();
 #endif
 
+#ifdef BENCHES
+#include "bench.h"
+Benches parser_benches ();
+#endif
+
 #endif
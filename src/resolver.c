@@ -0,0 +1,446 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#include "resolver.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast_node.h"
+#include "hash_map_macro.h"
+#include "span.h"
+#include "type.h"
+#include "vec.h"
+#include "vec_macro.h"
+
+NEO_IMPL_VEC (ASTAddress, ASTAddress)
+
+/* A name in scope, with the entry of the same name that it shadows.  */
+typedef struct ResolverEntry
+{
+  Span name_;
+  ASTNodeId binding_;
+  uint32_t frame_;
+  uint32_t shadowed_;
+} ResolverEntry;
+
+#define RESOLVER_NONE (UINT32_MAX)
+
+NEO_DECL_VEC (ResolverEntry, ResolverEntry)
+NEO_IMPL_VEC (ResolverEntry, ResolverEntry)
+NEO_DECL_HASHMAP (Span_Resolver, Span, uint32_t)
+NEO_IMPL_HASHMAP (Span_Resolver, Span, uint32_t, Span_hash, Span_eq)
+
+/* The names in scope, as a stack of entries cut into frames, with a map
+ * from each name to its innermost entry, as in the checker.  */
+typedef struct Resolver
+{
+  const ASTNodeManager *ast_mgr_;
+  const SourceFile *file_;
+  ASTScopes *scopes_;
+  Vec_ResolverEntry entries_;
+  HashMap_Span_Resolver innermost_;
+  /* Where each frame begins in ENTRIES_, innermost last.  */
+  Vec_u32 frames_;
+  /* A stack of the child lists being walked, shared by nested nodes.  */
+  Vec_ASTNodeId children_;
+} Resolver;
+
+static void
+Resolver_enter (Resolver *self)
+{
+  Vec_u32_push (&self->frames_, Vec_ResolverEntry_len (&self->entries_));
+}
+
+static void
+Resolver_push (Resolver *self, Span name, ASTNodeId binding)
+{
+  uint32_t index = Vec_ResolverEntry_len (&self->entries_);
+  uint32_t *innermost
+      = HashMap_Span_Resolver_get_or_insert (&self->innermost_, name, index);
+  Vec_ResolverEntry_push (
+      &self->entries_,
+      (ResolverEntry){ .name_ = name,
+                       .binding_ = binding,
+                       .frame_ = Vec_u32_len (&self->frames_) - 1,
+                       .shadowed_ = *innermost == index ? RESOLVER_NONE
+                                                        : *innermost });
+  *innermost = index;
+}
+
+/* A var that binds a name is addressed as the slot that it binds.  */
+static void
+Resolver_bind (Resolver *self, ASTNodeId var)
+{
+  uint32_t index = Vec_ResolverEntry_len (&self->entries_);
+  Vec_ASTAddress_begin (&self->scopes_->addresses_)[var] = (ASTAddress){
+    .binding_ = var,
+    .depth_ = 0,
+    .slot_ = index - Vec_u32_cend (&self->frames_)[-1],
+  };
+  Span name = SourceFile_get_span (
+      self->file_, *ASTNodeManager_get_span (self->ast_mgr_, var));
+  Resolver_push (self, name, var);
+}
+
+/* Pops the innermost frame, bringing back the entries it shadowed.  */
+static void
+Resolver_leave (Resolver *self)
+{
+  uint32_t begin = Vec_u32_pop (&self->frames_);
+  while (Vec_ResolverEntry_len (&self->entries_) > begin)
+    {
+      ResolverEntry entry = Vec_ResolverEntry_pop (&self->entries_);
+      if (entry.shadowed_ == RESOLVER_NONE)
+        {
+          HashMap_Span_Resolver_remove (&self->innermost_, &entry.name_);
+        }
+      else
+        {
+          *HashMap_Span_Resolver_get (&self->innermost_, &entry.name_)
+              = entry.shadowed_;
+        }
+    }
+}
+
+static void
+Resolver_resolve_name (Resolver *self, ASTNodeId node_id)
+{
+  Span name = SourceFile_get_span (
+      self->file_, *ASTNodeManager_get_span (self->ast_mgr_, node_id));
+  const uint32_t *index
+      = HashMap_Span_Resolver_cget (&self->innermost_, &name);
+  ASTAddress *address
+      = Vec_ASTAddress_begin (&self->scopes_->addresses_) + node_id;
+  if (!index)
+    {
+      self->scopes_->num_unbound_++;
+      *address = (ASTAddress){ .binding_ = get_null_ast_node_id (),
+                               .depth_ = AST_ADDRESS_UNBOUND,
+                               .slot_ = 0 };
+      return;
+    }
+  const ResolverEntry *entry
+      = Vec_ResolverEntry_cbegin (&self->entries_) + *index;
+  uint32_t num_frames = Vec_u32_len (&self->frames_);
+  *address = (ASTAddress){
+    .binding_ = entry->binding_,
+    .depth_ = num_frames - 1 - entry->frame_,
+    .slot_ = *index - Vec_u32_cbegin (&self->frames_)[entry->frame_],
+  };
+}
+
+static void Resolver_resolve (Resolver *self, ASTNodeId node_id);
+
+/* Each var is bound once its init and type are resolved, as the checker
+ * binds it once they are typed.  */
+static void
+Resolver_resolve_let (Resolver *self, const ASTLet *let)
+{
+  for (uint32_t i = 0; i < let->num_vars_; i++)
+    {
+      Resolver_resolve (self,
+                        ASTNodeManager_get_let_inits (self->ast_mgr_, let)[i]);
+      Resolver_resolve (self,
+                        ASTNodeManager_get_let_types (self->ast_mgr_, let)[i]);
+      if (i == 0)
+        {
+          Resolver_enter (self);
+        }
+      Resolver_bind (self,
+                     ASTNodeManager_get_let_vars (self->ast_mgr_, let)[i]);
+    }
+  Resolver_resolve (self, let->body_);
+  if (let->num_vars_)
+    {
+      Resolver_leave (self);
+    }
+}
+
+static void
+Resolver_resolve_lambda (Resolver *self, const ASTLambda *lambda)
+{
+  for (uint32_t i = 0; i < lambda->num_vars_; i++)
+    {
+      Resolver_resolve (
+          self, ASTNodeManager_get_lambda_types (self->ast_mgr_, lambda)[i]);
+    }
+  Resolver_enter (self);
+  for (uint32_t i = 0; i < lambda->num_vars_; i++)
+    {
+      Resolver_bind (
+          self, ASTNodeManager_get_lambda_vars (self->ast_mgr_, lambda)[i]);
+    }
+  Resolver_resolve (self, lambda->body_);
+  Resolver_leave (self);
+}
+
+static void
+Resolver_resolve (Resolver *self, ASTNodeId node_id)
+{
+  const ASTPayload *payload
+      = ASTNodeManager_get_payload (self->ast_mgr_, node_id);
+  uint32_t *frame_size
+      = Vec_u32_begin (&self->scopes_->frame_sizes_) + node_id;
+  switch (ASTNodeManager_get_kind (self->ast_mgr_, node_id))
+    {
+    case AST_VAR:
+    case AST_TYPE:
+      {
+        Resolver_resolve_name (self, node_id);
+        break;
+      }
+    case AST_LET:
+      {
+        *frame_size = payload->let_.num_vars_;
+        Resolver_resolve_let (self, &payload->let_);
+        break;
+      }
+    case AST_LAMBDA:
+      {
+        *frame_size = payload->lambda_.num_vars_;
+        Resolver_resolve_lambda (self, &payload->lambda_);
+        break;
+      }
+    default:
+      {
+        size_t begin = Vec_ASTNodeId_len (&self->children_);
+        ASTNodeManager_push_children (self->ast_mgr_, node_id,
+                                      &self->children_);
+        size_t end = Vec_ASTNodeId_len (&self->children_);
+        for (size_t i = begin; i < end; i++)
+          {
+            Resolver_resolve (self,
+                              Vec_ASTNodeId_cbegin (&self->children_)[i]);
+          }
+        Vec_ASTNodeId_resize (&self->children_, begin, 0);
+        break;
+      }
+    }
+}
+
+ASTScopes
+ASTScopes_resolve (const ASTNodeManager *ast_mgr, const SourceFile *file,
+                   ASTNodeId root)
+{
+  size_t num_nodes = ASTNodeManager_num_nodes (ast_mgr);
+  ASTScopes scopes = { .addresses_ = Vec_ASTAddress_new (),
+                       .frame_sizes_ = Vec_u32_new (),
+                       .num_unbound_ = 0 };
+  Vec_ASTAddress_resize (
+      &scopes.addresses_, num_nodes,
+      (ASTAddress){ .binding_ = get_null_ast_node_id (),
+                    .depth_ = AST_ADDRESS_UNBOUND,
+                    .slot_ = 0 });
+  Vec_u32_resize (&scopes.frame_sizes_, num_nodes, 0);
+  Resolver resolver = { .ast_mgr_ = ast_mgr,
+                        .file_ = file,
+                        .scopes_ = &scopes,
+                        .entries_ = Vec_ResolverEntry_new (),
+                        .innermost_ = HashMap_Span_Resolver_new (),
+                        .frames_ = Vec_u32_new (),
+                        .children_ = Vec_ASTNodeId_new () };
+  Resolver_enter (&resolver);
+  for (enum TypeKind kind = TYPE_NAMED_BEGIN; kind < TYPE_NAMED_END; kind++)
+    {
+      Resolver_push (&resolver, Span_from_cstring (TypeKind_get_name (kind)),
+                     get_null_ast_node_id ());
+    }
+  Resolver_resolve (&resolver, root);
+  Resolver_leave (&resolver);
+  assert (Vec_u32_is_empty (&resolver.frames_));
+  Vec_ResolverEntry_drop (&resolver.entries_);
+  HashMap_Span_Resolver_drop (&resolver.innermost_);
+  Vec_u32_drop (&resolver.frames_);
+  Vec_ASTNodeId_drop (&resolver.children_);
+  return scopes;
+}
+
+void
+ASTScopes_drop (ASTScopes *self)
+{
+  Vec_ASTAddress_drop (&self->addresses_);
+  Vec_u32_drop (&self->frame_sizes_);
+}
+
+const ASTAddress *
+ASTScopes_get_address (const ASTScopes *self, ASTNodeId node_id)
+{
+  assert (node_id < Vec_ASTAddress_len (&self->addresses_));
+  return Vec_ASTAddress_cbegin (&self->addresses_) + node_id;
+}
+
+uint32_t
+ASTScopes_get_frame_size (const ASTScopes *self, ASTNodeId node_id)
+{
+  assert (node_id < Vec_u32_len (&self->frame_sizes_));
+  return Vec_u32_cbegin (&self->frame_sizes_)[node_id];
+}
+
+#ifdef TESTS
+#include "test.h"
+
+#include <string.h>
+
+#include "diagnostic.h"
+#include "parser.h"
+
+/* Writes the address of each var and type of the tree, as `name@depth.slot`
+ * or `name@?` if it is unbound, and the frame size of each let and lambda,
+ * as `{size}`, in the order of their ids.  */
+static void
+ASTScopes_write (const ASTScopes *self, const ASTNodeManager *ast_mgr,
+                 const SourceFile *file, ASTNodeId root, String *str)
+{
+  char buf[32];
+  for (ASTNodeId id = get_invalid_ast_node_id () + 1; id <= root; id++)
+    {
+      switch (ASTNodeManager_get_kind (ast_mgr, id))
+        {
+        case AST_VAR:
+        case AST_TYPE:
+          {
+            Span name = SourceFile_get_span (
+                file, *ASTNodeManager_get_span (ast_mgr, id));
+            const ASTAddress *address = ASTScopes_get_address (self, id);
+            String_push_carray (str, Span_cbegin (&name), Span_len (&name));
+            if (address->depth_ == AST_ADDRESS_UNBOUND)
+              {
+                String_push_cstring (str, "@? ");
+              }
+            else
+              {
+                snprintf (buf, sizeof (buf), "@%u.%u ", address->depth_,
+                          address->slot_);
+                String_push_cstring (str, buf);
+              }
+            break;
+          }
+        case AST_LET:
+        case AST_LAMBDA:
+          {
+            snprintf (buf, sizeof (buf), "{%u} ",
+                      ASTScopes_get_frame_size (self, id));
+            String_push_cstring (str, buf);
+            break;
+          }
+        default:
+          break;
+        }
+    }
+}
+
+/* Returns the number of names bound by a var of another name, plus 1 unless
+ * the addresses of CONTENT are written as EXPECTED, with a trailing
+ * space.  */
+static size_t
+resolve_num_mismatches (const char *content, const char *expected)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("test"),
+                                    String_from_cstring (content));
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  ASTNodeId root = Parser_parse_file (&file, &diag_mgr, &ast_mgr);
+  ASTScopes scopes = ASTScopes_resolve (&ast_mgr, &file, root);
+  size_t num_mismatches = 0;
+  for (ASTNodeId id = get_invalid_ast_node_id () + 1; id <= root; id++)
+    {
+      const ASTAddress *address = ASTScopes_get_address (&scopes, id);
+      if (!is_null_ast_node_id (address->binding_))
+        {
+          Span name = SourceFile_get_span (
+              &file, *ASTNodeManager_get_span (&ast_mgr, id));
+          Span binding = SourceFile_get_span (
+              &file, *ASTNodeManager_get_span (&ast_mgr, address->binding_));
+          num_mismatches += !Span_eq (&name, &binding);
+        }
+    }
+  String str = String_new ();
+  ASTScopes_write (&scopes, &ast_mgr, &file, root, &str);
+  num_mismatches
+      += String_len (&str) != strlen (expected)
+         || memcmp (String_cbegin (&str), expected, String_len (&str));
+  String_drop (&str);
+  ASTScopes_drop (&scopes);
+  DiagnosticManager_drop (&diag_mgr);
+  ASTNodeManager_drop (&ast_mgr);
+  SourceFile_drop (&file);
+  return num_mismatches;
+}
+
+NEO_TEST (test_resolve_00)
+{
+  static const char *const cases[][2] = {
+    { "true", "" },
+    { "x", "x@? " },
+    { "let x = true, y: Bool = x in (x, y)",
+      "x@0.0 y@0.1 Bool@1.0 x@0.0 x@0.0 y@0.1 {2} " },
+    /* The named types are bound in the root frame in the order of their
+     * kinds.  */
+    { "let x: Int64 = 1, y: Int = x in y",
+      "x@0.0 Int64@0.2 y@0.1 Int@1.1 x@0.0 y@0.1 {2} " },
+    /* The frame of a let is opened as its first var is bound.  */
+    { "let x = let y = true in y in x", "x@0.0 y@0.0 y@0.0 {1} x@0.0 {1} " },
+    { "let x = true in let x = x in x",
+      "x@0.0 x@0.0 x@0.0 x@0.0 {1} {1} " },
+    { "let x = true, f = (a, b: Bool) +> if a then x else c in f",
+      "x@0.0 f@0.1 a@0.0 b@0.1 Bool@1.0 a@0.0 x@1.0 c@? {2} f@0.1 {2} " },
+    { "a +> b +> a", "a@0.0 b@0.0 a@1.0 {1} {1} " },
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      ASSERT_U64_EQ (resolve_num_mismatches (cases[i][0], cases[i][1]), 0);
+    }
+}
+
+NEO_TESTS (resolver_tests, test_resolve_00)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+#include "diagnostic.h"
+#include "parser.h"
+
+/* Resolves the names of SOURCE, which it takes.  */
+static void
+resolve_bench (Bencher *bencher_, String source)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"), source);
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  ASTNodeId node_id = Parser_parse_file (&file, &diag_mgr, &ast_mgr);
+  size_t num_unbound = 0;
+  BENCH_ITER
+  {
+    ASTScopes scopes = ASTScopes_resolve (&ast_mgr, &file, node_id);
+    num_unbound = scopes.num_unbound_;
+    ASTScopes_drop (&scopes);
+  }
+  Bencher_report_u64 (bencher_, "nodes", ASTNodeManager_num_nodes (&ast_mgr));
+  Bencher_report_u64 (bencher_, "unbound", num_unbound);
+  DiagnosticManager_drop (&diag_mgr);
+  ASTNodeManager_drop (&ast_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCH (bench_resolve_00)
+{
+  resolve_bench (bencher_, bench_gen_source (1 << 20, 42));
+}
+
+NEO_BENCH (bench_resolve_let_00)
+{
+  resolve_bench (bencher_, bench_gen_let_source (1000, 4, 42));
+}
+
+NEO_BENCH (bench_resolve_let_01)
+{
+  resolve_bench (bencher_, bench_gen_let_source (10000, 2, 42));
+}
+
+NEO_BENCHES (resolver_benches, bench_resolve_00, bench_resolve_let_00,
+             bench_resolve_let_01)
+#endif
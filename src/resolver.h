@@ -0,0 +1,62 @@
+/* Copyright (C) 2022 Yanxuan Cui <e-neo@qq.com>, all rights reserved.  */
+
+#ifndef NEO_RESOLVER_H
+#define NEO_RESOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast_node.h"
+#include "span.h"
+#include "vec.h"
+#include "vec_macro.h"
+
+/* The depth of a name that nothing binds.  */
+#define AST_ADDRESS_UNBOUND (UINT32_MAX)
+
+/* Where a var or type name is bound: in slot SLOT_ of the frame DEPTH_
+ * frames out from the innermost one at the name.  BINDING_ is the var that
+ * binds it, or null for a built-in name.  */
+typedef struct ASTAddress
+{
+  ASTNodeId binding_;
+  uint32_t depth_;
+  uint32_t slot_;
+} ASTAddress;
+
+NEO_DECL_VEC (ASTAddress, ASTAddress)
+
+/* The addresses of the names of a tree, and the frame sizes of its scopes,
+ * indexed by node id.  The root frame holds the built-in types, as the
+ * checker binds them.  A let or a lambda opens a frame with a slot for each
+ * of its vars.  A lambda opens it before its body, but a let only as it
+ * binds its first var, after the first init is typed, so that its frame
+ * does not count from the first init.  */
+typedef struct ASTScopes
+{
+  Vec_ASTAddress addresses_;
+  Vec_u32 frame_sizes_;
+  size_t num_unbound_;
+} ASTScopes;
+
+/* Resolves the names of the tree at ROOT, whose text is in FILE.  */
+ASTScopes ASTScopes_resolve (const ASTNodeManager *ast_mgr,
+                             const SourceFile *file, ASTNodeId root);
+void ASTScopes_drop (ASTScopes *self);
+/* Of a var or a type.  */
+const ASTAddress *ASTScopes_get_address (const ASTScopes *self,
+                                         ASTNodeId node_id);
+/* Of a let or a lambda.  */
+uint32_t ASTScopes_get_frame_size (const ASTScopes *self, ASTNodeId node_id);
+
+#ifdef TESTS
+#include "test.h"
+Tests resolver_tests ();
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+Benches resolver_benches ();
+#endif
+
+#endif
@@ -6,6 +6,7 @@
 #include <stddef.h>
 #include <string.h>
 
+#include "hash_map_macro.h"
 #include "result.h"
 #include "string.h"
 #include "vec.h"
@@ -101,6 +102,65 @@ Span_cmp_cstring (const Span *self, const char *cstr)
   return cstr[span_len] == '\0' ? 0 : -1;
 }
 
+uint64_t
+Span_hash (const Span *self)
+{
+  return neo_hash_bytes (Span_cbegin (self), Span_len (self));
+}
+
+bool
+Span_eq (const Span *self, const Span *other)
+{
+  size_t len = Span_len (self);
+  return len == Span_len (other)
+         && (!len || !memcmp (Span_cbegin (self), Span_cbegin (other), len));
+}
+
+CompactSpan
+CompactSpan_new (uint32_t offset, uint32_t len)
+{
+  return (CompactSpan){ .offset_ = offset, .len_ = len };
+}
+
+CompactSpan
+CompactSpan_from_span (const Span *span, const char *base)
+{
+  assert (Span_cbegin (span) >= base);
+  assert ((size_t)(Span_cend (span) - base) <= UINT32_MAX);
+  return CompactSpan_new (Span_cbegin (span) - base, Span_len (span));
+}
+
+uint32_t
+CompactSpan_get_offset (const CompactSpan *self)
+{
+  return self->offset_;
+}
+
+uint32_t
+CompactSpan_get_end (const CompactSpan *self)
+{
+  return self->offset_ + self->len_;
+}
+
+uint32_t
+CompactSpan_len (const CompactSpan *self)
+{
+  return self->len_;
+}
+
+Span
+CompactSpan_to_span (const CompactSpan *self, const char *base)
+{
+  return Span_new (base + self->offset_, self->len_);
+}
+
+bool
+CompactSpan_contains (const CompactSpan *self, const CompactSpan *other)
+{
+  return CompactSpan_get_offset (self) <= CompactSpan_get_offset (other)
+         && CompactSpan_get_end (other) <= CompactSpan_get_end (self);
+}
+
 Position
 Position_new (size_t line, size_t column)
 {
@@ -122,18 +182,15 @@ Position_get_column (const Position *self)
 SourceFile
 SourceFile_new (String path, String content)
 {
-  Vec_const_char_ptr lines = Vec_const_char_ptr_new ();
-  const char *ptr = String_cbegin (&content);
-  do
+  Vec_u32 lines = Vec_u32_new ();
+  Vec_u32_push (&lines, 0);
+  for (size_t i = 0; i < String_len (&content); i++)
     {
-      Vec_const_char_ptr_push (&lines, ptr);
-      while (ptr < String_cend (&content) && *ptr != '\n')
+      if (String_cbegin (&content)[i] == '\n')
         {
-          ptr++;
+          Vec_u32_push (&lines, i + 1);
         }
-      ptr++;
     }
-  while (ptr <= String_cend (&content));
   return (SourceFile){ .path_ = path, .content_ = content, .lines_ = lines };
 }
 
@@ -142,7 +199,7 @@ SourceFile_drop (SourceFile *self)
 {
   String_drop (&self->path_);
   String_drop (&self->content_);
-  Vec_const_char_ptr_drop (&self->lines_);
+  Vec_u32_drop (&self->lines_);
 }
 
 const String *
@@ -158,9 +215,9 @@ SourceFile_get_content (const SourceFile *self)
 }
 
 static int
-compare_const_char_ptr (const char *key, const char *item)
+compare_u32 (uint32_t key, uint32_t item)
 {
-  return key - item;
+  return (key > item) - (key < item);
 }
 
 static size_t
@@ -173,10 +230,11 @@ SourceFile_lookup_line (const SourceFile *self, const char *pos)
     }
   if (pos == String_cend (SourceFile_get_content (self)))
     {
-      return Vec_const_char_ptr_len (&self->lines_);
+      return Vec_u32_len (&self->lines_);
     }
-  Result_size_t_size_t res = Vec_const_char_ptr_binary_search_by (
-      &self->lines_, &pos, compare_const_char_ptr);
+  uint32_t offset = pos - String_cbegin (SourceFile_get_content (self));
+  Result_size_t_size_t res
+      = Vec_u32_binary_search_by (&self->lines_, &offset, compare_u32);
   if (Result_size_t_size_t_is_ok (&res))
     {
       return Result_size_t_size_t_unwrap (&res) + 1;
@@ -190,23 +248,148 @@ SourceFile_lookup_position (const SourceFile *self, const char *pos)
   size_t line = SourceFile_lookup_line (self, pos);
   if (line)
     {
-      return Position_new (
-          line, pos - Vec_const_char_ptr_cbegin (&self->lines_)[line - 1]);
+      return Position_new (line,
+                           pos - String_cbegin (&self->content_)
+                               - Vec_u32_cbegin (&self->lines_)[line - 1]);
     }
   return Position_new (0, 0);
 }
 
+/* Lines a cursor steps over before it falls back to a binary search.  */
+#define POSITION_CURSOR_MAX_STEPS 8
+
+PositionCursor
+PositionCursor_new (const SourceFile *file)
+{
+  return (PositionCursor){ .file_ = file, .line_ = 0 };
+}
+
+const SourceFile *
+PositionCursor_get_file (const PositionCursor *self)
+{
+  return self->file_;
+}
+
+Position
+PositionCursor_lookup (PositionCursor *self, const char *pos)
+{
+  const String *content = SourceFile_get_content (self->file_);
+  if (pos < String_cbegin (content) || pos > String_cend (content))
+    {
+      return Position_new (0, 0);
+    }
+  uint32_t offset = pos - String_cbegin (content);
+  const uint32_t *lines = Vec_u32_cbegin (&self->file_->lines_);
+  size_t num_lines = Vec_u32_len (&self->file_->lines_);
+  size_t line = self->line_;
+  if (line >= num_lines || offset < lines[line])
+    {
+      line = SourceFile_lookup_line (self->file_, pos) - 1;
+    }
+  else
+    {
+      size_t num_steps = 0;
+      while (line + 1 < num_lines && lines[line + 1] <= offset)
+        {
+          if (++num_steps > POSITION_CURSOR_MAX_STEPS)
+            {
+              line = SourceFile_lookup_line (self->file_, pos) - 1;
+              break;
+            }
+          line++;
+        }
+    }
+  self->line_ = line;
+  return Position_new (line + 1, offset - lines[line]);
+}
+
+uint32_t
+SourceFile_lookup_offset (const SourceFile *self, Position pos)
+{
+  if (pos.line_ == 0)
+    {
+      return 0;
+    }
+  if (pos.line_ > Vec_u32_len (&self->lines_))
+    {
+      return String_len (&self->content_);
+    }
+  Span line = SourceFile_get_line (self, pos.line_);
+  size_t len = Span_len (&line);
+  if (len && Span_cbegin (&line)[len - 1] == '\n')
+    {
+      len--;
+    }
+  return Vec_u32_cbegin (&self->lines_)[pos.line_ - 1]
+         + (pos.column_ < len ? pos.column_ : len);
+}
+
+size_t
+SourceFile_num_lines (const SourceFile *self)
+{
+  return Vec_u32_len (&self->lines_);
+}
+
 Span
 SourceFile_get_line (const SourceFile *self, size_t line)
 {
   assert (line);
-  const char *begin = Vec_const_char_ptr_cbegin (&self->lines_)[line - 1];
-  const char *end = line >= Vec_const_char_ptr_len (&self->lines_)
+  const char *content = String_cbegin (&self->content_);
+  const char *begin = content + Vec_u32_cbegin (&self->lines_)[line - 1];
+  const char *end = line >= Vec_u32_len (&self->lines_)
                         ? String_cend (&self->content_)
-                        : Vec_const_char_ptr_cbegin (&self->lines_)[line];
+                        : content + Vec_u32_cbegin (&self->lines_)[line];
   return Span_new (begin, end - begin);
 }
 
+Span
+SourceFile_get_span (const SourceFile *self, CompactSpan span)
+{
+  assert (CompactSpan_get_end (&span) <= String_len (&self->content_));
+  return CompactSpan_to_span (&span, String_cbegin (&self->content_));
+}
+
+void
+SourceFile_edit (SourceFile *self, CompactSpan range, Span text)
+{
+  uint32_t begin = CompactSpan_get_offset (&range);
+  uint32_t end = CompactSpan_get_end (&range);
+  assert (end <= String_len (&self->content_));
+  assert ((uint64_t)String_len (&self->content_) - CompactSpan_len (&range)
+              + Span_len (&text)
+          <= UINT32_MAX);
+  String_replace (&self->content_, begin, CompactSpan_len (&range),
+                  Span_cbegin (&text), Span_len (&text));
+  /* The lines beginning in (BEGIN, END] began after a replaced newline.  */
+  Result_size_t_size_t res
+      = Vec_u32_binary_search_by (&self->lines_, &begin, compare_u32);
+  size_t first = Result_size_t_size_t_is_ok (&res)
+                     ? Result_size_t_size_t_unwrap (&res) + 1
+                     : Result_size_t_size_t_unwrap_err (&res);
+  size_t last = first;
+  while (last < Vec_u32_len (&self->lines_)
+         && Vec_u32_cbegin (&self->lines_)[last] <= end)
+    {
+      last++;
+    }
+  Vec_u32 lines = Vec_u32_new ();
+  for (size_t i = 0; i < Span_len (&text); i++)
+    {
+      if (Span_cbegin (&text)[i] == '\n')
+        {
+          Vec_u32_push (&lines, begin + i + 1);
+        }
+    }
+  Vec_u32_splice (&self->lines_, first, last - first, Vec_u32_cbegin (&lines),
+                  Vec_u32_len (&lines));
+  uint32_t *ptr = Vec_u32_begin (&self->lines_) + first + Vec_u32_len (&lines);
+  for (; ptr < Vec_u32_end (&self->lines_); ptr++)
+    {
+      *ptr = *ptr - end + begin + Span_len (&text);
+    }
+  Vec_u32_drop (&lines);
+}
+
 #ifdef TESTS
 #include "test.h"
 
@@ -238,14 +421,12 @@ NEO_TEST (test_source_file_lookup_line_00)
                                          "} else {\n"
                                          "  false\n"
                                          "}");
-  ASSERT_U64_EQ (Vec_const_char_ptr_len (&file.lines_), 5);
+  ASSERT_U64_EQ (Vec_u32_len (&file.lines_), 5);
   const String *content = SourceFile_get_content (&file);
   size_t offsets[] = { 0, 10, 17, 26, 34 };
-  for (size_t i = 0; i < Vec_const_char_ptr_len (&file.lines_); i++)
+  for (size_t i = 0; i < Vec_u32_len (&file.lines_); i++)
     {
-      ASSERT_U64_EQ (Vec_const_char_ptr_cbegin (&file.lines_)[i]
-                         - (String_cbegin (content) + offsets[i]),
-                     0);
+      ASSERT_U64_EQ (Vec_u32_cbegin (&file.lines_)[i], offsets[i]);
     }
   ASSERT_U64_EQ (SourceFile_lookup_line (&file, NULL), 0);
   ASSERT_U64_EQ (SourceFile_lookup_line (&file, String_cend (content) + 1), 0);
@@ -263,14 +444,12 @@ NEO_TEST (test_source_file_lookup_line_01)
                                          "} else {\n"
                                          "  false\n"
                                          "}\n");
-  ASSERT_U64_EQ (Vec_const_char_ptr_len (&file.lines_), 6);
+  ASSERT_U64_EQ (Vec_u32_len (&file.lines_), 6);
   const String *content = SourceFile_get_content (&file);
   size_t offsets[] = { 0, 10, 17, 26, 34, 36 };
-  for (size_t i = 0; i < Vec_const_char_ptr_len (&file.lines_); i++)
+  for (size_t i = 0; i < Vec_u32_len (&file.lines_); i++)
     {
-      ASSERT_U64_EQ (Vec_const_char_ptr_cbegin (&file.lines_)[i]
-                         - (String_cbegin (content) + offsets[i]),
-                     0);
+      ASSERT_U64_EQ (Vec_u32_cbegin (&file.lines_)[i], offsets[i]);
     }
   ASSERT_U64_EQ (SourceFile_lookup_line (&file, NULL), 0);
   ASSERT_U64_EQ (SourceFile_lookup_line (&file, String_cend (content) + 1), 0);
@@ -309,8 +488,197 @@ NEO_TEST (test_source_file_lookup_position_01)
   SourceFile_drop (&file);
 }
 
+NEO_TEST (test_source_file_lookup_offset_00)
+{
+  SourceFile file = SourceFile_new_test ("true\nfalse");
+  ASSERT_U64_EQ (SourceFile_num_lines (&file), 2);
+  ASSERT_U64_EQ (SourceFile_lookup_offset (&file, Position_new (1, 2)), 2);
+  /* Past the end of a line is its end, before the newline.  */
+  ASSERT_U64_EQ (SourceFile_lookup_offset (&file, Position_new (1, 9)), 4);
+  ASSERT_U64_EQ (SourceFile_lookup_offset (&file, Position_new (2, 0)), 5);
+  ASSERT_U64_EQ (SourceFile_lookup_offset (&file, Position_new (2, 9)), 10);
+  ASSERT_U64_EQ (SourceFile_lookup_offset (&file, Position_new (3, 0)), 10);
+  ASSERT_U64_EQ (SourceFile_lookup_offset (&file, Position_new (0, 3)), 0);
+  SourceFile_drop (&file);
+}
+
+NEO_TEST (test_source_file_get_span_00)
+{
+  SourceFile file = SourceFile_new_test ("let x = true in\nx");
+  const String *content = SourceFile_get_content (&file);
+  Span x = Span_new (String_cbegin (content) + 16, 1);
+  CompactSpan compact = CompactSpan_from_span (&x, String_cbegin (content));
+  ASSERT_U64_EQ (CompactSpan_get_offset (&compact), 16);
+  ASSERT_U64_EQ (CompactSpan_get_end (&compact), 17);
+  Span span = SourceFile_get_span (&file, compact);
+  ASSERT_U64_EQ (Span_cbegin (&span) == Span_cbegin (&x), true);
+  ASSERT_I64_EQ (Span_cmp_cstring (&span, "x"), 0);
+  Position pos = SourceFile_lookup_position (&file, Span_cbegin (&span));
+  ASSERT_U64_EQ (Position_get_line (&pos), 2);
+  ASSERT_U64_EQ (Position_get_column (&pos), 0);
+  SourceFile_drop (&file);
+}
+
+/* Whether the line table kept across edits matches a rebuilt one.  */
+static bool
+SourceFile_lines_match_rebuilt (const SourceFile *self)
+{
+  String content = String_new ();
+  String_push_string (&content, SourceFile_get_content (self));
+  SourceFile rebuilt = SourceFile_new (String_from_cstring ("test"), content);
+  bool res = Vec_u32_len (&self->lines_) == Vec_u32_len (&rebuilt.lines_)
+             && !memcmp (Vec_u32_cbegin (&self->lines_),
+                         Vec_u32_cbegin (&rebuilt.lines_),
+                         Vec_u32_len (&rebuilt.lines_) * sizeof (uint32_t));
+  SourceFile_drop (&rebuilt);
+  return res;
+}
+
+NEO_TEST (test_source_file_edit_00)
+{
+  SourceFile file = SourceFile_new_test ("if true\nthen x\nelse y\n");
+  SourceFile_edit (&file, CompactSpan_new (7, 1), Span_from_cstring (" "));
+  ASSERT_U64_EQ (SourceFile_lines_match_rebuilt (&file), true);
+  SourceFile_edit (&file, CompactSpan_new (3, 0),
+                   Span_from_cstring ("\n\nnot\n"));
+  ASSERT_U64_EQ (SourceFile_lines_match_rebuilt (&file), true);
+  SourceFile_edit (&file, CompactSpan_new (0, 10), Span_from_cstring ("z"));
+  ASSERT_U64_EQ (SourceFile_lines_match_rebuilt (&file), true);
+  SourceFile_edit (&file, CompactSpan_new (0, 0), Span_from_cstring ("\n"));
+  ASSERT_U64_EQ (SourceFile_lines_match_rebuilt (&file), true);
+  ASSERT_I64_EQ (memcmp (String_cbegin (SourceFile_get_content (&file)),
+                         "\nzrue then x\nelse y\n",
+                         String_len (SourceFile_get_content (&file))),
+                 0);
+  SourceFile_drop (&file);
+}
+
+NEO_TEST (test_position_cursor_00)
+{
+  SourceFile file = SourceFile_new_test ("if true {\n"
+                                         "\n"
+                                         "  true\n"
+                                         "} else {\n\n\n\n\n\n\n\n\n\n\n"
+                                         "  false\n"
+                                         "}");
+  const String *content = SourceFile_get_content (&file);
+  size_t len = String_len (content);
+  /* Forward one byte at a time, backward, and in long strides, which take
+   * every path through the cursor.  */
+  PositionCursor cursor = PositionCursor_new (&file);
+  for (size_t stride = 1; stride < len; stride += 6)
+    {
+      for (size_t i = 0; i <= len; i++)
+        {
+          size_t offset = stride == 1 ? i : i * stride % (len + 1);
+          const char *pos = String_cbegin (content) + offset;
+          Position expected = SourceFile_lookup_position (&file, pos);
+          Position position = PositionCursor_lookup (&cursor, pos);
+          ASSERT_U64_EQ (Position_get_line (&position),
+                         Position_get_line (&expected));
+          ASSERT_U64_EQ (Position_get_column (&position),
+                         Position_get_column (&expected));
+        }
+    }
+  for (size_t i = len + 1; i-- > 0;)
+    {
+      const char *pos = String_cbegin (content) + i;
+      Position expected = SourceFile_lookup_position (&file, pos);
+      Position position = PositionCursor_lookup (&cursor, pos);
+      ASSERT_U64_EQ (Position_get_line (&position),
+                     Position_get_line (&expected));
+      ASSERT_U64_EQ (Position_get_column (&position),
+                     Position_get_column (&expected));
+    }
+  Position outside
+      = PositionCursor_lookup (&cursor, String_cend (content) + 1);
+  ASSERT_U64_EQ (Position_get_line (&outside), 0);
+  SourceFile_drop (&file);
+}
+
 NEO_TESTS (span_tests, test_span_cmp_cstring_00,
            test_source_file_lookup_line_00, test_source_file_lookup_line_01,
            test_source_file_lookup_position_00,
-           test_source_file_lookup_position_01)
+           test_source_file_lookup_position_01,
+           test_source_file_lookup_offset_00, test_source_file_get_span_00,
+           test_source_file_edit_00, test_position_cursor_00)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+#include "lexer.h"
+#include "token.h"
+
+static Vec_Token
+bench_lex (const SourceFile *file)
+{
+  Span span = Span_from_string (SourceFile_get_content (file));
+  Lexer lexer = Lexer_new (&span);
+  Vec_Token tokens = Vec_Token_new ();
+  Token token;
+  do
+    {
+      token = Lexer_next (&lexer);
+      Vec_Token_push (&tokens, token);
+    }
+  while (!Token_is_eof (&token));
+  return tokens;
+}
+
+/* Both ends of every token of a multi-megabyte file, as the token dump
+ * looks them up.  */
+NEO_BENCH (bench_lookup_position_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"),
+                                    bench_gen_source (4 << 20, 42));
+  Vec_Token tokens = bench_lex (&file);
+  size_t sum = 0;
+  BENCH_ITER
+  {
+    sum = 0;
+    for (const Token *token = Vec_Token_cbegin (&tokens);
+         token < Vec_Token_cend (&tokens); token++)
+      {
+        Span span = SourceFile_get_span (&file, token->span_);
+        Position begin
+            = SourceFile_lookup_position (&file, Span_cbegin (&span));
+        Position end = SourceFile_lookup_position (&file, Span_cend (&span));
+        sum += Position_get_line (&begin) + Position_get_column (&end);
+      }
+  }
+  Bencher_report_u64 (bencher_, "tokens", Vec_Token_len (&tokens));
+  Bencher_report_u64 (bencher_, "lines", SourceFile_num_lines (&file));
+  Bencher_report_u64 (bencher_, "sum", sum);
+  Vec_Token_drop (&tokens);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCH (bench_position_cursor_00)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"),
+                                    bench_gen_source (4 << 20, 42));
+  Vec_Token tokens = bench_lex (&file);
+  size_t sum = 0;
+  BENCH_ITER
+  {
+    sum = 0;
+    PositionCursor cursor = PositionCursor_new (&file);
+    for (const Token *token = Vec_Token_cbegin (&tokens);
+         token < Vec_Token_cend (&tokens); token++)
+      {
+        Span span = SourceFile_get_span (&file, token->span_);
+        Position begin = PositionCursor_lookup (&cursor, Span_cbegin (&span));
+        Position end = PositionCursor_lookup (&cursor, Span_cend (&span));
+        sum += Position_get_line (&begin) + Position_get_column (&end);
+      }
+  }
+  Bencher_report_u64 (bencher_, "tokens", Vec_Token_len (&tokens));
+  Bencher_report_u64 (bencher_, "lines", SourceFile_num_lines (&file));
+  Bencher_report_u64 (bencher_, "sum", sum);
+  Vec_Token_drop (&tokens);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCHES (span_benches, bench_lookup_position_00, bench_position_cursor_00)
 #endif
@@ -3,7 +3,9 @@
 #ifndef NEO_SPAN_H
 #define NEO_SPAN_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "string.h"
 #include "vec.h"
@@ -22,6 +24,25 @@ const char *Span_cend (const Span *self);
 size_t Span_len (const Span *self);
 int Span_cmp (const Span *self, const Span *other);
 int Span_cmp_cstring (const Span *self, const char *cstr);
+/* Hash and equality of the text, for spans as keys of a hash map.  */
+uint64_t Span_hash (const Span *self);
+bool Span_eq (const Span *self, const Span *other);
+
+/* A span stored as an offset and a length into the text it was lexed from,
+ * which is half the size of a Span.  The text must be under 4 GiB.  */
+typedef struct CompactSpan
+{
+  uint32_t offset_;
+  uint32_t len_;
+} CompactSpan;
+
+CompactSpan CompactSpan_new (uint32_t offset, uint32_t len);
+CompactSpan CompactSpan_from_span (const Span *span, const char *base);
+uint32_t CompactSpan_get_offset (const CompactSpan *self);
+uint32_t CompactSpan_get_end (const CompactSpan *self);
+uint32_t CompactSpan_len (const CompactSpan *self);
+Span CompactSpan_to_span (const CompactSpan *self, const char *base);
+bool CompactSpan_contains (const CompactSpan *self, const CompactSpan *other);
 
 typedef struct Position
 {
@@ -37,7 +58,8 @@ typedef struct SourceFile
 {
   String path_;
   String content_;
-  Vec_const_char_ptr lines_;
+  /* The offset at which each line begins.  */
+  Vec_u32 lines_;
 } SourceFile;
 
 SourceFile SourceFile_new (String path, String content);
@@ -45,11 +67,41 @@ void SourceFile_drop (SourceFile *self);
 const String *SourceFile_get_path (const SourceFile *self);
 const String *SourceFile_get_content (const SourceFile *self);
 Position SourceFile_lookup_position (const SourceFile *self, const char *pos);
+/* Returns the offset of POS, clamped to the end of its line, or of the
+ * content if there is no such line.  */
+uint32_t SourceFile_lookup_offset (const SourceFile *self, Position pos);
+size_t SourceFile_num_lines (const SourceFile *self);
 Span SourceFile_get_line (const SourceFile *self, size_t line);
+/* Resolves a span lexed from the content of the file.  */
+Span SourceFile_get_span (const SourceFile *self, CompactSpan span);
+/* Replaces RANGE of the content with TEXT, which must not point into the
+ * content, and updates the line table without rescanning the rest.  */
+void SourceFile_edit (SourceFile *self, CompactSpan range, Span text);
+
+/* Looks positions up in a file, stepping forward from the line of the last
+ * lookup.  Positions looked up in increasing order, as when tokens or
+ * diagnostics are written out, take amortized constant time.  Lookups
+ * backward or far ahead fall back to a binary search.  */
+typedef struct PositionCursor
+{
+  const SourceFile *file_;
+  /* 0-based.  */
+  size_t line_;
+} PositionCursor;
+
+PositionCursor PositionCursor_new (const SourceFile *file);
+const SourceFile *PositionCursor_get_file (const PositionCursor *self);
+/* Gives what SourceFile_lookup_position gives.  */
+Position PositionCursor_lookup (PositionCursor *self, const char *pos);
 
 #ifdef TESTS
 #include "test.h"
 Tests span_tests ();
 #endif
 
+#ifdef BENCHES
+#include "bench.h"
+Benches span_benches ();
+#endif
+
 #endif
@@ -2,12 +2,13 @@
 
 #include "string.h"
 
-#include <inttypes.h>
 #include <stddef.h>
-#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "vec.h"
 
+/* Holds the 20 digits of UINT64_MAX.  */
 #define INT64_STRING_SIZE (32)
 
 String
@@ -19,13 +20,9 @@ String_new ()
 String
 String_from_cstring (const char *cstr)
 {
-  Vec_char data = Vec_char_new ();
-  while (*cstr)
-    {
-      Vec_char_push (&data, *cstr);
-      cstr++;
-    }
-  return (String){ .data_ = data };
+  String str = String_new ();
+  String_push_cstring (&str, cstr);
+  return str;
 }
 
 void
@@ -73,63 +70,86 @@ String_push (String *self, char c)
 void
 String_push_repeat (String *self, char c, size_t count)
 {
-  for (size_t i = 0; i < count; i++)
-    {
-      String_push (self, c);
-    }
+  Vec_char_resize (&self->data_, String_len (self) + count, c);
 }
 
 void
 String_push_string (String *self, const String *str)
 {
-  for (const char *c = String_cbegin (str); c < String_cend (str); c++)
-    {
-      String_push (self, *c);
-    }
+  String_push_carray (self, String_cbegin (str), String_len (str));
 }
 
 void
 String_push_cstring (String *self, const char *cstr)
 {
-  while (*cstr)
-    {
-      String_push (self, *cstr);
-      cstr++;
-    }
+  String_push_carray (self, cstr, strlen (cstr));
 }
 
 void
 String_push_cstring_repeat (String *self, const char *cstr, size_t count)
 {
+  size_t len = strlen (cstr);
+  Vec_char_reserve (&self->data_, len * count);
   for (size_t i = 0; i < count; i++)
     {
-      String_push_cstring (self, cstr);
+      String_push_carray (self, cstr, len);
     }
 }
 
+/* Copies ARRAY in one go, after growing at most once.  */
 void
 String_push_carray (String *self, const char *array, size_t len)
 {
-  for (size_t i = 0; i < len; i++)
-    {
-      String_push (self, array[i]);
-    }
+  Vec_char_splice (&self->data_, String_len (self), 0, array, len);
+}
+
+void
+String_replace (String *self, size_t begin, size_t len, const char *array,
+                size_t array_len)
+{
+  Vec_char_splice (&self->data_, begin, len, array, array_len);
 }
 
 void
 String_push_i64 (String *self, int64_t n)
 {
-  char buffer[INT64_STRING_SIZE];
-  snprintf (buffer, INT64_STRING_SIZE, "%" PRIi64, n);
-  String_push_cstring (self, buffer);
+  if (n < 0)
+    {
+      String_push (self, '-');
+      /* Negating in unsigned arithmetic keeps INT64_MIN in range.  */
+      String_push_u64 (self, -(uint64_t)n);
+      return;
+    }
+  String_push_u64 (self, n);
 }
 
 void
 String_push_u64 (String *self, uint64_t n)
 {
+  static const char digit_pairs[]
+      = "00010203040506070809101112131415161718192021222324252627282930313233"
+        "34353637383940414243444546474849505152535455565758596061626364656667"
+        "6869707172737475767778798081828384858687888990919293949596979899";
+  /* Filled from the end, two digits at a time.  */
   char buffer[INT64_STRING_SIZE];
-  snprintf (buffer, INT64_STRING_SIZE, "%" PRIu64, n);
-  String_push_cstring (self, buffer);
+  char *begin = buffer + INT64_STRING_SIZE;
+  while (n >= 100)
+    {
+      const char *pair = digit_pairs + 2 * (n % 100);
+      n /= 100;
+      *--begin = pair[1];
+      *--begin = pair[0];
+    }
+  if (n >= 10)
+    {
+      *--begin = digit_pairs[2 * n + 1];
+      *--begin = digit_pairs[2 * n];
+    }
+  else
+    {
+      *--begin = '0' + n;
+    }
+  String_push_carray (self, begin, buffer + INT64_STRING_SIZE - begin);
 }
 
 void
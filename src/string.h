@@ -26,6 +26,9 @@ void String_push_string (String *self, const String *str);
 void String_push_cstring (String *self, const char *cstr);
 void String_push_cstring_repeat (String *self, const char *cstr, size_t count);
 void String_push_carray (String *self, const char *array, size_t len);
+/* Replaces the LEN chars at BEGIN with ARRAY.  */
+void String_replace (String *self, size_t begin, size_t len, const char *array,
+                     size_t array_len);
 void String_push_i64 (String *self, int64_t n);
 void String_push_u64 (String *self, uint64_t n);
 void String_clear (String *self);
@@ -5,6 +5,12 @@
 #include <stdio.h>
 #include <time.h>
 
+/* Includes the test headers at file scope first, so that tests.def can be
+ * expanded again inside main.  */
+#define NEO_PUSH_TESTS(NAME)
+#include "tests.def"
+#undef NEO_PUSH_TESTS
+
 static double
 timespec_to_secs (const struct timespec *t)
 {
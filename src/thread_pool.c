@@ -2,43 +2,194 @@
 
 #include "thread_pool.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <threads.h>
+#include <time.h>
 
+#include "json.h"
+#include "mpmc_queue_macro.h"
 #include "queue_macro.h"
 #include "vec.h"
 #include "vec_macro.h"
 
 NEO_IMPL_VEC (ThreadPoolJob, ThreadPoolJob)
 NEO_IMPL_QUEUE (ThreadPoolJob, ThreadPoolJob)
+NEO_IMPL_MPMC_QUEUE (ThreadPoolJob, ThreadPoolJob)
+
+/* Times a worker of the lock-free queue finds it empty before sleeping.  */
+#define THREAD_POOL_NUM_SPINS 64
+
+static uint64_t
+now_ns ()
+{
+  struct timespec now;
+  timespec_get (&now, TIME_UTC);
+  return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+static void
+counter_add (atomic_uint_fast64_t *counter, uint64_t n)
+{
+  atomic_fetch_add_explicit (counter, n, memory_order_relaxed);
+}
+
+static uint64_t
+counter_get (const atomic_uint_fast64_t *counter)
+{
+  return atomic_load_explicit ((atomic_uint_fast64_t *)counter,
+                               memory_order_relaxed);
+}
 
 static void
-ThreadPoolData_lock (ThreadPoolData *self)
+counter_max (atomic_uint_fast64_t *counter, uint64_t n)
 {
-  if (mtx_lock (&self->lock_) != thrd_success)
+  uint64_t old = counter_get (counter);
+  while (old < n
+         && !atomic_compare_exchange_weak_explicit (
+             counter, &old, n, memory_order_relaxed, memory_order_relaxed))
     {
-      abort ();
     }
 }
 
 static void
-ThreadPoolData_unlock (ThreadPoolData *self)
+ThreadPoolCounters_init (ThreadPoolCounters *self)
+{
+  atomic_init (&self->num_submitted_, 0);
+  atomic_init (&self->num_completed_, 0);
+  atomic_init (&self->wait_ns_, 0);
+  atomic_init (&self->num_lock_acquired_, 0);
+  atomic_init (&self->num_lock_contended_, 0);
+  atomic_init (&self->lock_wait_ns_, 0);
+  atomic_init (&self->lock_hold_ns_, 0);
+  atomic_init (&self->max_queue_len_, 0);
+  for (size_t i = 0; i < THREAD_POOL_NUM_BUCKETS; i++)
+    {
+      atomic_init (&self->queue_latency_[i], 0);
+      atomic_init (&self->run_latency_[i], 0);
+    }
+}
+
+static void
+ThreadPoolCounters_add_latency (atomic_uint_fast64_t *histogram,
+                                uint64_t ns)
+{
+  size_t bucket = ns ? 64 - __builtin_clzll (ns) : 0;
+  if (bucket >= THREAD_POOL_NUM_BUCKETS)
+    {
+      bucket = THREAD_POOL_NUM_BUCKETS - 1;
+    }
+  counter_add (&histogram[bucket], 1);
+}
+
+static void
+ThreadPoolCounters_sum (const ThreadPoolCounters *self, ThreadPoolStats *sum)
+{
+  sum->num_submitted_ += counter_get (&self->num_submitted_);
+  sum->num_completed_ += counter_get (&self->num_completed_);
+  sum->wait_ns_ += counter_get (&self->wait_ns_);
+  sum->num_lock_acquired_ += counter_get (&self->num_lock_acquired_);
+  sum->num_lock_contended_ += counter_get (&self->num_lock_contended_);
+  sum->lock_wait_ns_ += counter_get (&self->lock_wait_ns_);
+  sum->lock_hold_ns_ += counter_get (&self->lock_hold_ns_);
+  uint64_t max_queue_len = counter_get (&self->max_queue_len_);
+  if (sum->max_queue_len_ < max_queue_len)
+    {
+      sum->max_queue_len_ = max_queue_len;
+    }
+  for (size_t i = 0; i < THREAD_POOL_NUM_BUCKETS; i++)
+    {
+      sum->queue_latency_[i] += counter_get (&self->queue_latency_[i]);
+      sum->run_latency_[i] += counter_get (&self->run_latency_[i]);
+    }
+}
+
+static bool
+ThreadPoolData_stats_enabled (const ThreadPoolData *self)
+{
+  return atomic_load_explicit ((atomic_bool *)&self->stats_enabled_,
+                               memory_order_relaxed);
+}
+
+/* COUNTERS are those of the calling thread.  */
+static void
+ThreadPoolData_lock (ThreadPoolData *self, ThreadPoolCounters *counters)
 {
+  if (!ThreadPoolData_stats_enabled (self))
+    {
+      if (mtx_lock (&self->lock_) != thrd_success)
+        {
+          abort ();
+        }
+      self->lock_begin_ns_ = 0;
+      return;
+    }
+  int status = mtx_trylock (&self->lock_);
+  if (status == thrd_busy)
+    {
+      uint64_t begin = now_ns ();
+      if (mtx_lock (&self->lock_) != thrd_success)
+        {
+          abort ();
+        }
+      self->lock_begin_ns_ = now_ns ();
+      counter_add (&counters->num_lock_contended_, 1);
+      counter_add (&counters->lock_wait_ns_, self->lock_begin_ns_ - begin);
+    }
+  else if (status == thrd_success)
+    {
+      self->lock_begin_ns_ = now_ns ();
+    }
+  else
+    {
+      abort ();
+    }
+  counter_add (&counters->num_lock_acquired_, 1);
+}
+
+/* Returns when the lock was released, or 0 if that was not timed.  */
+static uint64_t
+ThreadPoolData_unlock (ThreadPoolData *self, ThreadPoolCounters *counters)
+{
+  uint64_t end = 0;
+  if (self->lock_begin_ns_)
+    {
+      end = now_ns ();
+      counter_add (&counters->lock_hold_ns_, end - self->lock_begin_ns_);
+    }
   if (mtx_unlock (&self->lock_) != thrd_success)
     {
       abort ();
     }
+  return end;
 }
 
+/* The time asleep counts as waiting, not as holding the lock.  */
 static void
-ThreadPoolData_wait_new_job_notify (ThreadPoolData *self)
+ThreadPoolData_wait_new_job_notify (ThreadPoolData *self,
+                                    ThreadPoolCounters *counters)
 {
+  uint64_t begin = 0;
+  if (self->lock_begin_ns_)
+    {
+      begin = now_ns ();
+      counter_add (&counters->lock_hold_ns_, begin - self->lock_begin_ns_);
+    }
   if (cnd_wait (&self->new_job_notify_, &self->lock_) != thrd_success)
     {
       abort ();
     }
+  /* Stats may have been enabled while asleep, so time the hold from here
+   * just as ThreadPoolData_lock would.  */
+  self->lock_begin_ns_ = ThreadPoolData_stats_enabled (self) ? now_ns () : 0;
+  if (begin && self->lock_begin_ns_)
+    {
+      counter_add (&counters->wait_ns_, self->lock_begin_ns_ - begin);
+    }
 }
 
 static void
@@ -50,6 +201,68 @@ ThreadPoolData_broadcast_new_job_notify (ThreadPoolData *self)
     }
 }
 
+static void
+ThreadPoolData_signal_new_job_notify (ThreadPoolData *self)
+{
+  if (cnd_signal (&self->new_job_notify_) != thrd_success)
+    {
+      abort ();
+    }
+}
+
+/* A sleeping worker counts itself before it looks at the queue once more,
+ * and a producer publishes its job before it looks at the count.  With a
+ * full fence on both sides, at least one of them sees the other, so a job
+ * never waits beside a sleeping worker.  */
+static ThreadPoolJob
+ThreadPoolData_pop_lock_free (ThreadPoolData *self,
+                              ThreadPoolCounters *counters)
+{
+  ThreadPoolJob job;
+  while (true)
+    {
+      for (size_t i = 0; i < THREAD_POOL_NUM_SPINS; i++)
+        {
+          if (MpmcQueue_ThreadPoolJob_try_pop (&self->lock_free_jobs_, &job))
+            {
+              return job;
+            }
+          thrd_yield ();
+        }
+      ThreadPoolData_lock (self, counters);
+      atomic_fetch_add (&self->num_sleeping_, 1);
+      atomic_thread_fence (memory_order_seq_cst);
+      bool popped
+          = MpmcQueue_ThreadPoolJob_try_pop (&self->lock_free_jobs_, &job);
+      if (!popped)
+        {
+          ThreadPoolData_wait_new_job_notify (self, counters);
+        }
+      atomic_fetch_sub (&self->num_sleeping_, 1);
+      ThreadPoolData_unlock (self, counters);
+      if (popped)
+        {
+          return job;
+        }
+    }
+}
+
+static void
+ThreadPoolData_push_lock_free (ThreadPoolData *self, ThreadPoolJob job)
+{
+  while (!MpmcQueue_ThreadPoolJob_try_push (&self->lock_free_jobs_, job))
+    {
+      thrd_yield ();
+    }
+  atomic_thread_fence (memory_order_seq_cst);
+  if (atomic_load (&self->num_sleeping_) > 0)
+    {
+      ThreadPoolData_lock (self, &self->submitters_);
+      ThreadPoolData_signal_new_job_notify (self);
+      ThreadPoolData_unlock (self, &self->submitters_);
+    }
+}
+
 static void
 exit_work (void *pool_data)
 {
@@ -57,19 +270,50 @@ exit_work (void *pool_data)
 }
 
 static int
-do_work (void *pool_data)
+do_work (void *pool_worker)
 {
-  ThreadPoolData *data = pool_data;
+  ThreadPoolWorker *worker = pool_worker;
+  ThreadPoolData *data = worker->data_;
+  ThreadPoolCounters *counters = &worker->counters_;
   while (true)
     {
-      ThreadPoolData_lock (data);
-      while (Queue_ThreadPoolJob_is_empty (&data->jobs_))
+      ThreadPoolJob job;
+      uint64_t begin = 0;
+      if (data->lock_free_)
         {
-          ThreadPoolData_wait_new_job_notify (data);
+          job = ThreadPoolData_pop_lock_free (data, counters);
+        }
+      else
+        {
+          ThreadPoolData_lock (data, counters);
+          while (Queue_ThreadPoolJob_is_empty (&data->jobs_))
+            {
+              ThreadPoolData_wait_new_job_notify (data, counters);
+            }
+          job = Queue_ThreadPoolJob_pop_front (&data->jobs_);
+          begin = ThreadPoolData_unlock (data, counters);
+        }
+      if (job.submit_ns_)
+        {
+          atomic_fetch_sub_explicit (&data->num_queued_, 1,
+                                     memory_order_relaxed);
+          /* The clock read on unlocking serves as the start.  */
+          if (!begin)
+            {
+              begin = now_ns ();
+            }
+          job.job_ (job.job_arg_);
+          uint64_t end = now_ns ();
+          ThreadPoolCounters_add_latency (counters->queue_latency_,
+                                          begin - job.submit_ns_);
+          ThreadPoolCounters_add_latency (counters->run_latency_,
+                                          end - begin);
+          counter_add (&counters->num_completed_, 1);
+        }
+      else
+        {
+          job.job_ (job.job_arg_);
         }
-      ThreadPoolJob job = Queue_ThreadPoolJob_pop_front (&data->jobs_);
-      ThreadPoolData_unlock (data);
-      job.job_ (job.job_arg_);
       if (job.job_ == exit_work)
         {
           break;
@@ -78,15 +322,26 @@ do_work (void *pool_data)
   return 0;
 }
 
-ThreadPool
-ThreadPool_new (size_t num_threads)
+static ThreadPool
+ThreadPool_new_with_queue (size_t num_threads, bool lock_free,
+                           size_t capacity)
 {
   ThreadPoolData *data = (ThreadPoolData *)malloc (sizeof (ThreadPoolData));
-  if (data == NULL)
+  ThreadPoolWorker *workers
+      = (ThreadPoolWorker *)malloc (num_threads * sizeof (ThreadPoolWorker));
+  if (data == NULL || (workers == NULL && num_threads))
     {
       abort ();
     }
+  data->lock_free_ = lock_free;
   data->jobs_ = Queue_ThreadPoolJob_new ();
+  data->lock_free_jobs_ = MpmcQueue_ThreadPoolJob_new (capacity);
+  data->workers_ = workers;
+  atomic_init (&data->num_sleeping_, 0);
+  atomic_init (&data->stats_enabled_, false);
+  data->lock_begin_ns_ = 0;
+  atomic_init (&data->num_queued_, 0);
+  ThreadPoolCounters_init (&data->submitters_);
   data->threads_ = Vec_thrd_t_with_capacity (num_threads);
   if (mtx_init (&data->lock_, mtx_plain) != thrd_success
       || cnd_init (&data->new_job_notify_) != thrd_success)
@@ -95,8 +350,11 @@ ThreadPool_new (size_t num_threads)
     }
   for (size_t i = 0; i < num_threads; i++)
     {
+      workers[i].data_ = data;
+      ThreadPoolCounters_init (&workers[i].counters_);
       Vec_thrd_t_push_uninit (&data->threads_);
-      if (thrd_create (Vec_thrd_t_begin (&data->threads_) + i, do_work, data)
+      if (thrd_create (Vec_thrd_t_begin (&data->threads_) + i, do_work,
+                       workers + i)
           != thrd_success)
         {
           abort ();
@@ -105,12 +363,41 @@ ThreadPool_new (size_t num_threads)
   return (ThreadPool){ .num_threads_ = num_threads, .data_ = data };
 }
 
+ThreadPool
+ThreadPool_new (size_t num_threads)
+{
+  return ThreadPool_new_with_queue (num_threads, false, 0);
+}
+
+ThreadPool
+ThreadPool_new_lock_free (size_t num_threads, size_t capacity)
+{
+  return ThreadPool_new_with_queue (num_threads, true, capacity);
+}
+
+static void
+ThreadPool_push (ThreadPool *self, ThreadPoolJob job)
+{
+  ThreadPoolData *data = self->data_;
+  if (data->lock_free_)
+    {
+      ThreadPoolData_push_lock_free (data, job);
+      return;
+    }
+  ThreadPoolData_lock (data, &data->submitters_);
+  Queue_ThreadPoolJob_push_back (&data->jobs_, job);
+  ThreadPoolData_broadcast_new_job_notify (data);
+  ThreadPoolData_unlock (data, &data->submitters_);
+}
+
 void
 ThreadPool_drop (ThreadPool *self)
 {
   for (size_t i = 0; i < self->num_threads_; i++)
     {
-      ThreadPool_execute (self, exit_work, self->data_);
+      ThreadPool_push (self, (ThreadPoolJob){ .job_ = exit_work,
+                                              .job_arg_ = self->data_,
+                                              .submit_ns_ = 0 });
     }
   for (const thrd_t *thread = Vec_thrd_t_cbegin (&self->data_->threads_);
        thread < Vec_thrd_t_cend (&self->data_->threads_); thread++)
@@ -123,7 +410,9 @@ ThreadPool_drop (ThreadPool *self)
   mtx_destroy (&self->data_->lock_);
   cnd_destroy (&self->data_->new_job_notify_);
   Queue_ThreadPoolJob_drop (&self->data_->jobs_);
+  MpmcQueue_ThreadPoolJob_drop (&self->data_->lock_free_jobs_);
   Vec_thrd_t_drop (&self->data_->threads_);
+  free (self->data_->workers_);
   free (self->data_);
   self->data_ = NULL;
 }
@@ -131,10 +420,469 @@ ThreadPool_drop (ThreadPool *self)
 void
 ThreadPool_execute (ThreadPool *self, void (*job) (void *), void *job_arg)
 {
-  ThreadPoolData_lock (self->data_);
-  Queue_ThreadPoolJob_push_back (
-      &self->data_->jobs_,
-      (ThreadPoolJob){ .job_ = job, .job_arg_ = job_arg });
-  ThreadPoolData_broadcast_new_job_notify (self->data_);
-  ThreadPoolData_unlock (self->data_);
+  ThreadPoolJob pool_job
+      = { .job_ = job, .job_arg_ = job_arg, .submit_ns_ = 0 };
+  ThreadPoolData *data = self->data_;
+  if (ThreadPoolData_stats_enabled (data))
+    {
+      pool_job.submit_ns_ = now_ns ();
+      /* Counted before the push, so that a worker taking the job at once
+       * never finds fewer jobs queued than it takes.  */
+      uint64_t num_queued = atomic_fetch_add_explicit (
+                                &data->num_queued_, 1, memory_order_relaxed)
+                            + 1;
+      counter_add (&data->submitters_.num_submitted_, 1);
+      counter_max (&data->submitters_.max_queue_len_, num_queued);
+    }
+  ThreadPool_push (self, pool_job);
+}
+
+void
+ThreadPool_enable_stats (ThreadPool *self)
+{
+  atomic_store (&self->data_->stats_enabled_, true);
 }
+
+ThreadPoolStats
+ThreadPool_get_stats (const ThreadPool *self)
+{
+  ThreadPoolStats stats;
+  memset (&stats, 0, sizeof (stats));
+  ThreadPoolCounters_sum (&self->data_->submitters_, &stats);
+  for (size_t i = 0; i < self->num_threads_; i++)
+    {
+      ThreadPoolCounters_sum (&self->data_->workers_[i].counters_, &stats);
+    }
+  return stats;
+}
+
+static void
+ThreadPoolStats_write_histogram (const uint64_t *histogram,
+                                 JsonWriter *writer)
+{
+  JsonWriter_begin_array (writer);
+  for (size_t i = 0; i < THREAD_POOL_NUM_BUCKETS; i++)
+    {
+      if (!histogram[i])
+        {
+          continue;
+        }
+      JsonWriter_begin_object (writer);
+      /* The last bucket has no bound.  */
+      JsonWriter_key (writer, "below_ns");
+      if (i + 1 < THREAD_POOL_NUM_BUCKETS)
+        {
+          JsonWriter_u64 (writer, (uint64_t)1 << i);
+        }
+      else
+        {
+          JsonWriter_null (writer);
+        }
+      JsonWriter_key (writer, "count");
+      JsonWriter_u64 (writer, histogram[i]);
+      JsonWriter_end_object (writer);
+    }
+  JsonWriter_end_array (writer);
+}
+
+void
+ThreadPoolStats_write (const ThreadPoolStats *self, JsonWriter *writer)
+{
+  JsonWriter_begin_object (writer);
+  JsonWriter_key (writer, "jobs_submitted");
+  JsonWriter_u64 (writer, self->num_submitted_);
+  JsonWriter_key (writer, "jobs_completed");
+  JsonWriter_u64 (writer, self->num_completed_);
+  JsonWriter_key (writer, "wait_ns");
+  JsonWriter_u64 (writer, self->wait_ns_);
+  JsonWriter_key (writer, "lock_acquired");
+  JsonWriter_u64 (writer, self->num_lock_acquired_);
+  JsonWriter_key (writer, "lock_contended");
+  JsonWriter_u64 (writer, self->num_lock_contended_);
+  JsonWriter_key (writer, "lock_wait_ns");
+  JsonWriter_u64 (writer, self->lock_wait_ns_);
+  JsonWriter_key (writer, "lock_hold_ns");
+  JsonWriter_u64 (writer, self->lock_hold_ns_);
+  JsonWriter_key (writer, "max_queue_len");
+  JsonWriter_u64 (writer, self->max_queue_len_);
+  JsonWriter_key (writer, "queue_latency");
+  ThreadPoolStats_write_histogram (self->queue_latency_, writer);
+  JsonWriter_key (writer, "run_latency");
+  ThreadPoolStats_write_histogram (self->run_latency_, writer);
+  JsonWriter_end_object (writer);
+}
+
+#ifdef TESTS
+#include "test.h"
+
+static ThreadPoolJob
+test_job (uintptr_t n)
+{
+  return (ThreadPoolJob){ .job_ = NULL, .job_arg_ = (void *)n };
+}
+
+NEO_TEST (test_mpmc_queue_00)
+{
+  MpmcQueue_ThreadPoolJob queue = MpmcQueue_ThreadPoolJob_new (5);
+  ASSERT_U64_EQ (MpmcQueue_ThreadPoolJob_capacity (&queue), 8);
+  ThreadPoolJob job = test_job (0);
+  ASSERT_U64_EQ (MpmcQueue_ThreadPoolJob_try_pop (&queue, &job), false);
+  /* Many laps around the cells, with the queue full at every lap.  */
+  uintptr_t next_push = 0, next_pop = 0;
+  for (size_t lap = 0; lap < 100; lap++)
+    {
+      while (MpmcQueue_ThreadPoolJob_try_push (&queue, test_job (next_push)))
+        {
+          next_push++;
+        }
+      ASSERT_U64_EQ (next_push - next_pop, 8);
+      for (size_t i = 0; i < 3 + lap % 6; i++)
+        {
+          ASSERT_U64_EQ (MpmcQueue_ThreadPoolJob_try_pop (&queue, &job),
+                         true);
+          ASSERT_U64_EQ ((uintptr_t)job.job_arg_, next_pop);
+          next_pop++;
+        }
+    }
+  while (MpmcQueue_ThreadPoolJob_try_pop (&queue, &job))
+    {
+      ASSERT_U64_EQ ((uintptr_t)job.job_arg_, next_pop);
+      next_pop++;
+    }
+  ASSERT_U64_EQ (next_pop, next_push);
+  MpmcQueue_ThreadPoolJob_drop (&queue);
+}
+
+#define TEST_MPMC_NUM_THREADS 4
+#define TEST_MPMC_NUM_ITEMS 20000
+
+typedef struct TestMpmcQueue
+{
+  MpmcQueue_ThreadPoolJob queue_;
+  atomic_size_t next_producer_;
+  atomic_size_t num_popped_;
+  atomic_uint_fast64_t sum_;
+  atomic_bool out_of_order_;
+} TestMpmcQueue;
+
+static int
+test_mpmc_produce (void *arg)
+{
+  TestMpmcQueue *test = arg;
+  uintptr_t producer = atomic_fetch_add (&test->next_producer_, 1);
+  for (uintptr_t i = 0; i < TEST_MPMC_NUM_ITEMS; i++)
+    {
+      ThreadPoolJob job = test_job (producer * TEST_MPMC_NUM_ITEMS + i);
+      while (!MpmcQueue_ThreadPoolJob_try_push (&test->queue_, job))
+        {
+          thrd_yield ();
+        }
+    }
+  return 0;
+}
+
+static int
+test_mpmc_consume (void *arg)
+{
+  TestMpmcQueue *test = arg;
+  /* What each producer pushed is popped in the order it was pushed.  */
+  uintptr_t last[TEST_MPMC_NUM_THREADS] = { 0 };
+  uint64_t sum = 0;
+  while (atomic_load (&test->num_popped_)
+         < TEST_MPMC_NUM_THREADS * TEST_MPMC_NUM_ITEMS)
+    {
+      ThreadPoolJob job;
+      if (!MpmcQueue_ThreadPoolJob_try_pop (&test->queue_, &job))
+        {
+          thrd_yield ();
+          continue;
+        }
+      uintptr_t n = (uintptr_t)job.job_arg_;
+      uintptr_t producer = n / TEST_MPMC_NUM_ITEMS;
+      if (n + 1 <= last[producer])
+        {
+          atomic_store (&test->out_of_order_, true);
+        }
+      last[producer] = n + 1;
+      sum += n;
+      atomic_fetch_add (&test->num_popped_, 1);
+    }
+  atomic_fetch_add (&test->sum_, sum);
+  return 0;
+}
+
+NEO_TEST (test_mpmc_queue_01)
+{
+  TestMpmcQueue test = { .queue_ = MpmcQueue_ThreadPoolJob_new (64) };
+  atomic_init (&test.next_producer_, 0);
+  atomic_init (&test.num_popped_, 0);
+  atomic_init (&test.sum_, 0);
+  atomic_init (&test.out_of_order_, false);
+  thrd_t threads[2 * TEST_MPMC_NUM_THREADS];
+  for (size_t i = 0; i < 2 * TEST_MPMC_NUM_THREADS; i++)
+    {
+      ASSERT_U64_EQ (thrd_create (threads + i,
+                                  i % 2 ? test_mpmc_consume
+                                        : test_mpmc_produce,
+                                  &test),
+                     thrd_success);
+    }
+  for (size_t i = 0; i < 2 * TEST_MPMC_NUM_THREADS; i++)
+    {
+      ASSERT_U64_EQ (thrd_join (threads[i], NULL), thrd_success);
+    }
+  uint64_t n = TEST_MPMC_NUM_THREADS * TEST_MPMC_NUM_ITEMS;
+  ASSERT_U64_EQ (atomic_load (&test.sum_), n * (n - 1) / 2);
+  ASSERT_U64_EQ (atomic_load (&test.out_of_order_), false);
+  ThreadPoolJob job;
+  ASSERT_U64_EQ (MpmcQueue_ThreadPoolJob_try_pop (&test.queue_, &job), false);
+  MpmcQueue_ThreadPoolJob_drop (&test.queue_);
+}
+
+static void
+test_count_job (void *counter)
+{
+  atomic_fetch_add ((atomic_size_t *)counter, 1);
+}
+
+NEO_TEST (test_thread_pool_00)
+{
+  for (size_t lock_free = 0; lock_free < 2; lock_free++)
+    {
+      atomic_size_t counter;
+      atomic_init (&counter, 0);
+      /* A tiny queue makes the producer wait for room.  */
+      ThreadPool pool = lock_free ? ThreadPool_new_lock_free (3, 4)
+                                  : ThreadPool_new (3);
+      for (size_t i = 0; i < 1000; i++)
+        {
+          ThreadPool_execute (&pool, test_count_job, &counter);
+        }
+      ThreadPool_drop (&pool);
+      ASSERT_U64_EQ (atomic_load (&counter), 1000);
+    }
+}
+
+NEO_TEST (test_thread_pool_01)
+{
+  for (size_t lock_free = 0; lock_free < 2; lock_free++)
+    {
+      atomic_size_t counter;
+      atomic_init (&counter, 0);
+      ThreadPool pool = lock_free ? ThreadPool_new_lock_free (2, 256)
+                                  : ThreadPool_new (2);
+      ThreadPool_execute (&pool, test_count_job, &counter);
+      ThreadPool_enable_stats (&pool);
+      for (size_t i = 0; i < 100; i++)
+        {
+          ThreadPool_execute (&pool, test_count_job, &counter);
+        }
+      ThreadPoolStats stats = ThreadPool_get_stats (&pool);
+      while (stats.num_completed_ < 100)
+        {
+          thrd_yield ();
+          stats = ThreadPool_get_stats (&pool);
+        }
+      ASSERT_U64_EQ (stats.num_submitted_, 100);
+      ASSERT_U64_EQ (stats.num_completed_, 100);
+      ASSERT_U64_EQ (stats.max_queue_len_ >= 1, true);
+      ASSERT_U64_EQ (stats.max_queue_len_ <= 100, true);
+      ASSERT_U64_EQ (stats.num_lock_contended_ <= stats.num_lock_acquired_,
+                     true);
+      uint64_t num_queued = 0, num_run = 0;
+      for (size_t i = 0; i < THREAD_POOL_NUM_BUCKETS; i++)
+        {
+          num_queued += stats.queue_latency_[i];
+          num_run += stats.run_latency_[i];
+        }
+      ASSERT_U64_EQ (num_queued, 100);
+      ASSERT_U64_EQ (num_run, 100);
+      ThreadPool_drop (&pool);
+      ASSERT_U64_EQ (atomic_load (&counter), 101);
+
+      JsonWriter writer = JsonWriter_new (NULL);
+      ThreadPoolStats_write (&stats, &writer);
+      const String *text = JsonWriter_get_buffer (&writer);
+      Json json;
+      ASSERT_U64_EQ (Json_parse (&json, String_cbegin (text),
+                                 String_len (text)),
+                     true);
+      ASSERT_U64_EQ (Json_get_number (Json_get (&json, "jobs_completed")),
+                     100);
+      const Json *histogram = Json_get (&json, "run_latency");
+      ASSERT_U64_EQ (Json_len (histogram) > 0, true);
+      ASSERT_U64_EQ (
+          Json_get_kind (Json_get (Json_at (histogram, 0), "count")),
+          JSON_NUMBER);
+      Json_drop (&json);
+      JsonWriter_drop (&writer);
+    }
+}
+
+NEO_TESTS (thread_pool_tests, test_mpmc_queue_00, test_mpmc_queue_01,
+           test_thread_pool_00, test_thread_pool_01)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+/* Shared by the threads of every contention bench, whatever their number,
+ * so that each bench does the same work.  */
+#define QUEUE_BENCH_NUM_OPS (1 << 15)
+
+/* Every thread pushes an item and pops one, over and over, through a single
+ * queue.  Pushing first keeps the queue from ever being empty for long.  */
+typedef struct QueueBench
+{
+  bool lock_free_;
+  size_t num_threads_;
+  Queue_ThreadPoolJob jobs_;
+  mtx_t lock_;
+  MpmcQueue_ThreadPoolJob lock_free_jobs_;
+  /* Threads start together, so that the time to create them overlaps no
+   * work.  */
+  atomic_size_t num_ready_;
+  atomic_size_t sum_;
+} QueueBench;
+
+static int
+queue_bench_run (void *arg)
+{
+  QueueBench *bench = arg;
+  atomic_fetch_add (&bench->num_ready_, 1);
+  while (atomic_load (&bench->num_ready_) < bench->num_threads_)
+    {
+      thrd_yield ();
+    }
+  size_t sum = 0;
+  ThreadPoolJob job = { .job_ = NULL, .job_arg_ = NULL };
+  for (size_t i = 0; i < QUEUE_BENCH_NUM_OPS / bench->num_threads_; i++)
+    {
+      job.job_arg_ = (void *)i;
+      if (bench->lock_free_)
+        {
+          while (!MpmcQueue_ThreadPoolJob_try_push (&bench->lock_free_jobs_,
+                                                    job))
+            {
+              thrd_yield ();
+            }
+          while (
+              !MpmcQueue_ThreadPoolJob_try_pop (&bench->lock_free_jobs_, &job))
+            {
+              thrd_yield ();
+            }
+        }
+      else
+        {
+          mtx_lock (&bench->lock_);
+          Queue_ThreadPoolJob_push_back (&bench->jobs_, job);
+          mtx_unlock (&bench->lock_);
+          mtx_lock (&bench->lock_);
+          job = Queue_ThreadPoolJob_pop_front (&bench->jobs_);
+          mtx_unlock (&bench->lock_);
+        }
+      sum += (size_t)job.job_arg_;
+    }
+  atomic_fetch_add (&bench->sum_, sum);
+  return 0;
+}
+
+static void
+queue_bench (Bencher *bencher_, bool lock_free, size_t num_threads)
+{
+  QueueBench bench = { .lock_free_ = lock_free,
+                       .num_threads_ = num_threads,
+                       .jobs_ = Queue_ThreadPoolJob_new (),
+                       .lock_free_jobs_ = MpmcQueue_ThreadPoolJob_new (128) };
+  mtx_init (&bench.lock_, mtx_plain);
+  atomic_init (&bench.sum_, 0);
+  thrd_t threads[64];
+  BENCH_ITER
+  {
+    atomic_init (&bench.num_ready_, 0);
+    for (size_t i = 0; i < num_threads; i++)
+      {
+        thrd_create (threads + i, queue_bench_run, &bench);
+      }
+    for (size_t i = 0; i < num_threads; i++)
+      {
+        thrd_join (threads[i], NULL);
+      }
+  }
+  Bencher_report_u64 (bencher_, "threads", num_threads);
+  Bencher_report_u64 (bencher_, "sum", atomic_load (&bench.sum_));
+  mtx_destroy (&bench.lock_);
+  Queue_ThreadPoolJob_drop (&bench.jobs_);
+  MpmcQueue_ThreadPoolJob_drop (&bench.lock_free_jobs_);
+}
+
+#define QUEUE_BENCH(NAME, LOCK_FREE, NUM_THREADS)                             \
+  NEO_BENCH (NAME) { queue_bench (bencher_, LOCK_FREE, NUM_THREADS); }
+
+QUEUE_BENCH (bench_mutex_queue_threads_01, false, 1)
+QUEUE_BENCH (bench_mutex_queue_threads_02, false, 2)
+QUEUE_BENCH (bench_mutex_queue_threads_04, false, 4)
+QUEUE_BENCH (bench_mutex_queue_threads_08, false, 8)
+QUEUE_BENCH (bench_mutex_queue_threads_16, false, 16)
+QUEUE_BENCH (bench_mutex_queue_threads_32, false, 32)
+QUEUE_BENCH (bench_mutex_queue_threads_64, false, 64)
+QUEUE_BENCH (bench_mpmc_queue_threads_01, true, 1)
+QUEUE_BENCH (bench_mpmc_queue_threads_02, true, 2)
+QUEUE_BENCH (bench_mpmc_queue_threads_04, true, 4)
+QUEUE_BENCH (bench_mpmc_queue_threads_08, true, 8)
+QUEUE_BENCH (bench_mpmc_queue_threads_16, true, 16)
+QUEUE_BENCH (bench_mpmc_queue_threads_32, true, 32)
+QUEUE_BENCH (bench_mpmc_queue_threads_64, true, 64)
+
+static void
+bench_empty_job (void *arg)
+{
+  (void)arg;
+}
+
+static void
+thread_pool_bench (Bencher *bencher_, bool lock_free, bool stats)
+{
+  BENCH_ITER
+  {
+    ThreadPool pool = lock_free ? ThreadPool_new_lock_free (4, 1024)
+                                : ThreadPool_new (4);
+    if (stats)
+      {
+        ThreadPool_enable_stats (&pool);
+      }
+    for (size_t i = 0; i < QUEUE_BENCH_NUM_OPS; i++)
+      {
+        ThreadPool_execute (&pool, bench_empty_job, NULL);
+      }
+    ThreadPool_drop (&pool);
+  }
+  Bencher_report_u64 (bencher_, "jobs", QUEUE_BENCH_NUM_OPS);
+}
+
+NEO_BENCH (bench_thread_pool_execute_00)
+{
+  thread_pool_bench (bencher_, false, false);
+}
+
+NEO_BENCH (bench_thread_pool_execute_lock_free_00)
+{
+  thread_pool_bench (bencher_, true, false);
+}
+
+NEO_BENCH (bench_thread_pool_execute_stats_00)
+{
+  thread_pool_bench (bencher_, false, true);
+}
+
+NEO_BENCHES (thread_pool_benches, bench_mutex_queue_threads_01,
+             bench_mutex_queue_threads_02, bench_mutex_queue_threads_04,
+             bench_mutex_queue_threads_08, bench_mutex_queue_threads_16,
+             bench_mutex_queue_threads_32, bench_mutex_queue_threads_64,
+             bench_mpmc_queue_threads_01, bench_mpmc_queue_threads_02,
+             bench_mpmc_queue_threads_04, bench_mpmc_queue_threads_08,
+             bench_mpmc_queue_threads_16, bench_mpmc_queue_threads_32,
+             bench_mpmc_queue_threads_64, bench_thread_pool_execute_00,
+             bench_thread_pool_execute_lock_free_00,
+             bench_thread_pool_execute_stats_00)
+#endif
@@ -3,9 +3,14 @@
 #ifndef NEO_THREAD_POOL_H
 #define NEO_THREAD_POOL_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <threads.h>
 
+#include "json.h"
+#include "mpmc_queue_macro.h"
 #include "queue_macro.h"
 #include "vec.h"
 #include "vec_macro.h"
@@ -14,18 +19,89 @@ typedef struct ThreadPoolJob
 {
   void (*job_) (void *);
   void *job_arg_;
+  /* When the job was submitted, in nanoseconds, or 0 if it is not counted
+   * in the statistics.  */
+  uint64_t submit_ns_;
 } ThreadPoolJob;
 
 NEO_DECL_VEC (ThreadPoolJob, ThreadPoolJob)
 NEO_DECL_QUEUE (ThreadPoolJob, ThreadPoolJob)
+NEO_DECL_MPMC_QUEUE (ThreadPoolJob, ThreadPoolJob)
 
-typedef struct ThreadPoolData
+/* Latencies are counted in buckets of powers of two: bucket 0 holds those
+ * under 1 ns, bucket I those under 2^I ns, and the last one all the rest.  */
+#define THREAD_POOL_NUM_BUCKETS 40
+
+/* What a pool has done since its statistics were enabled.  Times are in
+ * nanoseconds.  */
+typedef struct ThreadPoolStats
+{
+  uint64_t num_submitted_;
+  uint64_t num_completed_;
+  /* Spent by workers asleep on NEW_JOB_NOTIFY.  */
+  uint64_t wait_ns_;
+  uint64_t num_lock_acquired_;
+  /* Acquisitions that found LOCK taken, and the time spent waiting for
+   * it.  */
+  uint64_t num_lock_contended_;
+  uint64_t lock_wait_ns_;
+  uint64_t lock_hold_ns_;
+  /* The most jobs ever queued at once.  */
+  uint64_t max_queue_len_;
+  /* From submission to start, and from start to end.  */
+  uint64_t queue_latency_[THREAD_POOL_NUM_BUCKETS];
+  uint64_t run_latency_[THREAD_POOL_NUM_BUCKETS];
+} ThreadPoolStats;
+
+/* The statistics of one thread, which only that thread updates unless they
+ * are shared by the submitters.  Each set sits on cache lines of its own.  */
+typedef struct ThreadPoolCounters
 {
+  atomic_uint_fast64_t num_submitted_;
+  atomic_uint_fast64_t num_completed_;
+  atomic_uint_fast64_t wait_ns_;
+  atomic_uint_fast64_t num_lock_acquired_;
+  atomic_uint_fast64_t num_lock_contended_;
+  atomic_uint_fast64_t lock_wait_ns_;
+  atomic_uint_fast64_t lock_hold_ns_;
+  atomic_uint_fast64_t max_queue_len_;
+  atomic_uint_fast64_t queue_latency_[THREAD_POOL_NUM_BUCKETS];
+  atomic_uint_fast64_t run_latency_[THREAD_POOL_NUM_BUCKETS];
+  char pad_[NEO_CACHE_LINE_SIZE];
+} ThreadPoolCounters;
+
+typedef struct ThreadPoolData ThreadPoolData;
+
+typedef struct ThreadPoolWorker
+{
+  ThreadPoolData *data_;
+  ThreadPoolCounters counters_;
+} ThreadPoolWorker;
+
+struct ThreadPoolData
+{
+  /* Chooses which of the two queues holds the jobs.  */
+  bool lock_free_;
+  /* Guarded by LOCK.  */
   Queue_ThreadPoolJob jobs_;
+  MpmcQueue_ThreadPoolJob lock_free_jobs_;
   Vec_thrd_t threads_;
+  ThreadPoolWorker *workers_;
+  /* Only sleeping workers take the lock when the queue is lock-free.  */
   mtx_t lock_;
   cnd_t new_job_notify_;
-} ThreadPoolData;
+  /* Workers of the lock-free queue that are asleep or about to be, so that
+   * a producer takes the lock only when there is someone to wake.  */
+  atomic_size_t num_sleeping_;
+  atomic_bool stats_enabled_;
+  /* When the holder took LOCK, or 0 if the statistics were off by then.
+   * Guarded by LOCK.  */
+  uint64_t lock_begin_ns_;
+  /* Counted jobs submitted but not yet taken by a worker.  */
+  atomic_uint_fast64_t num_queued_;
+  /* Shared by the threads submitting jobs.  */
+  ThreadPoolCounters submitters_;
+};
 
 typedef struct ThreadPool
 {
@@ -34,8 +110,31 @@ typedef struct ThreadPool
 } ThreadPool;
 
 ThreadPool ThreadPool_new (size_t num_threads);
+/* Queues at most CAPACITY jobs without taking a lock.  More jobs make
+ * ThreadPool_execute wait for room.  */
+ThreadPool ThreadPool_new_lock_free (size_t num_threads, size_t capacity);
 void ThreadPool_drop (ThreadPool *self);
 void ThreadPool_execute (ThreadPool *self, void (*job) (void *),
                          void *job_arg);
+/* Statistics are off by default, since they read the clock around every
+ * job and every acquisition of the lock.  They may be turned on at any
+ * time, and jobs submitted before are not counted.  */
+void ThreadPool_enable_stats (ThreadPool *self);
+/* Sums the counters of every thread.  Jobs still running are counted as
+ * submitted only.  */
+ThreadPoolStats ThreadPool_get_stats (const ThreadPool *self);
+/* Writes STATS as a JSON object, with the latency histograms as arrays of
+ * the nonempty buckets.  */
+void ThreadPoolStats_write (const ThreadPoolStats *self, JsonWriter *writer);
+
+#ifdef TESTS
+#include "test.h"
+Tests thread_pool_tests ();
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+Benches thread_pool_benches ();
+#endif
 
 #endif
@@ -25,7 +25,8 @@ NEO_DECL_VEC (TokenKind, enum TokenKind)
 typedef struct Token
 {
   enum TokenKind kind_;
-  Span span_;
+  /* Relative to the text given to the lexer.  */
+  CompactSpan span_;
 } Token;
 
 NEO_DECL_VEC (Token, Token)
@@ -35,25 +35,37 @@ TypeManager_get_type (const TypeManager *self, TypeId id)
   return Vec_Type_cbegin (&self->types_) + id;
 }
 
-String
-TypeManager_to_string (const TypeManager *self, TypeId id)
+const char *
+TypeKind_get_name (enum TypeKind kind)
 {
-  switch (TypeManager_get_type (self, id)->kind_)
+  switch (kind)
     {
 #define NEO_TYPEKIND(N, L)                                                    \
   case TYPE_##N:                                                              \
     {                                                                         \
-      return String_from_cstring (L);                                         \
+      return L;                                                               \
     }
 #include "type_kind.def"
 #undef NEO_TYPEKIND
     default:
       {
-        return String_from_cstring ("internal error");
+        return "internal error";
       }
     }
 }
 
+const char *
+TypeManager_get_name (const TypeManager *self, TypeId id)
+{
+  return TypeKind_get_name (TypeManager_get_type (self, id)->kind_);
+}
+
+String
+TypeManager_to_string (const TypeManager *self, TypeId id)
+{
+  return String_from_cstring (TypeManager_get_name (self, id));
+}
+
 bool
 TypeManager_is_unknown (const TypeManager *self, TypeId id)
 {
@@ -72,6 +84,19 @@ TypeManager_is_bool (const TypeManager *self, TypeId id)
   return TypeManager_get_type (self, id)->kind_ == TYPE_BOOL;
 }
 
+bool
+TypeManager_is_integer (const TypeManager *self, TypeId id)
+{
+  enum TypeKind kind = TypeManager_get_type (self, id)->kind_;
+  return kind == TYPE_INT || kind == TYPE_INT64;
+}
+
+bool
+TypeManager_is_int64 (const TypeManager *self, TypeId id)
+{
+  return TypeManager_get_type (self, id)->kind_ == TYPE_INT64;
+}
+
 bool
 TypeManager_are_equal (const TypeManager *self, TypeId x, TypeId y)
 {
@@ -93,3 +118,27 @@ TypeManager_get_bool (const TypeManager *self)
   assert (Vec_Type_cbegin (&self->types_)[TYPE_BOOL].kind_ == TYPE_BOOL);
   return TYPE_BOOL;
 }
+
+TypeId
+TypeManager_get_int (const TypeManager *self)
+{
+  assert (TYPE_INT < Vec_Type_len (&self->types_));
+  assert (Vec_Type_cbegin (&self->types_)[TYPE_INT].kind_ == TYPE_INT);
+  return TYPE_INT;
+}
+
+TypeId
+TypeManager_get_int64 (const TypeManager *self)
+{
+  assert (TYPE_INT64 < Vec_Type_len (&self->types_));
+  assert (Vec_Type_cbegin (&self->types_)[TYPE_INT64].kind_ == TYPE_INT64);
+  return TYPE_INT64;
+}
+
+TypeId
+TypeManager_get_named (const TypeManager *self, enum TypeKind kind)
+{
+  assert (kind >= TYPE_NAMED_BEGIN && kind < TYPE_NAMED_END);
+  assert (Vec_Type_cbegin (&self->types_)[kind].kind_ == kind);
+  return kind;
+}
@@ -19,6 +19,18 @@ enum TypeKind
 #undef NEO_TYPEKIND
 };
 
+/* The kinds from TYPE_NAMED_BEGIN up to TYPE_NAMED_END are the types that
+ * programs name, which the root scope binds in that order.  */
+#define TYPE_NAMED_BEGIN (TYPE_BOOL)
+#define TYPE_NAMED_END (TYPE_INT64 + 1)
+
+/* TypeManager_new interns one type of each kind, whose id is its kind, so
+ * the ids below TYPE_NUM_BUILT_IN mean the same in every manager.  */
+#define TYPE_NUM_BUILT_IN (TYPE_INT64 + 1)
+
+/* Returns the static name of KIND.  */
+const char *TypeKind_get_name (enum TypeKind kind);
+
 typedef struct Type
 {
   enum TypeKind kind_;
@@ -34,12 +46,21 @@ typedef struct TypeManager
 TypeManager TypeManager_new ();
 void TypeManager_drop (TypeManager *self);
 const Type *TypeManager_get_type (const TypeManager *self, TypeId id);
+/* Returns a static name, which costs no allocation.  */
+const char *TypeManager_get_name (const TypeManager *self, TypeId id);
 String TypeManager_to_string (const TypeManager *self, TypeId id);
 bool TypeManager_is_unknown (const TypeManager *self, TypeId id);
 bool TypeManager_is_invalid (const TypeManager *self, TypeId id);
 bool TypeManager_is_bool (const TypeManager *self, TypeId id);
+/* Whether ID is Int or Int64.  */
+bool TypeManager_is_integer (const TypeManager *self, TypeId id);
+bool TypeManager_is_int64 (const TypeManager *self, TypeId id);
 bool TypeManager_are_equal (const TypeManager *self, TypeId x, TypeId y);
 TypeId TypeManager_get_invalid (const TypeManager *self);
 TypeId TypeManager_get_bool (const TypeManager *self);
+TypeId TypeManager_get_int (const TypeManager *self);
+TypeId TypeManager_get_int64 (const TypeManager *self);
+/* Of a kind from TYPE_NAMED_BEGIN up to TYPE_NAMED_END.  */
+TypeId TypeManager_get_named (const TypeManager *self, enum TypeKind kind);
 
 #endif
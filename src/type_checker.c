@@ -3,12 +3,19 @@
 #include "type_checker.h"
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
 
 #include "ast_node.h"
 #include "diagnostic.h"
+#include "hash_map_macro.h"
+#include "resolver.h"
 #include "span.h"
 #include "type.h"
+#include "vec.h"
 #include "vec_macro.h"
 
 void
@@ -32,6 +39,13 @@ ASTNodeIdToTypeIdMap_new (size_t len)
   return (ASTNodeIdToTypeIdMap){ .map_ = map };
 }
 
+/* New nodes start out unknown.  */
+static void
+ASTNodeIdToTypeIdMap_resize (ASTNodeIdToTypeIdMap *self, size_t len)
+{
+  Vec_TypeId_resize (&self->map_, len, TYPE_UNKNOWN);
+}
+
 static void
 ASTNodeIdToTypeIdMap_set (ASTNodeIdToTypeIdMap *self, ASTNodeId node_id,
                           TypeId type_id)
@@ -40,137 +54,1176 @@ ASTNodeIdToTypeIdMap_set (ASTNodeIdToTypeIdMap *self, ASTNodeId node_id,
   Vec_TypeId_begin (&self->map_)[node_id] = type_id;
 }
 
-TypeChecker
-TypeChecker_new (const ASTNodeManager *ast_mgr, DiagnosticManager *diag_mgr,
-                 TypeManager *type_mgr)
+TypeChecker
+TypeChecker_new (const ASTNodeManager *ast_mgr, DiagnosticManager *diag_mgr,
+                 TypeManager *type_mgr)
+{
+  DiagnosticManager_set_type_manager (diag_mgr, type_mgr);
+  return (TypeChecker){ .ast_mgr_ = ast_mgr,
+                        .diag_mgr_ = diag_mgr,
+                        .type_mgr_ = type_mgr,
+                        .map_ = ASTNodeIdToTypeIdMap_new (
+                            ASTNodeManager_num_nodes (ast_mgr)),
+                        .num_diags_ = Vec_u32_new (),
+                        .num_typed_ = 0,
+                        .num_forgotten_ = 0,
+                        .pool_ = NULL,
+                        .min_fork_nodes_ = 0,
+                        .forks_ = NULL,
+                        .scopes_ = NULL,
+                        .cancel_ = NULL };
+}
+
+void
+TypeChecker_set_pool (TypeChecker *self, ThreadPool *pool,
+                      size_t min_fork_nodes)
+{
+  self->pool_ = pool;
+  self->min_fork_nodes_ = min_fork_nodes;
+}
+
+void
+TypeChecker_set_scopes (TypeChecker *self, const ASTScopes *scopes)
+{
+  self->scopes_ = scopes;
+}
+
+void
+TypeChecker_set_cancel (TypeChecker *self, const atomic_bool *cancel)
+{
+  self->cancel_ = cancel;
+}
+
+static bool
+TypeChecker_is_cancelled (const TypeChecker *self)
+{
+  return self->cancel_
+         && atomic_load_explicit ((atomic_bool *)self->cancel_,
+                                  memory_order_relaxed);
+}
+
+void
+TypeChecker_drop (TypeChecker *self)
+{
+  ASTNodeIdToTypeIdMap_drop (&self->map_);
+  Vec_u32_drop (&self->num_diags_);
+}
+
+/* Names are kept as text, since built-in ones such as `Bool` are not in the
+ * source file.  */
+typedef struct TypeEnvEntry
+{
+  Span name_;
+  TypeId type_id_;
+  /* The entry of the same name that this one shadows, if any.  */
+  uint32_t shadowed_;
+} TypeEnvEntry;
+
+#define TYPE_ENV_NONE (UINT32_MAX)
+
+NEO_DECL_VEC (TypeEnvEntry, TypeEnvEntry)
+NEO_IMPL_VEC (TypeEnvEntry, TypeEnvEntry)
+NEO_DECL_HASHMAP (Span_u32, Span, uint32_t)
+NEO_IMPL_HASHMAP (Span_u32, Span, uint32_t, Span_hash, Span_eq)
+
+/* The names in scope, as a stack of entries, with a map from each name to
+ * its innermost entry, so that a lookup does not scan the stack.  Names
+ * resolved to addresses are instead found through the frames, which the
+ * entries are cut into, and the map is not kept.  */
+typedef struct TypeEnv
+{
+  Vec_TypeEnvEntry entries_;
+  HashMap_Span_u32 innermost_;
+  bool by_address_;
+  /* Where each frame begins in ENTRIES_, innermost last.  */
+  Vec_u32 frames_;
+} TypeEnv;
+
+static TypeEnv
+TypeEnv_new (bool by_address)
+{
+  return (TypeEnv){ .entries_ = Vec_TypeEnvEntry_new (),
+                    .innermost_ = HashMap_Span_u32_new (),
+                    .by_address_ = by_address,
+                    .frames_ = Vec_u32_new () };
+}
+
+static void
+TypeEnv_drop (TypeEnv *self)
+{
+  Vec_TypeEnvEntry_drop (&self->entries_);
+  HashMap_Span_u32_drop (&self->innermost_);
+  Vec_u32_drop (&self->frames_);
+}
+
+static size_t
+TypeEnv_len (const TypeEnv *self)
+{
+  return Vec_TypeEnvEntry_len (&self->entries_);
+}
+
+/* Opens a frame for the entries pushed next.  */
+static void
+TypeEnv_enter (TypeEnv *self)
+{
+  if (self->by_address_)
+    {
+      Vec_u32_push (&self->frames_, TypeEnv_len (self));
+    }
+}
+
+static void
+TypeEnv_push (TypeEnv *self, Span name, TypeId type_id)
+{
+  uint32_t index = TypeEnv_len (self);
+  if (self->by_address_)
+    {
+      Vec_TypeEnvEntry_push (&self->entries_,
+                             (TypeEnvEntry){ .name_ = name,
+                                             .type_id_ = type_id,
+                                             .shadowed_ = TYPE_ENV_NONE });
+      return;
+    }
+  uint32_t *innermost
+      = HashMap_Span_u32_get_or_insert (&self->innermost_, name, index);
+  Vec_TypeEnvEntry_push (&self->entries_,
+                         (TypeEnvEntry){ .name_ = name,
+                                         .type_id_ = type_id,
+                                         .shadowed_ = *innermost == index
+                                                          ? TYPE_ENV_NONE
+                                                          : *innermost });
+  *innermost = index;
+}
+
+/* Pops the entries past LEN, bringing back the ones they shadowed, and the
+ * frames that begin there.  A frame is opened right before its first entry
+ * is pushed, so the frames of the scopes around LEN begin below it.  */
+static void
+TypeEnv_truncate (TypeEnv *self, size_t len)
+{
+  if (self->by_address_)
+    {
+      while (!Vec_u32_is_empty (&self->frames_)
+             && Vec_u32_cend (&self->frames_)[-1] >= len)
+        {
+          Vec_u32_pop (&self->frames_);
+        }
+      Vec_TypeEnvEntry_resize (&self->entries_, len, (TypeEnvEntry){ 0 });
+      return;
+    }
+  while (TypeEnv_len (self) > len)
+    {
+      TypeEnvEntry entry = Vec_TypeEnvEntry_pop (&self->entries_);
+      if (entry.shadowed_ == TYPE_ENV_NONE)
+        {
+          HashMap_Span_u32_remove (&self->innermost_, &entry.name_);
+        }
+      else
+        {
+          *HashMap_Span_u32_get (&self->innermost_, &entry.name_)
+              = entry.shadowed_;
+        }
+    }
+}
+
+static const TypeEnvEntry *
+TypeEnv_lookup (const TypeEnv *self, const Span *name)
+{
+  const uint32_t *index = HashMap_Span_u32_cget (&self->innermost_, name);
+  return index ? Vec_TypeEnvEntry_cbegin (&self->entries_) + *index : NULL;
+}
+
+static const TypeEnvEntry *
+TypeEnv_lookup_address (const TypeEnv *self, const ASTAddress *address)
+{
+  if (address->depth_ == AST_ADDRESS_UNBOUND)
+    {
+      return NULL;
+    }
+  size_t num_frames = Vec_u32_len (&self->frames_);
+  assert (address->depth_ < num_frames);
+  uint32_t begin
+      = Vec_u32_cbegin (&self->frames_)[num_frames - 1 - address->depth_];
+  assert (begin + address->slot_ < TypeEnv_len (self));
+  return Vec_TypeEnvEntry_cbegin (&self->entries_) + begin + address->slot_;
+}
+
+/* Finds the entry of the var or type NODE_ID, by its address if the names
+ * were resolved, else by its name.  */
+static const TypeEnvEntry *
+TypeChecker_lookup (const TypeChecker *self, ASTNodeId node_id,
+                    const TypeEnv *env)
+{
+  if (env->by_address_)
+    {
+      return TypeEnv_lookup_address (
+          env, ASTScopes_get_address (self->scopes_, node_id));
+    }
+  const CompactSpan *span = ASTNodeManager_get_span (self->ast_mgr_, node_id);
+  Span name = SourceFile_get_span (self->diag_mgr_->file_, *span);
+  return TypeEnv_lookup (env, &name);
+}
+
+static TypeId
+TypeChecker_set_map (TypeChecker *self, ASTNodeId node_id, TypeId type_id)
+{
+  ASTNodeIdToTypeIdMap_set (&self->map_, node_id, type_id);
+  return type_id;
+}
+
+static TypeId TypeChecker_typeof (TypeChecker *self, ASTNodeId node_id,
+                                  TypeEnv *env);
+
+static TypeId
+TypeChecker_typeof_if_then_else (TypeChecker *self, ASTNodeId node_id,
+                                 TypeEnv *env)
+{
+  assert (ASTNodeManager_get_kind (self->ast_mgr_, node_id)
+          == AST_IF_THEN_ELSE);
+  const ASTIfThenElse *if_then_else
+      = &ASTNodeManager_get_payload (self->ast_mgr_, node_id)->if_then_else_;
+  TypeId if_expr_type_id
+      = TypeChecker_typeof (self, if_then_else->if_expr_, env);
+  if (!TypeManager_is_bool (self->type_mgr_, if_expr_type_id))
+    {
+      DiagnosticManager_diagnose_if_expr_not_bool (
+          self->diag_mgr_,
+          *ASTNodeManager_get_span (self->ast_mgr_, if_then_else->if_expr_),
+          if_expr_type_id);
+      return TypeChecker_set_map (self, node_id,
+                                  TypeManager_get_invalid (self->type_mgr_));
+    }
+  TypeId then_expr_type_id
+      = TypeChecker_typeof (self, if_then_else->then_expr_, env);
+  if (TypeManager_is_invalid (self->type_mgr_, then_expr_type_id))
+    {
+      return TypeChecker_set_map (self, node_id,
+                                  TypeManager_get_invalid (self->type_mgr_));
+    }
+  TypeId else_expr_type_id
+      = TypeChecker_typeof (self, if_then_else->else_expr_, env);
+  if (TypeManager_is_invalid (self->type_mgr_, else_expr_type_id))
+    {
+      return TypeChecker_set_map (self, node_id,
+                                  TypeManager_get_invalid (self->type_mgr_));
+    }
+  if (!TypeManager_are_equal (self->type_mgr_, then_expr_type_id,
+                              else_expr_type_id))
+    {
+      DiagnosticManager_diagnose_expr_types_not_equal (
+          self->diag_mgr_,
+          *ASTNodeManager_get_span (self->ast_mgr_, if_then_else->then_expr_),
+          then_expr_type_id,
+          *ASTNodeManager_get_span (self->ast_mgr_, if_then_else->else_expr_),
+          else_expr_type_id);
+      return TypeChecker_set_map (self, node_id,
+                                  TypeManager_get_invalid (self->type_mgr_));
+    }
+  return TypeChecker_set_map (self, node_id, then_expr_type_id);
+}
+
+static TypeId
+TypeChecker_typeof_type (TypeChecker *self, ASTNodeId node_id, TypeEnv *env)
+{
+  assert (ASTNodeManager_get_kind (self->ast_mgr_, node_id) == AST_TYPE);
+  const TypeEnvEntry *entry = TypeChecker_lookup (self, node_id, env);
+  if (entry)
+    {
+      return TypeChecker_set_map (self, node_id, entry->type_id_);
+    }
+  DiagnosticManager_diagnose_invalid_type (
+      self->diag_mgr_, *ASTNodeManager_get_span (self->ast_mgr_, node_id));
+  return TypeChecker_set_map (self, node_id,
+                              TypeManager_get_invalid (self->type_mgr_));
+}
+
+static TypeId
+TypeChecker_typeof_var (TypeChecker *self, ASTNodeId node_id, TypeEnv *env)
+{
+  assert (ASTNodeManager_get_kind (self->ast_mgr_, node_id) == AST_VAR);
+  const TypeEnvEntry *entry = TypeChecker_lookup (self, node_id, env);
+  if (entry)
+    {
+      return TypeChecker_set_map (self, node_id, entry->type_id_);
+    }
+  DiagnosticManager_diagnose_var_not_bound (
+      self->diag_mgr_, *ASTNodeManager_get_span (self->ast_mgr_, node_id));
+  return TypeChecker_set_map (self, node_id,
+                              TypeManager_get_invalid (self->type_mgr_));
+}
+
+/* Types an integer literal as Int64 if its text fits, else as Int, or as
+ * the type that a folded one was worked out in.  */
+static TypeId
+TypeChecker_typeof_integer (TypeChecker *self, ASTNodeId node_id)
+{
+  int64_t value;
+  return TypeChecker_set_map (
+      self, node_id,
+      ASTNodeManager_get_int64 (self->ast_mgr_, self->diag_mgr_->file_,
+                                node_id, &value)
+          ? TypeManager_get_int64 (self->type_mgr_)
+          : TypeManager_get_int (self->type_mgr_));
+}
+
+/* Whether OPERAND, of TYPE_ID, is an integer, diagnosing it if not.  */
+static bool
+TypeChecker_check_operand (TypeChecker *self, ASTNodeId operand,
+                           TypeId type_id)
+{
+  if (TypeManager_is_integer (self->type_mgr_, type_id))
+    {
+      return true;
+    }
+  DiagnosticManager_diagnose_operand_not_integer (
+      self->diag_mgr_, *ASTNodeManager_get_span (self->ast_mgr_, operand),
+      type_id);
+  return false;
+}
+
+/* Types the sign NODE_ID, whose operand is of EXPR_TYPE_ID, which it keeps.
+ */
+static TypeId
+TypeChecker_type_unary (TypeChecker *self, ASTNodeId node_id,
+                        TypeId expr_type_id)
+{
+  const ASTUnary *unary
+      = &ASTNodeManager_get_payload (self->ast_mgr_, node_id)->unary_;
+  if (TypeManager_is_invalid (self->type_mgr_, expr_type_id)
+      || !TypeChecker_check_operand (self, unary->expr_, expr_type_id))
+    {
+      return TypeManager_get_invalid (self->type_mgr_);
+    }
+  return expr_type_id;
+}
+
+/* Types the operator NODE_ID, whose operands are of LEFT_TYPE_ID and
+ * RIGHT_TYPE_ID.  Arithmetic stays in Int64 only if both operands are
+ * Int64, and is widened to Int otherwise.  Comparisons are Bool, and only
+ * compare Bools for equality.  */
+static TypeId
+TypeChecker_type_binary (TypeChecker *self, ASTNodeId node_id,
+                         TypeId left_type_id, TypeId right_type_id)
+{
+  enum ASTKind kind = ASTNodeManager_get_kind (self->ast_mgr_, node_id);
+  const ASTBinary *binary
+      = &ASTNodeManager_get_payload (self->ast_mgr_, node_id)->binary_;
+  if (TypeManager_is_invalid (self->type_mgr_, left_type_id)
+      || TypeManager_is_invalid (self->type_mgr_, right_type_id))
+    {
+      return TypeManager_get_invalid (self->type_mgr_);
+    }
+  if ((kind == AST_EQ || kind == AST_NEQ)
+      && TypeManager_is_bool (self->type_mgr_, left_type_id)
+      && TypeManager_is_bool (self->type_mgr_, right_type_id))
+    {
+      return TypeManager_get_bool (self->type_mgr_);
+    }
+  if (!TypeChecker_check_operand (self, binary->left_, left_type_id)
+      || !TypeChecker_check_operand (self, binary->right_, right_type_id))
+    {
+      return TypeManager_get_invalid (self->type_mgr_);
+    }
+  switch (kind)
+    {
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MUL:
+    case AST_DIV:
+      {
+        return TypeManager_is_int64 (self->type_mgr_, left_type_id)
+                       && TypeManager_is_int64 (self->type_mgr_,
+                                                right_type_id)
+                   ? TypeManager_get_int64 (self->type_mgr_)
+                   : TypeManager_get_int (self->type_mgr_);
+      }
+    default:
+      {
+        return TypeManager_get_bool (self->type_mgr_);
+      }
+    }
+}
+
+/* Types both operands, even if the first is invalid, as the sweep does.  */
+static TypeId
+TypeChecker_typeof_binary (TypeChecker *self, ASTNodeId node_id,
+                           TypeEnv *env)
+{
+  const ASTBinary *binary
+      = &ASTNodeManager_get_payload (self->ast_mgr_, node_id)->binary_;
+  TypeId left_type_id = TypeChecker_typeof (self, binary->left_, env);
+  TypeId right_type_id = TypeChecker_typeof (self, binary->right_, env);
+  return TypeChecker_set_map (
+      self, node_id,
+      TypeChecker_type_binary (self, node_id, left_type_id, right_type_id));
+}
+
+static TypeId
+TypeChecker_typeof_unary (TypeChecker *self, ASTNodeId node_id, TypeEnv *env)
+{
+  TypeId expr_type_id = TypeChecker_typeof (
+      self, ASTNodeManager_get_payload (self->ast_mgr_, node_id)->unary_.expr_,
+      env);
+  return TypeChecker_set_map (
+      self, node_id, TypeChecker_type_unary (self, node_id, expr_type_id));
+}
+
+/* Nodes added since the last check, whose subtrees are all new, are not in
+ * the map yet and are skipped.  */
+static void
+TypeChecker_forget_subtree (TypeChecker *self, ASTNodeId node_id)
+{
+  Vec_ASTNodeId stack = Vec_ASTNodeId_new ();
+  Vec_ASTNodeId_push (&stack, node_id);
+  while (!Vec_ASTNodeId_is_empty (&stack))
+    {
+      ASTNodeId id = Vec_ASTNodeId_pop (&stack);
+      if (!is_null_ast_node_id (id) && id < Vec_TypeId_len (&self->map_.map_))
+        {
+          self->num_forgotten_++;
+          ASTNodeIdToTypeIdMap_set (&self->map_, id, TYPE_UNKNOWN);
+          ASTNodeManager_push_children (self->ast_mgr_, id, &stack);
+        }
+    }
+  Vec_ASTNodeId_drop (&stack);
+}
+
+/* Whether a var of VAR_TYPE_ID can be bound to INIT, of INIT_TYPE_ID,
+ * diagnosing it if not.  Int64 is widened to Int, and an integer literal
+ * too big for Int64 is out of its range rather than of another type, unless
+ * it is a folded Int, which is diagnosed as the expression it was.  */
+static bool
+TypeChecker_can_bind (TypeChecker *self, ASTNodeId type, TypeId var_type_id,
+                      ASTNodeId init, TypeId init_type_id)
+{
+  if (TypeManager_are_equal (self->type_mgr_, var_type_id, init_type_id)
+      || (TypeManager_is_integer (self->type_mgr_, var_type_id)
+          && TypeManager_is_int64 (self->type_mgr_, init_type_id)))
+    {
+      return true;
+    }
+  if (TypeManager_is_int64 (self->type_mgr_, var_type_id)
+      && ASTNodeManager_get_kind (self->ast_mgr_, init) == AST_LIT_INTEGER
+      && ASTNodeManager_get_payload (self->ast_mgr_, init)->integer_.kind_
+             == AST_INTEGER_TEXT)
+    {
+      DiagnosticManager_diagnose_integer_out_of_range (
+          self->diag_mgr_, *ASTNodeManager_get_span (self->ast_mgr_, init));
+      return false;
+    }
+  DiagnosticManager_diagnose_let_type_not_equal (
+      self->diag_mgr_, *ASTNodeManager_get_span (self->ast_mgr_, type),
+      var_type_id, *ASTNodeManager_get_span (self->ast_mgr_, init),
+      init_type_id);
+  return false;
+}
+
+/* Types binding I of LET once its init is typed.  An annotated var is
+ * bound to the type it is annotated with.  */
+static bool
+TypeChecker_bind_init (TypeChecker *self, const ASTLet *let, uint32_t i,
+                       TypeId init_type_id, TypeEnv *env, bool *rebound)
+{
+  ASTNodeId var = ASTNodeManager_get_let_vars (self->ast_mgr_, let)[i];
+  ASTNodeId type = ASTNodeManager_get_let_types (self->ast_mgr_, let)[i];
+  ASTNodeId init = ASTNodeManager_get_let_inits (self->ast_mgr_, let)[i];
+  if (TypeManager_is_invalid (self->type_mgr_, init_type_id))
+    {
+      return false;
+    }
+  TypeId var_type_id = init_type_id;
+  if (!is_null_ast_node_id (type))
+    {
+      var_type_id = TypeChecker_typeof (self, type, env);
+      if (TypeManager_is_invalid (self->type_mgr_, var_type_id)
+          || !TypeChecker_can_bind (self, type, var_type_id, init,
+                                    init_type_id))
+        {
+          return false;
+        }
+    }
+  /* The types of a cancelled check are unknown, and must not replace the
+   * binding that the scope was typed with.  */
+  if (TypeChecker_is_cancelled (self))
+    {
+      return false;
+    }
+  /* A var never bound has nothing typed in its scope, and one replaced by
+   * an edit had its scope forgotten by TypeChecker_invalidate.  */
+  TypeId prev_type_id = ASTNodeIdToTypeIdMap_get (&self->map_, var);
+  if (prev_type_id != TYPE_UNKNOWN && prev_type_id != var_type_id)
+    {
+      *rebound = true;
+    }
+  TypeChecker_set_map (self, var, var_type_id);
+  if (i == 0)
+    {
+      TypeEnv_enter (env);
+    }
+  const CompactSpan *span = ASTNodeManager_get_span (self->ast_mgr_, var);
+  TypeEnv_push (env, SourceFile_get_span (self->diag_mgr_->file_, *span),
+                var_type_id);
+  return true;
+}
+
+/* Types binding I of LET and pushes it to ENV.  Returns false if it is
+ * invalid.  */
+static bool
+TypeChecker_bind (TypeChecker *self, const ASTLet *let, uint32_t i,
+                  TypeEnv *env, bool *rebound)
+{
+  ASTNodeId type = ASTNodeManager_get_let_types (self->ast_mgr_, let)[i];
+  ASTNodeId init = ASTNodeManager_get_let_inits (self->ast_mgr_, let)[i];
+  if (*rebound)
+    {
+      TypeChecker_forget_subtree (self, type);
+      TypeChecker_forget_subtree (self, init);
+    }
+  return TypeChecker_bind_init (self, let, i,
+                                TypeChecker_typeof (self, init, env), env,
+                                rebound);
+}
+
+/* Forgets the types in the scope of binding I of LET, but for the bindings
+ * up to I, which are typed one after another.  */
+static void
+TypeChecker_forget_scope (TypeChecker *self, const ASTLet *let, uint32_t i)
+{
+  for (uint32_t j = i + 1; j < let->num_vars_; j++)
+    {
+      TypeChecker_forget_subtree (
+          self, ASTNodeManager_get_let_types (self->ast_mgr_, let)[j]);
+      TypeChecker_forget_subtree (
+          self, ASTNodeManager_get_let_inits (self->ast_mgr_, let)[j]);
+    }
+  TypeChecker_forget_subtree (self, let->body_);
+}
+
+/* Binds the vars one after another.  The type of each binding is kept on its
+ * var, so that a let typed again can tell whether any binding changed, and
+ * only then forget the types in their scope.  */
+static TypeId
+TypeChecker_typeof_let (TypeChecker *self, ASTNodeId node_id, TypeEnv *env)
+{
+  assert (ASTNodeManager_get_kind (self->ast_mgr_, node_id) == AST_LET);
+  const ASTLet *let
+      = &ASTNodeManager_get_payload (self->ast_mgr_, node_id)->let_;
+  size_t env_len = TypeEnv_len (env);
+  bool rebound = false;
+  TypeId type_id = TypeManager_get_invalid (self->type_mgr_);
+  uint32_t i = 0;
+  while (i < let->num_vars_ && TypeChecker_bind (self, let, i, env, &rebound))
+    {
+      i++;
+    }
+  if (rebound)
+    {
+      /* Including the scopes left unchecked after an invalid binding, which
+       * are checked with the new bindings later.  */
+      TypeChecker_forget_scope (self, let, i);
+    }
+  if (i == let->num_vars_)
+    {
+      type_id = TypeChecker_typeof (self, let->body_, env);
+    }
+  TypeEnv_truncate (env, env_len);
+  return TypeChecker_set_map (self, node_id, type_id);
+}
+
+/* A subtree typed by a job of its own in the root environment, whose
+ * diagnostics are held back until the check reaches it.  */
+typedef struct TypeFork
+{
+  TypeForks *forks_;
+  ASTNodeId node_id_;
+  DiagnosticManager diag_mgr_;
+  size_t num_typed_;
+  /* Whether the check reached the fork and took its diagnostics.  */
+  bool joined_;
+} TypeFork;
+
+NEO_DECL_VEC (TypeFork, TypeFork)
+NEO_IMPL_VEC (TypeFork, TypeFork)
+
+/* The forks of a check, sorted by id.  All but the first are run on the
+ * pool, and the calling thread waits for them.  */
+struct TypeForks
+{
+  const TypeChecker *checker_;
+  Vec_TypeFork forks_;
+  /* Guards NUM_LEFT.  */
+  mtx_t lock_;
+  cnd_t done_notify_;
+  size_t num_left_;
+};
+
+static int
+TypeFork_compare (TypeFork fork, TypeFork other)
+{
+  return (fork.node_id_ > other.node_id_) - (fork.node_id_ < other.node_id_);
+}
+
+/* Takes the diagnostics of the fork at NODE_ID, if there is one, the first
+ * time that the check reaches it, so that they come in the order of a check
+ * without forks.  */
+static void
+TypeChecker_join (TypeChecker *self, ASTNodeId node_id)
+{
+  TypeFork key = { .node_id_ = node_id };
+  Result_size_t_size_t result = Vec_TypeFork_binary_search_by (
+      &self->forks_->forks_, &key, TypeFork_compare);
+  if (!Result_size_t_size_t_is_ok (&result))
+    {
+      return;
+    }
+  TypeFork *fork = Vec_TypeFork_begin (&self->forks_->forks_)
+                   + Result_size_t_size_t_unwrap (&result);
+  if (!fork->joined_)
+    {
+      fork->joined_ = true;
+      DiagnosticManager_append (self->diag_mgr_, &fork->diag_mgr_);
+    }
+}
+
+static TypeId
+TypeChecker_typeof_kind (TypeChecker *self, ASTNodeId node_id, TypeEnv *env)
+{
+  switch (ASTNodeManager_get_kind (self->ast_mgr_, node_id))
+    {
+    case AST_LIT_FALSE:
+    case AST_LIT_TRUE:
+      {
+        return TypeChecker_set_map (self, node_id,
+                                    TypeManager_get_bool (self->type_mgr_));
+      }
+    case AST_LIT_INTEGER:
+      {
+        return TypeChecker_typeof_integer (self, node_id);
+      }
+    case AST_IF_THEN_ELSE:
+      {
+        return TypeChecker_typeof_if_then_else (self, node_id, env);
+      }
+    case AST_TYPE:
+      {
+        return TypeChecker_typeof_type (self, node_id, env);
+      }
+    case AST_VAR:
+      {
+        return TypeChecker_typeof_var (self, node_id, env);
+      }
+    case AST_LET:
+      {
+        return TypeChecker_typeof_let (self, node_id, env);
+      }
+    case AST_POSITIVE:
+    case AST_NEGATIVE:
+      {
+        return TypeChecker_typeof_unary (self, node_id, env);
+      }
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MUL:
+    case AST_DIV:
+    case AST_EQ:
+    case AST_NEQ:
+    case AST_LE:
+    case AST_GE:
+    case AST_LT:
+    case AST_GT:
+      {
+        return TypeChecker_typeof_binary (self, node_id, env);
+      }
+    default:
+      {
+        return TypeChecker_set_map (self, node_id,
+                                    TypeManager_get_invalid (self->type_mgr_));
+      }
+    }
+}
+
+/* Only a recheck counts the diagnostics of each node.  */
+static uint32_t *
+TypeChecker_num_diags (TypeChecker *self, ASTNodeId node_id)
+{
+  return node_id < Vec_u32_len (&self->num_diags_)
+             ? Vec_u32_begin (&self->num_diags_) + node_id
+             : NULL;
+}
+
+static TypeId
+TypeChecker_typeof (TypeChecker *self, ASTNodeId node_id, TypeEnv *env)
+{
+  if (self->forks_)
+    {
+      TypeChecker_join (self, node_id);
+    }
+  uint32_t *num_diags = TypeChecker_num_diags (self, node_id);
+  if (!TypeManager_is_unknown (
+          self->type_mgr_, ASTNodeIdToTypeIdMap_get (&self->map_, node_id))
+      && !(num_diags && *num_diags))
+    {
+      return ASTNodeIdToTypeIdMap_get (&self->map_, node_id);
+    }
+  if (TypeChecker_is_cancelled (self))
+    {
+      return TYPE_UNKNOWN;
+    }
+  self->num_typed_++;
+  size_t num_total = DiagnosticManager_num_total (self->diag_mgr_);
+  TypeId type_id = TypeChecker_typeof_kind (self, node_id, env);
+  /* Typed from children that may have given up.  */
+  if (TypeChecker_is_cancelled (self))
+    {
+      ASTNodeIdToTypeIdMap_set (&self->map_, node_id, TYPE_UNKNOWN);
+      return TYPE_UNKNOWN;
+    }
+  if (num_diags)
+    {
+      *num_diags = DiagnosticManager_num_total (self->diag_mgr_) - num_total;
+    }
+  return type_id;
+}
+
+/* Opens the root frame of ENV, with the named types in it, in the order
+ * that the resolver binds them.  */
+static void
+TypeChecker_enter_root (const TypeChecker *self, TypeEnv *env)
+{
+  TypeEnv_enter (env);
+  for (enum TypeKind kind = TYPE_NAMED_BEGIN; kind < TYPE_NAMED_END; kind++)
+    {
+      TypeEnv_push (env, Span_from_cstring (TypeKind_get_name (kind)),
+                    TypeManager_get_named (self->type_mgr_, kind));
+    }
+}
+
+/* Types NODE_ID in an environment of nothing but the built-in types.  */
+static TypeId
+TypeChecker_typeof_root (TypeChecker *self, ASTNodeId node_id)
+{
+  TypeEnv env = TypeEnv_new (self->scopes_ != NULL);
+  TypeChecker_enter_root (self, &env);
+  TypeId type_id = TypeChecker_typeof (self, node_id, &env);
+  TypeEnv_drop (&env);
+  return type_id;
+}
+
+TypeId
+TypeChecker_recheck (TypeChecker *self, ASTNodeId node_id)
+{
+  ASTNodeIdToTypeIdMap_resize (&self->map_,
+                               ASTNodeManager_num_nodes (self->ast_mgr_));
+  Vec_u32_resize (&self->num_diags_,
+                  ASTNodeManager_num_nodes (self->ast_mgr_), 0);
+  return TypeChecker_typeof_root (self, node_id);
+}
+
+/* The nodes below an if, counted by ids, which is exact for a fresh parse,
+ * where they come right before it.  */
+static size_t
+TypeChecker_if_then_else_size (const TypeChecker *self, ASTNodeId node_id)
+{
+  ASTNodeId if_expr = ASTNodeManager_get_payload (self->ast_mgr_, node_id)
+                          ->if_then_else_.if_expr_;
+  return if_expr < node_id ? node_id - if_expr : 0;
+}
+
+/* Forks the subtrees below NODE_ID that are typed in the root environment:
+ * the branches of its ifs, down to those smaller than MIN_FORK_NODES.  Lets
+ * are not split, since their inits see the bindings before them.  */
+static void
+TypeChecker_split (const TypeChecker *self, ASTNodeId node_id,
+                   TypeForks *forks)
+{
+  if (ASTNodeManager_get_kind (self->ast_mgr_, node_id) == AST_IF_THEN_ELSE
+      && TypeChecker_if_then_else_size (self, node_id)
+             >= self->min_fork_nodes_)
+    {
+      const ASTIfThenElse *if_then_else
+          = &ASTNodeManager_get_payload (self->ast_mgr_, node_id)
+                 ->if_then_else_;
+      TypeChecker_split (self, if_then_else->if_expr_, forks);
+      TypeChecker_split (self, if_then_else->then_expr_, forks);
+      TypeChecker_split (self, if_then_else->else_expr_, forks);
+      return;
+    }
+  DiagnosticManager diag_mgr = DiagnosticManager_new (self->diag_mgr_->file_);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  DiagnosticManager_set_limit (&diag_mgr, self->diag_mgr_->limit_);
+  DiagnosticManager_set_type_manager (&diag_mgr, self->type_mgr_);
+  Vec_TypeFork_push (&forks->forks_, (TypeFork){ .forks_ = forks,
+                                                 .node_id_ = node_id,
+                                                 .diag_mgr_ = diag_mgr,
+                                                 .num_typed_ = 0,
+                                                 .joined_ = false });
+}
+
+static void
+TypeFork_run (void *fork_arg)
+{
+  TypeFork *fork = fork_arg;
+  TypeForks *forks = fork->forks_;
+  /* Shares the map, in which the forks set disjoint subtrees.  */
+  TypeChecker checker = *forks->checker_;
+  checker.diag_mgr_ = &fork->diag_mgr_;
+  checker.num_typed_ = 0;
+  checker.num_forgotten_ = 0;
+  checker.pool_ = NULL;
+  checker.forks_ = NULL;
+  TypeChecker_typeof_root (&checker, fork->node_id_);
+  fork->num_typed_ = checker.num_typed_;
+}
+
+static void
+TypeFork_run_counted (void *fork_arg)
+{
+  TypeFork_run (fork_arg);
+  TypeForks *forks = ((TypeFork *)fork_arg)->forks_;
+  if (mtx_lock (&forks->lock_) != thrd_success)
+    {
+      abort ();
+    }
+  if (--forks->num_left_ == 0
+      && cnd_signal (&forks->done_notify_) != thrd_success)
+    {
+      abort ();
+    }
+  if (mtx_unlock (&forks->lock_) != thrd_success)
+    {
+      abort ();
+    }
+}
+
+static int
+TypeFork_qsort_compare (const void *fork, const void *other)
+{
+  return TypeFork_compare (*(const TypeFork *)fork,
+                           *(const TypeFork *)other);
+}
+
+/* Types the forks of NODE_ID on the pool, then the nodes above them, taking
+ * the results of the forks as the check reaches them.  Forks that a check
+ * without them would have skipped, like the branches of an if whose
+ * condition is not Bool, are forgotten with their diagnostics.  */
+static void
+TypeChecker_fork_join (TypeChecker *self, ASTNodeId node_id)
+{
+  ASTNodeIdToTypeIdMap_resize (&self->map_,
+                               ASTNodeManager_num_nodes (self->ast_mgr_));
+  TypeForks forks
+      = { .checker_ = self, .forks_ = Vec_TypeFork_new (), .num_left_ = 0 };
+  TypeChecker_split (self, node_id, &forks);
+  size_t num_forks = Vec_TypeFork_len (&forks.forks_);
+  TypeFork *begin = Vec_TypeFork_begin (&forks.forks_);
+  qsort (begin, num_forks, sizeof (TypeFork), TypeFork_qsort_compare);
+  if (mtx_init (&forks.lock_, mtx_plain) != thrd_success
+      || cnd_init (&forks.done_notify_) != thrd_success)
+    {
+      abort ();
+    }
+  forks.num_left_ = num_forks - 1;
+  for (size_t i = 1; i < num_forks; i++)
+    {
+      ThreadPool_execute (self->pool_, TypeFork_run_counted, begin + i);
+    }
+  TypeFork_run (begin);
+  if (mtx_lock (&forks.lock_) != thrd_success)
+    {
+      abort ();
+    }
+  while (forks.num_left_)
+    {
+      if (cnd_wait (&forks.done_notify_, &forks.lock_) != thrd_success)
+        {
+          abort ();
+        }
+    }
+  if (mtx_unlock (&forks.lock_) != thrd_success)
+    {
+      abort ();
+    }
+  self->forks_ = &forks;
+  TypeChecker_typeof_root (self, node_id);
+  self->forks_ = NULL;
+  for (size_t i = 0; i < num_forks; i++)
+    {
+      if (begin[i].joined_)
+        {
+          self->num_typed_ += begin[i].num_typed_;
+        }
+      else
+        {
+          TypeChecker_forget_subtree (self, begin[i].node_id_);
+        }
+      DiagnosticManager_drop (&begin[i].diag_mgr_);
+    }
+  mtx_destroy (&forks.lock_);
+  cnd_destroy (&forks.done_notify_);
+  Vec_TypeFork_drop (&forks.forks_);
+}
+
+ASTNodeIdToTypeIdMap
+TypeChecker_check (TypeChecker *self, ASTNodeId node_id)
+{
+  if (self->pool_ && !is_null_ast_node_id (node_id))
+    {
+      TypeChecker_fork_join (self, node_id);
+    }
+  else
+    {
+      TypeChecker_recheck (self, node_id);
+    }
+  Vec_u32_drop (&self->num_diags_);
+  return self->map_;
+}
+
+/* A let whose inits are being swept, stacked innermost last.  */
+typedef struct SweepScope
 {
-  return (TypeChecker){ .ast_mgr_ = ast_mgr,
-                        .diag_mgr_ = diag_mgr,
-                        .type_mgr_ = type_mgr,
-                        .map_ = ASTNodeIdToTypeIdMap_new (Vec_ASTNode_len (
-                            ASTNodeManager_get_nodes (ast_mgr))) };
-}
+  uint32_t env_len_;
+  uint32_t num_bound_;
+} SweepScope;
 
-typedef struct TypeEnvEntry
+NEO_DECL_VEC (SweepScope, SweepScope)
+NEO_IMPL_VEC (SweepScope, SweepScope)
+
+enum SweepEventKind
 {
-  Span name_;
-  TypeId type_id_;
-} TypeEnvEntry;
+  SWEEP_NONE,
+  SWEEP_IF_EXPR,
+  SWEEP_THEN_EXPR,
+  SWEEP_FIRST_INIT,
+  SWEEP_INIT
+};
 
-NEO_DECL_VEC (TypeEnvEntry, TypeEnvEntry)
-NEO_IMPL_VEC (TypeEnvEntry, TypeEnvEntry)
+/* What the sweep does at a node, worked out before it starts.  */
+typedef struct SweepMark
+{
+  /* Where the subtree of the node begins, and, once its parent is through
+   * with it, where the sweep jumps to when it reaches the node.  A node that
+   * is not a jump is marked with its own id or less.  */
+  ASTNodeId jump_;
+  /* What the parent does once the node is typed, kept with the node, so
+   * that the sweep does not look the parent up far ahead.  */
+  enum SweepEventKind event_;
+  ASTNodeId parent_;
+} SweepMark;
 
-static TypeId
-TypeChecker_set_map (TypeChecker *self, ASTNodeId node_id, TypeId type_id)
+NEO_DECL_VEC (SweepMark, SweepMark)
+NEO_IMPL_VEC (SweepMark, SweepMark)
+
+static void
+jump_to (SweepMark *marks, ASTNodeId id, ASTNodeId target)
 {
-  ASTNodeIdToTypeIdMap_set (&self->map_, node_id, type_id);
-  return type_id;
+  if (marks[id].jump_ < target)
+    {
+      marks[id].jump_ = target;
+    }
 }
 
-static TypeId TypeChecker_typeof (TypeChecker *self, ASTNodeId node_id,
-                                  Vec_TypeEnvEntry *env);
+static void
+mark_event (SweepMark *mark, enum SweepEventKind event, ASTNodeId parent)
+{
+  mark->event_ = event;
+  mark->parent_ = parent;
+}
 
-static TypeId
-TypeChecker_typeof_if_then_else (TypeChecker *self, ASTNodeId node_id,
-                                 Vec_TypeEnvEntry *env)
+/* Checks that CHILDREN of ID are laid out right before it and one after
+ * another, each subtree in one piece, and marks where the subtree of ID
+ * begins.  A node that is then reached from two parents would have to be in
+ * two pieces, so the nodes swept form a tree.  */
+static bool
+mark_children (ASTNodeId id, const ASTNodeId *children, size_t len,
+               SweepMark *marks)
 {
-  const ASTNode *node = ASTNodeManager_get_node (self->ast_mgr_, node_id);
-  assert (node->kind_ == AST_IF_THEN_ELSE);
-  TypeId if_expr_type_id
-      = TypeChecker_typeof (self, node->if_then_else_.if_expr_, env);
-  if (!TypeManager_is_bool (self->type_mgr_, if_expr_type_id))
+  ASTNodeId begin = id;
+  ASTNodeId next = get_null_ast_node_id ();
+  for (size_t i = 0; i < len; i++)
     {
-      DiagnosticManager_diagnose_if_expr_not_bool (
-          self->diag_mgr_,
-          ASTNodeManager_get_node (self->ast_mgr_,
-                                   node->if_then_else_.if_expr_)
-              ->span_,
-          TypeManager_to_string (self->type_mgr_, if_expr_type_id));
-      return TypeChecker_set_map (self, node_id,
-                                  TypeManager_get_invalid (self->type_mgr_));
+      ASTNodeId child = children[i];
+      if (is_null_ast_node_id (child))
+        {
+          continue;
+        }
+      if (is_invalid_ast_node_id (child) || child >= id
+          || (!is_null_ast_node_id (next) && marks[child].jump_ != next))
+        {
+          return false;
+        }
+      if (is_null_ast_node_id (next))
+        {
+          begin = marks[child].jump_;
+        }
+      next = child + 1;
     }
-  TypeId then_expr_type_id
-      = TypeChecker_typeof (self, node->if_then_else_.then_expr_, env);
-  if (TypeManager_is_invalid (self->type_mgr_, then_expr_type_id))
+  marks[id].jump_ = begin;
+  return is_null_ast_node_id (next) || next == id;
+}
+
+/* Checks front to back that every subtree up to ROOT is laid out in post
+ * order, and marks each node: jumps past the vars and types of a let, which
+ * are typed with their binding, and past the children of a kind that is not
+ * typed, which the recursive checker never visits, and events at the
+ * conditions and then branches of ifs and at the inits of lets.  */
+static bool
+TypeChecker_mark_sweep (const TypeChecker *self, ASTNodeId root,
+                        Vec_SweepMark *marks_vec)
+{
+  SweepMark *marks = Vec_SweepMark_begin (marks_vec);
+  Vec_ASTNodeId children = Vec_ASTNodeId_new ();
+  bool in_order = true;
+  for (ASTNodeId id = get_invalid_ast_node_id () + 1; in_order && id <= root;
+       id++)
     {
-      return TypeChecker_set_map (self, node_id,
-                                  TypeManager_get_invalid (self->type_mgr_));
+      enum ASTKind kind = ASTNodeManager_get_kind (self->ast_mgr_, id);
+      switch (kind)
+        {
+        case AST_LIT_FALSE:
+        case AST_LIT_TRUE:
+        case AST_LIT_INTEGER:
+        case AST_TYPE:
+        case AST_VAR:
+          {
+            marks[id].jump_ = id;
+            break;
+          }
+        case AST_IF_THEN_ELSE:
+          {
+            const ASTIfThenElse *if_then_else
+                = &ASTNodeManager_get_payload (self->ast_mgr_, id)
+                       ->if_then_else_;
+            const ASTNodeId ids[] = { if_then_else->if_expr_,
+                                      if_then_else->then_expr_,
+                                      if_then_else->else_expr_ };
+            in_order = mark_children (id, ids, 3, marks);
+            if (in_order)
+              {
+                mark_event (marks + if_then_else->if_expr_, SWEEP_IF_EXPR,
+                            id);
+                mark_event (marks + if_then_else->then_expr_,
+                            SWEEP_THEN_EXPR, id);
+              }
+            break;
+          }
+        case AST_POSITIVE:
+        case AST_NEGATIVE:
+        case AST_ADD:
+        case AST_SUB:
+        case AST_MUL:
+        case AST_DIV:
+        case AST_EQ:
+        case AST_NEQ:
+        case AST_LE:
+        case AST_GE:
+        case AST_LT:
+        case AST_GT:
+          {
+            Vec_ASTNodeId_clear (&children);
+            ASTNodeManager_push_children (self->ast_mgr_, id, &children);
+            in_order = mark_children (id, Vec_ASTNodeId_cbegin (&children),
+                                      Vec_ASTNodeId_len (&children), marks);
+            break;
+          }
+        case AST_LET:
+          {
+            const ASTLet *let
+                = &ASTNodeManager_get_payload (self->ast_mgr_, id)->let_;
+            Vec_ASTNodeId_clear (&children);
+            ASTNodeManager_push_children (self->ast_mgr_, id, &children);
+            in_order = mark_children (id, Vec_ASTNodeId_cbegin (&children),
+                                      Vec_ASTNodeId_len (&children), marks);
+            for (uint32_t i = 0; in_order && i < let->num_vars_; i++)
+              {
+                ASTNodeId var
+                    = ASTNodeManager_get_let_vars (self->ast_mgr_, let)[i];
+                ASTNodeId type
+                    = ASTNodeManager_get_let_types (self->ast_mgr_, let)[i];
+                ASTNodeId init
+                    = ASTNodeManager_get_let_inits (self->ast_mgr_, let)[i];
+                jump_to (marks, var, var + 1);
+                if (!is_null_ast_node_id (type))
+                  {
+                    jump_to (marks, type, type + 1);
+                  }
+                mark_event (marks + init, i ? SWEEP_INIT : SWEEP_FIRST_INIT,
+                            id);
+              }
+            break;
+          }
+        default:
+          {
+            Vec_ASTNodeId_clear (&children);
+            ASTNodeManager_push_children (self->ast_mgr_, id, &children);
+            in_order = mark_children (id, Vec_ASTNodeId_cbegin (&children),
+                                      Vec_ASTNodeId_len (&children), marks);
+            if (in_order && marks[id].jump_ < id)
+              {
+                jump_to (marks, marks[id].jump_, id);
+              }
+            break;
+          }
+        }
     }
+  Vec_ASTNodeId_drop (&children);
+  return in_order;
+}
+
+static TypeId
+TypeChecker_sweep_if_then_else (TypeChecker *self, ASTNodeId node_id)
+{
+  const ASTIfThenElse *if_then_else
+      = &ASTNodeManager_get_payload (self->ast_mgr_, node_id)->if_then_else_;
+  TypeId if_expr_type_id
+      = ASTNodeIdToTypeIdMap_get (&self->map_, if_then_else->if_expr_);
+  TypeId then_expr_type_id
+      = ASTNodeIdToTypeIdMap_get (&self->map_, if_then_else->then_expr_);
   TypeId else_expr_type_id
-      = TypeChecker_typeof (self, node->if_then_else_.else_expr_, env);
-  if (TypeManager_is_invalid (self->type_mgr_, else_expr_type_id))
+      = ASTNodeIdToTypeIdMap_get (&self->map_, if_then_else->else_expr_);
+  if (!TypeManager_is_bool (self->type_mgr_, if_expr_type_id)
+      || TypeManager_is_invalid (self->type_mgr_, then_expr_type_id)
+      || TypeManager_is_invalid (self->type_mgr_, else_expr_type_id))
     {
-      return TypeChecker_set_map (self, node_id,
-                                  TypeManager_get_invalid (self->type_mgr_));
+      return TypeManager_get_invalid (self->type_mgr_);
     }
   if (!TypeManager_are_equal (self->type_mgr_, then_expr_type_id,
                               else_expr_type_id))
     {
       DiagnosticManager_diagnose_expr_types_not_equal (
           self->diag_mgr_,
-          ASTNodeManager_get_node (self->ast_mgr_,
-                                   node->if_then_else_.then_expr_)
-              ->span_,
-          TypeManager_to_string (self->type_mgr_, then_expr_type_id),
-          ASTNodeManager_get_node (self->ast_mgr_,
-                                   node->if_then_else_.else_expr_)
-              ->span_,
-          TypeManager_to_string (self->type_mgr_, else_expr_type_id));
-      return TypeChecker_set_map (self, node_id,
-                                  TypeManager_get_invalid (self->type_mgr_));
-    }
-  return TypeChecker_set_map (self, node_id, then_expr_type_id);
-}
-
-static TypeId
-TypeChecker_typeof_type (TypeChecker *self, ASTNodeId node_id,
-                         Vec_TypeEnvEntry *env)
-{
-  const ASTNode *node = ASTNodeManager_get_node (self->ast_mgr_, node_id);
-  assert (node->kind_ == AST_TYPE);
-  const TypeEnvEntry *ptr = Vec_TypeEnvEntry_cend (env);
-  while (ptr-- > Vec_TypeEnvEntry_cbegin (env))
-    {
-      if (!Span_cmp (&node->span_, &ptr->name_))
-        {
-          return TypeChecker_set_map (self, node_id, ptr->type_id_);
-        }
+          *ASTNodeManager_get_span (self->ast_mgr_, if_then_else->then_expr_),
+          then_expr_type_id,
+          *ASTNodeManager_get_span (self->ast_mgr_, if_then_else->else_expr_),
+          else_expr_type_id);
+      return TypeManager_get_invalid (self->type_mgr_);
     }
-  DiagnosticManager_diagnose_invalid_type (self->diag_mgr_, node->span_);
-  return TypeChecker_set_map (self, node_id,
-                              TypeManager_get_invalid (self->type_mgr_));
+  return then_expr_type_id;
 }
 
+/* Leaves the scope of the let, whose bindings were pushed as their inits
+ * were swept.  */
 static TypeId
-TypeChecker_typeof_var (TypeChecker *self, ASTNodeId node_id,
-                        Vec_TypeEnvEntry *env)
+TypeChecker_sweep_let (TypeChecker *self, ASTNodeId node_id, TypeEnv *env,
+                       Vec_SweepScope *scopes)
 {
-  const ASTNode *node = ASTNodeManager_get_node (self->ast_mgr_, node_id);
-  assert (node->kind_ == AST_VAR);
-  const TypeEnvEntry *ptr = Vec_TypeEnvEntry_cend (env);
-  while (ptr-- > Vec_TypeEnvEntry_cbegin (env))
+  const ASTLet *let
+      = &ASTNodeManager_get_payload (self->ast_mgr_, node_id)->let_;
+  SweepScope scope = Vec_SweepScope_pop (scopes);
+  TypeEnv_truncate (env, scope.env_len_);
+  if (scope.num_bound_ < let->num_vars_)
     {
-      if (!Span_cmp (&node->span_, &ptr->name_))
-        {
-          return TypeChecker_set_map (self, node_id, ptr->type_id_);
-        }
+      return TypeManager_get_invalid (self->type_mgr_);
     }
-  DiagnosticManager_diagnose_var_not_bound (self->diag_mgr_, node->span_);
-  return TypeChecker_set_map (self, node_id,
-                              TypeManager_get_invalid (self->type_mgr_));
+  return ASTNodeIdToTypeIdMap_get (&self->map_, let->body_);
 }
 
+/* Types NODE_ID from the types of its children, which were swept before.  */
 static TypeId
-TypeChecker_typeof (TypeChecker *self, ASTNodeId node_id,
-                    Vec_TypeEnvEntry *env)
+TypeChecker_sweep_node (TypeChecker *self, ASTNodeId node_id, TypeEnv *env,
+                        Vec_SweepScope *scopes)
 {
-  if (!TypeManager_is_unknown (
-          self->type_mgr_, ASTNodeIdToTypeIdMap_get (&self->map_, node_id)))
-    {
-      return ASTNodeIdToTypeIdMap_get (&self->map_, node_id);
-    }
-  const ASTNode *node = ASTNodeManager_get_node (self->ast_mgr_, node_id);
-  switch (node->kind_)
+  self->num_typed_++;
+  switch (ASTNodeManager_get_kind (self->ast_mgr_, node_id))
     {
     case AST_LIT_FALSE:
     case AST_LIT_TRUE:
@@ -178,9 +1231,14 @@ TypeChecker_typeof (TypeChecker *self, ASTNodeId node_id,
         return TypeChecker_set_map (self, node_id,
                                     TypeManager_get_bool (self->type_mgr_));
       }
+    case AST_LIT_INTEGER:
+      {
+        return TypeChecker_typeof_integer (self, node_id);
+      }
     case AST_IF_THEN_ELSE:
       {
-        return TypeChecker_typeof_if_then_else (self, node_id, env);
+        return TypeChecker_set_map (
+            self, node_id, TypeChecker_sweep_if_then_else (self, node_id));
       }
     case AST_TYPE:
       {
@@ -190,6 +1248,42 @@ TypeChecker_typeof (TypeChecker *self, ASTNodeId node_id,
       {
         return TypeChecker_typeof_var (self, node_id, env);
       }
+    case AST_LET:
+      {
+        return TypeChecker_set_map (
+            self, node_id, TypeChecker_sweep_let (self, node_id, env, scopes));
+      }
+    case AST_POSITIVE:
+    case AST_NEGATIVE:
+      {
+        const ASTUnary *unary
+            = &ASTNodeManager_get_payload (self->ast_mgr_, node_id)->unary_;
+        return TypeChecker_set_map (
+            self, node_id,
+            TypeChecker_type_unary (
+                self, node_id,
+                ASTNodeIdToTypeIdMap_get (&self->map_, unary->expr_)));
+      }
+    case AST_ADD:
+    case AST_SUB:
+    case AST_MUL:
+    case AST_DIV:
+    case AST_EQ:
+    case AST_NEQ:
+    case AST_LE:
+    case AST_GE:
+    case AST_LT:
+    case AST_GT:
+      {
+        const ASTBinary *binary
+            = &ASTNodeManager_get_payload (self->ast_mgr_, node_id)->binary_;
+        return TypeChecker_set_map (
+            self, node_id,
+            TypeChecker_type_binary (
+                self, node_id,
+                ASTNodeIdToTypeIdMap_get (&self->map_, binary->left_),
+                ASTNodeIdToTypeIdMap_get (&self->map_, binary->right_)));
+      }
     default:
       {
         return TypeChecker_set_map (self, node_id,
@@ -198,23 +1292,154 @@ TypeChecker_typeof (TypeChecker *self, ASTNodeId node_id,
     }
 }
 
+/* Does what the parent of NODE_ID does once it is typed, as the recursive
+ * checker would, and returns the first node to be swept next.  An invalid
+ * binding or condition skips the rest of its parent.  */
+static ASTNodeId
+TypeChecker_sweep_event (TypeChecker *self, ASTNodeId node_id,
+                         const SweepMark *mark, TypeEnv *env,
+                         Vec_SweepScope *scopes)
+{
+  TypeId type_id = ASTNodeIdToTypeIdMap_get (&self->map_, node_id);
+  switch (mark->event_)
+    {
+    case SWEEP_IF_EXPR:
+      {
+        if (!TypeManager_is_bool (self->type_mgr_, type_id))
+          {
+            DiagnosticManager_diagnose_if_expr_not_bool (
+                self->diag_mgr_,
+                *ASTNodeManager_get_span (self->ast_mgr_, node_id), type_id);
+            return mark->parent_;
+          }
+        return node_id + 1;
+      }
+    case SWEEP_THEN_EXPR:
+      {
+        if (TypeManager_is_invalid (self->type_mgr_, type_id))
+          {
+            return mark->parent_;
+          }
+        return node_id + 1;
+      }
+    case SWEEP_FIRST_INIT:
+    case SWEEP_INIT:
+      {
+        if (mark->event_ == SWEEP_FIRST_INIT)
+          {
+            Vec_SweepScope_push (
+                scopes, (SweepScope){ .env_len_ = TypeEnv_len (env),
+                                      .num_bound_ = 0 });
+          }
+        SweepScope *scope = Vec_SweepScope_begin (scopes)
+                            + Vec_SweepScope_len (scopes) - 1;
+        const ASTLet *let
+            = &ASTNodeManager_get_payload (self->ast_mgr_, mark->parent_)
+                   ->let_;
+        /* A fresh map has no binding to tell apart.  */
+        bool rebound = false;
+        if (!TypeChecker_bind_init (self, let, scope->num_bound_, type_id,
+                                    env, &rebound))
+          {
+            return mark->parent_;
+          }
+        scope->num_bound_++;
+        return node_id + 1;
+      }
+    default:
+      {
+        return node_id + 1;
+      }
+    }
+}
+
 ASTNodeIdToTypeIdMap
-TypeChecker_check (TypeChecker *self, ASTNodeId node_id)
+TypeChecker_check_sweep (TypeChecker *self, ASTNodeId node_id)
 {
-  Vec_TypeEnvEntry env = Vec_TypeEnvEntry_new ();
-  Vec_TypeEnvEntry_push (
-      &env,
-      (TypeEnvEntry){ .name_ = Span_from_cstring ("Bool"),
-                      .type_id_ = TypeManager_get_bool (self->type_mgr_) });
-  TypeChecker_typeof (self, node_id, &env);
-  Vec_TypeEnvEntry_drop (&env);
+  size_t num_nodes = ASTNodeManager_num_nodes (self->ast_mgr_);
+  if (node_id <= get_invalid_ast_node_id () || node_id >= num_nodes)
+    {
+      return TypeChecker_check (self, node_id);
+    }
+  ASTNodeIdToTypeIdMap_resize (&self->map_, num_nodes);
+  Vec_SweepMark marks = Vec_SweepMark_new ();
+  Vec_SweepMark_resize (&marks, node_id + 1,
+                        (SweepMark){ .event_ = SWEEP_NONE });
+  if (!TypeChecker_mark_sweep (self, node_id, &marks))
+    {
+      Vec_SweepMark_drop (&marks);
+      return TypeChecker_check (self, node_id);
+    }
+  const SweepMark *mark_of = Vec_SweepMark_cbegin (&marks);
+  /* The root has no parent to look at it, so its own mark is still where
+   * its subtree begins.  */
+  ASTNodeId next = mark_of[node_id].jump_;
+  TypeEnv env = TypeEnv_new (self->scopes_ != NULL);
+  TypeChecker_enter_root (self, &env);
+  Vec_SweepScope scopes = Vec_SweepScope_new ();
+  for (ASTNodeId id = next; id <= node_id; id++)
+    {
+      ASTNodeId jump = mark_of[id].jump_;
+      if (jump > id && jump > next)
+        {
+          next = jump;
+        }
+      if (id < next)
+        {
+          continue;
+        }
+      TypeChecker_sweep_node (self, id, &env, &scopes);
+      next = TypeChecker_sweep_event (self, id, mark_of + id, &env, &scopes);
+    }
+  assert (Vec_SweepScope_is_empty (&scopes));
+  Vec_SweepScope_drop (&scopes);
+  TypeEnv_drop (&env);
+  Vec_SweepMark_drop (&marks);
   return self->map_;
 }
 
+void
+TypeChecker_invalidate (TypeChecker *self, const ASTNodeId *ids, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+    {
+      if (ids[i] < Vec_TypeId_len (&self->map_.map_))
+        {
+          ASTNodeIdToTypeIdMap_set (&self->map_, ids[i], TYPE_UNKNOWN);
+        }
+    }
+  /* A var that is new to the map was renamed, so the uses in its scope may
+   * bind elsewhere now.  */
+  if (len > 0 && ASTNodeManager_get_kind (self->ast_mgr_, ids[len - 1])
+                     == AST_LET)
+    {
+      const ASTLet *let
+          = &ASTNodeManager_get_payload (self->ast_mgr_, ids[len - 1])->let_;
+      const ASTNodeId *vars
+          = ASTNodeManager_get_let_vars (self->ast_mgr_, let);
+      for (uint32_t i = 0; i < let->num_vars_; i++)
+        {
+          if (vars[i] >= Vec_TypeId_len (&self->map_.map_))
+            {
+              TypeChecker_forget_scope (self, let, i);
+              break;
+            }
+        }
+    }
+}
+
+const ASTNodeIdToTypeIdMap *
+TypeChecker_get_map (const TypeChecker *self)
+{
+  return &self->map_;
+}
+
 #ifdef TESTS
 #include "test.h"
 
-#include "lexer.h"
+#include <string.h>
+
+#include "folder.h"
 #include "parser.h"
 
 typedef struct TypeCheckerTest
@@ -232,21 +1457,10 @@ TypeCheckerTest_init (TypeCheckerTest *self, const char *content)
 {
   self->file_ = SourceFile_new (String_from_cstring ("test"),
                                 String_from_cstring (content));
-  Span content_span = Span_from_string (SourceFile_get_content (&self->file_));
-  Lexer lexer = Lexer_new (&content_span);
-  Vec_Token tokens = Vec_Token_new ();
-  Token token;
-  do
-    {
-      token = Lexer_next (&lexer);
-      Vec_Token_push (&tokens, token);
-    }
-  while (!Token_is_eof (&token));
   self->ast_mgr_ = ASTNodeManager_new ();
   self->diag_mgr_ = DiagnosticManager_new (&self->file_);
-  Parser parser = Parser_new (&tokens, &self->diag_mgr_, &self->ast_mgr_);
-  self->node_id_ = Parser_parse (&parser);
-  Vec_Token_drop (&tokens);
+  self->node_id_ = Parser_parse_file (&self->file_, &self->diag_mgr_,
+                                      &self->ast_mgr_);
   self->type_mgr_ = TypeManager_new ();
   self->type_checker_
       = TypeChecker_new (&self->ast_mgr_, &self->diag_mgr_, &self->type_mgr_);
@@ -309,5 +1523,534 @@ NEO_TEST (test_check_if_00)
   TypeCheckerTest_drop (&tester);
 }
 
-NEO_TESTS (type_checker_tests, test_check_true_00, test_check_if_00)
+NEO_TEST (test_check_let_00)
+{
+  TypeCheckerTest tester;
+  TypeCheckerTest_init (&tester,
+                        "let x = true, y: Bool = x in if y then x else false");
+  TypeChecker *checker = TypeCheckerTest_borrow_type_checker (&tester);
+  ASSERT_U64_EQ (
+      TypeChecker_recheck (checker, TypeCheckerTest_get_node_id (&tester)),
+      TypeManager_get_bool (TypeCheckerTest_get_type_manager (&tester)));
+  ASSERT_U64_EQ (DiagnosticManager_num_total (&tester.diag_mgr_), 0);
+  /* Everything is known the second time.  */
+  size_t num_typed = checker->num_typed_;
+  TypeChecker_recheck (checker, TypeCheckerTest_get_node_id (&tester));
+  ASSERT_U64_EQ (checker->num_typed_, num_typed);
+  TypeChecker_drop (checker);
+  TypeCheckerTest_drop (&tester);
+}
+
+NEO_TEST (test_check_let_01)
+{
+  TypeCheckerTest tester;
+  TypeCheckerTest_init (&tester, "let a = true in let b = a, c = b in "
+                                 "let d: Bool = c in let e = d in e");
+  TypeChecker *checker = TypeCheckerTest_borrow_type_checker (&tester);
+  ASSERT_U64_EQ (
+      TypeChecker_recheck (checker, TypeCheckerTest_get_node_id (&tester)),
+      TypeManager_get_bool (TypeCheckerTest_get_type_manager (&tester)));
+  /* A fresh check binds each var once and types each node once: the four
+   * lets, the five inits, the annotation and the body.  */
+  ASSERT_U64_EQ (checker->num_forgotten_, 0);
+  ASSERT_U64_EQ (checker->num_typed_, 11);
+  TypeChecker_drop (checker);
+  TypeCheckerTest_drop (&tester);
+}
+
+/* Counts the nodes typed differently and the diagnostics reported
+ * differently by the checks of SELF and OTHER, which parsed the same
+ * content, since the first NUM_DIAGS.  */
+static size_t
+TypeCheckerTest_num_mismatches (const TypeCheckerTest *self,
+                                const ASTNodeIdToTypeIdMap *map,
+                                const TypeCheckerTest *other,
+                                const ASTNodeIdToTypeIdMap *other_map,
+                                size_t num_diags)
+{
+  size_t num_mismatches
+      = self->type_checker_.num_typed_ != other->type_checker_.num_typed_;
+  for (ASTNodeId id = 0; id < ASTNodeManager_num_nodes (&self->ast_mgr_);
+       id++)
+    {
+      num_mismatches += ASTNodeIdToTypeIdMap_get (map, id)
+                        != ASTNodeIdToTypeIdMap_get (other_map, id);
+    }
+  num_mismatches += DiagnosticManager_num_total (&self->diag_mgr_)
+                    != DiagnosticManager_num_total (&other->diag_mgr_);
+  for (DiagnosticId id = num_diags;
+       id < DiagnosticManager_num_stored (&self->diag_mgr_)
+       && id < DiagnosticManager_num_stored (&other->diag_mgr_);
+       id++)
+    {
+      String message = DiagnosticManager_fmt_diagnostic (&self->diag_mgr_, id);
+      String other_message
+          = DiagnosticManager_fmt_diagnostic (&other->diag_mgr_, id);
+      Span span = Span_from_string (&message);
+      Span other_span = Span_from_string (&other_message);
+      num_mismatches += !Span_eq (&span, &other_span);
+      String_drop (&message);
+      String_drop (&other_message);
+    }
+  return num_mismatches;
+}
+
+/* Checks CONTENT recursively and by a sweep, and counts the mismatches.  */
+static size_t
+sweep_num_mismatches (const char *content)
+{
+  TypeCheckerTest recursive;
+  TypeCheckerTest swept;
+  TypeCheckerTest_init (&recursive, content);
+  TypeCheckerTest_init (&swept, content);
+  DiagnosticManager_set_display (&recursive.diag_mgr_, false);
+  DiagnosticManager_set_display (&swept.diag_mgr_, false);
+  size_t num_diags = DiagnosticManager_num_total (&recursive.diag_mgr_);
+  ASTNodeId node_id = TypeCheckerTest_get_node_id (&recursive);
+  /* A fresh parse is always swept, rather than checked recursively.  */
+  Vec_SweepMark marks = Vec_SweepMark_new ();
+  Vec_SweepMark_resize (&marks, node_id + 1,
+                        (SweepMark){ .event_ = SWEEP_NONE });
+  size_t num_mismatches
+      = !TypeChecker_mark_sweep (&swept.type_checker_, node_id, &marks);
+  Vec_SweepMark_drop (&marks);
+  ASTNodeIdToTypeIdMap map
+      = TypeChecker_check (&recursive.type_checker_, node_id);
+  ASTNodeIdToTypeIdMap swept_map
+      = TypeChecker_check_sweep (&swept.type_checker_, node_id);
+  num_mismatches += TypeCheckerTest_num_mismatches (&recursive, &map, &swept,
+                                                    &swept_map, num_diags);
+  ASTNodeIdToTypeIdMap_drop (&map);
+  ASTNodeIdToTypeIdMap_drop (&swept_map);
+  TypeCheckerTest_drop (&recursive);
+  TypeCheckerTest_drop (&swept);
+  return num_mismatches;
+}
+
+NEO_TEST (test_check_sweep_00)
+{
+  static const char *const sources[] = {
+    "true",
+    "if true then false else true",
+    "let x = true, y: Bool = x in if y then x else false",
+    "let x = true, y = if x then x else false, z: Bool = y in\n"
+    "if z then if y then x else z else false",
+    "let x = true in let x = if x then false else true in x",
+    "if let b = true in b then let c = false in c else true",
+    /* Invalid conditions and bindings leave the rest unchecked.  */
+    "if (true, false) then x else y",
+    "if true then y else z",
+    "if true then true else (1, z)",
+    "if true then Bool else false",
+    "let x: Nat = true in x",
+    "let x: Bool = (true, false), y = z in y",
+    "let x = z, y = w in q",
+    "let x = true in if x then 1 + 2 else false",
+    "let f = (a, b: Bool) +> if a then b else c in f",
+    /* Nothing below a kind that is not typed is visited.  */
+    "(x, let y = z in y, if a then b else c)",
+    "f(let x = true in x)",
+    "true == (if true then x else false)",
+    /* Operands are typed even next to an invalid one.  */
+    "let x = 1, y: Int = 2 in x + y * 3 <= 4 / x",
+    "true + x <= y * if true then 1 else z",
+    "let x: Int64 = 99999999999999999999 in x + 1",
+  };
+  for (size_t i = 0; i < sizeof (sources) / sizeof (sources[0]); i++)
+    {
+      ASSERT_U64_EQ (sweep_num_mismatches (sources[i]), 0);
+    }
+}
+
+/* Checks CONTENT with and without forks on POOL, which split every if, and
+ * counts the mismatches.  */
+static size_t
+fork_num_mismatches (const char *content, ThreadPool *pool)
+{
+  TypeCheckerTest sequential;
+  TypeCheckerTest forked;
+  TypeCheckerTest_init (&sequential, content);
+  TypeCheckerTest_init (&forked, content);
+  DiagnosticManager_set_display (&sequential.diag_mgr_, false);
+  DiagnosticManager_set_display (&forked.diag_mgr_, false);
+  size_t num_diags = DiagnosticManager_num_total (&sequential.diag_mgr_);
+  ASTNodeId node_id = TypeCheckerTest_get_node_id (&sequential);
+  TypeChecker_set_pool (&forked.type_checker_, pool, 1);
+  ASTNodeIdToTypeIdMap map
+      = TypeChecker_check (&sequential.type_checker_, node_id);
+  ASTNodeIdToTypeIdMap forked_map
+      = TypeChecker_check (&forked.type_checker_, node_id);
+  size_t num_mismatches = TypeCheckerTest_num_mismatches (
+      &sequential, &map, &forked, &forked_map, num_diags);
+  ASTNodeIdToTypeIdMap_drop (&map);
+  ASTNodeIdToTypeIdMap_drop (&forked_map);
+  TypeCheckerTest_drop (&sequential);
+  TypeCheckerTest_drop (&forked);
+  return num_mismatches;
+}
+
+NEO_TEST (test_check_fork_00)
+{
+  static const char *const sources[] = {
+    "true",
+    "if true then false else true",
+    "if if true then false else true then if false then true else false\n"
+    "else if true then true else false",
+    /* Branches that are not reached keep neither types nor diagnostics.  */
+    "if (true, false) then x else y",
+    "if if true then Bool else false then x else y",
+    "if true then y else if z then w else q",
+    "if true then (if a then b else c) else (if d then e else f)",
+    "if true then true else if true then (1, z) else false",
+    "if true then let x = true in x else let y = z in if y then w else q",
+    "let x = true in if x then if x then x else y else z",
+    "if a then (if b then c else d) else if e then f else g",
+  };
+  ThreadPool pool = ThreadPool_new (2);
+  for (size_t i = 0; i < sizeof (sources) / sizeof (sources[0]); i++)
+    {
+      ASSERT_U64_EQ (fork_num_mismatches (sources[i], &pool), 0);
+    }
+  ThreadPool_drop (&pool);
+}
+
+/* Checks CONTENT by name and by address, recursively if not SWEEP, and on
+ * POOL if it is not NULL, and counts the mismatches.  */
+static size_t
+resolved_num_mismatches (const char *content, bool sweep, ThreadPool *pool)
+{
+  TypeCheckerTest by_name;
+  TypeCheckerTest by_address;
+  TypeCheckerTest_init (&by_name, content);
+  TypeCheckerTest_init (&by_address, content);
+  DiagnosticManager_set_display (&by_name.diag_mgr_, false);
+  DiagnosticManager_set_display (&by_address.diag_mgr_, false);
+  size_t num_diags = DiagnosticManager_num_total (&by_name.diag_mgr_);
+  ASTNodeId node_id = TypeCheckerTest_get_node_id (&by_name);
+  ASTScopes scopes
+      = ASTScopes_resolve (&by_address.ast_mgr_, &by_address.file_, node_id);
+  TypeChecker_set_scopes (&by_address.type_checker_, &scopes);
+  if (pool)
+    {
+      TypeChecker_set_pool (&by_name.type_checker_, pool, 1);
+      TypeChecker_set_pool (&by_address.type_checker_, pool, 1);
+    }
+  ASTNodeIdToTypeIdMap map
+      = sweep ? TypeChecker_check_sweep (&by_name.type_checker_, node_id)
+              : TypeChecker_check (&by_name.type_checker_, node_id);
+  ASTNodeIdToTypeIdMap address_map
+      = sweep ? TypeChecker_check_sweep (&by_address.type_checker_, node_id)
+              : TypeChecker_check (&by_address.type_checker_, node_id);
+  size_t num_mismatches = TypeCheckerTest_num_mismatches (
+      &by_name, &map, &by_address, &address_map, num_diags);
+  ASTNodeIdToTypeIdMap_drop (&map);
+  ASTNodeIdToTypeIdMap_drop (&address_map);
+  ASTScopes_drop (&scopes);
+  TypeCheckerTest_drop (&by_name);
+  TypeCheckerTest_drop (&by_address);
+  return num_mismatches;
+}
+
+NEO_TEST (test_check_resolved_00)
+{
+  static const char *const sources[] = {
+    "true",
+    "let x = true, y: Bool = x in if y then x else false",
+    "let x = true in let x = if x then false else true in x",
+    "let x = true, y = let z = x in z, w = let x = y in x in\n"
+    "if w then y else x",
+    "if let b = true in b then let c = false in c else true",
+    "let Bool = true, x: Bool = Bool in x",
+    "let x: Int64 = 1, y: Int = x in if x < y then x else x * 2",
+    "let x = let y = true in y, z = (let w = x in w) in z",
+    /* Unbound names, and bindings that are left unchecked.  */
+    "if true then y else z",
+    "let x: Nat = true in x",
+    "let x: Bool = (true, false), y = z in y",
+    "let x = z, y = w in q",
+    "let f = (a, b: Bool) +> if a then b else c in f",
+    "(x, let y = z in y, if a then b else c)",
+    "if true then let x = true in x else let y = z in if y then w else q",
+  };
+  ThreadPool pool = ThreadPool_new (2);
+  for (size_t i = 0; i < sizeof (sources) / sizeof (sources[0]); i++)
+    {
+      ASSERT_U64_EQ (resolved_num_mismatches (sources[i], false, NULL), 0);
+      ASSERT_U64_EQ (resolved_num_mismatches (sources[i], true, NULL), 0);
+      ASSERT_U64_EQ (resolved_num_mismatches (sources[i], false, &pool), 0);
+    }
+  ThreadPool_drop (&pool);
+}
+
+#define NO_DIAGNOSTIC (-1)
+
+/* Counts the mismatches of the type of CONTENT against EXPECT, and of the
+ * diagnostic of its check against EXPECT_DIAG, or against none if it is
+ * NO_DIAGNOSTIC.  */
+static size_t
+integer_num_mismatches (const char *content, const char *expect,
+                        int expect_diag)
+{
+  TypeCheckerTest tester;
+  TypeCheckerTest_init (&tester, content);
+  DiagnosticManager_set_display (&tester.diag_mgr_, false);
+  size_t num_diags = DiagnosticManager_num_total (&tester.diag_mgr_);
+  TypeChecker *checker = TypeCheckerTest_borrow_type_checker (&tester);
+  TypeId type_id
+      = TypeChecker_recheck (checker, TypeCheckerTest_get_node_id (&tester));
+  const char *name = TypeManager_get_name (
+      TypeCheckerTest_get_type_manager (&tester), type_id);
+  size_t num_mismatches = strcmp (name, expect) != 0;
+  if (expect_diag == NO_DIAGNOSTIC)
+    {
+      num_mismatches
+          += DiagnosticManager_num_total (&tester.diag_mgr_) != num_diags;
+    }
+  else
+    {
+      num_mismatches
+          += DiagnosticManager_num_total (&tester.diag_mgr_) != num_diags + 1
+             || DiagnosticManager_get (&tester.diag_mgr_, num_diags)->name_
+                    != (enum DiagnosticName)expect_diag;
+    }
+  TypeChecker_drop (checker);
+  TypeCheckerTest_drop (&tester);
+  return num_mismatches;
+}
+
+NEO_TEST (test_check_integer_00)
+{
+  size_t num_mismatches = 0;
+  num_mismatches += integer_num_mismatches ("42", "Int64", NO_DIAGNOSTIC);
+  num_mismatches += integer_num_mismatches ("9223372036854775807", "Int64",
+                                            NO_DIAGNOSTIC);
+  num_mismatches += integer_num_mismatches ("9223372036854775808", "Int",
+                                            NO_DIAGNOSTIC);
+  num_mismatches
+      += integer_num_mismatches ("1 + 2 * 3 - 4", "Int64", NO_DIAGNOSTIC);
+  /* Arithmetic with an Int is widened to Int.  */
+  num_mismatches += integer_num_mismatches ("1 + 99999999999999999999",
+                                            "Int", NO_DIAGNOSTIC);
+  num_mismatches += integer_num_mismatches ("let x: Int = 1 in x / 2", "Int",
+                                            NO_DIAGNOSTIC);
+  num_mismatches += integer_num_mismatches (
+      "1 < 99999999999999999999", "Bool", NO_DIAGNOSTIC);
+  num_mismatches += integer_num_mismatches ("let b = 1 == 2 in true /= b",
+                                            "Bool", NO_DIAGNOSTIC);
+  num_mismatches += integer_num_mismatches (
+      "let x: Int64 = 9223372036854775807 in x", "Int64", NO_DIAGNOSTIC);
+  num_mismatches += integer_num_mismatches (
+      "let x: Int64 = 9223372036854775808 in x", "Invalid",
+      DIAGNOSTIC_INTEGER_OUT_OF_RANGE);
+  num_mismatches += integer_num_mismatches (
+      "let x: Int = 1, y: Int64 = x in y", "Invalid",
+      DIAGNOSTIC_LET_TYPE_NOT_EQUAL);
+  num_mismatches += integer_num_mismatches (
+      "let x: Int64 = true in x", "Invalid", DIAGNOSTIC_LET_TYPE_NOT_EQUAL);
+  num_mismatches += integer_num_mismatches ("1 + true", "Invalid",
+                                            DIAGNOSTIC_OPERAND_NOT_INTEGER);
+  num_mismatches += integer_num_mismatches ("let b = true in 2 * b", "Invalid",
+                                            DIAGNOSTIC_OPERAND_NOT_INTEGER);
+  num_mismatches += integer_num_mismatches ("true < false", "Invalid",
+                                            DIAGNOSTIC_OPERAND_NOT_INTEGER);
+  /* An invalid operand is not diagnosed again.  */
+  num_mismatches
+      += integer_num_mismatches ("x + 1", "Invalid", DIAGNOSTIC_VAR_NOT_BOUND);
+  ASSERT_U64_EQ (num_mismatches, 0);
+}
+
+/* Checks TREE from NODE_ID, and appends the names of its diagnostics to
+ * DIAGS.  */
+static const char *
+folded_check (const ASTNodeManager *tree, const SourceFile *file,
+              ASTNodeId node_id, TypeManager *type_mgr, Vec_u32 *diags)
+{
+  DiagnosticManager diag_mgr = DiagnosticManager_new (file);
+  DiagnosticManager_set_display (&diag_mgr, false);
+  TypeChecker checker = TypeChecker_new (tree, &diag_mgr, type_mgr);
+  ASTNodeIdToTypeIdMap node_type_map = TypeChecker_check (&checker, node_id);
+  const char *name = TypeManager_get_name (
+      type_mgr, ASTNodeIdToTypeIdMap_get (&node_type_map, node_id));
+  for (size_t i = 0; i < DiagnosticManager_num_total (&diag_mgr); i++)
+    {
+      Vec_u32_push (diags, DiagnosticManager_get (&diag_mgr, i)->name_);
+    }
+  ASTNodeIdToTypeIdMap_drop (&node_type_map);
+  DiagnosticManager_drop (&diag_mgr);
+  return name;
+}
+
+/* Counts the mismatches of the type and the diagnostics of CONTENT folded
+ * against those of CONTENT as parsed.  */
+static size_t
+folded_num_mismatches (const char *content)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("test"),
+                                    String_from_cstring (content));
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  ASTNodeId node_id = Parser_parse_file (&file, &diag_mgr, &ast_mgr);
+  ASTNodeManager folded = ASTNodeManager_new ();
+  Folder folder = Folder_new (&ast_mgr, &file, &folded);
+  ASTNodeId folded_id = Folder_fold (&folder, node_id);
+  Folder_drop (&folder);
+  TypeManager type_mgr = TypeManager_new ();
+  Vec_u32 diags = Vec_u32_new ();
+  Vec_u32 folded_diags = Vec_u32_new ();
+  const char *name
+      = folded_check (&ast_mgr, &file, node_id, &type_mgr, &diags);
+  const char *folded_name = folded_check (&folded, &file, folded_id,
+                                          &type_mgr, &folded_diags);
+  size_t num_mismatches
+      = (strcmp (name, folded_name) != 0)
+        + (Vec_u32_len (&diags) != Vec_u32_len (&folded_diags)
+           || memcmp (Vec_u32_cbegin (&diags), Vec_u32_cbegin (&folded_diags),
+                      Vec_u32_len (&diags) * sizeof (uint32_t)));
+  Vec_u32_drop (&diags);
+  Vec_u32_drop (&folded_diags);
+  TypeManager_drop (&type_mgr);
+  ASTNodeManager_drop (&folded);
+  ASTNodeManager_drop (&ast_mgr);
+  DiagnosticManager_drop (&diag_mgr);
+  SourceFile_drop (&file);
+  return num_mismatches;
+}
+
+/* A folded integer is typed as what it was folded from, not by the text
+ * of that.  */
+NEO_TEST (test_check_folded_00)
+{
+  static const char *const cases[] = {
+    "let x: Int64 = 1 + 2 in x",
+    "let c = true in if c then 1 + 1 else 2",
+    "let x: Int = 99999999999999999999 - 99999999999999999998 in x + 1",
+    "let x: Int64 = 99999999999999999999 - 99999999999999999998 in x",
+    "let x: Int64 = 9223372036854775808 in x",
+    "9223372036854775807 + 1",
+  };
+  for (size_t i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+    {
+      ASSERT_U64_EQ (folded_num_mismatches (cases[i]), 0);
+    }
+}
+
+NEO_TESTS (type_checker_tests, test_check_true_00, test_check_if_00,
+           test_check_let_00, test_check_let_01, test_check_sweep_00,
+           test_check_fork_00, test_check_resolved_00,
+           test_check_integer_00, test_check_folded_00)
+#endif
+
+#ifdef BENCHES
+#include "bench.h"
+
+#include "parser.h"
+
+/* Checks SOURCE, which it takes, recursively or by a sweep, forking on POOL
+ * if it is not NULL.  If BY_ADDRESS, names are resolved before the check,
+ * which is timed alone.  */
+static void
+check_bench (Bencher *bencher_, String source, bool sweep, ThreadPool *pool,
+             bool by_address)
+{
+  SourceFile file = SourceFile_new (String_from_cstring ("bench"), source);
+  ASTNodeManager ast_mgr = ASTNodeManager_new ();
+  DiagnosticManager diag_mgr = DiagnosticManager_new (&file);
+  ASTNodeId node_id = Parser_parse_file (&file, &diag_mgr, &ast_mgr);
+  ASTScopes scopes = ASTScopes_resolve (&ast_mgr, &file, node_id);
+  BENCH_ITER
+  {
+    TypeManager type_mgr = TypeManager_new ();
+    TypeChecker checker = TypeChecker_new (&ast_mgr, &diag_mgr, &type_mgr);
+    if (by_address)
+      {
+        TypeChecker_set_scopes (&checker, &scopes);
+      }
+    if (pool)
+      {
+        TypeChecker_set_pool (&checker, pool, 1 << 10);
+      }
+    ASTNodeIdToTypeIdMap node_type_map
+        = sweep ? TypeChecker_check_sweep (&checker, node_id)
+                : TypeChecker_check (&checker, node_id);
+    ASTNodeIdToTypeIdMap_drop (&node_type_map);
+    TypeManager_drop (&type_mgr);
+  }
+  Bencher_report_u64 (bencher_, "nodes", ASTNodeManager_num_nodes (&ast_mgr));
+  Bencher_report_u64 (bencher_, "diags",
+                      DiagnosticManager_num_total (&diag_mgr));
+  ASTScopes_drop (&scopes);
+  DiagnosticManager_drop (&diag_mgr);
+  ASTNodeManager_drop (&ast_mgr);
+  SourceFile_drop (&file);
+}
+
+NEO_BENCH (bench_check_if_00)
+{
+  check_bench (bencher_, bench_gen_if_source (10, 42), false, NULL, false);
+}
+
+NEO_BENCH (bench_check_sweep_if_00)
+{
+  check_bench (bencher_, bench_gen_if_source (10, 42), true, NULL, false);
+}
+
+NEO_BENCH (bench_check_if_01)
+{
+  check_bench (bencher_, bench_gen_if_source (13, 42), false, NULL, false);
+}
+
+NEO_BENCH (bench_check_sweep_if_01)
+{
+  check_bench (bencher_, bench_gen_if_source (13, 42), true, NULL, false);
+}
+
+NEO_BENCH (bench_check_let_00)
+{
+  check_bench (bencher_, bench_gen_let_source (1000, 4, 42), false, NULL,
+               false);
+}
+
+NEO_BENCH (bench_check_sweep_let_00)
+{
+  check_bench (bencher_, bench_gen_let_source (1000, 4, 42), true, NULL,
+               false);
+}
+
+NEO_BENCH (bench_check_resolved_let_00)
+{
+  check_bench (bencher_, bench_gen_let_source (1000, 4, 42), false, NULL,
+               true);
+}
+
+NEO_BENCH (bench_check_sweep_resolved_let_00)
+{
+  check_bench (bencher_, bench_gen_let_source (1000, 4, 42), true, NULL,
+               true);
+}
+
+NEO_BENCH (bench_check_sweep_let_01)
+{
+  check_bench (bencher_, bench_gen_let_source (10000, 2, 42), true, NULL,
+               false);
+}
+
+NEO_BENCH (bench_check_sweep_resolved_let_01)
+{
+  check_bench (bencher_, bench_gen_let_source (10000, 2, 42), true, NULL,
+               true);
+}
+
+NEO_BENCH (bench_check_fork_if_01)
+{
+  ThreadPool pool = ThreadPool_new (3);
+  check_bench (bencher_, bench_gen_if_source (13, 42), false, &pool, false);
+  ThreadPool_drop (&pool);
+}
+
+NEO_BENCHES (type_checker_benches, bench_check_if_00, bench_check_sweep_if_00,
+             bench_check_if_01, bench_check_sweep_if_01,
+             bench_check_fork_if_01, bench_check_let_00,
+             bench_check_sweep_let_00, bench_check_resolved_let_00,
+             bench_check_sweep_resolved_let_00, bench_check_sweep_let_01,
+             bench_check_sweep_resolved_let_01)
 #endif
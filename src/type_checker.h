@@ -3,9 +3,14 @@
 #ifndef NEO_TYPE_CHECKER_H
 #define NEO_TYPE_CHECKER_H
 
+#include <stdatomic.h>
+
 #include "ast_node.h"
 #include "diagnostic.h"
+#include "resolver.h"
+#include "thread_pool.h"
 #include "type.h"
+#include "vec.h"
 #include "vec_macro.h"
 
 typedef struct ASTNodeIdToTypeIdMap
@@ -17,22 +22,78 @@ void ASTNodeIdToTypeIdMap_drop (ASTNodeIdToTypeIdMap *self);
 TypeId ASTNodeIdToTypeIdMap_get (const ASTNodeIdToTypeIdMap *self,
                                  ASTNodeId node_id);
 
+typedef struct TypeForks TypeForks;
+
 typedef struct TypeChecker
 {
   const ASTNodeManager *ast_mgr_;
   DiagnosticManager *diag_mgr_;
   TypeManager *type_mgr_;
   ASTNodeIdToTypeIdMap map_;
+  /* The diagnostics reported while each node was typed by the last
+   * recheck, its subtree included.  */
+  Vec_u32 num_diags_;
+  /* Nodes typed rather than looked up in the map.  */
+  size_t num_typed_;
+  /* Nodes whose types were forgotten, to be typed again.  */
+  size_t num_forgotten_;
+  /* Types large subtrees on the pool in TypeChecker_check if not NULL.  */
+  ThreadPool *pool_;
+  size_t min_fork_nodes_;
+  /* The forks to join while the nodes above them are typed.  */
+  TypeForks *forks_;
+  /* Finds names by their addresses if not NULL.  */
+  const ASTScopes *scopes_;
+  /* Makes the check give up once set, if not NULL.  */
+  const atomic_bool *cancel_;
 } TypeChecker;
 
 TypeChecker TypeChecker_new (const ASTNodeManager *ast_mgr,
                              DiagnosticManager *diag_mgr,
                              TypeManager *type_mgr);
+/* Lets TypeChecker_check type the branches of ifs of at least
+ * MIN_FORK_NODES nodes on POOL, each alone.  The map and the diagnostics
+ * stay those of a check without POOL.  */
+void TypeChecker_set_pool (TypeChecker *self, ThreadPool *pool,
+                           size_t min_fork_nodes);
+/* Lets the checker find vars and types in flat frames by the addresses of
+ * SCOPES, rather than by name.  SCOPES must be resolved from the tree as it
+ * is checked, so it does not hold across edits.  */
+void TypeChecker_set_scopes (TypeChecker *self, const ASTScopes *scopes);
+/* Makes the checks of SELF give up once CANCEL is set, and return
+ * TYPE_UNKNOWN.  The nodes typed by then keep their types and the rest stay
+ * unknown, so that the next recheck carries on from there.  */
+void TypeChecker_set_cancel (TypeChecker *self, const atomic_bool *cancel);
+/* Only needed by a checker that keeps its map, see TypeChecker_recheck.  */
+void TypeChecker_drop (TypeChecker *self);
+/* Hands the map over to the caller.  */
 ASTNodeIdToTypeIdMap TypeChecker_check (TypeChecker *self, ASTNodeId node_id);
+/* Like TypeChecker_check, but types a fresh parse in one pass from the
+ * front of the manager, where children come before their parents, with no
+ * recursion.  Falls back to TypeChecker_check if the subtree of NODE_ID is
+ * not laid out that way, as after an incremental edit.  Must be the first
+ * check of SELF.  */
+ASTNodeIdToTypeIdMap TypeChecker_check_sweep (TypeChecker *self,
+                                              ASTNodeId node_id);
+/* Checks NODE_ID again and keeps the map, so that only the nodes invalidated
+ * or added to the manager since the last check are typed, along with the
+ * subtrees that reported diagnostics then, which report them again.  */
+TypeId TypeChecker_recheck (TypeChecker *self, ASTNodeId node_id);
+/* Forgets the types of IDS, the path down to a subtree that was replaced.  A
+ * let whose bindings then change forgets the types in their scope itself,
+ * and the last of IDS does here if the subtree was one of its vars.  */
+void TypeChecker_invalidate (TypeChecker *self, const ASTNodeId *ids,
+                             size_t len);
+const ASTNodeIdToTypeIdMap *TypeChecker_get_map (const TypeChecker *self);
 
 #ifdef TESTS
 #include "test.h"
 Tests type_checker_tests ();
 #endif
 
+#ifdef BENCHES
+#include "bench.h"
+Benches type_checker_benches ();
+#endif
+
 #endif
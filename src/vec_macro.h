@@ -11,15 +11,24 @@
 
 #include "result.h"
 
+/* See arena.h, which cannot be included here: its tests depend on headers
+ * that instantiate vectors.  */
+typedef struct Arena Arena;
+void *Arena_realloc (Arena *self, void *ptr, size_t old_size,
+                     size_t new_size);
+
 #define NEO_DECL_VEC(N, T)                                                    \
   typedef struct Vec_##N                                                      \
   {                                                                           \
     T *begin_;                                                                \
     T *end_;                                                                  \
     T *end_cap_;                                                              \
+    Arena *arena_;                                                            \
   } Vec_##N;                                                                  \
                                                                               \
+  Vec_##N Vec_##N##_with_capacity_in (Arena *arena, size_t capacity);         \
   Vec_##N Vec_##N##_with_capacity (size_t capacity);                          \
+  Vec_##N Vec_##N##_new_in (Arena *arena);                                    \
   Vec_##N Vec_##N##_new ();                                                   \
   void Vec_##N##_drop (Vec_##N *self);                                        \
   bool Vec_##N##_is_empty (const Vec_##N *self);                              \
@@ -32,26 +41,46 @@
   T *Vec_##N##_begin (Vec_##N *self);                                         \
   T *Vec_##N##_end (Vec_##N *self);                                           \
   void Vec_##N##_reserve (Vec_##N *self, size_t additional);                  \
+  void Vec_##N##_reserve_exact (Vec_##N *self, size_t additional);            \
+  void Vec_##N##_shrink_to_fit (Vec_##N *self);                               \
   void Vec_##N##_push_uninit (Vec_##N *self);                                 \
   void Vec_##N##_push (Vec_##N *self, T value);                               \
   T Vec_##N##_pop (Vec_##N *self);                                            \
+  void Vec_##N##_extend (Vec_##N *self, T const *items, size_t num_items);    \
   void Vec_##N##_resize (Vec_##N *self, size_t new_len, T value);             \
+  void Vec_##N##_splice (Vec_##N *self, size_t index, size_t num_removed,     \
+                         T const *items, size_t num_items);                   \
   void Vec_##N##_clear (Vec_##N *self);
 
 #define NEO_IMPL_VEC(N, T)                                                    \
-  Vec_##N Vec_##N##_with_capacity (size_t capacity)                           \
+  Vec_##N Vec_##N##_with_capacity_in (Arena *arena, size_t capacity)          \
   {                                                                           \
-    Vec_##N res                                                               \
-        = (Vec_##N){ .begin_ = NULL, .end_ = NULL, .end_cap_ = NULL };        \
-    Vec_##N##_reserve (&res, capacity);                                       \
+    Vec_##N res = (Vec_##N){                                                  \
+      .begin_ = NULL, .end_ = NULL, .end_cap_ = NULL, .arena_ = arena         \
+    };                                                                        \
+    Vec_##N##_reserve_exact (&res, capacity);                                 \
     return res;                                                               \
   }                                                                           \
                                                                               \
+  Vec_##N Vec_##N##_with_capacity (size_t capacity)                           \
+  {                                                                           \
+    return Vec_##N##_with_capacity_in (NULL, capacity);                       \
+  }                                                                           \
+                                                                              \
+  Vec_##N Vec_##N##_new_in (Arena *arena)                                     \
+  {                                                                           \
+    return Vec_##N##_with_capacity_in (arena, 0);                             \
+  }                                                                           \
+                                                                              \
   Vec_##N Vec_##N##_new () { return Vec_##N##_with_capacity (0); }            \
                                                                               \
   void Vec_##N##_drop (Vec_##N *self)                                         \
   {                                                                           \
-    free (self->begin_);                                                      \
+    /* Arena-backed storage is released with the arena.  */                   \
+    if (self->arena_ == NULL)                                                 \
+      {                                                                       \
+        free (self->begin_);                                                  \
+      }                                                                       \
     self->begin_ = NULL;                                                      \
     self->end_ = NULL;                                                        \
     self->end_cap_ = NULL;                                                    \
@@ -104,20 +133,25 @@
                                                                               \
   T *Vec_##N##_end (Vec_##N *self) { return self->end_; }                     \
                                                                               \
-  void Vec_##N##_reserve (Vec_##N *self, size_t additional)                   \
+  /* Moves the values to storage for exactly NEW_CAP of them.  */             \
+  static void Vec_##N##_set_capacity_ (Vec_##N *self, size_t new_cap)         \
   {                                                                           \
     size_t len = Vec_##N##_len (self);                                        \
     size_t cap = Vec_##N##_capacity (self);                                   \
-    if (len + additional <= cap)                                              \
+    assert (len <= new_cap);                                                  \
+    if (new_cap == 0 && self->arena_ == NULL)                                 \
       {                                                                       \
+        free (self->begin_);                                                  \
+        self->begin_ = NULL;                                                  \
+        self->end_ = NULL;                                                    \
+        self->end_cap_ = NULL;                                                \
         return;                                                               \
       }                                                                       \
-    size_t new_cap = cap ? 2 * cap : 8;                                       \
-    while (len + additional > new_cap)                                        \
-      {                                                                       \
-        new_cap *= 2;                                                         \
-      }                                                                       \
-    self->begin_ = (T *)realloc (self->begin_, sizeof (T) * new_cap);         \
+    self->begin_                                                              \
+        = self->arena_ ? (T *)Arena_realloc (self->arena_, self->begin_,      \
+                                             sizeof (T) * cap,                \
+                                             sizeof (T) * new_cap)            \
+                       : (T *)realloc (self->begin_, sizeof (T) * new_cap);   \
     if (self->begin_ == NULL)                                                 \
       {                                                                       \
         abort ();                                                             \
@@ -126,6 +160,47 @@
     self->end_cap_ = self->begin_ + new_cap;                                  \
   }                                                                           \
                                                                               \
+  /* Grows to at least twice the capacity, so that pushes take amortized      \
+   * constant time.  Small values start at a few of them, not one.  */        \
+  void Vec_##N##_reserve (Vec_##N *self, size_t additional)                   \
+  {                                                                           \
+    size_t len = Vec_##N##_len (self);                                        \
+    size_t cap = Vec_##N##_capacity (self);                                   \
+    if (len + additional <= cap)                                              \
+      {                                                                       \
+        return;                                                               \
+      }                                                                       \
+    size_t new_cap = 2 * cap;                                                 \
+    if (new_cap < len + additional)                                           \
+      {                                                                       \
+        new_cap = len + additional;                                           \
+      }                                                                       \
+    size_t min_cap = sizeof (T) == 1 ? 8 : sizeof (T) <= 1024 ? 4 : 1;        \
+    Vec_##N##_set_capacity_ (self, new_cap < min_cap ? min_cap : new_cap);    \
+  }                                                                           \
+                                                                              \
+  /* Grows to room for exactly ADDITIONAL more values, for a length known     \
+   * up front.  */                                                            \
+  void Vec_##N##_reserve_exact (Vec_##N *self, size_t additional)             \
+  {                                                                           \
+    size_t len = Vec_##N##_len (self);                                        \
+    if (len + additional > Vec_##N##_capacity (self))                         \
+      {                                                                       \
+        Vec_##N##_set_capacity_ (self, len + additional);                     \
+      }                                                                       \
+  }                                                                           \
+                                                                              \
+  /* Gives the spare capacity back.  Storage in an arena cannot be given      \
+   * back, so it is kept.  */                                                 \
+  void Vec_##N##_shrink_to_fit (Vec_##N *self)                                \
+  {                                                                           \
+    if (self->arena_ == NULL                                                  \
+        && Vec_##N##_len (self) < Vec_##N##_capacity (self))                  \
+      {                                                                       \
+        Vec_##N##_set_capacity_ (self, Vec_##N##_len (self));                 \
+      }                                                                       \
+  }                                                                           \
+                                                                              \
   void Vec_##N##_push_uninit (Vec_##N *self)                                  \
   {                                                                           \
     Vec_##N##_reserve (self, 1);                                              \
@@ -146,19 +221,53 @@
     return *self->end_;                                                       \
   }                                                                           \
                                                                               \
+  void Vec_##N##_extend (Vec_##N *self, T const *items, size_t num_items)     \
+  {                                                                           \
+    Vec_##N##_reserve (self, num_items);                                      \
+    if (num_items)                                                            \
+      {                                                                       \
+        memcpy (self->end_, items, sizeof (T) * num_items);                   \
+      }                                                                       \
+    self->end_ += num_items;                                                  \
+  }                                                                           \
+                                                                              \
+  /* Fills the new values in one pass after growing once, which the           \
+   * compiler can turn into a memset.  */                                     \
   void Vec_##N##_resize (Vec_##N *self, size_t new_len, T value)              \
   {                                                                           \
     size_t old_len = Vec_##N##_len (self);                                    \
-    if (new_len <= old_len)                                                   \
+    if (new_len > old_len)                                                    \
       {                                                                       \
-        self->end_ = self->begin_ + new_len;                                  \
-        return;                                                               \
+        Vec_##N##_reserve (self, new_len - old_len);                          \
+        for (T *ptr = self->end_; ptr < self->begin_ + new_len; ptr++)        \
+          {                                                                   \
+            *ptr = value;                                                     \
+          }                                                                   \
+      }                                                                       \
+    self->end_ = self->begin_ + new_len;                                      \
+  }                                                                           \
+                                                                              \
+  /* Replaces NUM_REMOVED values at INDEX with a copy of ITEMS.  */           \
+  void Vec_##N##_splice (Vec_##N *self, size_t index, size_t num_removed,     \
+                         T const *items, size_t num_items)                    \
+  {                                                                           \
+    size_t len = Vec_##N##_len (self);                                        \
+    assert (index + num_removed <= len);                                      \
+    if (num_items > num_removed)                                              \
+      {                                                                       \
+        Vec_##N##_reserve (self, num_items - num_removed);                    \
+      }                                                                       \
+    size_t num_moved = len - index - num_removed;                             \
+    if (num_moved && num_items != num_removed)                                \
+      {                                                                       \
+        memmove (self->begin_ + index + num_items,                            \
+                 self->begin_ + index + num_removed, sizeof (T) * num_moved); \
       }                                                                       \
-    Vec_##N##_reserve (self, new_len - old_len);                              \
-    for (size_t i = 0; i < new_len - old_len; i++)                            \
+    if (num_items)                                                            \
       {                                                                       \
-        Vec_##N##_push (self, value);                                         \
+        memcpy (self->begin_ + index, items, sizeof (T) * num_items);         \
       }                                                                       \
+    self->end_ = self->begin_ + len - num_removed + num_items;                \
   }                                                                           \
                                                                               \
   void Vec_##N##_clear (Vec_##N *self) { self->end_ = self->begin_; }